@@ -0,0 +1,51 @@
+/* Network namespace helpers of the diagnostic engines
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: diag_netns.h
+ *
+ * Purpose: To run the setup of the native diagnostic engines, or the
+ *          diagnostic commands, inside the namespace of a VRF
+ */
+
+#ifndef _DIAG_NETNS_H
+#define _DIAG_NETNS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* directory of the named namespaces */
+#define DIAG_NETNS_DIR          "/var/run/netns"
+
+/* namespace of the management (OOBM) interface */
+#define DIAG_NETNS_OOBM         "/proc/1/ns/net"
+
+/* namespace of the default vrf */
+#define DIAG_NETNS_DEFAULT      "swns"
+
+/* function run inside a namespace */
+typedef void (*diag_netns_fn)(void *aux);
+
+/* function displaying a line of output */
+typedef void (*diag_netns_output_fn)(char *line);
+
+int diag_netns_run(const char *name, bool mgmt, diag_netns_fn fn, void *aux);
+int diag_netns_exec(char *const argv[], bool keepNewline,
+                    diag_netns_output_fn fPtr);
+int diag_netns_spawn(char *const argv[], pid_t *pid);
+int diag_netns_wait(pid_t pid, const char *path);
+#endif /* _DIAG_NETNS_H */
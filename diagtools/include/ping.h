@@ -25,6 +25,7 @@
 #define _PING_H
 
 #include <stdbool.h>
+#include <netinet/in.h>
 #include "uuid.h"
 
 #define PING_STR            "Send ping requests to a device on the network\n"
@@ -63,6 +64,18 @@
 "Enter interval value in the range in seconds. (Default: 1 second)\n"
 #define INPUT_COUNT \
 "Enter Repetition value in the range. (Default: 5)\n"
+#define PING_SWEEP \
+"Ping many devices at once and display their reachability\n"
+#define PING_SWEEP_PREFIX \
+"Enter the IPv4 prefix of the devices to ping\n"
+#define PING_SWEEP_LIST \
+"Enter the comma separated IPv4 addresses of the devices to ping\n"
+#define INPUT_SWEEP_COUNT \
+"Enter the number of requests per device. (Default: 2)\n"
+#define PING_SWEEP_RATE \
+"Specify the maximum number of requests sent per second\n"
+#define INPUT_SWEEP_RATE \
+"Enter rate value in the range. (Default: 100 requests per second)\n"
 #define VRF     "Specifies the virtual routing and forwarding (VRF) to use\n"
 #define INPUT_VRF   "Specify the vrf name\n"
 #define MANAGEMENT "Specifies to use the management interface \n"
@@ -74,6 +87,14 @@
 #define PING_DEF_TIMEOUT        2
 #define PING_DEF_COUNT          5
 #define PING_DEF_SIZE           100
+#define PING_DEF_INTERVAL       1
+
+/* ping sweep limits and default values */
+#define PING_SWEEP_MAX_TARGETS  1024
+#define PING_SWEEP_MIN_PLEN     22
+#define PING_SWEEP_DEF_COUNT    2
+#define PING_SWEEP_DEF_RATE     100
+#define PING_SWEEP_DATA_SIZE    56
 
 /* default ping cmd */
 #define PING4_DEF_CMD       "ping"
@@ -84,6 +105,9 @@
 /* path of file which executes comamnd in a particular namespace */
 #define EXE_PATH    "/usr/bin/./nwdiag"
 
+/* arguments of the command, nwdiag and its namespace included */
+#define PING_EXEC_MAX_ARGS  24
+
 /* default vrf */
 #define DEFAULT_VRF_NAME "swns"
 
@@ -120,10 +144,21 @@ typedef struct pingEntry_t {
     bool mgmt;
 } pingEntry;
 
+/* structure to store the value of ping sweep tokens */
+typedef struct pingSweep_t {
+    pingEntry entry;            /* repetitions, timeout, vrf and mgmt */
+    struct in_addr targets[PING_SWEEP_MAX_TARGETS];
+    uint16_t nTargets;
+    uint16_t rate;              /* requests per second */
+} pingSweep;
+
 /* prototypes of functions */
 void printPingOutput (char *);
 int decodeParam (const char*, pingArguments, pingEntry *);
+int decodeSweepTargets (const char*, pingSweep *);
 bool ping_main (pingEntry *, void (*fPtr)(char *));
+bool ping_sweep (pingSweep *, void (*fPtr)(char *));
 extern struct cmd_element cli_ping_cmd;
 extern struct cmd_element cli_ping6_cmd;
+extern struct cmd_element cli_ping_sweep_cmd;
 #endif /* _PING_H */
@@ -0,0 +1,94 @@
+/* Native ping engine header file
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: ping_engine.h
+ *
+ * Purpose: To add declarations of the in-process ICMP echo engine
+ */
+
+#ifndef _PING_ENGINE_H
+#define _PING_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "ping.h"
+
+/* ICMP echo header length */
+#define PING_ICMP_HDRLEN        8
+
+/* IPv4 options length */
+#define PING_MAX_IPOPTLEN       40
+
+#define NSEC_PER_SEC            1000000000LL
+#define NSEC_PER_MSEC           1000000LL
+
+/* receive buffer, large enough for any reply */
+#define PING_RECV_BUFSIZE       65536
+
+/* ICMP echo socket */
+struct ping_socket {
+    int fd;
+    int family;
+    bool raw;           /* raw socket, else ICMP datagram socket */
+    uint16_t ident;     /* echo identifier, the kernel owns it on datagram
+                           sockets */
+};
+
+/* kind of a received message */
+typedef enum {
+    PING_REPLY_NONE,    /* not for this socket, or malformed */
+    PING_REPLY_ECHO,    /* echo reply */
+    PING_REPLY_ERROR,   /* ICMP error about one of the requests */
+    PING_REPLY_LOCAL    /* local error about one of the requests */
+} pingReplyKind;
+
+/* message received on an echo socket */
+struct ping_reply {
+    pingReplyKind kind;
+    struct sockaddr_storage from;   /* replier, or offender of an error */
+    uint16_t seq;                   /* sequence of the request */
+    int ttl;                        /* -1 when unknown */
+    uint8_t type;                   /* ICMP type of an error */
+    uint8_t code;                   /* ICMP code of an error */
+    uint32_t info;                  /* MTU of an error */
+    int error;                      /* errno of a local error */
+    size_t len;                     /* ICMP length of a reply */
+    const uint8_t *data;            /* echo data of a reply */
+    size_t dataLen;
+    uint8_t options[PING_MAX_IPOPTLEN]; /* IPv4 options of a reply */
+    size_t optionsLen;
+    struct timespec stamp;          /* receive time */
+};
+
+/* prototypes of functions */
+int ping_socket_open(struct ping_socket *, int family);
+void ping_socket_close(struct ping_socket *);
+int ping_send(struct ping_socket *, const struct sockaddr *, socklen_t,
+              uint16_t seq, const uint8_t *data, size_t len,
+              struct timespec *sent);
+int ping_recv(struct ping_socket *, uint8_t *buf, size_t size,
+              bool errQueue, struct ping_reply *);
+void ping_error_str(int family, const struct ping_reply *,
+                    char *buf, size_t size);
+double ping_rtt_ms(const struct timespec *sent, const struct timespec *rcvd);
+long long ping_monotonic_ns(void);
+const char *ping_addr_str(const struct sockaddr_storage *, char *buf);
+int ping_native(pingEntry *, void (*fPtr)(char *));
+#endif /* _PING_ENGINE_H */
@@ -64,6 +64,14 @@
 "Enter probes value (Default: 3)\n"
 #define DSTPORT_INPUT \
 "Enter destination port value (Default: 33434)\n"
+#define TRACEROUTE_PROBE \
+"Specify the type of the probe packets\n"
+#define PROBE_UDP \
+"Send UDP datagrams to unlikely ports (Default)\n"
+#define PROBE_ICMP \
+"Send ICMP echo requests\n"
+#define PROBE_TCP \
+"Send TCP SYN to the destination port (Default port: 80)\n"
 #define VRF     "Specifies the virtual routing and forwarding (VRF) to use\n"
 #define INPUT_VRF   "Specify the vrf name\n"
 #define MANAGEMENT "Specifies to use the management interface \n"
@@ -76,14 +84,24 @@
 #define TRACE_DEF_MINTTL                1
 #define TRACE_DEF_MAXTTL                30
 #define TRACE_DEF_WAIT                  3
+#define TRACE_DEF_TCP_PORT              80
+
+/* probes of the native traceroute */
+#define TRACE_DATA_SIZE                 32
+#define TRACE_MAX_INFLIGHT              128
 
 /* default traceroute cmd */
 #define TRACEROUTE4_DEF_CMD             "traceroute"
 #define TRACEROUTE6_DEF_CMD             "traceroute6"
+#define TRACEROUTE_ICMP_OPT             "-I"
+#define TRACEROUTE_TCP_OPT              "-T"
 
 /* path of file which executes comamnd in a particular namespace */
 #define EXE_PATH    "/usr/bin/./nwdiag"
 
+/* arguments of the command, nwdiag and its namespace included */
+#define TRACE_EXEC_MAX_ARGS  24
+
 /* default vrf */
 #define DEFAULT_VRF_NAME "swns"
 
@@ -98,9 +116,17 @@ typedef enum {
     TIME_OUT,
     IPV6_DESTINATION,
     TRACEROUTE_VRF_NAME,
-    TRACEROUTE_MGMT
+    TRACEROUTE_MGMT,
+    TRACEROUTE_PROBE_TYPE
 }arguments;
 
+/* type of the probe packets */
+typedef enum {
+    TRACE_PROBE_UDP,
+    TRACE_PROBE_ICMP,
+    TRACE_PROBE_TCP
+} traceProbeType;
+
 /*structure to store the traceroute tockens*/
 typedef struct tracerouteEntry_t {
     bool isIpv4;
@@ -113,11 +139,13 @@ typedef struct tracerouteEntry_t {
     char *tracerouteLoosesourceIp;
     char vrf_n[UUID_LEN + 1];
     bool mgmt;
+    traceProbeType tracerouteProbeType;
 } tracerouteEntry;
 
 /*prototypes of the functions*/
 void printOutput(char *);
 bool traceroute_handler(tracerouteEntry *, void (*fPtr)(char *));
+int traceroute_native(tracerouteEntry *, void (*fPtr)(char *));
 int decodeTracerouteParam(const char*, arguments, tracerouteEntry *);
 extern struct cmd_element cli_traceroute_cmd;
 extern struct cmd_element cli_traceroute6_cmd;
@@ -20,8 +20,6 @@
  */
 
 #define _GNU_SOURCE
-#include <fcntl.h>
-#include <sched.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -32,29 +30,29 @@
 #define PING6             "ping6"
 #define TRACEROUTE        "traceroute"
 #define TRACEROUTE6       "traceroute6"
-#define BUFFSIZE          1024
-#define NSPATHSIZE        280
 #define NAMESPACELENGTH   256
 
+/* commands allowed to run in a namespace */
+static const char *const commands[] = {
+    PING, PING6, TRACEROUTE, TRACEROUTE6, NULL
+};
+
 int main(int argc, char *argv[])
 {
-    int len = 0;
-    FILE *fp = NULL;
-    /* Assuming max namespace name size as 256 */
-    char buffer[BUFFSIZE];
-    char *target = buffer;
+    int i;
 
     /* Arguments to be passed in below order.
      * argv[1] = namespace name.
      * argv[2] = command to execute.
-     * argv[3] = parameters required by command.
+     * argv[3...] = parameters required by command, one per argument.
+     * The command is executed directly, no shell parses the parameters.
      */
     if (argc < 3) {
         printf("Invalid number of arguments specified\n");
         exit(0);
     }
 
-    if (strncmp("mgmt", (char*)argv[1], strlen("mgmt")) == 0)
+    if (strcmp("mgmt", argv[1]) == 0)
     {
         if (nl_setns_oobm() == -1)
         {
@@ -64,13 +62,13 @@ int main(int argc, char *argv[])
     }
     else
     {
-        if (strlen((char*)argv[1]) > NAMESPACELENGTH)
+        if (strlen(argv[1]) > NAMESPACELENGTH)
         {
             printf("Internal error, invalid vrf\n");
             exit(0);
         }
 
-        if (nl_setns_with_name((char*)argv[1]) == -1)
+        if (nl_setns_with_name(argv[1]) == -1)
         {
             printf("Internal error, vrf not found\n");
             exit(0);
@@ -78,48 +76,25 @@ int main(int argc, char *argv[])
     }
 
     /* Change to current user */
-    setuid(getuid());
-
-    if ((strncmp(PING, argv[2], strlen(argv[2])) == 0))
-    {
-        len += snprintf(target+len, BUFFSIZE, "%s ", PING);
-    }
-    else if ((strncmp(PING6, argv[2], strlen(argv[2])) == 0))
-    {
-        len += snprintf(target+len, BUFFSIZE, "%s ", PING6);
-    }
-    else if ((strncmp(TRACEROUTE, argv[2], strlen(argv[2])) == 0))
-    {
-        len += snprintf(target+len, BUFFSIZE, "%s ", TRACEROUTE);
-    }
-    else if ((strncmp(TRACEROUTE6, argv[2], strlen(argv[2])) == 0))
-    {
-        len += snprintf(target+len, BUFFSIZE, "%s ", TRACEROUTE6);
-    }
-    else
+    if (setuid(getuid()) == -1)
     {
-        printf("Internal error: unsupported operation\n");
-        exit (0);
+        printf("Internal error, failed to change user\n");
+        exit(0);
     }
 
-    if (strlen((char*)argv[3]) < (BUFFSIZE-len))
-    {
-        len += snprintf(target+len, BUFFSIZE-len, "%s ", argv[3]);
-    }
-    else
+    for (i = 0; commands[i]; i++)
     {
-        printf("Internal error: buffer overflow\n");
-        exit (0);
+        if (strcmp(commands[i], argv[2]) == 0)
+            break;
     }
-    fp = popen(buffer, "w");
-    if (fp)
+    if (!commands[i])
     {
-        while (fgets(buffer, BUFFSIZE, fp) != NULL)
-            printf("%s", buffer);
+        printf("Internal error: unsupported operation\n");
+        exit(0);
     }
-    else
-        printf("Internal error");
-
-    pclose(fp);
 
+    fflush(stdout);
+    execvp(commands[i], &argv[2]);
+    printf("Internal error, failed to execute %s\n", commands[i]);
+    exit(127);
 }
@@ -0,0 +1,383 @@
+/* Network namespace helpers of the diagnostic engines
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: diag_netns.c
+ *
+ * Purpose: To run the setup of the native diagnostic engines, or the
+ *          diagnostic commands, inside the namespace of a VRF.
+ *
+ * A socket belongs to the namespace of the thread which creates it, and
+ * keeps it afterwards. The engines create their sockets (and resolve their
+ * targets) from a short-lived thread which enters the namespace with
+ * setns(); the vtysh thread never leaves its own namespace.
+ *
+ * The namespace descriptors stay open between the runs, one per VRF, so that
+ * back-to-back diagnostics do not resolve and open the namespace again. The
+ * cache follows the VRF table: when the IDL changed, the descriptors of the
+ * namespaces no longer used by a VRF are closed, and the new ones opened.
+ * Before a cached descriptor is used, its identity is checked against the
+ * namespace currently mounted under the name, so that a namespace deleted
+ * and created again between two refreshes is opened again.
+ *
+ * When the engines cannot start, the command runs through the setuid nwdiag
+ * helper, which enters the namespace and executes it. Its argv is passed as
+ * is, without a shell, and its output streams back through a pipe.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "diag_netns.h"
+#include "ovsdb-idl.h"
+#include "shash.h"
+#include "sset.h"
+#include "util.h"
+#include "uuid.h"
+#include "vswitch-idl.h"
+#include "vrf-utils.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(diag_netns);
+
+extern struct ovsdb_idl *idl;
+
+/* cached namespace descriptor */
+struct diag_netns_entry {
+    int fd;                 /* -1 until the namespace exists */
+    dev_t dev;              /* identity of the namespace opened */
+    ino_t ino;
+};
+
+/* namespace descriptors by namespace name */
+static struct shash diag_netns_cache = SHASH_INITIALIZER(&diag_netns_cache);
+
+/* management namespace descriptor, it never changes */
+static int diag_netns_oobm_fd = -1;
+
+/* IDL sequence number of the last refresh of the cache */
+static unsigned int diag_netns_seqno;
+static bool diag_netns_synced;
+
+/* context of the namespace thread */
+struct diag_netns_thread {
+    int fd;
+    diag_netns_fn fn;
+    void *aux;
+    int error;
+};
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_thread_main
+| Responsibility : Enter the namespace and run the function
+| Parameters : void *arg : pointer to the thread context
+| Return : NULL
+-----------------------------------------------------------------------------*/
+static void *diag_netns_thread_main(void *arg)
+{
+    struct diag_netns_thread *t = arg;
+
+    if (setns(t->fd, CLONE_NEWNET) < 0)
+    {
+        t->error = errno;
+        return NULL;
+    }
+    t->fn(t->aux);
+    return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_open
+| Responsibility : Open a namespace
+| Parameters : const char *path : path of the namespace
+| Return : namespace descriptor, -1 on failure
+-----------------------------------------------------------------------------*/
+static int diag_netns_open(const char *path)
+{
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        VLOG_DBG("open %s failed (%s)", path, strerror(errno));
+    return fd;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_lookup
+| Responsibility : Find the cached descriptor of a namespace, opening it the
+|                  first time
+| Parameters : const char *name : namespace name
+| Return : cached namespace, NULL for an invalid name
+-----------------------------------------------------------------------------*/
+static struct diag_netns_entry *diag_netns_lookup(const char *name)
+{
+    struct diag_netns_entry *ns;
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (strchr(name, '/') || !strcmp(name, ".") || !strcmp(name, ".."))
+        return NULL;
+
+    ns = shash_find_data(&diag_netns_cache, name);
+    if (!ns)
+    {
+        ns = xmalloc(sizeof *ns);
+        ns->fd = -1;
+        shash_add(&diag_netns_cache, name, ns);
+    }
+    snprintf(path, sizeof path, "%s/%s", DIAG_NETNS_DIR, name);
+    if (ns->fd >= 0
+        && (stat(path, &st) < 0 || st.st_dev != ns->dev
+            || st.st_ino != ns->ino))
+    {
+        /* Namespace deleted, or created again under the same name */
+        VLOG_DBG("namespace %s changed, reopening it", name);
+        close(ns->fd);
+        ns->fd = -1;
+    }
+    if (ns->fd < 0)
+    {
+        /* Namespace of a new vrf, or not yet created at the last refresh */
+        ns->fd = diag_netns_open(path);
+        if (ns->fd >= 0 && fstat(ns->fd, &st) < 0)
+        {
+            close(ns->fd);
+            ns->fd = -1;
+        }
+        else if (ns->fd >= 0)
+        {
+            ns->dev = st.st_dev;
+            ns->ino = st.st_ino;
+        }
+    }
+    return ns;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_refresh
+| Responsibility : Make the cache match the VRF table after a change of the
+|                  IDL, closing the namespaces of the deleted VRFs and opening
+|                  the ones of the added VRFs
+| Parameters : none
+| Return : void
+-----------------------------------------------------------------------------*/
+static void diag_netns_refresh(void)
+{
+    const struct ovsrec_vrf *vrf_row = NULL;
+    struct shash_node *node, *next;
+    struct diag_netns_entry *ns;
+    char nsName[UUID_LEN + 1];
+    struct sset names;
+    const char *name;
+    unsigned int seqno;
+
+    if (!idl)
+        return;
+    seqno = ovsdb_idl_get_seqno(idl);
+    if (diag_netns_synced && seqno == diag_netns_seqno)
+        return;
+    diag_netns_seqno = seqno;
+    diag_netns_synced = true;
+
+    sset_init(&names);
+    sset_add(&names, DIAG_NETNS_DEFAULT);
+    OVSREC_VRF_FOR_EACH (vrf_row, idl)
+    {
+        if (get_vrf_ns_from_name(idl, vrf_row->name, nsName) != -1)
+            sset_add(&names, nsName);
+    }
+
+    SHASH_FOR_EACH_SAFE (node, next, &diag_netns_cache)
+    {
+        if (sset_contains(&names, node->name))
+            continue;
+        ns = node->data;
+        if (ns->fd >= 0)
+            close(ns->fd);
+        free(ns);
+        shash_delete(&diag_netns_cache, node);
+    }
+
+    SSET_FOR_EACH (name, &names)
+    {
+        diag_netns_lookup(name);
+    }
+    sset_destroy(&names);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_run
+| Responsibility : Run a function on a thread inside a namespace
+| Parameters : const char *name : namespace name, the default vrf when empty
+|              bool mgmt : run in the management namespace instead
+|              diag_netns_fn fn : function to run
+|              void *aux : argument of the function
+| Return : 0 when the function ran, errno value otherwise
+-----------------------------------------------------------------------------*/
+int diag_netns_run(const char *name, bool mgmt, diag_netns_fn fn, void *aux)
+{
+    struct diag_netns_thread t;
+    struct diag_netns_entry *ns;
+    pthread_t thread;
+    int error;
+
+    diag_netns_refresh();
+
+    memset(&t, 0, sizeof t);
+    t.fn = fn;
+    t.aux = aux;
+    if (mgmt)
+    {
+        if (diag_netns_oobm_fd < 0)
+            diag_netns_oobm_fd = diag_netns_open(DIAG_NETNS_OOBM);
+        t.fd = diag_netns_oobm_fd;
+    }
+    else
+    {
+        if (!name || !*name)
+            name = DIAG_NETNS_DEFAULT;
+        ns = diag_netns_lookup(name);
+        if (!ns)
+            return EINVAL;
+        t.fd = ns->fd;
+    }
+    if (t.fd < 0)
+        return ENOENT;
+
+    error = pthread_create(&thread, NULL, diag_netns_thread_main, &t);
+    if (!error)
+    {
+        pthread_join(thread, NULL);
+        error = t.error;
+    }
+    if (error)
+        VLOG_DBG("cannot run in namespace %s (%s)",
+                 mgmt ? DIAG_NETNS_OOBM : name, strerror(error));
+    return error;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_spawn
+| Responsibility : Start a command with its output and errors on a pipe
+| Parameters : char *const argv[] : NULL terminated arguments, argv[0] is the
+|                                   absolute path of the command
+|              pid_t *pid : process id of the command
+| Return : read end of the pipe, -1 with errno set on failure
+-----------------------------------------------------------------------------*/
+int diag_netns_spawn(char *const argv[], pid_t *pid)
+{
+    int fds[2], error;
+
+    if (pipe2(fds, O_CLOEXEC) < 0)
+        return -1;
+
+    *pid = fork();
+    if (*pid < 0)
+    {
+        error = errno;
+        close(fds[0]);
+        close(fds[1]);
+        errno = error;
+        return -1;
+    }
+    if (!*pid)
+    {
+        /* Child, the errors of the command are part of its output */
+        if (dup2(fds[1], STDOUT_FILENO) < 0
+            || dup2(fds[1], STDERR_FILENO) < 0)
+            _exit(127);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    return fds[0];
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_wait
+| Responsibility : Wait for the end of a command started by diag_netns_spawn
+| Parameters : pid_t pid : process id of the command
+|              const char *path : path of the command, for the log
+| Return : 0 when the command ran, errno value otherwise
+-----------------------------------------------------------------------------*/
+int diag_netns_wait(pid_t pid, const char *path)
+{
+    int status;
+
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+            return errno;
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+    {
+        VLOG_ERR("cannot execute %s", path);
+        return ENOEXEC;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : diag_netns_exec
+| Responsibility : Execute a command and display its output line by line
+| Parameters : char *const argv[] : NULL terminated arguments, argv[0] is the
+|                                   absolute path of the command
+|              bool keepNewline : pass the lines with their newline
+|              diag_netns_output_fn fPtr : function displaying a line
+| Return : 0 when the command ran, errno value otherwise
+-----------------------------------------------------------------------------*/
+int diag_netns_exec(char *const argv[], bool keepNewline,
+                    diag_netns_output_fn fPtr)
+{
+    char line[BUFSIZ];
+    int fd, error;
+    size_t len;
+    FILE *fp;
+    pid_t pid;
+
+    fd = diag_netns_spawn(argv, &pid);
+    if (fd < 0)
+        return errno;
+
+    fp = fdopen(fd, "r");
+    if (!fp)
+    {
+        error = errno;
+        close(fd);
+        waitpid(pid, NULL, 0);
+        return error;
+    }
+    while (fgets(line, sizeof line, fp))
+    {
+        len = strlen(line);
+        if (!keepNewline && len && line[len - 1] == '\n')
+            line[len - 1] = '\0';
+        fPtr(line);
+    }
+    fclose(fp);
+
+    return diag_netns_wait(pid, argv[0]);
+}
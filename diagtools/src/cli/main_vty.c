@@ -36,6 +36,7 @@ void cli_post_init(void)
     /* ping CLI commands */
     install_element (ENABLE_NODE, &cli_ping_cmd);
     install_element (ENABLE_NODE, &cli_ping6_cmd);
+    install_element (ENABLE_NODE, &cli_ping_sweep_cmd);
 
     /* Traceroute CLI commands */
     install_element (ENABLE_NODE, &cli_traceroute_cmd);
@@ -0,0 +1,1080 @@
+/* Native ping engine
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: ping_engine.c
+ *
+ * Purpose: In-process ICMP echo engine of the ping and ping6 commands.
+ *
+ * The echo socket is created inside the namespace of the VRF, a raw socket
+ * when allowed, an ICMP datagram socket otherwise. ICMP errors about the
+ * requests are read from the socket error queue (IP_RECVERR), receive
+ * times are the kernel timestamps of the replies. The output follows the
+ * one of iputils ping, so that existing scripts keep working.
+ *
+ * The kernel does not return the IP options of the replies on datagram
+ * sockets. Without a raw socket, a ping with the record-route or timestamp
+ * options is left to iputils ping through nwdiag.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <linux/errqueue.h>
+#include "ping_engine.h"
+#include "diag_netns.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(ping_engine);
+
+/* linux/icmp.h conflicts with netinet/ip_icmp.h */
+#ifndef ICMP_FILTER
+#define ICMP_FILTER         1
+#endif
+
+/* state of a ping run */
+struct ping_run {
+    pingEntry *p;
+    void (*fPtr)(char *);
+    int family;
+    struct sockaddr_storage dst;
+    socklen_t dstLen;
+    char dstStr[INET6_ADDRSTRLEN];
+    struct ping_socket sock;
+    int gaiError;               /* resolution error of the target */
+    int error;                  /* socket error */
+
+    uint16_t count;
+    uint16_t size;
+    uint8_t *data;              /* echo data of the requests */
+    struct timespec *sentAt;    /* send time, per sequence */
+    uint8_t *replied;           /* reply received, per sequence */
+
+    uint32_t transmitted;
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t errors;
+    double rttMin;
+    double rttMax;
+    double rttSum;
+    double rttSum2;
+};
+
+/* ICMP destination unreachable messages, by code */
+static const char *ping_unreach_str[] = {
+    "Destination Net Unreachable",
+    "Destination Host Unreachable",
+    "Destination Protocol Unreachable",
+    "Destination Port Unreachable",
+    "Frag needed and DF set",
+    "Source Route Failed",
+    "Destination Net Unknown",
+    "Destination Host Unknown",
+    "Source Host Isolated",
+    "Destination Net Prohibited",
+    "Destination Host Prohibited",
+    "Destination Net Unreachable for Type of Service",
+    "Destination Host Unreachable for Type of Service",
+    "Packet filtered",
+    "Precedence Violation",
+    "Precedence Cutoff",
+};
+
+/* ICMPv6 destination unreachable messages, by code */
+static const char *ping6_unreach_str[] = {
+    "No route",
+    "Administratively prohibited",
+    "Beyond scope of source address",
+    "Address unreachable",
+    "Port unreachable",
+};
+
+/*-----------------------------------------------------------------------------
+| Name : ping_out
+| Responsibility : Format a line of output and pass it to the display function
+| Parameters : struct ping_run *run : ping run
+|              const char *format : printf format
+| Return : void
+-----------------------------------------------------------------------------*/
+static void __attribute__((format(printf, 2, 3)))
+ping_out(struct ping_run *run, const char *format, ...)
+{
+    char line[BUFSIZ];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof line, format, args);
+    va_end(args);
+    (*run->fPtr)(line);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_csum_add
+| Responsibility : Add a buffer to an internet checksum
+| Parameters : uint32_t sum : partial sum
+|              const uint8_t *buf : buffer, at an even offset of the message
+|              size_t len : buffer length
+| Return : partial sum
+-----------------------------------------------------------------------------*/
+static uint32_t ping_csum_add(uint32_t sum, const uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < len; i += 2)
+        sum += (buf[i] << 8) | buf[i + 1];
+    if (len & 1)
+        sum += buf[len - 1] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_socket_open
+| Responsibility : Open an echo socket in the namespace of the thread
+| Parameters : struct ping_socket *s : socket to open
+|              int family : AF_INET or AF_INET6
+| Return : 0 on success, errno value otherwise
+-----------------------------------------------------------------------------*/
+int ping_socket_open(struct ping_socket *s, int family)
+{
+    int proto = (family == AF_INET) ? IPPROTO_ICMP : IPPROTO_ICMPV6;
+    int on = 1;
+    int error = 0;
+
+    memset(s, 0, sizeof *s);
+    s->family = family;
+    s->ident = getpid() & 0xffff;
+
+    /* Raw sockets need CAP_NET_RAW, datagram sockets need the group
+     * of the user in net.ipv4.ping_group_range */
+    s->fd = socket(family, SOCK_RAW | SOCK_CLOEXEC, proto);
+    if (s->fd >= 0)
+    {
+        s->raw = true;
+    }
+    else
+    {
+        if (errno != EPERM && errno != EACCES)
+            return errno;
+        s->fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC, proto);
+        if (s->fd < 0)
+            return errno;
+    }
+
+    if (family == AF_INET)
+    {
+        if (s->raw)
+        {
+            /* Errors come from the error queue, pass only echo replies */
+            uint32_t filter = ~(1U << ICMP_ECHOREPLY);
+
+            if (setsockopt(s->fd, SOL_RAW, ICMP_FILTER,
+                           &filter, sizeof filter) < 0)
+                error = errno;
+        }
+        else if (setsockopt(s->fd, IPPROTO_IP, IP_RECVTTL,
+                            &on, sizeof on) < 0)
+        {
+            error = errno;
+        }
+        if (!error
+            && setsockopt(s->fd, IPPROTO_IP, IP_RECVERR, &on, sizeof on) < 0)
+            error = errno;
+    }
+    else
+    {
+        if (s->raw)
+        {
+            struct icmp6_filter filter;
+
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+            if (setsockopt(s->fd, IPPROTO_ICMPV6, ICMP6_FILTER,
+                           &filter, sizeof filter) < 0)
+                error = errno;
+        }
+        if (!error
+            && (setsockopt(s->fd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT,
+                           &on, sizeof on) < 0
+                || setsockopt(s->fd, IPPROTO_IPV6, IPV6_RECVERR,
+                              &on, sizeof on) < 0))
+            error = errno;
+    }
+
+    if (!error
+        && setsockopt(s->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof on) < 0)
+        error = errno;
+
+    if (error)
+        ping_socket_close(s);
+    return error;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_socket_close
+| Responsibility : Close an echo socket
+| Parameters : struct ping_socket *s : socket
+| Return : void
+-----------------------------------------------------------------------------*/
+void ping_socket_close(struct ping_socket *s)
+{
+    if (s->fd >= 0)
+        close(s->fd);
+    s->fd = -1;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_send
+| Responsibility : Send an echo request
+| Parameters : struct ping_socket *s : socket
+|              const struct sockaddr *dst : destination, NULL when connected
+|              socklen_t dstLen : destination length
+|              uint16_t seq : sequence number
+|              const uint8_t *data : echo data
+|              size_t len : echo data length
+|              struct timespec *sent : send time
+| Return : 0 on success, errno value otherwise
+-----------------------------------------------------------------------------*/
+int ping_send(struct ping_socket *s, const struct sockaddr *dst,
+              socklen_t dstLen, uint16_t seq, const uint8_t *data,
+              size_t len, struct timespec *sent)
+{
+    uint8_t hdr[PING_ICMP_HDRLEN];
+    struct iovec iov[2];
+    struct msghdr msg;
+    uint32_t sum;
+
+    memset(hdr, 0, sizeof hdr);
+    hdr[0] = (s->family == AF_INET) ? ICMP_ECHO : ICMP6_ECHO_REQUEST;
+    hdr[4] = s->ident >> 8;
+    hdr[5] = s->ident & 0xff;
+    hdr[6] = seq >> 8;
+    hdr[7] = seq & 0xff;
+
+    /* The kernel computes the ICMPv6 checksums and the ones of the
+     * datagram sockets */
+    if (s->family == AF_INET && s->raw)
+    {
+        sum = ping_csum_add(0, hdr, sizeof hdr);
+        sum = ~ping_csum_add(sum, data, len);
+        hdr[2] = (sum >> 8) & 0xff;
+        hdr[3] = sum & 0xff;
+    }
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof hdr;
+    iov[1].iov_base = (void *) data;
+    iov[1].iov_len = len;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name = (void *) dst;
+    msg.msg_namelen = dst ? dstLen : 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    clock_gettime(CLOCK_REALTIME, sent);
+    if (sendmsg(s->fd, &msg, MSG_DONTWAIT) < 0)
+        return errno;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_recv
+| Responsibility : Receive and decode a message of an echo socket
+| Parameters : struct ping_socket *s : socket
+|              uint8_t *buf : receive buffer
+|              size_t size : buffer size
+|              bool errQueue : read the error queue
+|              struct ping_reply *r : decoded message, kind PING_REPLY_NONE
+|                                     when it is not for this socket
+| Return : 0 on success, errno value otherwise (EAGAIN when empty)
+-----------------------------------------------------------------------------*/
+int ping_recv(struct ping_socket *s, uint8_t *buf, size_t size,
+              bool errQueue, struct ping_reply *r)
+{
+    uint8_t echo = (s->family == AF_INET) ? ICMP_ECHOREPLY : ICMP6_ECHO_REPLY;
+    char control[512];
+    struct sock_extended_err *ee = NULL;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    const uint8_t *icmp = buf;
+    bool stamped = false;
+    size_t len, hl;
+    ssize_t n;
+
+    memset(r, 0, sizeof *r);
+    r->kind = PING_REPLY_NONE;
+    r->ttl = -1;
+
+    iov.iov_base = buf;
+    iov.iov_len = size;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name = &r->from;
+    msg.msg_namelen = sizeof r->from;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    n = recvmsg(s->fd, &msg, MSG_DONTWAIT | (errQueue ? MSG_ERRQUEUE : 0));
+    if (n < 0)
+        return errno;
+    len = n;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET
+            && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&r->stamp, CMSG_DATA(cmsg), sizeof r->stamp);
+            stamped = true;
+        }
+        else if (cmsg->cmsg_level == IPPROTO_IP)
+        {
+            if (cmsg->cmsg_type == IP_TTL)
+                memcpy(&r->ttl, CMSG_DATA(cmsg), sizeof r->ttl);
+            else if (cmsg->cmsg_type == IP_RECVERR)
+                ee = (struct sock_extended_err *) CMSG_DATA(cmsg);
+        }
+        else if (cmsg->cmsg_level == IPPROTO_IPV6)
+        {
+            if (cmsg->cmsg_type == IPV6_HOPLIMIT)
+                memcpy(&r->ttl, CMSG_DATA(cmsg), sizeof r->ttl);
+            else if (cmsg->cmsg_type == IPV6_RECVERR)
+                ee = (struct sock_extended_err *) CMSG_DATA(cmsg);
+        }
+    }
+    if (!stamped)
+        clock_gettime(CLOCK_REALTIME, &r->stamp);
+
+    if (errQueue)
+    {
+        /* The error queue returns the request the error is about */
+        uint8_t request = (s->family == AF_INET)
+                          ? ICMP_ECHO : ICMP6_ECHO_REQUEST;
+
+        if (!ee || len < PING_ICMP_HDRLEN || icmp[0] != request)
+            return 0;
+        if (s->raw && ((icmp[4] << 8) | icmp[5]) != s->ident)
+            return 0;
+        r->seq = (icmp[6] << 8) | icmp[7];
+        r->info = ee->ee_info;
+        memset(&r->from, 0, sizeof r->from);
+        if (ee->ee_origin == SO_EE_ORIGIN_ICMP
+            || ee->ee_origin == SO_EE_ORIGIN_ICMP6)
+        {
+            const struct sockaddr *offender = SO_EE_OFFENDER(ee);
+
+            if (offender->sa_family == AF_INET)
+                memcpy(&r->from, offender, sizeof(struct sockaddr_in));
+            else if (offender->sa_family == AF_INET6)
+                memcpy(&r->from, offender, sizeof(struct sockaddr_in6));
+            r->kind = PING_REPLY_ERROR;
+            r->type = ee->ee_type;
+            r->code = ee->ee_code;
+        }
+        else if (ee->ee_origin == SO_EE_ORIGIN_LOCAL)
+        {
+            r->kind = PING_REPLY_LOCAL;
+            r->error = ee->ee_errno;
+        }
+        return 0;
+    }
+
+    /* Raw IPv4 sockets receive the IP header */
+    if (s->family == AF_INET && s->raw)
+    {
+        if (len < sizeof(struct ip))
+            return 0;
+        hl = (buf[0] & 0x0f) * 4;
+        if (hl < sizeof(struct ip) || hl > len)
+            return 0;
+        r->ttl = buf[8];
+        r->optionsLen = hl - sizeof(struct ip);
+        memcpy(r->options, buf + sizeof(struct ip), r->optionsLen);
+        icmp = buf + hl;
+        len -= hl;
+    }
+
+    if (len < PING_ICMP_HDRLEN || icmp[0] != echo)
+        return 0;
+    if (s->raw && ((icmp[4] << 8) | icmp[5]) != s->ident)
+        return 0;
+
+    r->kind = PING_REPLY_ECHO;
+    r->seq = (icmp[6] << 8) | icmp[7];
+    r->len = len;
+    r->data = icmp + PING_ICMP_HDRLEN;
+    r->dataLen = len - PING_ICMP_HDRLEN;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_error_str
+| Responsibility : Describe an error received on an echo socket
+| Parameters : int family : AF_INET or AF_INET6
+|              const struct ping_reply *r : error
+|              char *buf : description
+|              size_t size : description size
+| Return : void
+-----------------------------------------------------------------------------*/
+void ping_error_str(int family, const struct ping_reply *r,
+                    char *buf, size_t size)
+{
+    if (r->kind == PING_REPLY_LOCAL)
+    {
+        if (r->error == EMSGSIZE)
+            snprintf(buf, size, "local error: Message too long, mtu=%u",
+                     r->info);
+        else
+            snprintf(buf, size, "local error: %s", strerror(r->error));
+    }
+    else if (family == AF_INET)
+    {
+        switch (r->type)
+        {
+            case ICMP_DEST_UNREACH:
+                if (r->code == ICMP_FRAG_NEEDED)
+                    snprintf(buf, size, "Frag needed and DF set (mtu = %u)",
+                             r->info);
+                else if (r->code < ARRAY_SIZE(ping_unreach_str))
+                    snprintf(buf, size, "%s", ping_unreach_str[r->code]);
+                else
+                    snprintf(buf, size, "Dest Unreachable, Bad Code: %d",
+                             r->code);
+                break;
+            case ICMP_TIME_EXCEEDED:
+                snprintf(buf, size, "%s", (r->code == ICMP_EXC_TTL)
+                         ? "Time to live exceeded"
+                         : "Frag reassembly time exceeded");
+                break;
+            case ICMP_SOURCE_QUENCH:
+                snprintf(buf, size, "Source Quench");
+                break;
+            case ICMP_PARAMETERPROB:
+                snprintf(buf, size, "Parameter problem: pointer = %u",
+                         r->info);
+                break;
+            default:
+                snprintf(buf, size, "Bad ICMP type: %d", r->type);
+                break;
+        }
+    }
+    else
+    {
+        switch (r->type)
+        {
+            case ICMP6_DST_UNREACH:
+                if (r->code < ARRAY_SIZE(ping6_unreach_str))
+                    snprintf(buf, size, "Destination unreachable: %s",
+                             ping6_unreach_str[r->code]);
+                else
+                    snprintf(buf, size, "Destination unreachable: "
+                             "Unknown code %d", r->code);
+                break;
+            case ICMP6_PACKET_TOO_BIG:
+                snprintf(buf, size, "Packet too big: mtu=%u", r->info);
+                break;
+            case ICMP6_TIME_EXCEEDED:
+                snprintf(buf, size, "Time exceeded: %s",
+                         (r->code == ICMP6_TIME_EXCEED_TRANSIT)
+                         ? "Hop limit" : "Defrag failure");
+                break;
+            case ICMP6_PARAM_PROB:
+                snprintf(buf, size, "Parameter problem: pointer = %u",
+                         r->info);
+                break;
+            default:
+                snprintf(buf, size, "ICMP type %d code %d",
+                         r->type, r->code);
+                break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_rtt_ms
+| Responsibility : Compute a round trip time
+| Parameters : const struct timespec *sent : send time
+|              const struct timespec *rcvd : receive time
+| Return : round trip time in milliseconds
+-----------------------------------------------------------------------------*/
+double ping_rtt_ms(const struct timespec *sent, const struct timespec *rcvd)
+{
+    long long ns = (rcvd->tv_sec - sent->tv_sec) * NSEC_PER_SEC
+                   + (rcvd->tv_nsec - sent->tv_nsec);
+
+    /* The clock may step between the send and the receive */
+    return ns > 0 ? (double) ns / NSEC_PER_MSEC : 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_monotonic_ns
+| Responsibility : Read the monotonic clock
+| Parameters : void
+| Return : time in nanoseconds
+-----------------------------------------------------------------------------*/
+long long ping_monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_addr_str
+| Responsibility : Format the address of a socket address
+| Parameters : const struct sockaddr_storage *ss : socket address
+|              char *buf : buffer of INET6_ADDRSTRLEN bytes
+| Return : buf
+-----------------------------------------------------------------------------*/
+const char *ping_addr_str(const struct sockaddr_storage *ss, char *buf)
+{
+    const void *addr = NULL;
+
+    if (ss->ss_family == AF_INET)
+        addr = &((const struct sockaddr_in *) ss)->sin_addr;
+    else if (ss->ss_family == AF_INET6)
+        addr = &((const struct sockaddr_in6 *) ss)->sin6_addr;
+
+    if (!addr || !inet_ntop(ss->ss_family, addr, buf, INET6_ADDRSTRLEN))
+        snprintf(buf, INET6_ADDRSTRLEN, "?");
+    return buf;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_rtt_str
+| Responsibility : Format a round trip time with the precision of iputils
+| Parameters : double ms : round trip time in milliseconds
+|              char *buf : buffer
+|              size_t size : buffer size
+| Return : buf
+-----------------------------------------------------------------------------*/
+static const char *ping_rtt_str(double ms, char *buf, size_t size)
+{
+    if (ms >= 100)
+        snprintf(buf, size, "%.0f", ms);
+    else if (ms >= 10)
+        snprintf(buf, size, "%.1f", ms);
+    else if (ms >= 1)
+        snprintf(buf, size, "%.2f", ms);
+    else
+        snprintf(buf, size, "%.3f", ms);
+    return buf;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_setup
+| Responsibility : Resolve the target and open the echo socket, inside the
+|                  namespace of the vrf
+| Parameters : void *aux : pointer to the ping run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_setup(void *aux)
+{
+    struct ping_run *run = aux;
+    struct addrinfo hints, *res;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = run->family;
+    hints.ai_socktype = SOCK_DGRAM;
+    run->gaiError = getaddrinfo(run->p->pingTarget, NULL, &hints, &res);
+    if (!run->gaiError)
+    {
+        memcpy(&run->dst, res->ai_addr, res->ai_addrlen);
+        run->dstLen = res->ai_addrlen;
+        freeaddrinfo(res);
+    }
+    run->error = ping_socket_open(&run->sock, run->family);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_fill
+| Responsibility : Fill the echo data with the data-fill pattern, or with
+|                  incrementing bytes without pattern
+| Parameters : struct ping_run *run : ping run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_fill(struct ping_run *run)
+{
+    uint8_t pattern[MAX_PATTERN_LENGTH / 2];
+    const char *fill = run->p->pingDataFill;
+    char line[BUFSIZ], pair[3];
+    size_t n = 0, i;
+    int len = 0;
+
+    /* Two hex digits per byte, like iputils */
+    while (fill && *fill && n < sizeof pattern)
+    {
+        memset(pair, 0, sizeof pair);
+        pair[0] = *fill++;
+        if (*fill)
+            pair[1] = *fill++;
+        pattern[n++] = strtoul(pair, NULL, 16);
+    }
+
+    for (i = 0; i < run->size; i++)
+        run->data[i] = n ? pattern[i % n] : (i & 0xff);
+
+    if (n)
+    {
+        len += snprintf(line + len, sizeof line - len, "PATTERN: 0x");
+        for (i = 0; i < n; i++)
+            len += snprintf(line + len, sizeof line - len, "%02x",
+                            pattern[i]);
+        ping_out(run, "%s\n", line);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_ip_options
+| Responsibility : Build the IPv4 record-route or timestamp option
+| Parameters : pingEntry *p : pointer to ping structure
+|              uint8_t *opts : option buffer of PING_MAX_IPOPTLEN bytes
+| Return : length of the option, 0 without option
+-----------------------------------------------------------------------------*/
+static size_t ping_native_ip_options(const pingEntry *p, uint8_t *opts)
+{
+    memset(opts, 0, PING_MAX_IPOPTLEN);
+    if (p->includeTimestamp || p->includeTimestampAddress)
+    {
+        opts[0] = IPOPT_TS;
+        opts[1] = p->includeTimestamp ? PING_MAX_IPOPTLEN : 36;
+        opts[2] = 5;
+        opts[3] = p->includeTimestamp ? IPOPT_TS_TSONLY : IPOPT_TS_TSANDADDR;
+        return opts[1];
+    }
+    if (p->recordRoute)
+    {
+        opts[0] = IPOPT_NOP;
+        opts[1] = IPOPT_RR;
+        opts[2] = PING_MAX_IPOPTLEN - 1;
+        opts[3] = 4;
+        return PING_MAX_IPOPTLEN;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_print_options
+| Responsibility : Display the record-route and timestamp options of a reply
+| Parameters : struct ping_run *run : ping run
+|              const uint8_t *opts : IPv4 options
+|              size_t len : options length
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_print_options(struct ping_run *run,
+                                      const uint8_t *opts, size_t len)
+{
+    char addr[INET_ADDRSTRLEN];
+    size_t i = 0, j, olen, end, step;
+    uint32_t ts;
+
+    while (i < len && opts[i] != IPOPT_EOL)
+    {
+        if (opts[i] == IPOPT_NOP)
+        {
+            i++;
+            continue;
+        }
+        if (i + 1 >= len || opts[i + 1] < 2 || i + opts[i + 1] > len)
+            break;
+        olen = opts[i + 1];
+
+        if (opts[i] == IPOPT_RR && olen >= 3)
+        {
+            /* The pointer is one past the last recorded address */
+            end = MIN(MAX(opts[i + 2], 4) - 1, olen);
+            for (j = 3; j + 4 <= end; j += 4)
+                ping_out(run, "%s\t%s\n", (j == 3) ? "RR: " : "",
+                         inet_ntop(AF_INET, opts + i + j, addr, sizeof addr));
+        }
+        else if (opts[i] == IPOPT_TS && olen >= 4)
+        {
+            step = ((opts[i + 3] & 0x0f) == IPOPT_TS_TSONLY) ? 4 : 8;
+            end = MIN(MAX(opts[i + 2], 5) - 1, olen);
+            for (j = 4; j + step <= end; j += step)
+            {
+                memcpy(&ts, opts + i + j + step - 4, sizeof ts);
+                ts = ntohl(ts);
+                if (step == 8)
+                    inet_ntop(AF_INET, opts + i + j, addr, sizeof addr);
+                ping_out(run, "%s\t%s%s%u %s\n", (j == 4) ? "TS: " : "",
+                         (step == 8) ? addr : "", (step == 8) ? "\t" : "",
+                         ts & 0x7fffffff,
+                         (ts & 0x80000000) ? "not-standard" : "absolute");
+            }
+            if (opts[i + 3] >> 4)
+                ping_out(run, "\t(%u hops not recorded)\n",
+                         opts[i + 3] >> 4);
+        }
+        i += olen;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_reply
+| Responsibility : Account and display a message received on the socket
+| Parameters : struct ping_run *run : ping run
+|              const struct ping_reply *r : message
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_reply(struct ping_run *run,
+                              const struct ping_reply *r)
+{
+    char from[INET6_ADDRSTRLEN], name[BUFSIZ], rtt[32], ttl[16];
+    char text[128];
+    size_t idx, i;
+    bool dup;
+    double ms;
+
+    if (r->kind == PING_REPLY_NONE || !r->seq || r->seq > run->transmitted)
+        return;
+    idx = r->seq - 1;
+    ping_addr_str(&r->from, from);
+
+    if (r->kind != PING_REPLY_ECHO)
+    {
+        run->errors++;
+        ping_error_str(run->family, r, text, sizeof text);
+        if (r->kind == PING_REPLY_LOCAL)
+            ping_out(run, "ping: %s\n", text);
+        else
+            ping_out(run, "From %s icmp_seq=%u %s\n", from, r->seq, text);
+        return;
+    }
+
+    ms = ping_rtt_ms(&run->sentAt[idx], &r->stamp);
+    dup = run->replied[idx];
+    if (dup)
+    {
+        run->duplicates++;
+    }
+    else
+    {
+        run->replied[idx] = 1;
+        if (!run->received || ms < run->rttMin)
+            run->rttMin = ms;
+        if (!run->received || ms > run->rttMax)
+            run->rttMax = ms;
+        run->received++;
+        run->rttSum += ms;
+        run->rttSum2 += ms * ms;
+    }
+
+    /* Hostname targets show the resolved address too */
+    if (strcmp(run->p->pingTarget, from) && !strcmp(run->dstStr, from))
+        snprintf(name, sizeof name, "%s (%s)", run->p->pingTarget, from);
+    else
+        snprintf(name, sizeof name, "%s", from);
+    ttl[0] = '\0';
+    if (r->ttl >= 0)
+        snprintf(ttl, sizeof ttl, " ttl=%d", r->ttl);
+
+    ping_out(run, "%zu bytes from %s: icmp_seq=%u%s time=%s ms%s\n",
+             r->len, name, r->seq, ttl, ping_rtt_str(ms, rtt, sizeof rtt),
+             dup ? " (DUP!)" : "");
+
+    for (i = 0; i < r->dataLen && i < run->size; i++)
+    {
+        if (r->data[i] != run->data[i])
+        {
+            ping_out(run, "wrong data byte #%zu should be 0x%x but was "
+                     "0x%x\n", i, run->data[i], r->data[i]);
+            break;
+        }
+    }
+
+    if (r->optionsLen)
+        ping_native_print_options(run, r->options, r->optionsLen);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_receive
+| Responsibility : Process the messages queued on the socket
+| Parameters : struct ping_run *run : ping run
+|              uint8_t *buf : receive buffer
+|              bool errQueue : process the error queue
+| Return : number of messages processed
+-----------------------------------------------------------------------------*/
+static int ping_native_receive(struct ping_run *run, uint8_t *buf,
+                               bool errQueue)
+{
+    struct ping_reply r;
+    int n = 0;
+
+    while (!ping_recv(&run->sock, buf, PING_RECV_BUFSIZE, errQueue, &r))
+    {
+        ping_native_reply(run, &r);
+        n++;
+    }
+    return n;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_send
+| Responsibility : Send the next echo request
+| Parameters : struct ping_run *run : ping run
+|              uint8_t *buf : receive buffer, for the error queue
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_send(struct ping_run *run, uint8_t *buf)
+{
+    uint16_t seq = run->transmitted + 1;
+    int error;
+
+    error = ping_send(&run->sock,
+                      run->p->isBcast ? (struct sockaddr *) &run->dst : NULL,
+                      run->dstLen, seq, run->data, run->size,
+                      &run->sentAt[seq - 1]);
+    run->transmitted++;
+
+    /* A failed send reports the pending error of the socket, which is
+     * described in the error queue */
+    if (error && error != EAGAIN && error != ENOBUFS
+        && !ping_native_receive(run, buf, true))
+    {
+        run->errors++;
+        ping_out(run, "ping: sendmsg: %s\n", strerror(error));
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_configure
+| Responsibility : Apply the ping options to the socket, and connect it
+| Parameters : struct ping_run *run : ping run
+| Return : true on success, false after displaying the error
+-----------------------------------------------------------------------------*/
+static bool ping_native_configure(struct ping_run *run)
+{
+    uint8_t opts[PING_MAX_IPOPTLEN];
+    int fd = run->sock.fd, on = 1, tos = run->p->pingTos;
+    size_t optLen;
+
+    if (run->family == AF_INET)
+    {
+        if (tos && setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof tos) < 0)
+        {
+            ping_out(run, "ping: error setting tos: %s\n", strerror(errno));
+            return false;
+        }
+
+        optLen = ping_native_ip_options(run->p, opts);
+        if (optLen
+            && setsockopt(fd, IPPROTO_IP, IP_OPTIONS, opts, optLen) < 0)
+        {
+            ping_out(run, "ping: error setting ip-option: %s\n",
+                     strerror(errno));
+            return false;
+        }
+
+        /* Replies to broadcast requests come from many sources, the
+         * socket stays unconnected */
+        if (run->p->isBcast)
+        {
+            if (setsockopt(fd, SOL_SOCKET, SO_BROADCAST,
+                           &on, sizeof on) < 0)
+            {
+                ping_out(run, "ping: can't set broadcasting: %s\n",
+                         strerror(errno));
+                return false;
+            }
+            ping_out(run, "WARNING: pinging broadcast address\n");
+            return true;
+        }
+    }
+
+    if (connect(fd, (struct sockaddr *) &run->dst, run->dstLen) < 0)
+    {
+        ping_out(run, "connect: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native_statistics
+| Responsibility : Display the statistics of a ping run
+| Parameters : struct ping_run *run : ping run
+|              long long elapsed : run time in nanoseconds
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_native_statistics(struct ping_run *run, long long elapsed)
+{
+    char line[BUFSIZ];
+    double avg, mdev;
+    int len = 0;
+
+    ping_out(run, "\n--- %s ping statistics ---\n", run->p->pingTarget);
+
+    len += snprintf(line + len, sizeof line - len,
+                    "%u packets transmitted, %u received",
+                    run->transmitted, run->received);
+    if (run->duplicates)
+        len += snprintf(line + len, sizeof line - len, ", +%u duplicates",
+                        run->duplicates);
+    if (run->errors)
+        len += snprintf(line + len, sizeof line - len, ", +%u errors",
+                        run->errors);
+    len += snprintf(line + len, sizeof line - len,
+                    ", %u%% packet loss, time %lldms\n",
+                    run->transmitted
+                    ? (run->transmitted - run->received) * 100
+                      / run->transmitted
+                    : 0,
+                    elapsed / NSEC_PER_MSEC);
+    ping_out(run, "%s", line);
+
+    if (run->received)
+    {
+        avg = run->rttSum / run->received;
+        mdev = sqrt(MAX(run->rttSum2 / run->received - avg * avg, 0));
+        ping_out(run, "rtt min/avg/max/mdev = %.3f/%.3f/%.3f/%.3f ms\n",
+                 run->rttMin, avg, run->rttMax, mdev);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_native
+| Responsibility : Perform ping functionality in process
+| Parameters : pingEntry* p : pointer to ping structure,
+|              void (*fptr)(char *buff): function pointer for display purpose
+| Return : 0 when the ping ran, errno value when it could not start (no
+|          privilege to enter the namespace or to open the socket, or IP
+|          options requested without a raw socket)
+-----------------------------------------------------------------------------*/
+int ping_native(pingEntry *p, void (*fPtr)(char *))
+{
+    uint8_t opts[PING_MAX_IPOPTLEN];
+    long long start, now, nextSend, deadline = 0, wait;
+    long long interval, timeout;
+    struct ping_run run;
+    struct pollfd pfd;
+    uint8_t *buf;
+    int error;
+
+    if (!p || !fPtr || !p->pingTarget)
+        return EINVAL;
+
+    memset(&run, 0, sizeof run);
+    run.p = p;
+    run.fPtr = fPtr;
+    run.family = p->isIpv4 ? AF_INET : AF_INET6;
+    run.sock.fd = -1;
+
+    error = diag_netns_run(p->vrf_n, p->mgmt, ping_native_setup, &run);
+    if (!error)
+        error = run.error;
+    if (error)
+        return error;
+
+    if (run.gaiError)
+    {
+        ping_out(&run, "ping: unknown host %s\n", p->pingTarget);
+        ping_socket_close(&run.sock);
+        return 0;
+    }
+
+    /* The options of the replies would not display */
+    if (run.family == AF_INET && !run.sock.raw
+        && ping_native_ip_options(p, opts))
+    {
+        ping_socket_close(&run.sock);
+        return EOPNOTSUPP;
+    }
+
+    run.count = p->pingRepetitions ? p->pingRepetitions : PING_DEF_COUNT;
+    run.size = p->pingDataSize ? p->pingDataSize : PING_DEF_SIZE;
+    interval = (p->pingInterval ? p->pingInterval : PING_DEF_INTERVAL)
+               * NSEC_PER_SEC;
+    timeout = (p->pingTimeout ? p->pingTimeout : PING_DEF_TIMEOUT)
+              * NSEC_PER_SEC;
+    run.data = xmalloc(run.size);
+    run.sentAt = xcalloc(run.count, sizeof *run.sentAt);
+    run.replied = xcalloc(run.count, sizeof *run.replied);
+    buf = xmalloc(PING_RECV_BUFSIZE);
+    ping_addr_str(&run.dst, run.dstStr);
+
+    ping_native_fill(&run);
+    if (!ping_native_configure(&run))
+        goto out;
+
+    if (run.family == AF_INET)
+        ping_out(&run, "PING %s (%s) %u(%zu) bytes of data.\n",
+                 p->pingTarget, run.dstStr, run.size,
+                 sizeof(struct ip) + ping_native_ip_options(p, opts)
+                 + PING_ICMP_HDRLEN + run.size);
+    else
+        ping_out(&run, "PING %s(%s) %u data bytes\n",
+                 p->pingTarget, run.dstStr, run.size);
+
+    pfd.fd = run.sock.fd;
+    pfd.events = POLLIN;
+    start = nextSend = ping_monotonic_ns();
+    for (;;)
+    {
+        now = ping_monotonic_ns();
+        if (run.transmitted < run.count && now >= nextSend)
+        {
+            ping_native_send(&run, buf);
+            nextSend += interval;
+            if (run.transmitted == run.count)
+                deadline = now + timeout;
+            continue;
+        }
+        if (run.transmitted == run.count
+            && (run.received + run.errors >= run.count || now >= deadline))
+            break;
+
+        wait = (run.transmitted < run.count) ? nextSend - now : deadline - now;
+        if (poll(&pfd, 1, (wait + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC) < 0)
+        {
+            /* Interrupted, display the statistics like iputils */
+            if (errno != EINTR)
+                VLOG_ERR("poll failed (%s)", strerror(errno));
+            break;
+        }
+        if (pfd.revents & POLLERR)
+            ping_native_receive(&run, buf, true);
+        if (pfd.revents & POLLIN)
+            ping_native_receive(&run, buf, false);
+    }
+    ping_native_statistics(&run, ping_monotonic_ns() - start);
+
+out:
+    ping_socket_close(&run.sock);
+    free(buf);
+    free(run.replied);
+    free(run.sentAt);
+    free(run.data);
+    return 0;
+}
@@ -24,7 +24,10 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "ping.h"
+#include "ping_engine.h"
+#include "diag_netns.h"
 #include "openvswitch/vlog.h"
 
 VLOG_DEFINE_THIS_MODULE(ping_handler);
@@ -39,10 +42,10 @@ VLOG_DEFINE_THIS_MODULE(ping_handler);
 ----------------------------------------------------------------------------------------*/
 bool ping_main (pingEntry *p, void (*fPtr)(char *buff))
 {
-    char buffer[BUFSIZ];
-    char *target = buffer;
-    int len = 0;
-    FILE *fp = NULL;
+    char *args[PING_EXEC_MAX_ARGS];
+    char count[12], size[12], interval[12], timeout[12], tos[12];
+    int n = 0;
+    int error;
 
     if (!fPtr)
     {
@@ -55,57 +58,66 @@ bool ping_main (pingEntry *p, void (*fPtr)(char *buff))
         return false;
     }
 
+    /* Ping in process, the command runs through nwdiag only when the
+     * native engine cannot start, e.g. without the privilege to enter
+     * the namespace */
+    error = ping_native(p, fPtr);
+    if (!error)
+        return true;
+    VLOG_DBG("native ping unavailable (%s), using %s",
+             strerror(error), EXE_PATH);
+
     /* Executing the command in the "swns" namespace or
-                the namespace specified by user */
-    len += snprintf(target+len, BUFSIZ, "%s ", EXE_PATH);
+                the namespace specified by user */
+    args[n++] = EXE_PATH;
 
-    if(p->mgmt)
-    {
-        len += snprintf(target+len,  BUFSIZ-len, "%s ", "mgmt");
-    }
+    if (p->mgmt)
+        args[n++] = "mgmt";
+    else if (!strcmp(p->vrf_n, ""))
+        args[n++] = DEFAULT_VRF_NAME;
     else
-    {
-        if(!strcmp(p->vrf_n,""))
-            len += snprintf(target+len, BUFSIZ-len, "%s ", DEFAULT_VRF_NAME);
-        else
-            len += snprintf(target+len, BUFSIZ-len, "%s ", p->vrf_n);
-    }
+        args[n++] = p->vrf_n;
 
     /* Append default cmd either ping4 or ping6 */
     if (p->isIpv4)
-        len += snprintf(target+len, BUFSIZ-len, "%s ", PING4_DEF_CMD);
+        args[n++] = PING4_DEF_CMD;
     else
-        len += snprintf(target+len, BUFSIZ-len, "%s ", PING6_DEF_CMD);
-
-    len += snprintf(target+len, BUFSIZ-len, " \" ");
+        args[n++] = PING6_DEF_CMD;
 
     /* if broadcast address, append broadcast option */
     if (p->isBcast)
-        len += snprintf(target+len, BUFSIZ-len, "-b ");
-
-    /* Append Target address */
-    if (p->pingTarget)
-        len += snprintf(target+len, BUFSIZ-len, "%s", p->pingTarget);
+        args[n++] = "-b";
 
     /* Append value repetitions(count) */
     if (!p->pingRepetitions)
         p->pingRepetitions = PING_DEF_COUNT;
 
-    len += snprintf(target+len, BUFSIZ-len, " -c %d", p->pingRepetitions);
+    snprintf(count, sizeof count, "%d", p->pingRepetitions);
+    args[n++] = "-c";
+    args[n++] = count;
 
     /* Append value of packet size */
     if (!p->pingDataSize)
         p->pingDataSize = PING_DEF_SIZE;
 
-    len += snprintf(target+len, BUFSIZ-len, " -s %d", p->pingDataSize);
+    snprintf(size, sizeof size, "%d", p->pingDataSize);
+    args[n++] = "-s";
+    args[n++] = size;
 
     /* Append value of Interval */
     if (p->pingInterval)
-        len += snprintf(target+len, BUFSIZ-len, " -i %d", p->pingInterval);
+    {
+        snprintf(interval, sizeof interval, "%d", p->pingInterval);
+        args[n++] = "-i";
+        args[n++] = interval;
+    }
 
     /* Append value of datafill */
     if (p->pingDataFill)
-        len += snprintf(target+len, BUFSIZ-len, " -p %s", p->pingDataFill);
+    {
+        args[n++] = "-p";
+        args[n++] = p->pingDataFill;
+    }
 
     /* Ping4 options */
     if (p->isIpv4)
@@ -113,34 +125,47 @@ bool ping_main (pingEntry *p, void (*fPtr)(char *buff))
         /* Append value of timeout */
         if (!p->pingTimeout)
             p->pingTimeout = PING_DEF_TIMEOUT;
-        len += snprintf(target+len, BUFSIZ-len, " -W %d", p->pingTimeout);
+        snprintf(timeout, sizeof timeout, "%d", p->pingTimeout);
+        args[n++] = "-W";
+        args[n++] = timeout;
 
         /* Append value of tos */
         if (p->pingTos)
-            len += snprintf(target+len, BUFSIZ-len, " -Q %d", p->pingTos);
+        {
+            snprintf(tos, sizeof tos, "%d", p->pingTos);
+            args[n++] = "-Q";
+            args[n++] = tos;
+        }
 
         /* Ping4 ip-options */
         if (p->includeTimestamp)
-            len += snprintf(target+len, BUFSIZ-len, " -T tsonly ");
+        {
+            args[n++] = "-T";
+            args[n++] = "tsonly";
+        }
         else if (p->includeTimestampAddress)
-            len += snprintf(target+len, BUFSIZ-len, " -T tsandaddr ");
+        {
+            args[n++] = "-T";
+            args[n++] = "tsandaddr";
+        }
         else if (p->recordRoute)
-            len += snprintf(target+len, BUFSIZ-len, " -R ");
+        {
+            args[n++] = "-R";
+        }
     }
 
-    len += snprintf(target+len, BUFSIZ-len, " \" ");
-    fp = popen(buffer, "w");
-    if (fp)
-    {
-        while (fgets(buffer, BUFSIZ, fp ) != NULL)
-            (*fPtr)(buffer);
-    }
-    else
+    /* Append Target address, never parsed as an option */
+    args[n++] = "--";
+    if (p->pingTarget)
+        args[n++] = p->pingTarget;
+    args[n] = NULL;
+
+    error = diag_netns_exec(args, true, fPtr);
+    if (error)
     {
-        VLOG_ERR("Failed to open pipe stream");
+        VLOG_ERR("Failed to run %s (%s)", EXE_PATH, strerror(error));
         (*fPtr)("Internal error");
         return false;
     }
-    pclose(fp);
     return true;
 }
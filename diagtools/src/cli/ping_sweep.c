@@ -0,0 +1,594 @@
+/* Ping sweep handler file
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: ping_sweep.c
+ *
+ * Purpose: To ping many IPv4 devices at once.
+ *
+ * One echo socket serves all the targets. The requests go out round by
+ * round, each round visiting every target once, at no more than the
+ * configured rate; the sequence number of a request identifies its target
+ * and round. Replies and errors are collected while sending, and a table
+ * of the reachability and round trip times displays at the end.
+ *
+ * Without the privilege to enter the namespace of the vrf or to open an
+ * ICMP socket, the targets are pinged by iputils ping, through the nwdiag
+ * helper. Several of them run at once, as many as the rate allows, and
+ * they are started at the configured rate.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "ping.h"
+#include "ping_engine.h"
+#include "diag_netns.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(ping_sweep);
+
+/* receive buffer of the sweep socket, for bursts of replies */
+#define PING_SWEEP_SNDRCV_BUF   (256 * 1024)
+
+/* shortest interval between the requests of iputils ping for users */
+#define PING_SWEEP_EXEC_INTERVAL    "0.2"
+
+/* requests per second of one iputils ping, from the interval above */
+#define PING_SWEEP_EXEC_RATE        5
+
+/* iputils ping running at once */
+#define PING_SWEEP_EXEC_MAX_CHILDREN    32
+
+/* result of a target */
+struct ping_sweep_target {
+    struct sockaddr_in addr;
+    uint8_t sent;
+    uint8_t received;
+    double rttMin;
+    double rttMax;
+    double rttSum;
+    char status[64];            /* last error about the target */
+};
+
+/* iputils ping of a target */
+struct ping_sweep_child {
+    struct ping_sweep_target *target;
+    pid_t pid;
+    int fd;                     /* output of the command */
+    size_t len;                 /* bytes of the line being read */
+    char line[BUFSIZ];
+};
+
+/* state of a sweep */
+struct ping_sweep_run {
+    pingSweep *s;
+    void (*fPtr)(char *);
+    struct ping_socket sock;
+    int error;                  /* socket error */
+    struct ping_sweep_target *targets;
+    struct timespec *sentAt;    /* send time, per sequence */
+    uint8_t *answered;          /* reply or error received, per sequence */
+    uint8_t data[PING_SWEEP_DATA_SIZE];
+    uint32_t total;             /* requests of the sweep */
+    uint32_t transmitted;
+    uint32_t answers;
+};
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_out
+| Responsibility : Format a line of output and pass it to the display function
+| Parameters : struct ping_sweep_run *run : sweep
+|              const char *format : printf format
+| Return : void
+-----------------------------------------------------------------------------*/
+static void __attribute__((format(printf, 2, 3)))
+ping_sweep_out(struct ping_sweep_run *run, const char *format, ...)
+{
+    char line[BUFSIZ];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof line, format, args);
+    va_end(args);
+    (*run->fPtr)(line);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_setup
+| Responsibility : Open the echo socket inside the namespace of the vrf
+| Parameters : void *aux : pointer to the sweep
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_sweep_setup(void *aux)
+{
+    struct ping_sweep_run *run = aux;
+
+    run->error = ping_socket_open(&run->sock, AF_INET);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_reply
+| Responsibility : Account a message received on the sweep socket
+| Parameters : struct ping_sweep_run *run : sweep
+|              const struct ping_reply *r : message
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_sweep_reply(struct ping_sweep_run *run,
+                             const struct ping_reply *r)
+{
+    const struct sockaddr_in *from = (const struct sockaddr_in *) &r->from;
+    struct ping_sweep_target *t;
+    size_t idx;
+    double ms;
+
+    if (r->kind == PING_REPLY_NONE || !r->seq || r->seq > run->transmitted)
+        return;
+    idx = r->seq - 1;
+    t = &run->targets[idx % run->s->nTargets];
+
+    if (r->kind != PING_REPLY_ECHO)
+    {
+        ping_error_str(AF_INET, r, t->status, sizeof t->status);
+    }
+    else
+    {
+        /* The socket is not connected, check the replier */
+        if (from->sin_family != AF_INET
+            || from->sin_addr.s_addr != t->addr.sin_addr.s_addr
+            || run->answered[idx])
+            return;
+
+        ms = ping_rtt_ms(&run->sentAt[idx], &r->stamp);
+        if (!t->received || ms < t->rttMin)
+            t->rttMin = ms;
+        if (!t->received || ms > t->rttMax)
+            t->rttMax = ms;
+        t->rttSum += ms;
+        t->received++;
+    }
+
+    if (!run->answered[idx])
+    {
+        run->answered[idx] = 1;
+        run->answers++;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_receive
+| Responsibility : Process the messages queued on the sweep socket
+| Parameters : struct ping_sweep_run *run : sweep
+|              uint8_t *buf : receive buffer
+|              bool errQueue : process the error queue
+| Return : number of messages processed
+-----------------------------------------------------------------------------*/
+static int ping_sweep_receive(struct ping_sweep_run *run, uint8_t *buf,
+                              bool errQueue)
+{
+    struct ping_reply r;
+    int n = 0;
+
+    while (!ping_recv(&run->sock, buf, PING_RECV_BUFSIZE, errQueue, &r))
+    {
+        ping_sweep_reply(run, &r);
+        n++;
+    }
+    return n;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_send
+| Responsibility : Send the next request of the sweep
+| Parameters : struct ping_sweep_run *run : sweep
+|              uint8_t *buf : receive buffer, for the error queue
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_sweep_send(struct ping_sweep_run *run, uint8_t *buf)
+{
+    uint32_t idx = run->transmitted;
+    struct ping_sweep_target *t = &run->targets[idx % run->s->nTargets];
+    int error;
+
+    error = ping_send(&run->sock, (struct sockaddr *) &t->addr,
+                      sizeof t->addr, idx + 1, run->data, sizeof run->data,
+                      &run->sentAt[idx]);
+    run->transmitted++;
+    t->sent++;
+
+    if (error && error != EAGAIN && error != ENOBUFS
+        && !ping_sweep_receive(run, buf, true))
+    {
+        snprintf(t->status, sizeof t->status, "%s", strerror(error));
+        run->answered[idx] = 1;
+        run->answers++;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_table
+| Responsibility : Display the results of the sweep
+| Parameters : struct ping_sweep_run *run : sweep
+|              long long elapsed : sweep time in nanoseconds
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_sweep_table(struct ping_sweep_run *run, long long elapsed)
+{
+    char addr[INET_ADDRSTRLEN];
+    struct ping_sweep_target *t;
+    uint16_t i, reachable = 0;
+
+    ping_sweep_out(run, "\n%-15s %4s %4s %4s %9s %9s %9s  %s\n",
+                   "Target", "Sent", "Rcvd", "Loss",
+                   "Min(ms)", "Avg(ms)", "Max(ms)", "Status");
+    ping_sweep_out(run, "%s\n", "-------------------------------------------"
+                   "-------------------------------------");
+
+    for (i = 0; i < run->s->nTargets; i++)
+    {
+        t = &run->targets[i];
+        inet_ntop(AF_INET, &t->addr.sin_addr, addr, sizeof addr);
+        if (t->received)
+        {
+            reachable++;
+            ping_sweep_out(run, "%-15s %4u %4u %3u%% %9.3f %9.3f %9.3f  %s\n",
+                           addr, t->sent, t->received,
+                           (t->sent - t->received) * 100 / t->sent,
+                           t->rttMin, t->rttSum / t->received, t->rttMax,
+                           "reachable");
+        }
+        else
+        {
+            ping_sweep_out(run, "%-15s %4u %4u %3u%% %9s %9s %9s  %s\n",
+                           addr, t->sent, 0, t->sent ? 100 : 0, "-", "-", "-",
+                           t->status[0] ? t->status : "no reply");
+        }
+    }
+
+    ping_sweep_out(run, "\n%u targets, %u reachable, %u unreachable, "
+                   "time %lldms\n", run->s->nTargets, reachable,
+                   run->s->nTargets - reachable, elapsed / NSEC_PER_MSEC);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_exec_line
+| Responsibility : Read the summary of iputils ping for a target
+| Parameters : struct ping_sweep_target *t : target
+|              char *line : line of output, without its newline
+| Return : void
+-----------------------------------------------------------------------------*/
+static void ping_sweep_exec_line(struct ping_sweep_target *t, char *line)
+{
+    unsigned int sent, received;
+    double min, avg, max, mdev;
+
+    if (sscanf(line, "%u packets transmitted, %u received",
+               &sent, &received) == 2)
+    {
+        t->sent = MIN(sent, UINT8_MAX);
+        t->received = MIN(received, t->sent);
+    }
+    else if (sscanf(line, "rtt min/avg/max/mdev = %lf/%lf/%lf/%lf",
+                    &min, &avg, &max, &mdev) == 4)
+    {
+        t->rttMin = min;
+        t->rttMax = max;
+        t->rttSum = avg * t->received;
+    }
+    else if (!strncmp(line, "ping: ", 6))
+    {
+        snprintf(t->status, sizeof t->status, "%s", line + 6);
+    }
+    else if (!strncmp(line, "connect: ", 9))
+    {
+        snprintf(t->status, sizeof t->status, "%s", line + 9);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_exec_read
+| Responsibility : Read the output available from the iputils ping of a
+|                  target, line by line
+| Parameters : struct ping_sweep_child *c : command
+| Return : true while the command is running, false at the end of its output
+-----------------------------------------------------------------------------*/
+static bool ping_sweep_exec_read(struct ping_sweep_child *c)
+{
+    char *end;
+    ssize_t n;
+    size_t used;
+
+    n = read(c->fd, c->line + c->len, sizeof c->line - 1 - c->len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return true;
+    if (n > 0)
+        c->len += n;
+    c->line[c->len] = '\0';
+
+    used = 0;
+    while ((end = strchr(c->line + used, '\n')))
+    {
+        *end = '\0';
+        ping_sweep_exec_line(c->target, c->line + used);
+        used = end + 1 - c->line;
+    }
+    if (n <= 0 || (!used && c->len == sizeof c->line - 1))
+    {
+        /* end of the output, or a line too long to be a summary */
+        if (c->len > used)
+            ping_sweep_exec_line(c->target, c->line + used);
+        used = c->len;
+    }
+    memmove(c->line, c->line + used, c->len - used);
+    c->len -= used;
+    return n > 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep_exec
+| Responsibility : Ping the targets through nwdiag, when the sweep socket
+|                  cannot be opened. Each iputils ping sends a request every
+|                  PING_SWEEP_EXEC_INTERVAL seconds, so that as many run at
+|                  once as keep the requests within the rate of the sweep;
+|                  they start at that rate too.
+| Parameters : struct ping_sweep_run *run : sweep
+| Return : returns true on successful execution, false for any error
+|          encountered
+-----------------------------------------------------------------------------*/
+static bool ping_sweep_exec(struct ping_sweep_run *run)
+{
+    char *args[PING_EXEC_MAX_ARGS];
+    char count[8], timeout[8], addr[INET_ADDRSTRLEN];
+    struct ping_sweep_child *children, *c;
+    struct pollfd *pfds;
+    pingSweep *s = run->s;
+    long long start, now, nextStart, gap;
+    uint16_t reps, wait, rate, maxChildren, next = 0, active = 0, i;
+    int n = 0, error = 0, error2;
+
+    reps = s->entry.pingRepetitions ? s->entry.pingRepetitions
+                                    : PING_SWEEP_DEF_COUNT;
+    wait = s->entry.pingTimeout ? s->entry.pingTimeout : PING_DEF_TIMEOUT;
+    rate = s->rate ? s->rate : PING_SWEEP_DEF_RATE;
+    maxChildren = MIN(MAX(rate / PING_SWEEP_EXEC_RATE, 1),
+                      MIN(s->nTargets, PING_SWEEP_EXEC_MAX_CHILDREN));
+    gap = NSEC_PER_SEC / rate;
+    snprintf(count, sizeof count, "%u", reps);
+    snprintf(timeout, sizeof timeout, "%u", wait);
+
+    args[n++] = EXE_PATH;
+    if (s->entry.mgmt)
+        args[n++] = "mgmt";
+    else if (!strcmp(s->entry.vrf_n, ""))
+        args[n++] = DEFAULT_VRF_NAME;
+    else
+        args[n++] = s->entry.vrf_n;
+    args[n++] = PING4_DEF_CMD;
+    args[n++] = "-n";
+    args[n++] = "-q";
+    args[n++] = "-c";
+    args[n++] = count;
+    args[n++] = "-i";
+    args[n++] = PING_SWEEP_EXEC_INTERVAL;
+    /* a target that does not reply costs the timeout after the last
+     * request */
+    args[n++] = "-W";
+    args[n++] = timeout;
+    args[n++] = "--";
+    args[n++] = addr;
+    args[n] = NULL;
+
+    run->targets = xcalloc(s->nTargets, sizeof *run->targets);
+    children = xcalloc(maxChildren, sizeof *children);
+    pfds = xcalloc(maxChildren, sizeof *pfds);
+    for (i = 0; i < s->nTargets; i++)
+    {
+        run->targets[i].addr.sin_family = AF_INET;
+        run->targets[i].addr.sin_addr = s->targets[i];
+    }
+    ping_sweep_out(run, "PING SWEEP %u targets, %u requests each, "
+                   "%u targets at once\n", s->nTargets, reps, maxChildren);
+
+    start = nextStart = ping_monotonic_ns();
+    while (active || (next < s->nTargets && !error))
+    {
+        now = ping_monotonic_ns();
+        if (next < s->nTargets && !error && active < maxChildren
+            && now >= nextStart)
+        {
+            c = &children[active];
+            memset(c, 0, sizeof *c);
+            c->target = &run->targets[next];
+            inet_ntop(AF_INET, &s->targets[next], addr, sizeof addr);
+            c->fd = diag_netns_spawn(args, &c->pid);
+            if (c->fd < 0)
+            {
+                error = errno;
+                continue;
+            }
+            pfds[active].fd = c->fd;
+            pfds[active].events = POLLIN;
+            active++;
+            next++;
+            nextStart += gap;
+            continue;
+        }
+
+        if (poll(pfds, active, (next < s->nTargets && !error
+                                && active < maxChildren)
+                 ? (nextStart - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC
+                 : -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            VLOG_ERR("poll failed (%s)", strerror(errno));
+            error = errno;
+            /* wait for the commands running */
+            for (i = 0; i < active; i++)
+                pfds[i].revents = POLLHUP;
+        }
+
+        for (i = 0; i < active; )
+        {
+            c = &children[i];
+            if (!pfds[i].revents || ping_sweep_exec_read(c))
+            {
+                i++;
+                continue;
+            }
+            close(c->fd);
+            error2 = diag_netns_wait(c->pid, EXE_PATH);
+            if (error2 && !error)
+                error = error2;
+
+            /* keep the running commands at the front */
+            active--;
+            children[i] = children[active];
+            pfds[i] = pfds[active];
+        }
+    }
+
+    if (error)
+    {
+        VLOG_ERR("Failed to execute %s (%s)", EXE_PATH, strerror(error));
+        ping_sweep_out(run, "ping sweep: cannot execute ping: %s\n",
+                       strerror(error));
+    }
+    else
+    {
+        ping_sweep_table(run, ping_monotonic_ns() - start);
+    }
+    free(pfds);
+    free(children);
+    free(run->targets);
+    return !error;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : ping_sweep
+| Responsibility : Ping all the targets of a sweep and display the results
+| Parameters : pingSweep *s : pointer to ping sweep structure
+|              void (*fptr)(char *buff): function pointer for display purpose
+| Return : returns true on successful execution, false for any error
+|          encountered
+-----------------------------------------------------------------------------*/
+bool ping_sweep(pingSweep *s, void (*fPtr)(char *buff))
+{
+    long long start, now, nextSend, deadline = 0, wait, gap, timeout;
+    struct ping_sweep_run run;
+    struct pollfd pfd;
+    uint8_t *buf;
+    uint16_t count, i;
+    int error, size = PING_SWEEP_SNDRCV_BUF;
+
+    if (!fPtr)
+    {
+        VLOG_ERR("function pointer passed is null");
+        return false;
+    }
+    if (!s || !s->nTargets)
+    {
+        VLOG_ERR("Pointer to ping sweep structure is null");
+        return false;
+    }
+
+    memset(&run, 0, sizeof run);
+    run.s = s;
+    run.fPtr = fPtr;
+    run.sock.fd = -1;
+
+    error = diag_netns_run(s->entry.vrf_n, s->entry.mgmt,
+                           ping_sweep_setup, &run);
+    if (!error)
+        error = run.error;
+    if (error)
+    {
+        VLOG_DBG("sweep socket unavailable (%s), using %s",
+                 strerror(error), EXE_PATH);
+        return ping_sweep_exec(&run);
+    }
+    setsockopt(run.sock.fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+
+    count = s->entry.pingRepetitions ? s->entry.pingRepetitions
+                                     : PING_SWEEP_DEF_COUNT;
+    gap = NSEC_PER_SEC / (s->rate ? s->rate : PING_SWEEP_DEF_RATE);
+    timeout = (s->entry.pingTimeout ? s->entry.pingTimeout
+                                    : PING_DEF_TIMEOUT) * NSEC_PER_SEC;
+
+    run.total = (uint32_t) s->nTargets * count;
+    run.targets = xcalloc(s->nTargets, sizeof *run.targets);
+    run.sentAt = xcalloc(run.total, sizeof *run.sentAt);
+    run.answered = xcalloc(run.total, sizeof *run.answered);
+    buf = xmalloc(PING_RECV_BUFSIZE);
+    for (i = 0; i < sizeof run.data; i++)
+        run.data[i] = i;
+    for (i = 0; i < s->nTargets; i++)
+    {
+        run.targets[i].addr.sin_family = AF_INET;
+        run.targets[i].addr.sin_addr = s->targets[i];
+    }
+
+    ping_sweep_out(&run, "PING SWEEP %u targets, %u requests each, "
+                   "%u requests/s\n", s->nTargets, count,
+                   (unsigned int) (NSEC_PER_SEC / gap));
+
+    pfd.fd = run.sock.fd;
+    pfd.events = POLLIN;
+    start = nextSend = ping_monotonic_ns();
+    for (;;)
+    {
+        now = ping_monotonic_ns();
+        if (run.transmitted < run.total && now >= nextSend)
+        {
+            ping_sweep_send(&run, buf);
+            nextSend += gap;
+            if (run.transmitted == run.total)
+                deadline = now + timeout;
+            continue;
+        }
+        if (run.transmitted == run.total
+            && (run.answers >= run.total || now >= deadline))
+            break;
+
+        wait = (run.transmitted < run.total) ? nextSend - now : deadline - now;
+        if (poll(&pfd, 1, (wait + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC) < 0)
+        {
+            if (errno != EINTR)
+                VLOG_ERR("poll failed (%s)", strerror(errno));
+            break;
+        }
+        if (pfd.revents & POLLERR)
+            ping_sweep_receive(&run, buf, true);
+        if (pfd.revents & POLLIN)
+            ping_sweep_receive(&run, buf, false);
+    }
+    ping_sweep_table(&run, ping_monotonic_ns() - start);
+
+    ping_socket_close(&run.sock);
+    free(buf);
+    free(run.answered);
+    free(run.sentAt);
+    free(run.targets);
+    return true;
+}
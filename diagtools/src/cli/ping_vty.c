@@ -216,6 +216,86 @@ int decodeParam (const char* value, pingArguments type, pingEntry* p)
     return CMD_SUCCESS;
 }
 
+/*-----------------------------------------------------------------------------
+| Name : decodeSweepTargets
+| Responsibility : Validate the targets of a ping sweep and store them in
+|                  pingSweep structure
+| Parameters : const char* value : IPv4 prefix, or comma separated IPv4
+|                                  addresses
+|              pingSweep *s : pointer to structure
+| Return : CMD_SUCCESS for success , CMD_WARNING for failure
+-----------------------------------------------------------------------------*/
+int decodeSweepTargets (const char* value, pingSweep* s)
+{
+    char buffer[BUFSIZ];
+    char *token, *save = NULL, *plenStr;
+    struct in_addr addr;
+    uint32_t mask, host, first, last;
+    int plen;
+
+    if (strlen(value) >= sizeof buffer)
+    {
+        vty_out (vty, "Too many targets. %s", VTY_NEWLINE);
+        return CMD_WARNING;
+    }
+    strcpy(buffer, value);
+    s->nTargets = 0;
+
+    plenStr = strchr(buffer, '/');
+    if (plenStr)
+    {
+        /* Every host address of the prefix */
+        *plenStr++ = '\0';
+        plen = atoi(plenStr);
+        if (inet_pton(AF_INET, buffer, &addr) <= 0 || plen < 0 || plen > 32)
+        {
+            vty_out (vty, "Invalid IPv4 prefix. %s", VTY_NEWLINE);
+            return CMD_WARNING;
+        }
+        if (plen < PING_SWEEP_MIN_PLEN)
+        {
+            vty_out (vty, "Prefix length should be at least %d. %s",
+                     PING_SWEEP_MIN_PLEN, VTY_NEWLINE);
+            return CMD_WARNING;
+        }
+        mask = plen ? 0xffffffff << (32 - plen) : 0;
+        first = ntohl(addr.s_addr) & mask;
+        last = first | ~mask;
+        if (plen < 31)
+        {
+            /* skip the network and broadcast addresses */
+            first++;
+            last--;
+        }
+        for (host = first; host <= last; host++)
+            s->targets[s->nTargets++].s_addr = htonl(host);
+        return CMD_SUCCESS;
+    }
+
+    for (token = strtok_r(buffer, ",", &save); token;
+         token = strtok_r(NULL, ",", &save))
+    {
+        if (inet_pton(AF_INET, token, &addr) <= 0)
+        {
+            vty_out (vty, "Invalid IPv4 address %s. %s", token, VTY_NEWLINE);
+            return CMD_WARNING;
+        }
+        if (s->nTargets == PING_SWEEP_MAX_TARGETS)
+        {
+            vty_out (vty, "Only %d devices can be pinged at once. %s",
+                     PING_SWEEP_MAX_TARGETS, VTY_NEWLINE);
+            return CMD_WARNING;
+        }
+        s->targets[s->nTargets++] = addr;
+    }
+    if (!s->nTargets)
+    {
+        vty_out (vty, "Invalid IPv4 address. %s", VTY_NEWLINE);
+        return CMD_WARNING;
+    }
+    return CMD_SUCCESS;
+}
+
 /*-----------------------------------------------------------------------------
 | Defun for ping IPv4
 | Responsibility : Display ping IPv4 parameters to the user,perform
@@ -420,3 +500,78 @@ DEFUN (cli_ping6,
     }
     return CMD_SUCCESS;
 }
+
+/*-----------------------------------------------------------------------------
+| Defun for ping sweep
+| Responsibility : Ping many IPv4 devices at once, perform validation of
+| input parameters and pass them to handler
+-----------------------------------------------------------------------------*/
+DEFUN (cli_ping_sweep,
+       cli_ping_sweep_cmd,
+    " ping sweep ( A.B.C.D/M | WORD )"
+    " { repetitions <1-10> | timeout <1-60> | rate <1-1000>"
+    " | vrf WORD | mgmt }",
+    PING_STR
+    PING_SWEEP
+    PING_SWEEP_PREFIX
+    PING_SWEEP_LIST
+    PING_COUNT
+    INPUT_SWEEP_COUNT
+    PING_TIMEOUT
+    INPUT_TIMEOUT
+    PING_SWEEP_RATE
+    INPUT_SWEEP_RATE
+    VRF
+    INPUT_VRF
+    MANAGEMENT
+    )
+{
+    pingSweep s;
+    memset (&s, 0, sizeof (struct pingSweep_t));
+
+    /* decode token IPv4 prefix/address list */
+    if (decodeSweepTargets(argv[0], &s) != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token sweep targets failed");
+        return CMD_SUCCESS;
+    }
+
+    /* decode token repetitions */
+    if (decodeParam(argv[1], REPETITIONS, &s.entry) != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token repetition failed");
+        return CMD_SUCCESS;
+    }
+
+    /* decode token timeout */
+    if (decodeParam(argv[2], TIMEOUT, &s.entry) != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token timeout failed");
+        return CMD_SUCCESS;
+    }
+
+    /* Store value of rate */
+    if (argv[3])
+        s.rate = atoi(argv[3]);
+
+    /* decode token vrf */
+    if (decodeParam(argv[4], VRF_NAME, &s.entry) != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token vrf failed");
+        return CMD_SUCCESS;
+    }
+
+    /* decode token mgmt */
+    if (decodeParam(argv[5], MGMT, &s.entry) != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token mgmt failed");
+        return CMD_SUCCESS;
+    }
+
+    if (!ping_sweep(&s, printPingOutput))
+    {
+       VLOG_ERR("Call to sweep handler failed");
+       return CMD_SUCCESS;
+    }
+    return CMD_SUCCESS;
+}
@@ -0,0 +1,948 @@
+/* Native traceroute engine
+ *
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * File: traceroute_engine.c
+ *
+ * Purpose: In-process traceroute and traceroute6 with parallel probes.
+ *
+ * The probes of all the TTLs go out at once, up to TRACE_MAX_INFLIGHT of
+ * them, instead of one hop after the other. The time exceeded and
+ * unreachable errors are read from the error queue of the probe sockets
+ * (IP_RECVERR) and matched to their probe:
+ *  - udp: one socket, the destination port of the probe, base port plus
+ *    probe index, identifies it;
+ *  - icmp: one echo socket, the sequence number identifies the probe;
+ *  - tcp: one non-blocking connect per probe, the socket identifies it.
+ * A hop displays as soon as all its probes are answered or timed out and
+ * the previous hops are displayed. The trace ends at the hop where the
+ * destination answers, or reports it unreachable.
+ *
+ * The whole trace runs on the namespace thread of diag_netns_run(), so
+ * that the per-probe TCP sockets are created in the namespace of the vrf.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <linux/errqueue.h>
+#include "traceroute.h"
+#include "ping_engine.h"
+#include "diag_netns.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(traceroute_engine);
+
+/* state of a probe */
+struct trace_probe {
+    int fd;                         /* tcp socket, -1 otherwise */
+    bool sent;
+    bool done;
+    struct timespec sentAt;
+    long long deadline;             /* monotonic time of the timeout */
+    struct sockaddr_storage from;   /* replier, AF_UNSPEC without reply */
+    double rtt;
+    char note[16];                  /* !H, !N... */
+    bool last;                      /* the trace ends at this hop */
+};
+
+/* error read from the error queue of a probe socket */
+struct trace_error {
+    struct sockaddr_storage dst;        /* destination of the probe */
+    struct sockaddr_storage offender;
+    uint8_t origin;
+    uint8_t type;
+    uint8_t code;
+    uint32_t info;
+    struct timespec stamp;
+};
+
+/* state of a traceroute run */
+struct trace_run {
+    tracerouteEntry *p;
+    void (*fPtr)(char *);
+    int family;
+    struct sockaddr_storage dst;
+    socklen_t dstLen;
+    char dstStr[INET6_ADDRSTRLEN];
+    int error;                      /* errno when the run could not start */
+
+    traceProbeType mode;
+    uint8_t minTtl;
+    uint8_t maxTtl;
+    uint32_t nProbes;
+    uint16_t port;
+    long long timeout;
+    uint8_t options[PING_MAX_IPOPTLEN];
+    size_t optionsLen;
+
+    int udpFd;                      /* udp mode socket */
+    struct ping_socket echo;        /* icmp mode socket */
+    uint8_t data[TRACE_DATA_SIZE];
+    uint8_t *buf;
+
+    struct trace_probe *probes;
+    size_t total;
+    size_t nextSend;
+    size_t inFlight;
+    unsigned int nextHop;           /* next hop to display */
+    unsigned int lastHop;           /* last hop of the trace */
+};
+
+/*-----------------------------------------------------------------------------
+| Name : trace_out
+| Responsibility : Format a line of output and pass it to the display function
+| Parameters : struct trace_run *run : traceroute run
+|              const char *format : printf format
+| Return : void
+-----------------------------------------------------------------------------*/
+static void __attribute__((format(printf, 2, 3)))
+trace_out(struct trace_run *run, const char *format, ...)
+{
+    char line[BUFSIZ];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof line, format, args);
+    va_end(args);
+    (*run->fPtr)(line);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_addr_equal
+| Responsibility : Compare the addresses of two socket addresses
+| Parameters : const struct sockaddr_storage *a, *b : socket addresses
+| Return : true when the addresses are equal
+-----------------------------------------------------------------------------*/
+static bool trace_addr_equal(const struct sockaddr_storage *a,
+                             const struct sockaddr_storage *b)
+{
+    if (a->ss_family != b->ss_family)
+        return false;
+    if (a->ss_family == AF_INET)
+        return ((const struct sockaddr_in *) a)->sin_addr.s_addr
+               == ((const struct sockaddr_in *) b)->sin_addr.s_addr;
+    if (a->ss_family == AF_INET6)
+        return !memcmp(&((const struct sockaddr_in6 *) a)->sin6_addr,
+                       &((const struct sockaddr_in6 *) b)->sin6_addr,
+                       sizeof(struct in6_addr));
+    return false;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_addr_port
+| Responsibility : Read or write the port of a socket address
+| Parameters : struct sockaddr_storage *ss : socket address
+|              int port : port to write, -1 to only read it
+| Return : port
+-----------------------------------------------------------------------------*/
+static uint16_t trace_addr_port(struct sockaddr_storage *ss, int port)
+{
+    in_port_t *p = (ss->ss_family == AF_INET)
+                   ? &((struct sockaddr_in *) ss)->sin_port
+                   : &((struct sockaddr_in6 *) ss)->sin6_port;
+
+    if (port >= 0)
+        *p = htons(port);
+    return ntohs(*p);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_set_ttl
+| Responsibility : Set the TTL (hop limit) of the packets of a socket
+| Parameters : struct trace_run *run : traceroute run
+|              int fd : socket
+|              int ttl : TTL
+| Return : 0 on success, errno value otherwise
+-----------------------------------------------------------------------------*/
+static int trace_set_ttl(struct trace_run *run, int fd, int ttl)
+{
+    int error;
+
+    if (run->family == AF_INET)
+        error = setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof ttl);
+    else
+        error = setsockopt(fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS,
+                           &ttl, sizeof ttl);
+    return error < 0 ? errno : 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_socket_options
+| Responsibility : Enable the error queue and the timestamps of a probe
+|                  socket, and set the loose source route
+| Parameters : struct trace_run *run : traceroute run
+|              int fd : socket
+| Return : 0 on success, errno value otherwise
+-----------------------------------------------------------------------------*/
+static int trace_socket_options(struct trace_run *run, int fd)
+{
+    int on = 1;
+
+    if (run->family == AF_INET)
+    {
+        if (setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof on) < 0)
+            return errno;
+        if (run->optionsLen
+            && setsockopt(fd, IPPROTO_IP, IP_OPTIONS,
+                          run->options, run->optionsLen) < 0)
+            return errno;
+    }
+    else if (setsockopt(fd, IPPROTO_IPV6, IPV6_RECVERR, &on, sizeof on) < 0)
+    {
+        return errno;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof on) < 0)
+        return errno;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_recv_error
+| Responsibility : Read an error from the error queue of a udp or tcp socket
+| Parameters : int fd : socket
+|              struct trace_error *e : error
+| Return : 0 on success, errno value otherwise (EAGAIN when empty)
+-----------------------------------------------------------------------------*/
+static int trace_recv_error(int fd, struct trace_error *e)
+{
+    struct sock_extended_err *ee = NULL;
+    char control[512];
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    uint8_t data[64];
+    bool stamped = false;
+
+    memset(e, 0, sizeof *e);
+    iov.iov_base = data;
+    iov.iov_len = sizeof data;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name = &e->dst;
+    msg.msg_namelen = sizeof e->dst;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        return errno;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET
+            && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&e->stamp, CMSG_DATA(cmsg), sizeof e->stamp);
+            stamped = true;
+        }
+        else if ((cmsg->cmsg_level == IPPROTO_IP
+                  && cmsg->cmsg_type == IP_RECVERR)
+                 || (cmsg->cmsg_level == IPPROTO_IPV6
+                     && cmsg->cmsg_type == IPV6_RECVERR))
+        {
+            ee = (struct sock_extended_err *) CMSG_DATA(cmsg);
+        }
+    }
+    if (!stamped)
+        clock_gettime(CLOCK_REALTIME, &e->stamp);
+    if (!ee)
+        return EAGAIN;
+
+    e->origin = ee->ee_origin;
+    e->type = ee->ee_type;
+    e->code = ee->ee_code;
+    e->info = ee->ee_info;
+    if (SO_EE_OFFENDER(ee)->sa_family == AF_INET)
+        memcpy(&e->offender, SO_EE_OFFENDER(ee), sizeof(struct sockaddr_in));
+    else if (SO_EE_OFFENDER(ee)->sa_family == AF_INET6)
+        memcpy(&e->offender, SO_EE_OFFENDER(ee),
+               sizeof(struct sockaddr_in6));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_probe_ttl
+| Responsibility : Compute the TTL of a probe
+| Parameters : struct trace_run *run : traceroute run
+|              size_t k : probe index
+| Return : TTL
+-----------------------------------------------------------------------------*/
+static unsigned int trace_probe_ttl(const struct trace_run *run, size_t k)
+{
+    return run->minTtl + k / run->nProbes;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_probe_done
+| Responsibility : Complete a probe
+| Parameters : struct trace_run *run : traceroute run
+|              size_t k : probe index
+|              const struct sockaddr_storage *from : replier, NULL on timeout
+|              const struct timespec *stamp : time of the reply
+|              const char *note : annotation of the reply, NULL for none
+|              bool last : the trace ends at the hop of the probe
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_probe_done(struct trace_run *run, size_t k,
+                             const struct sockaddr_storage *from,
+                             const struct timespec *stamp,
+                             const char *note, bool last)
+{
+    struct trace_probe *probe = &run->probes[k];
+    unsigned int ttl = trace_probe_ttl(run, k);
+
+    if (k >= run->nextSend || !probe->sent || probe->done)
+        return;
+
+    probe->done = true;
+    run->inFlight--;
+    if (probe->fd >= 0)
+    {
+        close(probe->fd);
+        probe->fd = -1;
+    }
+    if (from)
+    {
+        probe->from = *from;
+        probe->rtt = ping_rtt_ms(&probe->sentAt, stamp);
+    }
+    if (note)
+        snprintf(probe->note, sizeof probe->note, "%s", note);
+    if (last)
+    {
+        probe->last = true;
+        if (ttl < run->lastHop)
+            run->lastHop = ttl;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_error_done
+| Responsibility : Complete a probe with an ICMP error about it
+| Parameters : struct trace_run *run : traceroute run
+|              size_t k : probe index
+|              const struct sockaddr_storage *from : offender
+|              const struct timespec *stamp : time of the error
+|              uint8_t origin : SO_EE_ORIGIN_* of the error
+|              uint8_t type : ICMP type
+|              uint8_t code : ICMP code
+|              uint32_t info : MTU of the error
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_error_done(struct trace_run *run, size_t k,
+                             const struct sockaddr_storage *from,
+                             const struct timespec *stamp, uint8_t origin,
+                             uint8_t type, uint8_t code, uint32_t info)
+{
+    char note[16];
+    bool v4 = (origin == SO_EE_ORIGIN_ICMP);
+
+    if (origin != SO_EE_ORIGIN_ICMP && origin != SO_EE_ORIGIN_ICMP6)
+    {
+        /* Local error, the probe did not leave */
+        trace_probe_done(run, k, NULL, stamp, NULL, false);
+        return;
+    }
+
+    if ((v4 && type == ICMP_TIME_EXCEEDED)
+        || (!v4 && type == ICMP6_TIME_EXCEEDED))
+    {
+        trace_probe_done(run, k, from, stamp, NULL, false);
+        return;
+    }
+
+    /* The destination rejects the udp probes with port unreachable */
+    if ((v4 && type == ICMP_DEST_UNREACH && code == ICMP_PORT_UNREACH)
+        || (!v4 && type == ICMP6_DST_UNREACH
+            && code == ICMP6_DST_UNREACH_NOPORT))
+    {
+        trace_probe_done(run, k, from, stamp, NULL, true);
+        return;
+    }
+
+    if (v4 && type == ICMP_DEST_UNREACH)
+    {
+        switch (code)
+        {
+            case ICMP_NET_UNREACH:
+            case ICMP_NET_UNKNOWN:
+            case ICMP_NET_UNR_TOS:
+                snprintf(note, sizeof note, "!N");
+                break;
+            case ICMP_HOST_UNREACH:
+            case ICMP_HOST_UNKNOWN:
+            case ICMP_HOST_UNR_TOS:
+                snprintf(note, sizeof note, "!H");
+                break;
+            case ICMP_PROT_UNREACH:
+                snprintf(note, sizeof note, "!P");
+                break;
+            case ICMP_FRAG_NEEDED:
+                snprintf(note, sizeof note, "!F-%u", info);
+                break;
+            case ICMP_SR_FAILED:
+                snprintf(note, sizeof note, "!S");
+                break;
+            case ICMP_NET_ANO:
+            case ICMP_HOST_ANO:
+            case ICMP_PKT_FILTERED:
+                snprintf(note, sizeof note, "!X");
+                break;
+            case ICMP_PREC_VIOLATION:
+                snprintf(note, sizeof note, "!V");
+                break;
+            case ICMP_PREC_CUTOFF:
+                snprintf(note, sizeof note, "!C");
+                break;
+            default:
+                snprintf(note, sizeof note, "!<%u>", code);
+                break;
+        }
+    }
+    else if (!v4 && type == ICMP6_DST_UNREACH)
+    {
+        switch (code)
+        {
+            case ICMP6_DST_UNREACH_NOROUTE:
+                snprintf(note, sizeof note, "!N");
+                break;
+            case ICMP6_DST_UNREACH_ADMIN:
+                snprintf(note, sizeof note, "!X");
+                break;
+            case ICMP6_DST_UNREACH_BEYONDSCOPE:
+                snprintf(note, sizeof note, "!S");
+                break;
+            case ICMP6_DST_UNREACH_ADDR:
+                snprintf(note, sizeof note, "!H");
+                break;
+            default:
+                snprintf(note, sizeof note, "!<%u>", code);
+                break;
+        }
+    }
+    else if (!v4 && type == ICMP6_PACKET_TOO_BIG)
+    {
+        snprintf(note, sizeof note, "!F-%u", info);
+    }
+    else
+    {
+        snprintf(note, sizeof note, "!<%u-%u>", type, code);
+    }
+    trace_probe_done(run, k, from, stamp, note, true);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_send
+| Responsibility : Send the next probe
+| Parameters : struct trace_run *run : traceroute run
+|              long long now : monotonic time
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_send(struct trace_run *run, long long now)
+{
+    size_t k = run->nextSend++;
+    struct trace_probe *probe = &run->probes[k];
+    unsigned int ttl = trace_probe_ttl(run, k);
+    struct sockaddr_storage dst = run->dst;
+    socklen_t len = sizeof(int);
+    int error = 0, fd;
+
+    probe->sent = true;
+    probe->deadline = now + run->timeout;
+    run->inFlight++;
+
+    switch (run->mode)
+    {
+        case TRACE_PROBE_UDP:
+            /* The pending error of an earlier probe would fail the send,
+             * the error queue keeps its details */
+            getsockopt(run->udpFd, SOL_SOCKET, SO_ERROR, &error, &len);
+            trace_addr_port(&dst, run->port + k);
+            error = trace_set_ttl(run, run->udpFd, ttl);
+            clock_gettime(CLOCK_REALTIME, &probe->sentAt);
+            if (!error && sendto(run->udpFd, run->data, sizeof run->data,
+                                 MSG_DONTWAIT, (struct sockaddr *) &dst,
+                                 run->dstLen) < 0)
+                error = errno;
+            break;
+
+        case TRACE_PROBE_ICMP:
+            error = trace_set_ttl(run, run->echo.fd, ttl);
+            if (!error)
+                error = ping_send(&run->echo, (struct sockaddr *) &dst,
+                                  run->dstLen, k + 1, run->data,
+                                  sizeof run->data, &probe->sentAt);
+            break;
+
+        case TRACE_PROBE_TCP:
+            trace_addr_port(&dst, run->port);
+            fd = socket(run->family,
+                        SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                error = errno;
+                break;
+            }
+            probe->fd = fd;
+            error = trace_socket_options(run, fd);
+            if (!error)
+                error = trace_set_ttl(run, fd, ttl);
+            clock_gettime(CLOCK_REALTIME, &probe->sentAt);
+            if (!error && connect(fd, (struct sockaddr *) &dst,
+                                  run->dstLen) < 0 && errno != EINPROGRESS)
+                error = errno;
+            break;
+    }
+
+    /* The probe is lost, the pending errors come from the error queue */
+    if (error && error != EAGAIN && error != ENOBUFS)
+        VLOG_DBG("probe %zu failed (%s)", k, strerror(error));
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_receive_udp
+| Responsibility : Process the errors and replies of the udp socket
+| Parameters : struct trace_run *run : traceroute run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_receive_udp(struct trace_run *run)
+{
+    struct sockaddr_storage from;
+    socklen_t fromLen;
+    struct timespec stamp;
+    struct trace_error e;
+    size_t k;
+
+    while (!trace_recv_error(run->udpFd, &e))
+    {
+        if (e.dst.ss_family != run->family)
+            continue;
+        k = (uint16_t) (trace_addr_port(&e.dst, -1) - run->port);
+        if (k < run->total)
+            trace_error_done(run, k, &e.offender, &e.stamp,
+                             e.origin, e.type, e.code, e.info);
+    }
+
+    /* A service of the destination answered a probe */
+    for (;;)
+    {
+        fromLen = sizeof from;
+        if (recvfrom(run->udpFd, run->buf, PING_RECV_BUFSIZE, MSG_DONTWAIT,
+                     (struct sockaddr *) &from, &fromLen) < 0)
+            break;
+        clock_gettime(CLOCK_REALTIME, &stamp);
+        k = (uint16_t) (trace_addr_port(&from, -1) - run->port);
+        if (k < run->total && trace_addr_equal(&from, &run->dst))
+            trace_probe_done(run, k, &from, &stamp, NULL, true);
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_receive_icmp
+| Responsibility : Process the errors and replies of the echo socket
+| Parameters : struct trace_run *run : traceroute run
+|              bool errQueue : process the error queue
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_receive_icmp(struct trace_run *run, bool errQueue)
+{
+    struct ping_reply r;
+    uint8_t origin = (run->family == AF_INET) ? SO_EE_ORIGIN_ICMP
+                                              : SO_EE_ORIGIN_ICMP6;
+
+    while (!ping_recv(&run->echo, run->buf, PING_RECV_BUFSIZE, errQueue, &r))
+    {
+        if (r.kind == PING_REPLY_NONE || !r.seq || r.seq > run->total)
+            continue;
+        if (r.kind == PING_REPLY_ECHO)
+        {
+            if (trace_addr_equal(&r.from, &run->dst))
+                trace_probe_done(run, r.seq - 1, &r.from, &r.stamp,
+                                 NULL, true);
+        }
+        else
+        {
+            trace_error_done(run, r.seq - 1, &r.from, &r.stamp,
+                             (r.kind == PING_REPLY_ERROR)
+                             ? origin : SO_EE_ORIGIN_LOCAL,
+                             r.type, r.code, r.info);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_receive_tcp
+| Responsibility : Process the events of the socket of a tcp probe
+| Parameters : struct trace_run *run : traceroute run
+|              size_t k : probe index
+|              short revents : poll events
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_receive_tcp(struct trace_run *run, size_t k,
+                              short revents)
+{
+    struct trace_probe *probe = &run->probes[k];
+    struct timespec stamp;
+    struct trace_error e;
+    socklen_t len = sizeof(int);
+    int error = 0;
+
+    if (!trace_recv_error(probe->fd, &e))
+    {
+        trace_error_done(run, k, &e.offender, &e.stamp,
+                         e.origin, e.type, e.code, e.info);
+        return;
+    }
+
+    /* The destination answered the SYN, with a SYN-ACK or a reset */
+    getsockopt(probe->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    clock_gettime(CLOCK_REALTIME, &stamp);
+    if (!error || error == ECONNREFUSED)
+        trace_probe_done(run, k, &run->dst, &stamp, NULL, true);
+    else if (revents & (POLLERR | POLLHUP))
+        trace_probe_done(run, k, NULL, &stamp, NULL, false);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_display
+| Responsibility : Display the completed hops, in order
+| Parameters : struct trace_run *run : traceroute run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_display(struct trace_run *run)
+{
+    char line[BUFSIZ], addr[INET6_ADDRSTRLEN];
+    const struct sockaddr_storage *prev;
+    struct trace_probe *probe;
+    size_t first, q;
+    int len;
+
+    while (run->nextHop <= run->lastHop)
+    {
+        first = (size_t) (run->nextHop - run->minTtl) * run->nProbes;
+        for (q = 0; q < run->nProbes; q++)
+        {
+            if (!run->probes[first + q].done)
+                return;
+        }
+
+        len = snprintf(line, sizeof line, "%2u ", run->nextHop);
+        prev = NULL;
+        for (q = 0; q < run->nProbes; q++)
+        {
+            probe = &run->probes[first + q];
+            if (probe->from.ss_family == AF_UNSPEC)
+            {
+                len += snprintf(line + len, sizeof line - len, " *");
+                continue;
+            }
+            if (!prev || !trace_addr_equal(prev, &probe->from))
+            {
+                ping_addr_str(&probe->from, addr);
+                /* Hops are not resolved, the address is shown once */
+                len += snprintf(line + len, sizeof line - len, " %s", addr);
+                prev = &probe->from;
+            }
+            len += snprintf(line + len, sizeof line - len, "  %.3f ms%s%s",
+                            probe->rtt, probe->note[0] ? " " : "",
+                            probe->note);
+        }
+        trace_out(run, "%s", line);
+        run->nextHop++;
+    }
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_loop
+| Responsibility : Send the probes and collect their replies until the last
+|                  hop is displayed
+| Parameters : struct trace_run *run : traceroute run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_loop(struct trace_run *run)
+{
+    struct pollfd *pfds = xcalloc(TRACE_MAX_INFLIGHT + 1, sizeof *pfds);
+    size_t *index = xcalloc(TRACE_MAX_INFLIGHT + 1, sizeof *index);
+    long long now, wait;
+    size_t k, n;
+
+    while (run->nextHop <= run->lastHop)
+    {
+        now = ping_monotonic_ns();
+        while (run->nextSend < run->total
+               && run->inFlight < TRACE_MAX_INFLIGHT
+               && trace_probe_ttl(run, run->nextSend) <= run->lastHop)
+            trace_send(run, now);
+
+        /* Timeouts, and the probes past the end of the trace */
+        wait = run->timeout;
+        for (k = 0; k < run->nextSend; k++)
+        {
+            struct trace_probe *probe = &run->probes[k];
+
+            if (!probe->sent || probe->done)
+                continue;
+            if (now >= probe->deadline
+                || trace_probe_ttl(run, k) > run->lastHop)
+                trace_probe_done(run, k, NULL, NULL, NULL, false);
+            else if (probe->deadline - now < wait)
+                wait = probe->deadline - now;
+        }
+
+        trace_display(run);
+        if (run->nextHop > run->lastHop)
+            break;
+
+        n = 0;
+        if (run->mode == TRACE_PROBE_TCP)
+        {
+            for (k = 0; k < run->nextSend; k++)
+            {
+                if (run->probes[k].fd < 0)
+                    continue;
+                pfds[n].fd = run->probes[k].fd;
+                pfds[n].events = POLLOUT;
+                index[n++] = k;
+            }
+        }
+        else
+        {
+            pfds[n].fd = (run->mode == TRACE_PROBE_UDP) ? run->udpFd
+                                                        : run->echo.fd;
+            pfds[n++].events = POLLIN;
+        }
+
+        if (poll(pfds, n, (wait + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC) < 0)
+        {
+            if (errno != EINTR)
+                VLOG_ERR("poll failed (%s)", strerror(errno));
+            break;
+        }
+
+        for (k = 0; k < n; k++)
+        {
+            if (!pfds[k].revents)
+                continue;
+            if (run->mode == TRACE_PROBE_UDP)
+                trace_receive_udp(run);
+            else if (run->mode == TRACE_PROBE_ICMP)
+            {
+                if (pfds[k].revents & POLLERR)
+                    trace_receive_icmp(run, true);
+                if (pfds[k].revents & POLLIN)
+                    trace_receive_icmp(run, false);
+            }
+            else
+                trace_receive_tcp(run, index[k], pfds[k].revents);
+        }
+    }
+
+    free(index);
+    free(pfds);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_open
+| Responsibility : Open the probe socket of the udp and icmp modes, and
+|                  check that the destination has a route
+| Parameters : struct trace_run *run : traceroute run
+| Return : 0 on success, errno value of the socket creation otherwise, -1
+|          after displaying an error
+-----------------------------------------------------------------------------*/
+static int trace_open(struct trace_run *run)
+{
+    struct sockaddr_storage first = run->dst;
+    struct in_addr gateway;
+    int fd, error;
+
+    /* The route check goes to the first gateway of a source route */
+    if (run->p->tracerouteLoosesourceIp
+        && inet_pton(AF_INET, run->p->tracerouteLoosesourceIp, &gateway) > 0)
+        ((struct sockaddr_in *) &first)->sin_addr = gateway;
+    trace_addr_port(&first, run->port);
+
+    fd = socket(run->family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return errno;
+    if (connect(fd, (struct sockaddr *) &first, run->dstLen) < 0)
+    {
+        trace_out(run, "connect: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (run->mode == TRACE_PROBE_UDP)
+    {
+        run->udpFd = socket(run->family,
+                            SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (run->udpFd < 0)
+            return errno;
+        return trace_socket_options(run, run->udpFd);
+    }
+    if (run->mode == TRACE_PROBE_ICMP)
+    {
+        error = ping_socket_open(&run->echo, run->family);
+        if (!error && run->optionsLen
+            && setsockopt(run->echo.fd, IPPROTO_IP, IP_OPTIONS,
+                          run->options, run->optionsLen) < 0)
+            error = errno;
+        return error;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+| Name : trace_run_ns
+| Responsibility : Run a traceroute inside the namespace of the vrf
+| Parameters : void *aux : pointer to the traceroute run
+| Return : void
+-----------------------------------------------------------------------------*/
+static void trace_run_ns(void *aux)
+{
+    struct trace_run *run = aux;
+    tracerouteEntry *p = run->p;
+    struct addrinfo hints, *res;
+    struct in_addr gateway;
+    size_t k;
+    int error;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = run->family;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(p->tracerouteTarget, NULL, &hints, &res))
+    {
+        trace_out(run, "traceroute: unknown host %s", p->tracerouteTarget);
+        return;
+    }
+    memcpy(&run->dst, res->ai_addr, res->ai_addrlen);
+    run->dstLen = res->ai_addrlen;
+    freeaddrinfo(res);
+    ping_addr_str(&run->dst, run->dstStr);
+
+    /* Loose source route through the gateway, then the destination */
+    if (run->family == AF_INET && p->tracerouteLoosesourceIp
+        && inet_pton(AF_INET, p->tracerouteLoosesourceIp, &gateway) > 0)
+    {
+        run->options[0] = IPOPT_NOP;
+        run->options[1] = IPOPT_LSRR;
+        run->options[2] = 3 + 2 * sizeof(struct in_addr);
+        run->options[3] = IPOPT_MINOFF;
+        memcpy(run->options + 4, &gateway, sizeof gateway);
+        memcpy(run->options + 8,
+               &((struct sockaddr_in *) &run->dst)->sin_addr,
+               sizeof(struct in_addr));
+        run->optionsLen = run->options[2] + 1;
+    }
+
+    error = trace_open(run);
+    if (error > 0)
+    {
+        /* Not started, the caller falls back to the traceroute command */
+        run->error = error;
+        return;
+    }
+    if (error < 0)
+        return;
+
+    trace_out(run, "traceroute to %s (%s), %u hops max, %zu byte packets",
+              p->tracerouteTarget, run->dstStr, run->maxTtl,
+              ((run->family == AF_INET) ? sizeof(struct ip)
+                                        : sizeof(struct ip6_hdr))
+              + PING_ICMP_HDRLEN + TRACE_DATA_SIZE);
+
+    run->total = (size_t) (run->maxTtl - run->minTtl + 1) * run->nProbes;
+    run->probes = xcalloc(run->total, sizeof *run->probes);
+    for (k = 0; k < run->total; k++)
+        run->probes[k].fd = -1;
+    run->buf = xmalloc(PING_RECV_BUFSIZE);
+    run->nextHop = run->minTtl;
+    run->lastHop = run->maxTtl;
+
+    trace_loop(run);
+
+    for (k = 0; k < run->total; k++)
+    {
+        if (run->probes[k].fd >= 0)
+            close(run->probes[k].fd);
+    }
+    free(run->buf);
+    free(run->probes);
+}
+
+/*-----------------------------------------------------------------------------
+| Name : traceroute_native
+| Responsibility : Perform traceroute functionality in process
+| Parameters : tracerouteEntry* p : pointer to traceroute structure,
+|              void (*fptr)(char *buff): function pointer for display purpose
+| Return : 0 when the traceroute ran, errno value when it could not start
+|          (no privilege to enter the namespace or to open the socket)
+-----------------------------------------------------------------------------*/
+int traceroute_native(tracerouteEntry *p, void (*fPtr)(char *))
+{
+    struct trace_run run;
+    int error;
+
+    if (!p || !fPtr || !p->tracerouteTarget)
+        return EINVAL;
+
+    memset(&run, 0, sizeof run);
+    run.p = p;
+    run.fPtr = fPtr;
+    run.family = p->isIpv4 ? AF_INET : AF_INET6;
+    run.udpFd = -1;
+    run.echo.fd = -1;
+    run.mode = p->tracerouteProbeType;
+    run.minTtl = p->tracerouteMinttl ? p->tracerouteMinttl : TRACE_DEF_MINTTL;
+    run.maxTtl = p->tracerouteMaxttl ? p->tracerouteMaxttl : TRACE_DEF_MAXTTL;
+    run.nProbes = p->tracerouteProbes ? p->tracerouteProbes
+                                      : TRACE_DEF_PROBES;
+    run.timeout = (p->tracerouteTimeout ? p->tracerouteTimeout
+                                        : TRACE_DEF_WAIT) * NSEC_PER_SEC;
+    if (p->tracerouteDstport)
+        run.port = p->tracerouteDstport;
+    else
+        run.port = (run.mode == TRACE_PROBE_TCP) ? TRACE_DEF_TCP_PORT
+                                                 : TRACE_DEF_PORT;
+    if (run.minTtl > run.maxTtl)
+        run.minTtl = run.maxTtl;
+    for (error = 0; error < TRACE_DATA_SIZE; error++)
+        run.data[error] = 0x40 + error;
+
+    error = diag_netns_run(p->vrf_n, p->mgmt, trace_run_ns, &run);
+    if (!error)
+        error = run.error;
+
+    if (run.udpFd >= 0)
+        close(run.udpFd);
+    ping_socket_close(&run.echo);
+    return error;
+}
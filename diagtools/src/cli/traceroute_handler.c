@@ -23,7 +23,9 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "traceroute.h"
+#include "diag_netns.h"
 #include "vtysh/command.h"
 #include "vtysh/vtysh.h"
 #include "openvswitch/vlog.h"
@@ -39,10 +41,10 @@ VLOG_DEFINE_THIS_MODULE(traceroute_handler);
 ----------------------------------------------------------------------------------------*/
 bool traceroute_handler(tracerouteEntry *p, void (*fPtr)(char *buff))
 {
-    char buffer[BUFSIZ];
-    char *target = buffer;
-    int len = 0;
-    FILE *fp = NULL;
+    char *args[TRACE_EXEC_MAX_ARGS];
+    char dstport[12], maxttl[12], minttl[12], probes[12], timeout[12];
+    int n = 0;
+    int error;
 
     if(!fPtr)
     {
@@ -55,64 +57,85 @@ bool traceroute_handler(tracerouteEntry *p, void (*fPtr)(char *buff))
         return false;
     }
 
+    /* Trace in process, the command runs through nwdiag only when the
+     * native engine cannot start */
+    error = traceroute_native(p, fPtr);
+    if (!error)
+        return true;
+    VLOG_DBG("native traceroute unavailable (%s), using %s",
+             strerror(error), EXE_PATH);
+
     /* Append path and namespace name */
-    len += snprintf(target+len, BUFSIZ, "%s ", EXE_PATH);
+    args[n++] = EXE_PATH;
 
     if(p->mgmt)
     {
-        len += snprintf(target+len,  BUFSIZ-len, "%s ", "mgmt");
+        args[n++] = "mgmt";
     }
     else
     {
         if(!strcmp(p->vrf_n,""))
-            len += snprintf(target+len, BUFSIZ-len, "%s ", DEFAULT_VRF_NAME);
+            args[n++] = DEFAULT_VRF_NAME;
         else
-            len += snprintf(target+len, BUFSIZ-len, "%s ", p->vrf_n);
+            args[n++] = p->vrf_n;
     }
 
     /* Append default cmd either traceroute4 or traceroute6 */
     if(p->isIpv4)
     {
-        len += snprintf(target+len, BUFSIZ-len, "%s ", TRACEROUTE4_DEF_CMD);
+        args[n++] = TRACEROUTE4_DEF_CMD;
     }
     else
     {
-        len += snprintf(target+len, BUFSIZ-len, "%s ", TRACEROUTE6_DEF_CMD);
+        args[n++] = TRACEROUTE6_DEF_CMD;
     }
 
-    len += snprintf(target+len, BUFSIZ-len, " \" ");
-    /* Append Target address */
-    if(p->tracerouteTarget)
+    /* Append the probe type, udp by default */
+    if(p->tracerouteProbeType == TRACE_PROBE_ICMP)
     {
-        len += snprintf(target+len, BUFSIZ-len, "%s", p->tracerouteTarget);
+        args[n++] = TRACEROUTE_ICMP_OPT;
     }
+    else if(p->tracerouteProbeType == TRACE_PROBE_TCP)
+    {
+        args[n++] = TRACEROUTE_TCP_OPT;
+    }
+
     /* Append the value of destination port */
     if(!p->tracerouteDstport)
     {
-        p->tracerouteDstport = TRACE_DEF_PORT;
+        p->tracerouteDstport = (p->tracerouteProbeType == TRACE_PROBE_TCP)
+                               ? TRACE_DEF_TCP_PORT : TRACE_DEF_PORT;
     }
-    len += snprintf(target+len, BUFSIZ-len, " -p %d", p->tracerouteDstport);
+    snprintf(dstport, sizeof dstport, "%d", p->tracerouteDstport);
+    args[n++] = "-p";
+    args[n++] = dstport;
 
     /* Append the value of max TTL */
     if(!p->tracerouteMaxttl)
     {
         p->tracerouteMaxttl = TRACE_DEF_MAXTTL;
     }
-    len += snprintf(target+len, BUFSIZ-len, " -m %d", p->tracerouteMaxttl);
+    snprintf(maxttl, sizeof maxttl, "%d", p->tracerouteMaxttl);
+    args[n++] = "-m";
+    args[n++] = maxttl;
 
     /* Append the value of probes */
     if(!p->tracerouteProbes)
     {
         p->tracerouteProbes = TRACE_DEF_PROBES;
     }
-    len += snprintf(target+len, BUFSIZ-len, " -q %d", p->tracerouteProbes);
+    snprintf(probes, sizeof probes, "%u", p->tracerouteProbes);
+    args[n++] = "-q";
+    args[n++] = probes;
 
     /* Append the value of wait time */
     if(!p->tracerouteTimeout)
     {
         p->tracerouteTimeout = TRACE_DEF_WAIT;
     }
-    len += snprintf(target+len, BUFSIZ-len, " -w %d", p->tracerouteTimeout);
+    snprintf(timeout, sizeof timeout, "%d", p->tracerouteTimeout);
+    args[n++] = "-w";
+    args[n++] = timeout;
 
     /* Traceroute4 options */
     if(p->isIpv4)
@@ -122,31 +145,32 @@ bool traceroute_handler(tracerouteEntry *p, void (*fPtr)(char *buff))
         {
             p->tracerouteMinttl = TRACE_DEF_MINTTL;
         }
-        len += snprintf(target+len, BUFSIZ-len,
-                        " -f %d", p->tracerouteMinttl);
+        snprintf(minttl, sizeof minttl, "%d", p->tracerouteMinttl);
+        args[n++] = "-f";
+        args[n++] = minttl;
 
         /* Append the IP of loosesourceroute */
         if(p->tracerouteLoosesourceIp)
         {
-            len += snprintf(target+len, BUFSIZ-len,
-                            " -g %s", p->tracerouteLoosesourceIp);
+            args[n++] = "-g";
+            args[n++] = p->tracerouteLoosesourceIp;
         }
     }
 
-    len += snprintf(target+len, BUFSIZ-len, " \" ");
-    fp = popen(buffer,"w");
-
-    if(fp)
+    /* Append Target address, never parsed as an option */
+    args[n++] = "--";
+    if(p->tracerouteTarget)
     {
-        while (fgets(buffer, BUFSIZ, fp ) != NULL)
-            (*fPtr)(buffer);
+        args[n++] = p->tracerouteTarget;
     }
-    else
+    args[n] = NULL;
+
+    error = diag_netns_exec(args, false, fPtr);
+    if(error)
     {
-        VLOG_ERR("Failed to open pipe stream");
+        VLOG_ERR("Failed to run %s (%s)", EXE_PATH, strerror(error));
         (*fPtr)("Internal error");
         return false;
     }
-    pclose(fp);
     return true;
 }
@@ -201,6 +201,19 @@ int decodeTracerouteParam(const char* value, arguments type, tracerouteEntry* p)
             }
             break;
         }
+        case TRACEROUTE_PROBE_TYPE :
+        {
+            if (value)
+            {
+                if (!strcmp(value, "icmp"))
+                    p->tracerouteProbeType = TRACE_PROBE_ICMP;
+                else if (!strcmp(value, "tcp"))
+                    p->tracerouteProbeType = TRACE_PROBE_TCP;
+                else
+                    p->tracerouteProbeType = TRACE_PROBE_UDP;
+            }
+            break;
+        }
 
         default : break;
     }
@@ -215,7 +228,8 @@ int decodeTracerouteParam(const char* value, arguments type, tracerouteEntry* p)
 DEFUN (cli_traceroute,
        cli_traceroute_cmd,
     "traceroute ( A.B.C.D | WORD ) { dstport <1-34000> | maxttl <1-255> | "
-    "minttl <1-255> | probes <1-5>| timeout <1-60> | vrf WORD | mgmt} ",
+    "minttl <1-255> | probes <1-5>| timeout <1-60> | vrf WORD | mgmt | "
+    "probe ( udp | icmp | tcp )} ",
     TRACEROUTE_STR
     TRACEROUTE_IP
     TRACEROUTE_HOST
@@ -232,6 +246,10 @@ DEFUN (cli_traceroute,
     VRF
     INPUT_VRF
     MANAGEMENT
+    TRACEROUTE_PROBE
+    PROBE_UDP
+    PROBE_ICMP
+    PROBE_TCP
     )
 {
     tracerouteEntry p;
@@ -308,6 +326,14 @@ DEFUN (cli_traceroute,
         return CMD_SUCCESS;
     }
 
+    /* decode token probe */
+    if (decodeTracerouteParam(argv[8], TRACEROUTE_PROBE_TYPE, &p)
+        != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token probe failed");
+        return CMD_SUCCESS;
+    }
+
     /* handler for popen, output is printed by printOutput function */
     if(!traceroute_handler(&p, printOutput))
     {
@@ -327,7 +353,7 @@ DEFUN (cli_traceroute_ipoption,
        cli_traceroute_ipoption_cmd,
     "traceroute ( A.B.C.D | WORD ) ip-option loosesourceroute A.B.C.D "
     "{ dstport <1-34000> | maxttl <1-255> | minttl <1-255> | "
-    "probes <1-5>| timeout <1-60>} ",
+    "probes <1-5>| timeout <1-60> | probe ( udp | icmp | tcp )} ",
     TRACEROUTE_STR
     TRACEROUTE_IP
     TRACEROUTE_HOST
@@ -344,6 +370,10 @@ DEFUN (cli_traceroute_ipoption,
     PROBES_INPUT
     TRACEROUTE_TIMEOUT
     TIMEOUT_INPUT
+    TRACEROUTE_PROBE
+    PROBE_UDP
+    PROBE_ICMP
+    PROBE_TCP
     )
 {
     tracerouteEntry p;
@@ -414,6 +444,14 @@ DEFUN (cli_traceroute_ipoption,
         return CMD_SUCCESS;
     }
 
+    /* decode token probe */
+    if (decodeTracerouteParam(argv[7], TRACEROUTE_PROBE_TYPE, &p)
+        != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token probe failed");
+        return CMD_SUCCESS;
+    }
+
     /* handler for popen, output is printed by printOutput function */
     if(!traceroute_handler(&p, printOutput))
     {
@@ -432,7 +470,8 @@ DEFUN (cli_traceroute_ipoption,
 DEFUN (cli_traceroute6,
        cli_traceroute6_cmd,
     "traceroute6 ( X:X::X:X | WORD ) { dstport <1-34000> | maxttl <1-255> | "
-    "probes <1-5>| timeout <1-60> | vrf WORD | mgmt} ",
+    "probes <1-5>| timeout <1-60> | vrf WORD | mgmt | "
+    "probe ( udp | icmp | tcp )} ",
     TRACEROUTE6_STR
     TRACEROUTE_IP
     TRACEROUTE_HOST
@@ -447,6 +486,10 @@ DEFUN (cli_traceroute6,
     VRF
     INPUT_VRF
     MANAGEMENT
+    TRACEROUTE_PROBE
+    PROBE_UDP
+    PROBE_ICMP
+    PROBE_TCP
     )
 {
     tracerouteEntry p;
@@ -501,6 +544,14 @@ DEFUN (cli_traceroute6,
         return CMD_SUCCESS;
     }
 
+    /* decode token probe */
+    if (decodeTracerouteParam(argv[7], TRACEROUTE_PROBE_TYPE, &p)
+        != CMD_SUCCESS)
+    {
+        VLOG_ERR("Decoding of token probe failed");
+        return CMD_SUCCESS;
+    }
+
    /* handler for popen, output is printed by printOutput function */
     if(!traceroute_handler(&p, printOutput))
     {
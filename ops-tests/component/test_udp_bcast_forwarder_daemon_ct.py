@@ -13,6 +13,7 @@
 # License for the specific language governing permissions and limitations
 # under the License.
 
+from json import loads
 from time import sleep
 
 TOPOLOGY = """
@@ -313,6 +314,78 @@ def udp_forward_protocol_server_entry03(sw1):
     return True
 
 
+# Verify JSON dump output, filters and changed-since deltas
+def udp_forward_protocol_json_dump(sw1):
+    out = "ovs-appctl -t ops-relay udpfwd/dump --json interface 13"
+    dump = loads(sw1(out, shell="bash"))
+    intf = dump['interfaces']['13']
+    assert intf['server_count'] == 4
+    assert {'ip': '12.12.12.12', 'port': 53, 'ref_count': 1} \
+        in intf['servers']
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump --json interface 13 " \
+          "feature dhcp-relay"
+    dump = loads(sw1(out, shell="bash"))
+    servers = dump['interfaces']['13']['servers']
+    assert len(servers) == 1 and servers[0]['ip'] == '12.1.1.1'
+    assert 'udp_bcast_forwarder' not in dump['features']
+
+    generation = dump['generation']
+    sw1("configure terminal")
+    sw1("interface 14")
+    sw1("ip forward-protocol udp 14.14.14.14 dns")
+    sw1("end")
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump --json " \
+          "--changed-since=%d" % generation
+    dump = loads(sw1(out, shell="bash"))
+    assert dump['generation'] > generation
+    assert '14' in dump['interfaces']
+    if not dump['full']:
+        assert '13' not in dump['interfaces']
+
+    # The text dump applies the same filter, also with an interface
+    out = "ovs-appctl -t ops-relay udpfwd/dump " \
+          "--changed-since=%d" % generation
+    output = sw1(out, shell="bash")
+    assert 'Generation : ' in output
+    assert 'Interface 14:' in output
+    if 'Full dump : 0' in output:
+        assert 'Interface 13:' not in output
+
+    out = "ovs-appctl -t ops-relay udpfwd/dump interface 14 " \
+          "--changed-since=%d" % dump['generation']
+    output = sw1(out, shell="bash")
+    assert 'Full dump : 0' in output
+    assert 'Interface 14:' not in output
+    return True
+
+
+# Verify the receive context of a non-default VRF uses the VRF namespace
+def udp_forward_protocol_vrf_namespace(sw1):
+    sw1("configure terminal")
+    sw1("vrf red")
+    sw1("end")
+
+    # The namespace of a VRF is named after its UUID, not its name
+    out = "ovs-vsctl --bare --columns=_uuid find vrf name=red"
+    uuid = sw1(out, shell="bash").strip()
+    assert uuid
+
+    out = "ovs-appctl -t ops-relay udpfwd/vrfs"
+    output = sw1(out, shell="bash")
+    assert 'VRF red : namespace %s' % uuid in output
+    assert 'namespace red' not in output
+
+    sw1("configure terminal")
+    sw1("no vrf red")
+    sw1("end")
+
+    output = sw1(out, shell="bash")
+    assert 'VRF red' not in output
+    return True
+
+
 # Verify UDP forward-protocol configuration post reboot
 def udp_forward_protocol_reboot(sw1):
     sw1("configure terminal")
@@ -383,3 +456,9 @@ def test_ipapps_udp_bcast_forwarder_configuration(topology, step):
     step("Verify the configuration of dhcp-relay helper address and")
     step("UDP forward-protocol server addresses together")
     udp_forward_protocol_server_entry03(sw1)
+
+    step("Verify JSON dump output, filters and changed-since deltas")
+    udp_forward_protocol_json_dump(sw1)
+
+    step("Verify the receive context of a non-default VRF")
+    udp_forward_protocol_vrf_namespace(sw1)
@@ -171,3 +171,22 @@ def test_ping_cli(topology, step):
     ret = sw1('ping6 localhost data-fill dee datagram-size 200 '
               'interval 2 repetitions 1')
     assert "PING localhost(localhost)" in ret and "200 data bytes" in ret
+
+
+def test_ping_sweep_non_root(topology, step):
+    sw1 = topology.get('sw1')
+
+    assert sw1 is not None
+
+    step('### ping sweep as admin ###')
+    ret = sw1('ping sweep 127.0.0.1,127.0.0.2 repetitions 1 timeout 1')
+    assert '2 targets, 2 reachable' in ret
+
+    step('### ping sweep as a user without privileges ###')
+    # netop cannot open the ICMP socket of the sweep in the namespace of
+    # the vrf, the targets are pinged through nwdiag instead
+    ret = sw1('su netop -s /bin/sh -c "vtysh -c \'ping sweep '
+              '127.0.0.1,127.0.0.2 repetitions 1 timeout 1\'"',
+              shell='bash')
+    assert '2 targets at once' in ret
+    assert '2 targets, 2 reachable' in ret
@@ -62,6 +62,10 @@
 
 #include "udpfwd.h"
 #include "dhcpv6_relay.h"
+#include "relay_stats.h"
+#include "relay_netlink.h"
+#include "relay_snapshot.h"
+#include "relay_reactor.h"
 
 /*
  * Global variable declarations.
@@ -74,6 +78,21 @@ struct ovsdb_idl *idl;
 
 VLOG_DEFINE_THIS_MODULE(relay_main);
 
+/* Warm restart snapshot file, NULL if snapshots are disabled */
+static char *snapshot_path = NULL;
+
+/* The restored state still has to be checked against the configuration */
+static bool snapshot_reconcile_pending = false;
+
+/* Configuration changed since the last snapshot */
+static bool snapshot_dirty = false;
+
+/* Configuration generation saved in the last snapshot */
+static uint64_t snapshot_generation = 0;
+
+/* Earliest time of the next periodic snapshot */
+static long long int snapshot_next = 0;
+
 /*
  * Function      : usage
  * Responsiblity : Daemon usage help display
@@ -92,8 +111,14 @@ static void usage(void)
     vlog_usage();
     printf("\nOther options:\n"
             "  --unixctl=SOCKET        override default control socket name\n"
+            "  --stats-shm[=NAME]      export statistics in shared memory\n"
+            "                          (default NAME: %s)\n"
+            "  --no-snapshot           do not save or restore the warm\n"
+            "                          restart snapshot\n"
+            "  --rx-threads=N          receive threads (default: %d)\n"
             "  -h, --help              display this help message\n"
-            "  -V, --version           display version information\n");
+            "  -V, --version           display version information\n",
+            RELAY_STATS_SHM_DEFAULT_NAME, RELAY_REACTOR_DEFAULT_THREADS);
     exit(EXIT_SUCCESS);
 }
 
@@ -102,12 +127,21 @@ static void usage(void)
  * Responsiblity : Daemon options validator
  * Parameters    : argc, argv[] - Arguments
  *               : unixctl_pathp - unixctl path
+ *               : stats_shm_namep - statistics segment name, NULL if
+ *                                   export is disabled
+ *               : snapshotp - false if warm restart snapshots are disabled
+ *               : rx_threadsp - number of receive threads
  * Return        : char* - daemon launch command
  */
-static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
+static char *parse_options(int argc, char *argv[], char **unixctl_pathp,
+                           char **stats_shm_namep, bool *snapshotp,
+                           int *rx_threadsp)
 {
     enum {
         OPT_UNIXCTL = UCHAR_MAX + 1,
+        OPT_STATS_SHM,
+        OPT_NO_SNAPSHOT,
+        OPT_RX_THREADS,
         VLOG_OPTION_ENUMS,
         DAEMON_OPTION_ENUMS,
     };
@@ -116,6 +150,9 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
             {"help",        no_argument, NULL, 'h'},
             {"version",     no_argument, NULL, 'V'},
             {"unixctl",     required_argument, NULL, OPT_UNIXCTL},
+            {"stats-shm",   optional_argument, NULL, OPT_STATS_SHM},
+            {"no-snapshot", no_argument, NULL, OPT_NO_SNAPSHOT},
+            {"rx-threads",  required_argument, NULL, OPT_RX_THREADS},
             DAEMON_LONG_OPTIONS,
             VLOG_LONG_OPTIONS,
             {NULL, 0, NULL, 0},
@@ -144,6 +181,23 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
             *unixctl_pathp = optarg;
             break;
 
+        case OPT_STATS_SHM:
+            *stats_shm_namep = optarg ? optarg : RELAY_STATS_SHM_DEFAULT_NAME;
+            break;
+
+        case OPT_NO_SNAPSHOT:
+            *snapshotp = false;
+            break;
+
+        case OPT_RX_THREADS:
+            if (!str_to_int(optarg, 10, rx_threadsp)
+                || (*rx_threadsp < 1)
+                || (*rx_threadsp > RELAY_REACTOR_MAX_THREADS)) {
+                VLOG_FATAL("--rx-threads must be between 1 and %d",
+                           RELAY_REACTOR_MAX_THREADS);
+            }
+            break;
+
             VLOG_OPTION_HANDLERS
             DAEMON_OPTION_HANDLERS
 
@@ -172,9 +226,136 @@ static char *parse_options(int argc, char *argv[], char **unixctl_pathp)
     }
 }
 
+/*
+ * Function      : relay_snapshot_changed
+ * Responsiblity : Check whether the state changed since the last snapshot
+ * Parameters    : none
+ * Return        : true - if a new snapshot is needed
+ *                 false - otherwise
+ */
+static bool relay_snapshot_changed(void)
+{
+    uint64_t generation;
+
+    atomic_read(&udpfwd_ctrl_cb_p->config_generation, &generation);
+    return snapshot_dirty || (generation != snapshot_generation);
+}
+
+/*
+ * Function      : relay_snapshot_save
+ * Responsiblity : Write the state of all relay modules to the snapshot
+ *                 file.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_snapshot_save(void)
+{
+    struct relay_snapshot snap;
+
+    if (NULL == snapshot_path)
+        return;
+
+    /* Taken first, changes made while saving go in the next snapshot */
+    atomic_read(&udpfwd_ctrl_cb_p->config_generation, &snapshot_generation);
+    snapshot_dirty = false;
+    snapshot_next = time_msec() + RELAY_SNAPSHOT_INTERVAL;
+
+    relay_snapshot_init(&snap);
+    udpfwd_snapshot_save(&snap);
+#ifdef FTR_DHCPV6_RELAY
+    dhcpv6r_snapshot_save(&snap);
+#endif /* FTR_DHCPV6_RELAY */
+    relay_snapshot_write(&snap, snapshot_path);
+    relay_snapshot_destroy(&snap);
+}
+
+/*
+ * Function      : relay_snapshot_restore
+ * Responsiblity : Reload the state saved by a previous instance, so that
+ *                 forwarding resumes before the configuration is read.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_snapshot_restore(void)
+{
+    struct relay_snapshot_reader reader;
+    const void *payload;
+    uint32_t length;
+    uint16_t type;
+
+    if ((NULL == snapshot_path)
+        || !relay_snapshot_open(&reader, snapshot_path))
+        return;
+
+    while (relay_snapshot_next(&reader, &type, &payload, &length)) {
+        switch (type) {
+        case RELAY_SNAPSHOT_UDPFWD_GLOBAL:
+        case RELAY_SNAPSHOT_UDPFWD_INTF:
+            udpfwd_snapshot_restore(type, payload, length);
+            break;
+
+#ifdef FTR_DHCPV6_RELAY
+        case RELAY_SNAPSHOT_DHCPV6R_INTF:
+            dhcpv6r_snapshot_restore(type, payload, length);
+            break;
+#endif /* FTR_DHCPV6_RELAY */
+
+        default:
+            VLOG_DBG("Skipping snapshot section of type %u", type);
+            break;
+        }
+    }
+    relay_snapshot_close(&reader);
+
+    snapshot_reconcile_pending = true;
+    atomic_read(&udpfwd_ctrl_cb_p->config_generation, &snapshot_generation);
+}
+
+/*
+ * Function      : relay_snapshot_run
+ * Responsiblity : Write a periodic snapshot when the state changed and
+ *                 the snapshot interval expired.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_snapshot_run(void)
+{
+    if ((NULL != snapshot_path) && (time_msec() >= snapshot_next)
+        && relay_snapshot_changed()) {
+        relay_snapshot_save();
+    }
+}
+
+/*
+ * Function      : relay_snapshot_wait
+ * Responsiblity : Wake up for the next periodic snapshot, if the state
+ *                 changed since the last one.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_snapshot_wait(void)
+{
+    if ((NULL != snapshot_path) && relay_snapshot_changed()) {
+        poll_timer_wait_until(snapshot_next);
+    }
+}
+
+/*
+ * Function      : relay_snapshot_signal_hook
+ * Responsiblity : Save a snapshot before exiting on a fatal signal.
+ * Parameters    : aux - unused
+ * Return        : none
+ */
+static void relay_snapshot_signal_hook(void *aux OVS_UNUSED)
+{
+    relay_snapshot_save();
+}
+
 /*
  * Function      : relay_unixctl_run_and_wait
- * Responsiblity : run unixctl and wait for next idl run
+ * Responsiblity : run unixctl and block until there is work to do: an idl
+ *                 change, a unixctl request, a kernel interface event, a
+ *                 statistics refresh or a packet thread notification.
  * Parameters    : none
  * Return        : none
  */
@@ -184,7 +365,9 @@ static void relay_unixctl_run_and_wait(struct unixctl_server *unixctl,
     unixctl_server_run(unixctl);
 
     ovsdb_idl_wait(idl);
-    poll_timer_wait(IDL_POLL_INTERVAL * 1000);
+    relay_netlink_wait();
+    udpfwd_wait();
+    relay_snapshot_wait();
 
     unixctl_server_wait(unixctl);
     if (exiting) {
@@ -215,12 +398,21 @@ static void relay_exit_cb(struct unixctl_conn *conn, int argc OVS_UNUSED,
  */
 static void relay_exit(void)
 {
+    relay_snapshot_save();
+    free(snapshot_path);
+    snapshot_path = NULL;
+
+    /* No packet is handled past this point */
+    relay_reactor_exit();
+
     udpfwd_exit();
 #ifdef FTR_DHCPV6_RELAY
     dhcpv6r_exit();
 #endif /* FTR_DHCPV6_RELAY */
 
+    relay_netlink_exit();
     ovsdb_idl_destroy(idl);
+    relay_stats_exit();
 }
 
 /*
@@ -302,6 +494,12 @@ void relay_run(void)
     if (!relay_idl_run_and_lockcheck())
         return;
 
+    /* Kernel interface events and statistics do not depend on the
+     * configuration having changed */
+    relay_netlink_run();
+    udpfwd_run();
+    relay_snapshot_run();
+
     new_idl_seqno = ovsdb_idl_get_seqno(idl);
 
     /* Do NOOP if there is not change in idl sequence number */
@@ -316,6 +514,20 @@ void relay_run(void)
     dhcpv6r_reconfigure();
 #endif /* FTR_DHCPV6_RELAY */
 
+    /* The first full walk after a restore brought the restored entries
+     * in line with the configured records, drop what none of them own */
+    if (snapshot_reconcile_pending) {
+        udpfwd_reconcile_interfaces();
+#ifdef FTR_DHCPV6_RELAY
+        dhcpv6r_reconcile_interfaces();
+#endif /* FTR_DHCPV6_RELAY */
+        snapshot_reconcile_pending = false;
+    }
+    snapshot_dirty = true;
+
+    /* All modules have seen the tracked changes of this run */
+    ovsdb_idl_track_clear(idl);
+
     /* Cache the lated idl sequence number */
     idl_seqno = new_idl_seqno;
 
@@ -330,14 +542,18 @@ void relay_run(void)
 int main(int argc, char *argv[])
 {
     char *unixctl_path = NULL;
+    char *stats_shm_name = NULL;
     struct unixctl_server *unixctl;
     char *remote;
     bool exiting = false;
+    bool snapshot = true;
+    int rx_threads = RELAY_REACTOR_DEFAULT_THREADS;
     int32_t retVal = 0;
 
     set_program_name(argv[0]);
     proctitle_init(argc, argv);
-    remote = parse_options(argc, argv, &unixctl_path);
+    remote = parse_options(argc, argv, &unixctl_path, &stats_shm_name,
+                           &snapshot, &rx_threads);
 
     ovsrec_init();
     daemonize_start();
@@ -350,6 +566,26 @@ int main(int argc, char *argv[])
 
     idl_init(remote);
 
+    /* Statistics export is optional, the daemon runs without it */
+    if (stats_shm_name) {
+        relay_stats_init(stats_shm_name);
+    }
+
+    /* Without interface notifications, kernel interfaces are only looked
+     * up again on configuration changes */
+    if (false == relay_netlink_init())
+    {
+        VLOG_WARN("Kernel interface notifications are not available");
+    }
+
+    /* Receive threads shared by all relay sockets */
+    if (false == relay_reactor_init(rx_threads))
+    {
+        free(remote);
+        VLOG_ERR("Failed to start the receive reactor");
+        return -1;
+    }
+
     if (false == udpfwd_init())
     {
         free(remote);
@@ -367,6 +603,15 @@ int main(int argc, char *argv[])
 #endif /* FTR_DHCPV6_RELAY */
 
     free(remote);
+
+    /* Resume forwarding with the state of the previous instance; it is
+     * checked against OVSDB once the configuration is read */
+    if (snapshot) {
+        snapshot_path = xasprintf("%s/%s", ovs_rundir(), RELAY_SNAPSHOT_FILE);
+        relay_snapshot_restore();
+        fatal_signal_add_hook(relay_snapshot_signal_hook, NULL, NULL, false);
+    }
+
     daemonize_complete();
     vlog_enable_async();
 
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_netlink.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Subscribe to kernel link and address notifications.
+ * - Deliver the notifications to the relay modules from the main loop.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "poll-loop.h"
+#include "openvswitch/vlog.h"
+#include "util.h"
+#include "relay_netlink.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_netlink);
+
+/* Size of the buffer a batch of notifications is read into */
+#define RELAY_NETLINK_BUFFER_SIZE 16384
+
+struct relay_netlink_callback {
+    relay_netlink_cb *cb;
+    void *aux;
+};
+
+static int nl_sock = -1;
+static struct relay_netlink_callback callbacks[RELAY_NETLINK_MAX_CALLBACKS];
+static size_t n_callbacks = 0;
+
+/*
+ * Function      : relay_netlink_notify
+ * Responsiblity : Hand an event to all registered callbacks.
+ * Parameters    : event - kernel interface event
+ * Return        : none
+ */
+static void relay_netlink_notify(const struct relay_netlink_event *event)
+{
+    size_t iter;
+
+    for (iter = 0; iter < n_callbacks; iter++) {
+        callbacks[iter].cb(event, callbacks[iter].aux);
+    }
+}
+
+/*
+ * Function      : relay_netlink_parse_link
+ * Responsiblity : Build an event from a link notification.
+ * Parameters    : nlh - netlink message
+ *                 event - event to fill in
+ * Return        : true - if the message is valid
+ *                 false - otherwise
+ */
+static bool relay_netlink_parse_link(const struct nlmsghdr *nlh,
+                                     struct relay_netlink_event *event)
+{
+    const struct ifinfomsg *ifi;
+    const struct rtattr *rta;
+    int len;
+
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof *ifi))
+        return false;
+
+    ifi = NLMSG_DATA(nlh);
+    event->type = (RTM_NEWLINK == nlh->nlmsg_type) ? RELAY_NETLINK_LINK_NEW
+                                                   : RELAY_NETLINK_LINK_DEL;
+    event->ifIndex = ifi->ifi_index;
+    event->ifName = NULL;
+
+    len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof *ifi);
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if ((IFLA_IFNAME == rta->rta_type)
+            && memchr(RTA_DATA(rta), '\0', RTA_PAYLOAD(rta))) {
+            event->ifName = RTA_DATA(rta);
+            break;
+        }
+    }
+
+    return NULL != event->ifName;
+}
+
+/*
+ * Function      : relay_netlink_parse_addr
+ * Responsiblity : Build an event from an address notification.
+ * Parameters    : nlh - netlink message
+ *                 event - event to fill in
+ * Return        : true - if the message is valid
+ *                 false - otherwise
+ */
+static bool relay_netlink_parse_addr(const struct nlmsghdr *nlh,
+                                     struct relay_netlink_event *event)
+{
+    const struct ifaddrmsg *ifa;
+
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof *ifa))
+        return false;
+
+    ifa = NLMSG_DATA(nlh);
+    event->type = (RTM_NEWADDR == nlh->nlmsg_type) ? RELAY_NETLINK_ADDR_NEW
+                                                   : RELAY_NETLINK_ADDR_DEL;
+    event->ifIndex = ifa->ifa_index;
+    event->ifName = NULL;
+    return true;
+}
+
+/*
+ * Function      : relay_netlink_init
+ * Responsiblity : Open the notification socket. Without it the modules
+ *                 only learn about kernel interfaces on configuration
+ *                 changes.
+ * Parameters    : none
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_netlink_init(void)
+{
+    struct sockaddr_nl addr;
+
+    nl_sock = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     NETLINK_ROUTE);
+    if (nl_sock < 0) {
+        VLOG_ERR("Failed to create netlink socket, errno : %d", errno);
+        return false;
+    }
+
+    memset(&addr, 0, sizeof addr);
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(nl_sock, (struct sockaddr *)&addr, sizeof addr) < 0) {
+        VLOG_ERR("Failed to bind netlink socket, errno : %d", errno);
+        close(nl_sock);
+        nl_sock = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Function      : relay_netlink_exit
+ * Responsiblity : Close the notification socket.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_netlink_exit(void)
+{
+    if (0 <= nl_sock) {
+        close(nl_sock);
+        nl_sock = -1;
+    }
+    n_callbacks = 0;
+}
+
+/*
+ * Function      : relay_netlink_register
+ * Responsiblity : Register a callback for kernel interface events.
+ * Parameters    : cb - callback
+ *                 aux - argument passed to the callback
+ * Return        : none
+ */
+void relay_netlink_register(relay_netlink_cb *cb, void *aux)
+{
+    ovs_assert(n_callbacks < RELAY_NETLINK_MAX_CALLBACKS);
+
+    callbacks[n_callbacks].cb = cb;
+    callbacks[n_callbacks].aux = aux;
+    n_callbacks++;
+}
+
+/*
+ * Function      : relay_netlink_run
+ * Responsiblity : Read all pending notifications and deliver them.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_netlink_run(void)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    static struct relay_netlink_event resync = { RELAY_NETLINK_RESYNC, 0,
+                                                 NULL };
+    static uint32_t buf[RELAY_NETLINK_BUFFER_SIZE / sizeof(uint32_t)];
+    struct relay_netlink_event event;
+    struct nlmsghdr *nlh;
+    ssize_t len;
+    bool valid;
+
+    if (nl_sock < 0)
+        return;
+
+    while (true) {
+        len = recv(nl_sock, buf, sizeof buf, 0);
+        if (len < 0) {
+            if (EINTR == errno)
+                continue;
+            if (ENOBUFS == errno) {
+                /* The socket overflowed, state has to be read again */
+                VLOG_WARN_RL(&rl, "Netlink notifications lost, resyncing");
+                relay_netlink_notify(&resync);
+                continue;
+            }
+            if (EAGAIN != errno) {
+                VLOG_ERR_RL(&rl, "Failed to read netlink socket, errno : %d",
+                            errno);
+            }
+            return;
+        }
+
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+             nlh = NLMSG_NEXT(nlh, len)) {
+            switch (nlh->nlmsg_type) {
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                valid = relay_netlink_parse_link(nlh, &event);
+                break;
+
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                valid = relay_netlink_parse_addr(nlh, &event);
+                break;
+
+            default:
+                valid = false;
+                break;
+            }
+
+            if (valid) {
+                relay_netlink_notify(&event);
+            }
+        }
+    }
+}
+
+/*
+ * Function      : relay_netlink_wait
+ * Responsiblity : Arrange for the main loop to wake up on a notification.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_netlink_wait(void)
+{
+    if (0 <= nl_sock)
+        poll_fd_wait(nl_sock, POLLIN);
+}
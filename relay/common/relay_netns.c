@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_netns.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Open VRF network namespaces.
+ * - Move threads between namespaces and create sockets in them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "openvswitch/vlog.h"
+#include "relay_netns.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_netns);
+
+/* Namespace the daemon was started in */
+static int daemon_ns = -1;
+
+/*
+ * Function      : relay_netns_init
+ * Responsiblity : Remember the namespace of the daemon, so that threads
+ *                 can return to it. Called from the main thread before
+ *                 any thread changes namespace.
+ * Parameters    : none
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_netns_init(void)
+{
+    if (0 <= daemon_ns)
+        return true;
+
+    daemon_ns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (daemon_ns < 0) {
+        VLOG_ERR("Failed to open the daemon namespace, errno : %d", errno);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function      : relay_netns_open
+ * Responsiblity : Open the namespace of a VRF
+ * Parameters    : name - namespace name of the VRF
+ * Return        : namespace descriptor, -1 on failure
+ */
+int relay_netns_open(const char *name)
+{
+    char path[PATH_MAX];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", RELAY_NETNS_DIR, name);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        VLOG_WARN("Failed to open namespace %s, errno : %d", path, errno);
+    }
+    return fd;
+}
+
+/*
+ * Function      : relay_netns_enter
+ * Responsiblity : Move the calling thread to a namespace. Only the calling
+ *                 thread changes namespace.
+ * Parameters    : nsFd - namespace descriptor, -1 for the daemon namespace
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_netns_enter(int nsFd)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+
+    if (0 != setns(nsFd < 0 ? daemon_ns : nsFd, CLONE_NEWNET)) {
+        VLOG_ERR_RL(&rl, "Failed to change namespace, errno : %d", errno);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function      : relay_netns_socket
+ * Responsiblity : Create a socket in a namespace. The calling thread is
+ *                 back in the daemon namespace on return.
+ * Parameters    : nsFd - namespace descriptor, -1 for the daemon namespace
+ *                 domain, type, protocol - as for socket()
+ * Return        : socket descriptor, -1 on failure
+ */
+int relay_netns_socket(int nsFd, int domain, int type, int protocol)
+{
+    int sock, err;
+
+    if (nsFd < 0)
+        return socket(domain, type, protocol);
+
+    if (!relay_netns_enter(nsFd))
+        return -1;
+
+    sock = socket(domain, type, protocol);
+    err = errno;
+
+    if (!relay_netns_enter(-1)) {
+        /* The thread cannot be left in the wrong namespace */
+        VLOG_FATAL("Failed to return to the daemon namespace");
+    }
+
+    errno = err;
+    return sock;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_pool.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Fixed size object arena used for the relay server stores.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util.h"
+#include "relay_pool.h"
+
+/* Chunk header, followed by the objects */
+struct relay_pool_chunk {
+    struct relay_pool_chunk *next;
+    size_t n_used;           /* objects carved from this chunk so far */
+    uint64_t objs[];         /* aligned start of the objects */
+};
+
+/*
+ * Function      : relay_pool_init
+ * Responsiblity : Initialize an empty pool. No memory is allocated until
+ *                 the first object is requested.
+ * Parameters    : pool - pool to initialize
+ *                 obj_size - size of an object
+ *                 objs_per_chunk - objects allocated at once
+ * Return        : none
+ */
+void relay_pool_init(struct relay_pool *pool, size_t obj_size,
+                     size_t objs_per_chunk)
+{
+    /* Free objects hold the free list link */
+    pool->obj_size = ROUND_UP(MAX(obj_size, sizeof(void *)),
+                              sizeof(uint64_t));
+    pool->objs_per_chunk = objs_per_chunk ? objs_per_chunk : 1;
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->n_free = 0;
+    pool->n_in_use = 0;
+}
+
+/*
+ * Function      : relay_pool_destroy
+ * Responsiblity : Release all chunks of a pool. Objects still in use
+ *                 become invalid.
+ * Parameters    : pool - pool to destroy
+ * Return        : none
+ */
+void relay_pool_destroy(struct relay_pool *pool)
+{
+    struct relay_pool_chunk *chunk, *next;
+
+    for (chunk = pool->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->n_free = 0;
+    pool->n_in_use = 0;
+}
+
+/*
+ * Function      : relay_pool_alloc
+ * Responsiblity : Get an object from the pool. The object is not zeroed.
+ * Parameters    : pool - pool to allocate from
+ * Return        : object
+ */
+void *relay_pool_alloc(struct relay_pool *pool)
+{
+    struct relay_pool_chunk *chunk = pool->chunks;
+    void *obj;
+
+    if (pool->free_list) {
+        obj = pool->free_list;
+        pool->free_list = *(void **)obj;
+        pool->n_free--;
+    } else {
+        if (!chunk || chunk->n_used == pool->objs_per_chunk) {
+            chunk = xmalloc(sizeof *chunk
+                            + pool->obj_size * pool->objs_per_chunk);
+            chunk->n_used = 0;
+            chunk->next = pool->chunks;
+            pool->chunks = chunk;
+        }
+        obj = (char *)chunk->objs + pool->obj_size * chunk->n_used++;
+    }
+
+    pool->n_in_use++;
+    return obj;
+}
+
+/*
+ * Function      : relay_pool_free
+ * Responsiblity : Return an object to the pool for reuse
+ * Parameters    : pool - pool the object was allocated from
+ *                 obj - object, may be NULL
+ * Return        : none
+ */
+void relay_pool_free(struct relay_pool *pool, void *obj)
+{
+    if (NULL == obj)
+        return;
+
+    *(void **)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->n_free++;
+    pool->n_in_use--;
+}
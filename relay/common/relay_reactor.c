@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_reactor.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Epoll based receive thread pool shared by the relay sockets.
+ * - Quiescence of the pool for source removal and configuration swaps.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include "coverage.h"
+#include "ovs-atomic.h"
+#include "openvswitch/vlog.h"
+#include "timeval.h"
+#include "util.h"
+#include "relay_netns.h"
+#include "relay_reactor.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_reactor);
+
+COVERAGE_DEFINE(relay_reactor_wakeup);
+COVERAGE_DEFINE(relay_reactor_rearm);
+COVERAGE_DEFINE(relay_reactor_netns_error);
+
+struct relay_reactor_thread {
+    pthread_t thread;
+    atomic_uint64_t seen_epoch;  /* last epoch this thread acknowledged */
+    struct relay_reactor_source **deferred; /* disarmed sources whose
+                                               namespace could not be
+                                               entered */
+    size_t n_deferred;
+    size_t allocated_deferred;
+    long long int retry_time;    /* when the deferred sources are re-armed */
+};
+
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static ino_t daemon_ns_id;
+
+static struct relay_reactor_thread *threads = NULL;
+static int n_threads = 0;
+
+/* Synchronization with the pool */
+static pthread_mutex_t reactor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reactor_cond = PTHREAD_COND_INITIALIZER;
+static atomic_uint64_t epoch;
+static atomic_bool stopping;
+
+/*
+ * Function      : relay_reactor_ns_id
+ * Responsiblity : Get the identity of a namespace
+ * Parameters    : nsFd - namespace descriptor, -1 for the daemon namespace
+ * Return        : namespace inode, 0 on failure
+ */
+static ino_t relay_reactor_ns_id(int nsFd)
+{
+    struct stat st;
+
+    if (nsFd < 0)
+        return daemon_ns_id;
+
+    if (0 != fstat(nsFd, &st)) {
+        VLOG_ERR("Failed to identify namespace, errno : %d", errno);
+        return 0;
+    }
+    return st.st_ino;
+}
+
+/*
+ * Function      : relay_reactor_arm
+ * Responsiblity : Arm a source for its next readiness event. Re-arming a
+ *                 socket with packets still queued reports it again.
+ * Parameters    : source - registered source
+ *                 op - EPOLL_CTL_ADD or EPOLL_CTL_MOD
+ * Return        : 0 on success, errno otherwise
+ */
+static int relay_reactor_arm(struct relay_reactor_source *source, int op)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
+    ev.data.ptr = source;
+    return epoll_ctl(epoll_fd, op, source->fd, &ev) ? errno : 0;
+}
+
+/*
+ * Function      : relay_reactor_defer
+ * Responsiblity : Keep a source whose namespace could not be entered
+ *                 disarmed until the retry time of the thread.
+ * Parameters    : self - calling thread
+ *                 source - source, disarmed
+ * Return        : none
+ */
+static void relay_reactor_defer(struct relay_reactor_thread *self,
+                                struct relay_reactor_source *source)
+{
+    if (0 == self->n_deferred) {
+        self->retry_time = time_msec() + RELAY_REACTOR_RETRY_MSEC;
+    }
+    if (self->n_deferred >= self->allocated_deferred) {
+        self->deferred = x2nrealloc(self->deferred, &self->allocated_deferred,
+                                    sizeof *self->deferred);
+    }
+    self->deferred[self->n_deferred++] = source;
+}
+
+/*
+ * Function      : relay_reactor_rearm_deferred
+ * Responsiblity : Re-arm the sources deferred by the calling thread. A
+ *                 source whose namespace still cannot be entered is
+ *                 deferred again when it is next reported.
+ * Parameters    : self - calling thread
+ * Return        : none
+ */
+static void relay_reactor_rearm_deferred(struct relay_reactor_thread *self)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    struct relay_reactor_source *source;
+    size_t iter;
+    int err;
+
+    for (iter = 0; iter < self->n_deferred; iter++) {
+        source = self->deferred[iter];
+
+        /* A source removed meanwhile is no longer in the set */
+        err = relay_reactor_arm(source, EPOLL_CTL_MOD);
+        if (err && (ENOENT != err)) {
+            VLOG_ERR_RL(&rl, "Failed to re-arm socket %d, errno : %d",
+                        source->fd, err);
+        }
+    }
+    self->n_deferred = 0;
+}
+
+/*
+ * Function      : relay_reactor_timeout
+ * Responsiblity : Get the epoll_wait timeout of a thread, until the
+ *                 retry time of its deferred sources.
+ * Parameters    : self - calling thread
+ * Return        : timeout in ms, -1 for none
+ */
+static int relay_reactor_timeout(const struct relay_reactor_thread *self)
+{
+    long long int now;
+
+    if (0 == self->n_deferred)
+        return -1;
+
+    now = time_msec();
+    return now >= self->retry_time ? 0 : self->retry_time - now;
+}
+
+/*
+ * Function      : relay_reactor_ack
+ * Responsiblity : Acknowledge the current epoch once the thread holds no
+ *                 reference to any source. Deferred sources are re-armed
+ *                 first, as a deferred source may be being removed.
+ * Parameters    : self - calling thread
+ * Return        : none
+ */
+static void relay_reactor_ack(struct relay_reactor_thread *self)
+{
+    uint64_t current, seen;
+
+    atomic_read(&epoch, &current);
+    atomic_read_relaxed(&self->seen_epoch, &seen);
+    if (seen == current)
+        return;
+
+    relay_reactor_rearm_deferred(self);
+
+    pthread_mutex_lock(&reactor_mutex);
+    atomic_store(&self->seen_epoch, current);
+    pthread_cond_broadcast(&reactor_cond);
+    pthread_mutex_unlock(&reactor_mutex);
+}
+
+/*
+ * Function      : relay_reactor_main
+ * Responsiblity : Pool thread. Handles ready sources until the reactor
+ *                 stops.
+ * Parameters    : arg - struct relay_reactor_thread of this thread
+ * Return        : none
+ */
+static void *relay_reactor_main(void *arg)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    struct relay_reactor_thread *self = arg;
+    struct epoll_event events[RELAY_REACTOR_MAX_EVENTS];
+    struct relay_reactor_source *source;
+    ino_t ns_id = daemon_ns_id;
+    bool stop;
+    int n, iter, err;
+
+    while (true) {
+        n = epoll_wait(epoll_fd, events, RELAY_REACTOR_MAX_EVENTS,
+                       relay_reactor_timeout(self));
+        if (n < 0) {
+            if (EINTR != errno) {
+                VLOG_ERR_RL(&rl, "epoll_wait failed, errno : %d", errno);
+            }
+            n = 0;
+        }
+
+        for (iter = 0; iter < n; iter++) {
+            source = events[iter].data.ptr;
+            if (NULL == source) {
+                /* wake_fd, handled below */
+                COVERAGE_INC(relay_reactor_wakeup);
+                continue;
+            }
+
+            if (source->nsId != ns_id) {
+                if (!relay_netns_enter(source->nsFd)) {
+                    /* Handling it here would use the wrong namespace */
+                    VLOG_WARN_RL(&rl, "Failed to enter the namespace of "
+                                 "socket %d, retrying in %d ms", source->fd,
+                                 RELAY_REACTOR_RETRY_MSEC);
+                    COVERAGE_INC(relay_reactor_netns_error);
+                    relay_reactor_defer(self, source);
+                    continue;
+                }
+                ns_id = source->nsId;
+            }
+
+            if (!source->cb(source->aux, RELAY_REACTOR_BUDGET)) {
+                /* Left disarmed for its owner to replace */
+                continue;
+            }
+
+            /* A source removed meanwhile is no longer in the set */
+            err = relay_reactor_arm(source, EPOLL_CTL_MOD);
+            if (err && (ENOENT != err)) {
+                VLOG_ERR_RL(&rl, "Failed to re-arm socket %d, errno : %d",
+                            source->fd, err);
+            }
+            COVERAGE_INC(relay_reactor_rearm);
+        }
+
+        if (relay_reactor_timeout(self) == 0) {
+            relay_reactor_rearm_deferred(self);
+        }
+
+        atomic_read(&stopping, &stop);
+        if (stop)
+            break;
+
+        relay_reactor_ack(self);
+    }
+    return NULL;
+}
+
+/*
+ * Function      : relay_reactor_init
+ * Responsiblity : Create the epoll set and start the thread pool.
+ * Parameters    : n - number of pool threads
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_reactor_init(int n)
+{
+    struct epoll_event ev;
+    struct stat st;
+    int iter, retVal;
+
+    /* Threads start in the daemon namespace */
+    if (!relay_netns_init() || (0 != stat("/proc/self/ns/net", &st))) {
+        VLOG_ERR("Failed to identify the daemon namespace");
+        return false;
+    }
+    daemon_ns_id = st.st_ino;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((epoll_fd < 0) || (wake_fd < 0)) {
+        VLOG_ERR("Failed to create the reactor, errno : %d", errno);
+        goto error;
+    }
+
+    /* Level triggered, so that one write wakes every thread */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev)) {
+        VLOG_ERR("Failed to register the reactor wakeup, errno : %d", errno);
+        goto error;
+    }
+
+    atomic_init(&epoch, 0);
+    atomic_init(&stopping, false);
+
+    n = MAX(1, MIN(n, RELAY_REACTOR_MAX_THREADS));
+    threads = xcalloc(n, sizeof *threads);
+    for (iter = 0; iter < n; iter++) {
+        atomic_init(&threads[iter].seen_epoch, 0);
+        retVal = pthread_create(&threads[iter].thread, NULL,
+                                relay_reactor_main, &threads[iter]);
+        if (0 != retVal) {
+            VLOG_ERR("Failed to create reactor thread : %d", retVal);
+            break;
+        }
+        n_threads++;
+    }
+
+    if (0 == n_threads) {
+        goto error;
+    }
+
+    VLOG_INFO("Receive reactor started with %d threads", n_threads);
+    return true;
+
+error:
+    free(threads);
+    threads = NULL;
+    if (0 <= epoll_fd)
+        close(epoll_fd);
+    if (0 <= wake_fd)
+        close(wake_fd);
+    epoll_fd = wake_fd = -1;
+    return false;
+}
+
+/*
+ * Function      : relay_reactor_exit
+ * Responsiblity : Stop and join the thread pool. Sources still registered
+ *                 are left to their owners.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_reactor_exit(void)
+{
+    uint64_t value = 1;
+    int iter;
+
+    if (epoll_fd < 0)
+        return;
+
+    atomic_store(&stopping, true);
+    if (write(wake_fd, &value, sizeof(value)) < 0) {
+        VLOG_ERR("Failed to wake the reactor, errno : %d", errno);
+    }
+
+    for (iter = 0; iter < n_threads; iter++) {
+        pthread_join(threads[iter].thread, NULL);
+        free(threads[iter].deferred);
+    }
+    free(threads);
+    threads = NULL;
+    n_threads = 0;
+
+    close(epoll_fd);
+    close(wake_fd);
+    epoll_fd = wake_fd = -1;
+}
+
+/*
+ * Function      : relay_reactor_add
+ * Responsiblity : Start waiting on a source. The source must stay valid
+ *                 until relay_reactor_remove() returns.
+ * Parameters    : source - source to register
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_reactor_add(struct relay_reactor_source *source)
+{
+    int err;
+
+    if (epoll_fd < 0)
+        return false;
+
+    source->nsId = relay_reactor_ns_id(source->nsFd);
+    err = relay_reactor_arm(source, EPOLL_CTL_ADD);
+    if (err) {
+        VLOG_ERR("Failed to register socket %d, errno : %d",
+                 source->fd, err);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function      : relay_reactor_remove
+ * Responsiblity : Stop waiting on a source. On return no thread uses the
+ *                 source, so it can be freed and its socket closed.
+ * Parameters    : source - registered source
+ * Return        : none
+ */
+void relay_reactor_remove(struct relay_reactor_source *source)
+{
+    if (epoll_fd < 0)
+        return;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, NULL)) {
+        VLOG_ERR("Failed to unregister socket %d, errno : %d",
+                 source->fd, errno);
+    }
+    relay_reactor_synchronize();
+}
+
+/*
+ * Function      : relay_reactor_synchronize
+ * Responsiblity : Wait until every pool thread finished the batch it was
+ *                 handling. Must not be called with a lock the handlers
+ *                 take, such as waitSem.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_reactor_synchronize(void)
+{
+    uint64_t value = 1, target, seen;
+    int iter;
+
+    if (epoll_fd < 0)
+        return;
+
+    pthread_mutex_lock(&reactor_mutex);
+    atomic_add(&epoch, 1, &target);
+    target++;
+
+    if (write(wake_fd, &value, sizeof(value)) < 0) {
+        VLOG_ERR("Failed to wake the reactor, errno : %d", errno);
+    }
+
+    for (iter = 0; iter < n_threads; iter++) {
+        atomic_read(&threads[iter].seen_epoch, &seen);
+        while (seen < target) {
+            pthread_cond_wait(&reactor_cond, &reactor_mutex);
+            atomic_read(&threads[iter].seen_epoch, &seen);
+        }
+    }
+
+    /* Every thread is past the wakeup, stop waking them */
+    if (read(wake_fd, &value, sizeof(value)) < 0 && EAGAIN != errno) {
+        VLOG_ERR("Failed to reset the reactor wakeup, errno : %d", errno);
+    }
+    pthread_mutex_unlock(&reactor_mutex);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_rowmap.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Remember the interface each applied configuration row refers to, so
+ *   that deleted rows can be undone without rescanning the tables.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "relay_rowmap.h"
+
+/*
+ * Function      : relay_row_map_init
+ * Responsiblity : Initialize an empty row map.
+ * Parameters    : map - row map
+ * Return        : none
+ */
+void relay_row_map_init(struct relay_row_map *map)
+{
+    hmap_init(&map->rows);
+}
+
+/*
+ * Function      : relay_row_map_destroy
+ * Responsiblity : Free all entries of a row map.
+ * Parameters    : map - row map
+ * Return        : none
+ */
+void relay_row_map_destroy(struct relay_row_map *map)
+{
+    struct relay_row_ref *ref;
+
+    HMAP_FOR_EACH_POP (ref, node, &map->rows) {
+        free(ref->portName);
+        free(ref);
+    }
+    hmap_destroy(&map->rows);
+}
+
+/*
+ * Function      : relay_row_map_find
+ * Responsiblity : Look up the entry of a row.
+ * Parameters    : map - row map
+ *                 uuid - row uuid
+ * Return        : entry, NULL if the row was never applied
+ */
+struct relay_row_ref *relay_row_map_find(const struct relay_row_map *map,
+                                         const struct uuid *uuid)
+{
+    struct relay_row_ref *ref;
+
+    HMAP_FOR_EACH_WITH_HASH (ref, node, uuid_hash(uuid), &map->rows) {
+        if (uuid_equals(&ref->uuid, uuid)) {
+            return ref;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function      : relay_row_map_set
+ * Responsiblity : Record the interface and UDP port a row configures,
+ *                 adding the row if needed.
+ * Parameters    : map - row map
+ *                 uuid - row uuid
+ *                 portName - interface name
+ *                 udp_dport - UDP port, 0 if not applicable
+ * Return        : none
+ */
+void relay_row_map_set(struct relay_row_map *map, const struct uuid *uuid,
+                       const char *portName, int64_t udp_dport)
+{
+    struct relay_row_ref *ref;
+
+    ref = relay_row_map_find(map, uuid);
+    if (NULL == ref) {
+        ref = xmalloc(sizeof *ref);
+        ref->uuid = *uuid;
+        ref->portName = NULL;
+        hmap_insert(&map->rows, &ref->node, uuid_hash(uuid));
+    }
+
+    if ((NULL == ref->portName) || strcmp(ref->portName, portName)) {
+        free(ref->portName);
+        ref->portName = xstrdup(portName);
+    }
+    ref->udp_dport = udp_dport;
+}
+
+/*
+ * Function      : relay_row_map_remove
+ * Responsiblity : Remove and free the entry of a row.
+ * Parameters    : map - row map
+ *                 ref - entry to remove
+ * Return        : none
+ */
+void relay_row_map_remove(struct relay_row_map *map,
+                          struct relay_row_ref *ref)
+{
+    hmap_remove(&map->rows, &ref->node);
+    free(ref->portName);
+    free(ref);
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_snapshot.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Build and atomically write the runtime state snapshot.
+ * - Map a snapshot back in and walk its sections.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hash.h"
+#include "openvswitch/vlog.h"
+#include "util.h"
+#include "relay_snapshot.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_snapshot);
+
+/* Sections start on this boundary */
+#define RELAY_SNAPSHOT_ALIGN 8
+
+/*
+ * Function      : relay_snapshot_reserve
+ * Responsiblity : Make room at the end of a snapshot being built.
+ * Parameters    : snap - snapshot
+ *                 length - bytes needed
+ * Return        : start of the reserved bytes
+ */
+static char *relay_snapshot_reserve(struct relay_snapshot *snap,
+                                    size_t length)
+{
+    char *start;
+
+    while (snap->size + length > snap->allocated) {
+        snap->data = x2nrealloc(snap->data, &snap->allocated, 1);
+    }
+    start = snap->data + snap->size;
+    snap->size += length;
+    return start;
+}
+
+/*
+ * Function      : relay_snapshot_init
+ * Responsiblity : Start building a snapshot.
+ * Parameters    : snap - snapshot
+ * Return        : none
+ */
+void relay_snapshot_init(struct relay_snapshot *snap)
+{
+    snap->data = NULL;
+    snap->size = 0;
+    snap->allocated = 0;
+    snap->section = 0;
+
+    /* The header is filled in when the snapshot is written */
+    memset(relay_snapshot_reserve(snap, sizeof(struct relay_snapshot_header)),
+           0, sizeof(struct relay_snapshot_header));
+}
+
+/*
+ * Function      : relay_snapshot_destroy
+ * Responsiblity : Free a snapshot being built.
+ * Parameters    : snap - snapshot
+ * Return        : none
+ */
+void relay_snapshot_destroy(struct relay_snapshot *snap)
+{
+    free(snap->data);
+    snap->data = NULL;
+    snap->size = snap->allocated = 0;
+}
+
+/*
+ * Function      : relay_snapshot_section_start
+ * Responsiblity : Open a new section. Payload is added with
+ *                 relay_snapshot_put until relay_snapshot_section_end.
+ * Parameters    : snap - snapshot
+ *                 type - section type
+ * Return        : none
+ */
+void relay_snapshot_section_start(struct relay_snapshot *snap,
+                                  enum relay_snapshot_type type)
+{
+    struct relay_snapshot_section section;
+
+    ovs_assert(0 == snap->section);
+
+    memset(&section, 0, sizeof section);
+    section.type = type;
+    snap->section = snap->size;
+    relay_snapshot_put(snap, &section, sizeof section);
+}
+
+/*
+ * Function      : relay_snapshot_put
+ * Responsiblity : Append payload to the open section.
+ * Parameters    : snap - snapshot
+ *                 data - payload
+ *                 length - payload length
+ * Return        : none
+ */
+void relay_snapshot_put(struct relay_snapshot *snap, const void *data,
+                        size_t length)
+{
+    memcpy(relay_snapshot_reserve(snap, length), data, length);
+}
+
+/*
+ * Function      : relay_snapshot_section_end
+ * Responsiblity : Close the open section.
+ * Parameters    : snap - snapshot
+ * Return        : none
+ */
+void relay_snapshot_section_end(struct relay_snapshot *snap)
+{
+    struct relay_snapshot_section *section;
+    size_t pad;
+
+    ovs_assert(0 != snap->section);
+
+    section = (struct relay_snapshot_section *)(snap->data + snap->section);
+    section->length = snap->size - snap->section - sizeof *section;
+
+    pad = ROUND_UP(snap->size, RELAY_SNAPSHOT_ALIGN) - snap->size;
+    memset(relay_snapshot_reserve(snap, pad), 0, pad);
+    snap->section = 0;
+}
+
+/*
+ * Function      : relay_snapshot_write
+ * Responsiblity : Write a snapshot to a file. The file is replaced
+ *                 atomically, so a reader never sees a partial snapshot.
+ * Parameters    : snap - snapshot
+ *                 path - file name
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_snapshot_write(struct relay_snapshot *snap, const char *path)
+{
+    struct relay_snapshot_header *hdr;
+    const char *data;
+    size_t left;
+    ssize_t written;
+    char *tmp;
+    int fd;
+
+    hdr = (struct relay_snapshot_header *)snap->data;
+    hdr->magic = RELAY_SNAPSHOT_MAGIC;
+    hdr->version = RELAY_SNAPSHOT_VERSION;
+    hdr->header_size = sizeof *hdr;
+    hdr->size = snap->size;
+    hdr->checksum = hash_bytes(snap->data + sizeof *hdr,
+                               snap->size - sizeof *hdr, 0);
+    hdr->pid = getpid();
+    hdr->saved_at = time(NULL);
+
+    tmp = xasprintf("%s.tmp", path);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        VLOG_ERR("Failed to create snapshot %s, errno : %d", tmp, errno);
+        free(tmp);
+        return false;
+    }
+
+    for (data = snap->data, left = snap->size; left; ) {
+        written = write(fd, data, left);
+        if (written < 0) {
+            if (EINTR == errno)
+                continue;
+            VLOG_ERR("Failed to write snapshot %s, errno : %d", tmp, errno);
+            close(fd);
+            unlink(tmp);
+            free(tmp);
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+    close(fd);
+
+    if (rename(tmp, path) < 0) {
+        VLOG_ERR("Failed to rename snapshot %s, errno : %d", tmp, errno);
+        unlink(tmp);
+        free(tmp);
+        return false;
+    }
+
+    free(tmp);
+    VLOG_DBG("Saved %"PRIu64" byte snapshot to %s", hdr->size, path);
+    return true;
+}
+
+/*
+ * Function      : relay_snapshot_open
+ * Responsiblity : Map a snapshot file and validate its header and
+ *                 checksum.
+ * Parameters    : reader - reader to initialize
+ *                 path - file name
+ * Return        : true - if the snapshot can be used
+ *                 false - otherwise
+ */
+bool relay_snapshot_open(struct relay_snapshot_reader *reader,
+                         const char *path)
+{
+    const struct relay_snapshot_header *hdr;
+    struct stat st;
+    void *base;
+    int fd;
+
+    reader->base = NULL;
+    reader->size = 0;
+    reader->offset = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (ENOENT != errno) {
+            VLOG_WARN("Failed to open snapshot %s, errno : %d", path, errno);
+        }
+        return false;
+    }
+
+    if ((fstat(fd, &st) < 0)
+        || (st.st_size < (off_t)sizeof(struct relay_snapshot_header))) {
+        VLOG_WARN("Ignoring truncated snapshot %s", path);
+        close(fd);
+        return false;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        VLOG_WARN("Failed to map snapshot %s, errno : %d", path, errno);
+        return false;
+    }
+
+    reader->base = base;
+    reader->size = st.st_size;
+
+    hdr = base;
+    if ((RELAY_SNAPSHOT_MAGIC != hdr->magic)
+        || (RELAY_SNAPSHOT_VERSION != hdr->version)
+        || (sizeof *hdr != hdr->header_size)
+        || (reader->size != hdr->size)
+        || (hdr->checksum != hash_bytes(reader->base + sizeof *hdr,
+                                        reader->size - sizeof *hdr, 0))) {
+        VLOG_WARN("Ignoring invalid snapshot %s", path);
+        relay_snapshot_close(reader);
+        return false;
+    }
+
+    reader->offset = sizeof *hdr;
+    VLOG_INFO("Restoring state saved by pid %u, %lld seconds ago",
+              hdr->pid, (long long int)(time(NULL) - hdr->saved_at));
+    return true;
+}
+
+/*
+ * Function      : relay_snapshot_next
+ * Responsiblity : Get the next section of a snapshot.
+ * Parameters    : reader - snapshot reader
+ *                 type - section type
+ *                 payload - section payload
+ *                 length - payload length
+ * Return        : true - if a section is returned
+ *                 false - at the end of the snapshot
+ */
+bool relay_snapshot_next(struct relay_snapshot_reader *reader,
+                         uint16_t *type, const void **payload,
+                         uint32_t *length)
+{
+    const struct relay_snapshot_section *section;
+    size_t left;
+
+    left = reader->size - reader->offset;
+    if ((NULL == reader->base) || (left < sizeof *section))
+        return false;
+
+    section = (const struct relay_snapshot_section *)
+              (reader->base + reader->offset);
+    if (section->length > left - sizeof *section) {
+        VLOG_WARN("Truncated snapshot section, type : %u", section->type);
+        return false;
+    }
+
+    *type = section->type;
+    *payload = section + 1;
+    *length = section->length;
+
+    reader->offset += MIN(ROUND_UP(sizeof *section + section->length,
+                                   RELAY_SNAPSHOT_ALIGN), left);
+    return true;
+}
+
+/*
+ * Function      : relay_snapshot_close
+ * Responsiblity : Unmap a snapshot.
+ * Parameters    : reader - snapshot reader
+ * Return        : none
+ */
+void relay_snapshot_close(struct relay_snapshot_reader *reader)
+{
+    if (NULL != reader->base) {
+        munmap((void *)reader->base, reader->size);
+    }
+    reader->base = NULL;
+    reader->size = reader->offset = 0;
+}
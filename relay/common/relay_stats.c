@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_stats.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Create the statistics shared memory segment.
+ * - Assign interface records to the relay modules.
+ * - Record per packet processing latency.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "openvswitch/vlog.h"
+#include "util.h"
+#include "relay_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(relay_stats);
+
+/* Mapped segment, NULL when export is disabled */
+static struct relay_stats_header *stats_hdr = NULL;
+static size_t stats_size = 0;
+static char *stats_name = NULL;
+
+/* Packets of a kind are processed by any thread of the receive reactor */
+static pthread_mutex_t record_mutex[RELAY_STATS_KIND_MAX] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Interface records are written by the main thread on configuration
+ * changes and by the reactor threads on packets */
+static pthread_mutex_t intf_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Function      : relay_stats_intf_at
+ * Responsiblity : Get an interface record of the segment.
+ * Parameters    : index - record index
+ * Return        : interface record
+ */
+static struct relay_stats_intf *relay_stats_intf_at(uint32_t index)
+{
+    return (struct relay_stats_intf *)((char *)stats_hdr
+                                       + stats_hdr->header_size
+                                       + index * stats_hdr->intf_size);
+}
+
+/*
+ * Function      : relay_stats_init
+ * Responsiblity : Create and map the statistics shared memory segment.
+ * Parameters    : name - segment name
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+bool relay_stats_init(const char *name)
+{
+    int fd;
+
+    stats_size = sizeof(struct relay_stats_header)
+                 + RELAY_STATS_MAX_INTERFACES
+                   * sizeof(struct relay_stats_intf);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        VLOG_ERR("Failed to create statistics segment %s, errno : %d",
+                 name, errno);
+        return false;
+    }
+
+    if (ftruncate(fd, stats_size) < 0) {
+        VLOG_ERR("Failed to size statistics segment %s, errno : %d",
+                 name, errno);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    stats_hdr = mmap(NULL, stats_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    close(fd);
+    if (MAP_FAILED == stats_hdr) {
+        VLOG_ERR("Failed to map statistics segment %s, errno : %d",
+                 name, errno);
+        stats_hdr = NULL;
+        shm_unlink(name);
+        return false;
+    }
+
+    stats_hdr->version = RELAY_STATS_VERSION;
+    stats_hdr->header_size = sizeof(struct relay_stats_header);
+    stats_hdr->intf_size = sizeof(struct relay_stats_intf);
+    stats_hdr->global_size = sizeof(struct relay_stats_global);
+    stats_hdr->max_interfaces = RELAY_STATS_MAX_INTERFACES;
+    stats_hdr->pid = getpid();
+    stats_hdr->start_time = time(NULL);
+
+    /* Readers only trust the layout once the magic is visible */
+    __atomic_store_n(&stats_hdr->magic, RELAY_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    stats_name = xstrdup(name);
+    VLOG_INFO("Exporting statistics in shared memory segment %s", name);
+    return true;
+}
+
+/*
+ * Function      : relay_stats_exit
+ * Responsiblity : Remove the statistics segment name. The mapping is kept
+ *                 since the packet threads are not joined on exit; it goes
+ *                 away with the process.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_stats_exit(void)
+{
+    if (NULL == stats_name)
+        return;
+
+    shm_unlink(stats_name);
+    free(stats_name);
+    stats_name = NULL;
+}
+
+/*
+ * Function      : relay_stats_enabled
+ * Responsiblity : Check whether statistics export is enabled.
+ * Parameters    : none
+ * Return        : true - if the segment is mapped
+ *                 false - otherwise
+ */
+bool relay_stats_enabled(void)
+{
+    return NULL != stats_hdr;
+}
+
+/*
+ * Function      : relay_stats_intf_write_begin
+ * Responsiblity : Start an update of an interface record. Updates of the
+ *                 interface records are serialized, so that the sequence
+ *                 lock has a single writer. May be called from any thread.
+ * Parameters    : intf - interface record
+ * Return        : none
+ */
+void relay_stats_intf_write_begin(struct relay_stats_intf *intf)
+{
+    pthread_mutex_lock(&intf_mutex);
+    relay_stats_write_begin(&intf->seq);
+}
+
+/*
+ * Function      : relay_stats_intf_write_end
+ * Responsiblity : Complete an update of an interface record.
+ * Parameters    : intf - interface record
+ * Return        : none
+ */
+void relay_stats_intf_write_end(struct relay_stats_intf *intf)
+{
+    relay_stats_write_end(&intf->seq);
+    pthread_mutex_unlock(&intf_mutex);
+}
+
+/*
+ * Function      : relay_stats_intf_alloc
+ * Responsiblity : Assign a free interface record. Called from the main
+ *                 thread only.
+ * Parameters    : kind - owner of the record
+ *                 name - interface name
+ * Return        : interface record, NULL if export is disabled or full
+ */
+struct relay_stats_intf *relay_stats_intf_alloc(enum relay_stats_kind kind,
+                                                const char *name)
+{
+    struct relay_stats_intf *intf;
+    uint32_t iter;
+
+    if (NULL == stats_hdr)
+        return NULL;
+
+    for (iter = 0; iter < stats_hdr->max_interfaces; iter++) {
+        intf = relay_stats_intf_at(iter);
+        if (intf->in_use)
+            continue;
+
+        relay_stats_intf_write_begin(intf);
+        memset(intf->counters, 0, sizeof(intf->counters));
+        ovs_strzcpy(intf->name, name, sizeof(intf->name));
+        intf->kind = kind;
+        intf->in_use = 1;
+        relay_stats_intf_write_end(intf);
+        return intf;
+    }
+
+    VLOG_WARN("No free statistics record for interface %s", name);
+    return NULL;
+}
+
+/*
+ * Function      : relay_stats_intf_free
+ * Responsiblity : Release an interface record.
+ * Parameters    : intf - interface record, may be NULL
+ * Return        : none
+ */
+void relay_stats_intf_free(struct relay_stats_intf *intf)
+{
+    if ((NULL == stats_hdr) || (NULL == intf))
+        return;
+
+    relay_stats_intf_write_begin(intf);
+    intf->in_use = 0;
+    memset(intf->counters, 0, sizeof(intf->counters));
+    relay_stats_intf_write_end(intf);
+}
+
+/*
+ * Function      : relay_stats_record_kernel_drops
+ * Responsiblity : Account packets dropped by the kernel before the relay
+ *                 could read them. May be called from any thread.
+ * Parameters    : kind - packet path
+ *                 drops - newly dropped packets
+ * Return        : none
+ */
+void relay_stats_record_kernel_drops(enum relay_stats_kind kind,
+                                     uint64_t drops)
+{
+    struct relay_stats_global *global;
+
+    if (NULL == stats_hdr)
+        return;
+
+    global = &stats_hdr->global[kind];
+
+    pthread_mutex_lock(&record_mutex[kind]);
+    relay_stats_write_begin(&global->seq);
+    relay_stats_store(&global->kernel_drops, global->kernel_drops + drops);
+    relay_stats_write_end(&global->seq);
+    pthread_mutex_unlock(&record_mutex[kind]);
+}
+
+/*
+ * Function      : relay_stats_record_packet
+ * Responsiblity : Account a processed packet. May be called from any
+ *                 thread.
+ * Parameters    : kind - packet path
+ *                 latency_ns - processing time of the packet
+ * Return        : none
+ */
+void relay_stats_record_packet(enum relay_stats_kind kind,
+                               uint64_t latency_ns)
+{
+    struct relay_stats_global *global;
+    uint32_t bucket;
+
+    if (NULL == stats_hdr)
+        return;
+
+    global = &stats_hdr->global[kind];
+    bucket = latency_ns ? 63 - __builtin_clzll(latency_ns) : 0;
+    if (bucket >= RELAY_STATS_LATENCY_BUCKETS)
+        bucket = RELAY_STATS_LATENCY_BUCKETS - 1;
+
+    pthread_mutex_lock(&record_mutex[kind]);
+    relay_stats_write_begin(&global->seq);
+    relay_stats_store(&global->rx_packets, global->rx_packets + 1);
+    relay_stats_store(&global->latency_sum_ns,
+                      global->latency_sum_ns + latency_ns);
+    relay_stats_store(&global->latency[bucket],
+                      global->latency[bucket] + 1);
+    relay_stats_write_end(&global->seq);
+    pthread_mutex_unlock(&record_mutex[kind]);
+}
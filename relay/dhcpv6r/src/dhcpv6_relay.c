@@ -59,6 +59,8 @@
 #include "coverage.h"
 #include "svec.h"
 
+#include <arpa/inet.h>
+
 #include "relay_common.h"
 #include "dhcpv6_relay.h"
 
@@ -74,6 +76,135 @@ DHCPV6_RELAY_CTRL_CB *dhcpv6_relay_ctrl_cb_p = &dhcpv6_relay_ctrl_cb;
 
 VLOG_DEFINE_THIS_MODULE(dhcpv6_relay);
 
+COVERAGE_DEFINE(dhcpv6r_dhcp_relay_rows);
+
+/*
+ * Function      : dhcpv6r_create_socket
+ * Responsiblity : Create the UDP socket listening on the DHCPv6 server port
+ * Parameters    : none
+ * Return        : sockfd, on success
+ *                 -1, on failure
+ */
+static int dhcpv6r_create_socket(void)
+{
+    struct sockaddr_in6 addr;
+    int32_t sock;
+    int32_t val = 1;
+    int32_t hops = DHCPV6_MCAST_HOP_LIMIT;
+    int32_t loop = 0;
+
+    sock = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  IPPROTO_UDP);
+    if (-1 == sock) {
+        VLOG_ERR("Failed to create DHCPv6 relay socket, errno : %d", errno);
+        return -1;
+    }
+
+    if ((0 != setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY,
+                         &val, sizeof(val)))
+        || (0 != setsockopt(sock, SOL_SOCKET, SO_REUSEADDR,
+                            &val, sizeof(val)))
+        || (0 != setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO,
+                            &val, sizeof(val)))
+        || (0 != setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
+                            &loop, sizeof(loop)))
+        || (0 != setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS,
+                            &hops, sizeof(hops)))) {
+        VLOG_ERR("Failed to set DHCPv6 relay socket options, errno : %d",
+                 errno);
+        close(sock);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(DHCPV6_SERVER_PORT);
+    if (0 != bind(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        VLOG_ERR("Failed to bind DHCPv6 relay socket, errno : %d", errno);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/*
+ * Function      : dhcpv6r_socket_open
+ * Responsiblity : Create the relay socket, join the multicast group on the
+ *                 configured interfaces and register the socket with the
+ *                 reactor. A failure is logged and retried on the next
+ *                 reconfiguration.
+ * Parameters    : none
+ * Return        : true, on success
+ *                 false, on failure
+ */
+static bool dhcpv6r_socket_open(void)
+{
+    int32_t sock;
+
+    sock = dhcpv6r_create_socket();
+    if (-1 == sock) {
+        VLOG_ERR("Failed to create DHCPv6 relay socket, relay is inactive");
+        return false;
+    }
+    dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd = sock;
+    dhcpv6r_join_mcast_groups();
+
+    /* Receive through the reactor, in the daemon namespace */
+    dhcpv6_relay_ctrl_cb_p->source.fd = sock;
+    dhcpv6_relay_ctrl_cb_p->source.nsFd = -1;
+    dhcpv6_relay_ctrl_cb_p->source.cb = dhcpv6r_packet_recv;
+    dhcpv6_relay_ctrl_cb_p->source.aux = NULL;
+    if (!relay_reactor_add(&dhcpv6_relay_ctrl_cb_p->source)) {
+        VLOG_ERR("Failed to register DHCPv6 relay socket with the reactor");
+        close(sock);
+        dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd = -1;
+        return false;
+    }
+
+    VLOG_INFO("DHCPv6 relay socket opened");
+    return true;
+}
+
+/*
+ * Function      : dhcpv6r_socket_close
+ * Responsiblity : Unregister the relay socket from the reactor and close
+ *                 it, which also leaves its multicast groups.
+ * Parameters    : none
+ * Return        : none
+ */
+static void dhcpv6r_socket_close(void)
+{
+    if (0 > dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd) {
+        return;
+    }
+
+    relay_reactor_remove(&dhcpv6_relay_ctrl_cb_p->source);
+    close(dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd);
+    dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd = -1;
+    VLOG_INFO("DHCPv6 relay socket closed");
+}
+
+/*
+ * Function      : dhcpv6r_socket_update
+ * Responsiblity : Hold the relay socket only while the relay is enabled,
+ *                 so that a disabled relay does not claim the DHCPv6
+ *                 server port.
+ * Parameters    : none
+ * Return        : none
+ */
+static void dhcpv6r_socket_update(void)
+{
+    bool open = (0 <= dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd);
+
+    if (dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_enable && !open) {
+        dhcpv6r_socket_open();
+    } else if (!dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_enable && open) {
+        dhcpv6r_socket_close();
+    }
+}
+
 /*
  * Function      : dhcpv6r_module_init
  * Responsiblity : Initialization routine for dhcpv6 relay feature
@@ -100,9 +231,28 @@ bool dhcpv6r_module_init(void)
     /* Initialize server hash map */
     cmap_init(&dhcpv6_relay_ctrl_cb_p->serverHashMap);
 
+    /* Initialize the map of applied configuration records */
+    relay_row_map_init(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows);
+
     /* default values */
     dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_enable = false;
     dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_option79_enable = false;
+    inet_pton(AF_INET6, DHCPV6_ALLAGENTS,
+              &dhcpv6_relay_ctrl_cb_p->agentIpv6Address);
+
+    /* Allocate memory for packet receive and transmit buffers */
+    dhcpv6_relay_ctrl_cb_p->rcvbuff = (char *)
+        calloc(DHCPV6_RELAY_BATCH_SIZE, DHCPV6_RECV_BUFFER_SIZE);
+    dhcpv6_relay_ctrl_cb_p->txbuff = (char *)
+        calloc(DHCPV6_RELAY_BATCH_SIZE, DHCPV6_RELAY_HEADROOM);
+    if ((NULL == dhcpv6_relay_ctrl_cb_p->rcvbuff)
+        || (NULL == dhcpv6_relay_ctrl_cb_p->txbuff)) {
+        VLOG_FATAL("Memory allocation for DHCPv6 relay buffers failed");
+        return false;
+    }
+
+    /* The socket is opened once the relay is enabled */
+    dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd = -1;
 
     return true;
 }
@@ -179,38 +329,23 @@ void dhcpv6r_process_globalconfig_update(void)
  */
 void dhcpv6r_server_config_update(void)
 {
-    const struct ovsrec_dhcp_relay *rec_first = NULL;
     const struct ovsrec_dhcp_relay *rec = NULL;
-
-    /* Check for server configuration changes */
-    rec_first = ovsrec_dhcp_relay_first(idl);
-    if (NULL == rec_first) {
-        /* Check if last entry from the table is deleted */
-        dhcpv6r_handle_row_delete(idl);
-        return;
-    }
-
-    if (!OVSREC_IDL_ANY_TABLE_ROWS_INSERTED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_MODIFIED(rec_first, idl_seqno)) {
-        /* FIXME: Log to be removed after initial round of testing */
-        VLOG_DBG("No table changes updates");
-        return;
-    }
-
-    /* Process row delete notification */
-    if (OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)) {
-      dhcpv6r_handle_row_delete(idl);
-    }
-
-    /* Process row insert/modify notifications */
-    OVSREC_DHCP_RELAY_FOR_EACH (rec, idl) {
-        if (OVSREC_IDL_IS_ROW_INSERTED(rec, idl_seqno)
-            || OVSREC_IDL_IS_ROW_MODIFIED(rec, idl_seqno)) {
+    uint32_t n_rows = 0;
+
+    /* Only the records changed since the last run are tracked */
+    OVSREC_DHCP_RELAY_FOR_EACH_TRACKED (rec, idl) {
+        n_rows++;
+        if (ovsrec_dhcp_relay_is_deleted(rec)) {
+            dhcpv6r_handle_row_delete(&rec->header_.uuid);
+        } else {
             dhcpv6r_handle_config_change(rec, idl_seqno);
         }
     }
-    /* FIXME : handle port deletion */
+
+    if (n_rows) {
+        COVERAGE_ADD(dhcpv6r_dhcp_relay_rows, n_rows);
+        VLOG_DBG("Processed %u DHCP-Relay records", n_rows);
+    }
     return;
 }
 
@@ -227,6 +362,7 @@ void dhcpv6r_reconfigure()
 
     /* Check for global configuration changes in system table */
     dhcpv6r_process_globalconfig_update();
+    dhcpv6r_socket_update();
 
     /* Process dhcp_relay table updates */
     dhcpv6r_server_config_update();
@@ -234,6 +370,84 @@ void dhcpv6r_reconfigure()
     return;
 }
 
+/*
+ * Function      : dhcpv6r_snapshot_save
+ * Responsiblity : Append the interface table to a warm restart snapshot.
+ * Parameters    : snap - snapshot being built
+ * Return        : none
+ */
+void dhcpv6r_snapshot_save(struct relay_snapshot *snap)
+{
+    DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    const DHCPV6_RELAY_SERVER_T *server;
+    DHCPV6R_SNAPSHOT_INTF rec;
+    DHCPV6R_SNAPSHOT_SERVER saved[MAX_SERVERS_PER_INTERFACE];
+    struct shash_node *node;
+    int iter;
+
+    /* Counters are updated by the packet receive thread */
+    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+    SHASH_FOR_EACH(node, &dhcpv6_relay_ctrl_cb_p->intfHashTable) {
+        intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
+        if (strlen(intfNode->portName) >= sizeof(rec.portName)) {
+            VLOG_WARN("Interface name %s too long, not saved",
+                      intfNode->portName);
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        ovs_strzcpy(rec.portName, intfNode->portName, sizeof(rec.portName));
+        rec.dhcpv6_relay_pkt_counters = intfNode->dhcpv6_relay_pkt_counters;
+
+        memset(saved, 0, sizeof(saved));
+        for (iter = 0; iter < intfNode->addrCount; iter++) {
+            server = intfNode->serverArray[iter];
+            saved[rec.n_servers].ipv6_address = server->key.ipv6_address;
+            if (server->key.egressIfIndex
+                && (NULL == if_indextoname(server->key.egressIfIndex,
+                                saved[rec.n_servers].egressIfName))) {
+                /* The outgoing interface is gone, OVSDB restores it */
+                continue;
+            }
+            rec.n_servers++;
+        }
+
+        relay_snapshot_section_start(snap, RELAY_SNAPSHOT_DHCPV6R_INTF);
+        relay_snapshot_put(snap, &rec, sizeof(rec));
+        relay_snapshot_put(snap, saved, rec.n_servers * sizeof(saved[0]));
+        relay_snapshot_section_end(snap);
+    }
+    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+}
+
+/*
+ * Function      : dhcpv6r_snapshot_restore
+ * Responsiblity : Restore one section of a warm restart snapshot. The
+ *                 global enable flag is not restored, it is only ever
+ *                 set from the configuration.
+ * Parameters    : type - section type
+ *                 payload - section payload
+ *                 length - payload length
+ * Return        : none
+ */
+void dhcpv6r_snapshot_restore(uint16_t type, const void *payload,
+                              uint32_t length)
+{
+    const DHCPV6R_SNAPSHOT_INTF *rec = payload;
+
+    if (RELAY_SNAPSHOT_DHCPV6R_INTF != type) {
+        return;
+    }
+
+    if ((length < sizeof(*rec))
+        || ((length - sizeof(*rec)) / sizeof(rec->servers[0])
+            < rec->n_servers)) {
+        VLOG_WARN("Ignoring truncated interface snapshot section");
+        return;
+    }
+    dhcpv6r_restore_interface(rec);
+}
+
 /*
  * Function      : dhcpv6r_exit
  * Responsiblity : dhcpv6_relay module cleanup before exit
@@ -242,7 +456,10 @@ void dhcpv6r_reconfigure()
  */
 void dhcpv6r_exit(void)
 {
-    return;
+    dhcpv6r_socket_close();
+
+    free(dhcpv6_relay_ctrl_cb_p->rcvbuff);
+    free(dhcpv6_relay_ctrl_cb_p->txbuff);
 }
 
 
@@ -261,6 +478,8 @@ static void dhcpv6r_interface_dump(struct shash_node *node,
     DHCPV6_RELAY_SERVER_T *server = NULL, **serverArray = NULL;
     DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
     int32_t iter = 0;
+    char addrStr[INET6_ADDRSTRLEN];
+    char ifName[IF_NAMESIZE];
 
     intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
     serverArray = intfNode->serverArray;
@@ -272,8 +491,14 @@ static void dhcpv6r_interface_dump(struct shash_node *node,
     for(iter = 0; iter < intfNode->addrCount; iter++)
     {
         server = serverArray[iter];
-        ds_put_format(ds, "%s,%d,egress %s ", server->ipv6_address,
-            server->ref_count, server->egressIfName);
+        inet_ntop(AF_INET6, &server->key.ipv6_address, addrStr,
+                  sizeof(addrStr));
+        if ((0 == server->key.egressIfIndex)
+            || (NULL == if_indextoname(server->key.egressIfIndex, ifName))) {
+            ovs_strzcpy(ifName, "(null)", sizeof(ifName));
+        }
+        ds_put_format(ds, "%s,%d,egress %s ", addrStr,
+            server->ref_count, ifName);
     }
     return;
 }
@@ -344,6 +569,12 @@ bool dhcpv6r_init()
                         &ovsrec_dhcp_relay_col_vrf);
     ovsdb_idl_add_column(idl,
                         &ovsrec_dhcp_relay_col_ipv6_ucast_server);
+
+    /* Track record changes, so that updates only visit changed records */
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_port);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_vrf);
+    ovsdb_idl_track_add_column(idl,
+                               &ovsrec_dhcp_relay_col_ipv6_ucast_server);
     /* FIXME: This will be removed after schema changes got merged. */
 #if 0
     ovsdb_idl_add_column(idl,
@@ -363,6 +594,9 @@ bool dhcpv6r_init()
 
     unixctl_command_register("dhcpv6r/dump", "", 0, 2,
                              dhcpv6r_unixctl_dump, NULL);
+
+    /* Follow kernel interfaces coming and going */
+    relay_netlink_register(dhcpv6r_netlink_event, NULL);
     return true;
 }
 #endif /* FTR_DHCPV6_RELAY */
@@ -25,62 +25,171 @@
 
 #include "dhcpv6_relay.h"
 #include "hash.h"
+#include "hmap.h"
+#include "sset.h"
+#include "util.h"
 #include <string.h>
+#include <arpa/inet.h>
 
 VLOG_DEFINE_THIS_MODULE(dhcpv6_relay_config);
 
 #ifdef FTR_DHCPV6_RELAY
 
-#define GENERATE_KEY(HASH_IP, HASH_EGRESSNAME, HASH_KEY) \
-    if (HASH_EGRESSNAME) \
-        HASH_KEY = hash_2words(hash_string(HASH_IP, 0), \
-        hash_string(HASH_EGRESSNAME, 0));\
-      else \
-        HASH_KEY = hash_2words(hash_string(HASH_IP, 0), 0);
+BUILD_ASSERT_DECL(sizeof(DHCPV6_RELAY_SERVER_KEY) ==
+                  sizeof(struct in6_addr) + sizeof(uint32_t));
 
+#define GENERATE_KEY(SERVER_KEY) \
+    hash_bytes((SERVER_KEY), sizeof(DHCPV6_RELAY_SERVER_KEY), 0)
 
 /*
  * Function      : compare_server
  * Responsiblity : compare server ipv6 address and
- *                 outgoing egress ifNames
- * Parameters    : ip1, ip2 - ipv6 addresses
- *                 ifName1, ifName2 - egress interface
+ *                 outgoing egress interface
+ * Parameters    : key1, key2 - server keys
  * Return        : true - success
  *                 false - failure
  */
-bool compare_server(char *ip1, char*ip2, char*ifName1, char*ifName2)
+bool compare_server(const DHCPV6_RELAY_SERVER_KEY *key1,
+                    const DHCPV6_RELAY_SERVER_KEY *key2)
 {
-    if (0 == strncmp(ip1, ip2, strlen(ip1)))
-    {
-        if (ifName1 == NULL && ifName2 == NULL)
-            return true;
-        else if (ifName1 == NULL || ifName2 == NULL)
+    return 0 == memcmp(key1, key2, sizeof(DHCPV6_RELAY_SERVER_KEY));
+}
+
+/*
+ * Function      : dhcpv6r_server_key_init
+ * Responsiblity : Convert a configured server to its lookup key
+ * Parameters    : key - key to fill
+ *                 ipv6_address - server IPv6 address string
+ *                 egressIfName - outgoing interface name, NULL for
+ *                                unicast servers
+ * Return        : true - success
+ *                 false - invalid address or unknown interface
+ */
+bool dhcpv6r_server_key_init(DHCPV6_RELAY_SERVER_KEY *key,
+                             const char *ipv6_address,
+                             const char *egressIfName)
+{
+    memset(key, 0, sizeof(*key));
+    if (1 != inet_pton(AF_INET6, ipv6_address, &key->ipv6_address)) {
+        VLOG_ERR("Invalid server IPv6 address : %s", ipv6_address);
+        return false;
+    }
+
+    if (NULL != egressIfName) {
+        key->egressIfIndex = if_nametoindex(egressIfName);
+        if (0 == key->egressIfIndex) {
+            VLOG_ERR("Unknown outgoing interface %s for server %s",
+                     egressIfName, ipv6_address);
             return false;
-        else
-            if (0 == strncmp(ifName1, ifName2, strlen(ifName1)))
-                return true;
+        }
+    }
+    return true;
+}
+
+/*
+ * Function      : dhcpv6r_server_key_to_string
+ * Responsiblity : Format a server key for logs
+ * Parameters    : key - server key
+ *                 buf - output buffer of INET6_ADDRSTRLEN bytes
+ * Return        : buf
+ */
+static const char *dhcpv6r_server_key_to_string(
+                        const DHCPV6_RELAY_SERVER_KEY *key, char *buf)
+{
+    return inet_ntop(AF_INET6, &key->ipv6_address, buf, INET6_ADDRSTRLEN);
+}
+
+/*
+ * Function      : dhcpv6r_update_mcast_membership
+ * Responsiblity : Join or leave the All_DHCP_Relay_Agents_and_Servers
+ *                 group on an interface, so that client messages sent to
+ *                 it are received on the relay socket.
+ * Parameters    : intfNode - Interface entry
+ *                 join - true to join, false to leave
+ * Return        : none
+ */
+static void dhcpv6r_update_mcast_membership(
+                DHCPV6_RELAY_INTERFACE_NODE_T *intfNode, bool join)
+{
+    struct ipv6_mreq mreq;
+
+    if ((0 == intfNode->ifIndex)
+        || (0 >= dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd)) {
+        return;
+    }
+
+    mreq.ipv6mr_multiaddr = dhcpv6_relay_ctrl_cb_p->agentIpv6Address;
+    mreq.ipv6mr_interface = intfNode->ifIndex;
+    if (0 != setsockopt(dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd,
+                        IPPROTO_IPV6,
+                        join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+                        &mreq, sizeof(mreq))) {
+        VLOG_ERR("Failed to %s %s on interface %s, errno : %d",
+                 join ? "join" : "leave", DHCPV6_ALLAGENTS,
+                 intfNode->portName, errno);
+    }
+}
+
+/*
+ * Function      : dhcpv6r_join_mcast_groups
+ * Responsiblity : Join the All_DHCP_Relay_Agents_and_Servers group on
+ *                 every known interface, once the relay socket is opened.
+ * Parameters    : none
+ * Return        : none
+ */
+void dhcpv6r_join_mcast_groups(void)
+{
+    struct shash_node *node;
+
+    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+    SHASH_FOR_EACH(node, &dhcpv6_relay_ctrl_cb_p->intfHashTable) {
+        dhcpv6r_update_mcast_membership(node->data, true);
     }
-    return false;
+    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+}
+
+/*
+ * Function      : dhcpv6r_stats_publish
+ * Responsiblity : Copy the interface counters to its shared memory
+ *                 statistics record, if statistics export is enabled.
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+void dhcpv6r_stats_publish(const DHCPV6_RELAY_INTERFACE_NODE_T *intfNode)
+{
+    struct relay_stats_intf *stats = intfNode->stats;
+    const DHCPV6_RELAY_PKT_COUNTER *counters =
+                                &intfNode->dhcpv6_relay_pkt_counters;
+
+    if (NULL == stats)
+        return;
+
+    relay_stats_intf_write_begin(stats);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPV6R_CLIENT_DROPS],
+                      counters->client_drops);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPV6R_CLIENT_VALIDS],
+                      counters->client_valids);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPV6R_SERVER_DROPS],
+                      counters->serv_drops);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPV6R_SERVER_VALIDS],
+                      counters->serv_valids);
+    relay_stats_intf_write_end(stats);
 }
 
 /*
  * Function      : dhcpv6r_get_server_entry
  * Responsiblity : Lookup the hash map for a specific server entry
- * Parameters    : ipv6_address - server IPv6 address
- *                 egressIfName - Outgoing Interface name
+ * Parameters    : key - server address and outgoing interface
  * Return        : DHCPV6_RELAY_SERVER_T* - pointer to the server entry
  */
-DHCPV6_RELAY_SERVER_T* dhcpv6r_get_server_entry(char* ipv6_address,
-                                        char* egressIfName)
+DHCPV6_RELAY_SERVER_T* dhcpv6r_get_server_entry(
+                                const DHCPV6_RELAY_SERVER_KEY *key)
 {
-    uint32_t hash_key;
     DHCPV6_RELAY_SERVER_T *serverIP = NULL;
 
-    GENERATE_KEY(ipv6_address, egressIfName, hash_key);
-    CMAP_FOR_EACH_WITH_HASH(serverIP, cmap_node, hash_key,
+    CMAP_FOR_EACH_WITH_HASH(serverIP, cmap_node, GENERATE_KEY(key),
                            &dhcpv6_relay_ctrl_cb_p->serverHashMap) {
-        if (compare_server(ipv6_address, serverIP->ipv6_address,
-                egressIfName, serverIP->egressIfName))
+        if (compare_server(key, &serverIP->key))
             return serverIP;
     }
     return NULL;
@@ -89,286 +198,353 @@ DHCPV6_RELAY_SERVER_T* dhcpv6r_get_server_entry(char* ipv6_address,
 /*
  * Function      : dhcpv6r_add_server_entry
  * Responsiblity : Add a server entry to server hash table
- * Parameters    : ipv6_address - server IPv6 address
- *                 egressIfName - Outgoing Interface name
+ * Parameters    : key - server address and outgoing interface
  * Return        : DHCPV6_RELAY_SERVER_T* - pointer to the newly created server entry
  */
-DHCPV6_RELAY_SERVER_T* dhcpv6r_add_server_entry(char* ipv6_address,
-                                        char* egressIfName)
+DHCPV6_RELAY_SERVER_T* dhcpv6r_add_server_entry(
+                                const DHCPV6_RELAY_SERVER_KEY *key)
 {
     DHCPV6_RELAY_SERVER_T *serverIP;
-    uint32_t hash_key;
+    char addrStr[INET6_ADDRSTRLEN];
 
     serverIP = (DHCPV6_RELAY_SERVER_T *) malloc(sizeof(DHCPV6_RELAY_SERVER_T));
     if (NULL == serverIP) {
         VLOG_ERR("Failed to allocate memory for the server entry for "
-                 "ipv6: %s", ipv6_address);
+                 "ipv6: %s", dhcpv6r_server_key_to_string(key, addrStr));
         return NULL;
     }
 
-    serverIP->ipv6_address = xstrdup(ipv6_address);
-    if (egressIfName)
-        serverIP->egressIfName = xstrdup(egressIfName);
-    else
-        serverIP->egressIfName = NULL;
+    serverIP->key = *key;
     serverIP->ref_count  = 1; /*Reference count starts with 1*/
 
-    GENERATE_KEY(ipv6_address, egressIfName, hash_key);
     cmap_insert(&dhcpv6_relay_ctrl_cb_p->serverHashMap,
-                (struct cmap_node *)serverIP, hash_key);
+                (struct cmap_node *)serverIP, GENERATE_KEY(key));
 
     return serverIP;
 }
 
+/* Entry of a server set, used while diffing a configuration update */
+struct dhcpv6r_server_set_node {
+    struct hmap_node hmap_node;   /* in struct dhcpv6r_server_set map */
+    DHCPV6_RELAY_SERVER_KEY key;  /* Server address and outgoing interface */
+    bool present;                 /* already configured on the interface */
+};
+
+/* Set of configured servers. Lookups are by key, additions are applied
+ * in configuration order. */
+struct dhcpv6r_server_set {
+    struct hmap map;                          /* key index */
+    struct dhcpv6r_server_set_node **order;   /* configuration order */
+    size_t n;
+    size_t allocated;
+};
+
+/* Servers of an interface covered by a configuration update */
+#define DHCPV6R_SCOPE_UCAST 0x1  /* unicast servers */
+#define DHCPV6R_SCOPE_MCAST 0x2  /* multicast servers */
+#define DHCPV6R_SCOPE_ALL   (DHCPV6R_SCOPE_UCAST | DHCPV6R_SCOPE_MCAST)
+
 /*
- * Function      : dhcpv6r_store_address
- * Responsiblity : Add a server reference to an interface
- * Parameters    : intfNode - Interface entry
- *                 ipv6_address - server IPv6 address
- *                 egressIfName - outgoing interface name
- * Return        : true - if the entry is successfully added
- *                 false - otherwise
+ * Function      : dhcpv6r_server_set_init
+ * Responsiblity : Initialize an empty server set
+ * Parameters    : set - server set
+ * Return        : none
  */
-bool dhcpv6r_store_address(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                        char* ipv6_address, char *egressIfName)
+static void dhcpv6r_server_set_init(struct dhcpv6r_server_set *set)
 {
-    DHCPV6_RELAY_SERVER_T  *server;
-
-    if(intfNode->addrCount >= MAX_SERVERS_PER_INTERFACE)
-    {
-        VLOG_ERR("Maximum server configuration limit reached on interface"
-                 " %s (count : %d)", intfNode->portName, intfNode->addrCount);
-        return false;
-    }
+    hmap_init(&set->map);
+    set->order = NULL;
+    set->n = set->allocated = 0;
+}
 
-    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+/*
+ * Function      : dhcpv6r_server_set_destroy
+ * Responsiblity : Free a server set
+ * Parameters    : set - server set
+ * Return        : none
+ */
+static void dhcpv6r_server_set_destroy(struct dhcpv6r_server_set *set)
+{
+    size_t iter;
 
-    /* If address count is non zero but the address is NULL, return error */
-    if((0 != intfNode->addrCount) && (NULL == intfNode->serverArray))
-    {
-        VLOG_ERR("Address count is [%d], but server IPv6 address ref array "
-                 "is NULL for Interface [%s] while storing a server ref",
-                 intfNode->addrCount, intfNode->portName);
-        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
-        return false;
+    for (iter = 0; iter < set->n; iter++) {
+        free(set->order[iter]);
     }
+    free(set->order);
+    hmap_destroy(&set->map);
+}
 
-    /* There is no server table pointers for this interface, we will allocate
-     * memory for this array of server entry pointers */
-    else if(intfNode->serverArray == NULL)
-    {
-        intfNode->addrCount = 0;
-        intfNode->serverArray = (DHCPV6_RELAY_SERVER_T **)
-                                    malloc(MAX_SERVERS_PER_INTERFACE
-                                    * sizeof(DHCPV6_RELAY_SERVER_T *));
-        if (NULL == intfNode->serverArray) {
-            VLOG_ERR("Failed to allocate server array for interface : %s",
-                    intfNode->portName);
-            sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
-            return false;
-        }
-    }
+/*
+ * Function      : dhcpv6r_server_set_find
+ * Responsiblity : Lookup a server in a server set
+ * Parameters    : set - server set
+ *                 key - server address and outgoing interface
+ * Return        : set entry, NULL if not found
+ */
+static struct dhcpv6r_server_set_node *
+dhcpv6r_server_set_find(const struct dhcpv6r_server_set *set,
+                        const DHCPV6_RELAY_SERVER_KEY *key)
+{
+    struct dhcpv6r_server_set_node *setNode;
 
-    VLOG_INFO("Attempting to add server entry ipv6: %s"
-              "on interface : %s", ipv6_address, intfNode->portName);
-    /* Checks whether Server IP entry exists or not */
-    server = dhcpv6r_get_server_entry(ipv6_address, egressIfName);
-    if(NULL != server)
-    {
-        /* Increment server entry reference count */
-        server->ref_count++;
-        VLOG_INFO("Matching server found, incremented ref count. "
-               "server : %s (refcount :%d)", server->ipv6_address,
-               server->ref_count);
-    }
-    else
-    {
-        /* No matching server entry, create new */
-        if((server = dhcpv6r_add_server_entry(
-                       ipv6_address, egressIfName)) == NULL)
-        {
-            VLOG_ERR("Error while adding a new server entry");
-            sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
-            return false;
+    HMAP_FOR_EACH_WITH_HASH (setNode, hmap_node, GENERATE_KEY(key),
+                             &set->map) {
+        if (compare_server(&setNode->key, key)) {
+            return setNode;
         }
     }
+    return NULL;
+}
 
-    /* Update IP reference table (per interface) */
-    intfNode->serverArray[intfNode->addrCount] = server;
-    /* Increment the address count in interface table */
-    intfNode->addrCount++;
+/*
+ * Function      : dhcpv6r_server_set_add_key
+ * Responsiblity : Add a server key to a server set, duplicates are ignored
+ * Parameters    : set - server set
+ *                 key - server address and outgoing interface
+ * Return        : none
+ */
+static void dhcpv6r_server_set_add_key(struct dhcpv6r_server_set *set,
+                                       const DHCPV6_RELAY_SERVER_KEY *key)
+{
+    struct dhcpv6r_server_set_node *setNode;
 
-    VLOG_INFO("Server entry successfully updated for interface : %s, "
-              " current address_count : %d", intfNode->portName,
-              intfNode->addrCount);
+    if (NULL != dhcpv6r_server_set_find(set, key)) {
+        return;
+    }
 
-    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+    setNode = xmalloc(sizeof *setNode);
+    setNode->key = *key;
+    setNode->present = false;
+    hmap_insert(&set->map, &setNode->hmap_node, GENERATE_KEY(key));
 
-    return true;
+    if (set->n >= set->allocated) {
+        set->order = x2nrealloc(set->order, &set->allocated,
+                                sizeof *set->order);
+    }
+    set->order[set->n++] = setNode;
 }
 
 /*
- * Function      : dhcpv6r_push_deleted_server_ref_to_end
- * Responsiblity : Move the deleted entry from the server array to the end
- * Parameters    : intfNode - Interface entry
- *                 deleted_index - Index in the server array of the interface
+ * Function      : dhcpv6r_server_set_add
+ * Responsiblity : Add a configured server to a server set, parsing it
+ *                 once. Invalid servers are logged and skipped,
+ *                 duplicates are ignored.
+ * Parameters    : set - server set
+ *                 ipv6_address - server IPv6 address string
+ *                 egressIfName - outgoing interface name, NULL for
+ *                                unicast servers
  * Return        : none
  */
-void dhcpv6r_push_deleted_server_ref_to_end(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                                        int deleted_index)
+static void dhcpv6r_server_set_add(struct dhcpv6r_server_set *set,
+                                   const char *ipv6_address,
+                                   const char *egressIfName)
 {
-    uint8_t currentAddrCount = 0;
-    DHCPV6_RELAY_SERVER_T *server;
-    DHCPV6_RELAY_SERVER_T **serverArray = intfNode->serverArray;
+    DHCPV6_RELAY_SERVER_KEY key;
 
-    currentAddrCount = intfNode->addrCount;
+    if (dhcpv6r_server_key_init(&key, ipv6_address, egressIfName)) {
+        dhcpv6r_server_set_add_key(set, &key);
+    }
+}
+
+/*
+ * Function      : dhcpv6r_server_in_scope
+ * Responsiblity : Check whether a configuration update covers a server
+ * Parameters    : server - server entry
+ *                 scope - DHCPV6R_SCOPE_* flags
+ * Return        : true - if the server is covered
+ *                 false - otherwise
+ */
+static bool dhcpv6r_server_in_scope(const DHCPV6_RELAY_SERVER_T *server,
+                                    int scope)
+{
+    return scope & (server->key.egressIfIndex ? DHCPV6R_SCOPE_MCAST
+                                              : DHCPV6R_SCOPE_UCAST);
+}
 
-    /* Move the NULL at the end of the list */
-    server = serverArray[currentAddrCount];
-    serverArray[currentAddrCount] = serverArray[deleted_index] = NULL;
-    serverArray[deleted_index] = server;
+/*
+ * Function      : dhcpv6r_server_unref
+ * Responsiblity : Drop a reference to a server entry and free it once
+ *                 no interface uses it. Called with waitSem held.
+ * Parameters    : server - server entry
+ * Return        : none
+ */
+static void dhcpv6r_server_unref(DHCPV6_RELAY_SERVER_T *server)
+{
+    assert(server->ref_count);
+    /* Decrement server reference Count */
+    server->ref_count--;
+    /* If reference count becomes zero */
+    if (0 >= server->ref_count)
+    {
+        VLOG_INFO("server reference count reached 0. Freeing entry");
+        cmap_remove(&dhcpv6_relay_ctrl_cb_p->serverHashMap,
+                    (struct cmap_node *)server,
+                    GENERATE_KEY(&server->key));
+        free(server);
+    }
 }
 
 /*
- * Function      : dhcpv6r_remove_server_ref_entry
- * Responsiblity : Remove reference to a server entry from an interface entry
- * Parameters    : intfNode - Interface entry
- *                 ipv6_address - server IPv6 address
- *                 deleted_index - Index in the server array
- * Return        : true - if the entry is successfully dereferenced
- *                 false - entry not found
+ * Function      : dhcpv6r_server_ref
+ * Responsiblity : Take a reference to a server entry, creating it if
+ *                 needed. Called with waitSem held.
+ * Parameters    : key - server address and outgoing interface
+ * Return        : DHCPV6_RELAY_SERVER_T* - server entry, NULL on failure
  */
-bool dhcpv6r_remove_server_ref_entry(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                                char* ipv6_address, char* egressIfName,
-                                int *deleted_index)
+static DHCPV6_RELAY_SERVER_T *dhcpv6r_server_ref(
+                                const DHCPV6_RELAY_SERVER_KEY *key)
 {
-    uint8_t index = 0;
-    uint32_t hash_key;
-    DHCPV6_RELAY_SERVER_T **serverArray = NULL;
     DHCPV6_RELAY_SERVER_T *server;
 
-    serverArray = intfNode->serverArray;
-    /* Find the entry in Server IP Table & free the memory (structFree) if
-     * ref_count is zero */
-    for ( ; index < intfNode->addrCount; index++)
+    /* Checks whether Server IP entry exists or not */
+    server = dhcpv6r_get_server_entry(key);
+    if (NULL != server)
     {
-        if (compare_server(serverArray[index]->ipv6_address, ipv6_address,
-                serverArray[index]->egressIfName, egressIfName))
-        {
-            VLOG_INFO("Address to be deleted found in interface : %s",
-                      intfNode->portName);
-            server = serverArray[index];
-            assert(server->ref_count);
-            /* Decrement server reference Count */
-            server->ref_count--;
-            /* If reference count becomes zero */
-            if(0 >= server->ref_count)
-            {
-                GENERATE_KEY(ipv6_address, egressIfName, hash_key);
-                VLOG_INFO("server reference count reached 0. Freeing entry");
-                cmap_remove(&dhcpv6_relay_ctrl_cb_p->serverHashMap,
-                            (struct cmap_node *)server, hash_key);
-                /* assign outgoing interface to NULL */
-                if (NULL != server->egressIfName)
-                    free(server->egressIfName);
-                if (NULL != server->ipv6_address)
-                    free(server->ipv6_address);
-                free(server);
-            }
-
-            *deleted_index = index;
-            /*Make the IP ref Table entry NULL*/
-            serverArray[index] = NULL;
-            return true;
-        }
+        /* Increment server entry reference count */
+        server->ref_count++;
+        return server;
     }
-    return false;
+
+    /* No matching server entry, create new */
+    return dhcpv6r_add_server_entry(key);
 }
 
 /*
- * Function      : dhcpv6r_remove_address
- * Responsiblity : Remove a server reference from an interface
+ * Function      : dhcpv6r_free_interface_node
+ * Responsiblity : Remove an interface entry which has no configuration
+ *                 left. Called with waitSem held.
  * Parameters    : intfNode - Interface entry
- *                 ipaddress - server IPv6 address
- *                 egressIfName - outgoing interface name
- * Return        : true - if the server reference is removed
- *                 false - otherwise
+ * Return        : none
  */
-bool dhcpv6r_remove_address(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                        char* ipv6_address, char* egressIfName)
+static void dhcpv6r_free_interface_node(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode)
 {
-    DHCPV6_RELAY_SERVER_T **serverArray = NULL;
-    bool retVal = false;
-    int deleted_index;  /*IP ref table's deleted index*/
     struct shash_node *node;
 
-    VLOG_INFO("Attempting to delete server : %s on "
-              "interface : %s", ipv6_address, intfNode->portName);
+    VLOG_INFO("All configuration on the interface : %s are removed."
+              " Freeing interface entry", intfNode->portName);
+    node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable,
+                      intfNode->portName);
+    if (NULL != node)
+    {
+        shash_delete(&dhcpv6_relay_ctrl_cb_p->intfHashTable, node);
+    }
+    else
+    {
+        VLOG_ERR("Interface node not found in hash table : %s",
+                 intfNode->portName);
+    }
+    dhcpv6r_update_mcast_membership(intfNode, false);
+    relay_stats_intf_free(intfNode->stats);
+    if (NULL != intfNode->portName)
+        free(intfNode->portName);
+
+    free(intfNode);
+}
+
+/*
+ * Function      : dhcpv6r_apply_server_delta
+ * Responsiblity : Make the servers of an interface within a scope match a
+ *                 server set. The whole delta is applied under a single
+ *                 waitSem hold, in time linear in the number of servers.
+ *                 The interface entry is freed if its last server is
+ *                 removed, so it must not be used afterwards.
+ * Parameters    : intfNode - Interface entry
+ *                 desired - servers that should be configured
+ *                 scope - DHCPV6R_SCOPE_* flags
+ * Return        : none
+ */
+static void dhcpv6r_apply_server_delta(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
+                                       struct dhcpv6r_server_set *desired,
+                                       int scope)
+{
+    struct dhcpv6r_server_set_node *setNode;
+    DHCPV6_RELAY_SERVER_T *server;
+    int iter, kept = 0, added = 0, removed = 0;
+    size_t iter1;
 
     sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
 
-    /* Server IP Reference table pointer */
-    serverArray = intfNode->serverArray;
+    /* There is no server table pointers for this interface, we will allocate
+     * memory for this array of server entry pointers */
+    if ((NULL == intfNode->serverArray) && (0 != desired->n))
+    {
+        intfNode->addrCount = 0;
+        intfNode->serverArray = (DHCPV6_RELAY_SERVER_T **)
+                                    malloc(MAX_SERVERS_PER_INTERFACE
+                                    * sizeof(DHCPV6_RELAY_SERVER_T *));
+        if (NULL == intfNode->serverArray) {
+            VLOG_ERR("Failed to allocate server array for interface : %s",
+                    intfNode->portName);
+            sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+            return;
+        }
+    }
 
-    retVal = dhcpv6r_remove_server_ref_entry(intfNode, ipv6_address,
-                                        egressIfName, (int*)&deleted_index);
-    if(false == retVal)
+    /* Drop the servers which are no longer configured, compacting the
+     * array in place */
+    for (iter = 0; iter < intfNode->addrCount; iter++)
     {
-        /* Release the semaphore & return */
-        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
-        VLOG_ERR("Server entry not found on the interface");
-        return false;
+        server = intfNode->serverArray[iter];
+        if (dhcpv6r_server_in_scope(server, scope))
+        {
+            setNode = dhcpv6r_server_set_find(desired, &server->key);
+            if (NULL == setNode)
+            {
+                dhcpv6r_server_unref(server);
+                removed++;
+                continue;
+            }
+            setNode->present = true;
+        }
+        intfNode->serverArray[kept++] = server;
     }
 
-    /* Decrement interface server reference count */
-    intfNode->addrCount --;
+    /* Add the servers which are newly configured */
+    for (iter1 = 0; iter1 < desired->n; iter1++)
+    {
+        setNode = desired->order[iter1];
+        if (setNode->present)
+            continue;
+
+        if (kept >= MAX_SERVERS_PER_INTERFACE)
+        {
+            VLOG_ERR("Maximum server configuration limit reached on "
+                     "interface %s (count : %d)", intfNode->portName, kept);
+            break;
+        }
 
-    VLOG_INFO("Interface server reference count after decrement : %d",
-              intfNode->addrCount);
+        server = dhcpv6r_server_ref(&setNode->key);
+        if (NULL == server)
+        {
+            VLOG_ERR("Error while adding a new server entry");
+            continue;
+        }
+        intfNode->serverArray[kept++] = server;
+        added++;
+    }
 
-    /* Push the NULL entry at the end of the list
-     * If address count is zero & deleted index is also zero, no need to swap
-     * the deleted entry, because the entire list is NULL now.*/
-    if(!((0 == deleted_index) && (0 == intfNode->addrCount)))
+    intfNode->addrCount = kept;
+    if ((0 != added) || (0 != removed))
     {
-        dhcpv6r_push_deleted_server_ref_to_end(intfNode, deleted_index);
+        VLOG_INFO("Server entries updated for interface : %s, added : %d, "
+                  "removed : %d, current address_count : %d",
+                  intfNode->portName, added, removed, kept);
     }
 
-    /* Check whether this was the only configured server IP for the interface.
-     * In that case we must free the memory for entire server table
-     * for this interface. First entry NULL means, entire list is NULL.
-     * because NULL entries are
-     * always pushed to the end of the list */
-    if ((NULL == serverArray[0]) && (intfNode->addrCount ==0))
+    if ((0 == kept) && (NULL != intfNode->serverArray))
     {
-        VLOG_INFO("All configuration on the interface : %s are removed."
-                  " Freeing interface entry", intfNode->portName);
-
         /* Delete the entire IP reference table */
-        free(serverArray);
-        /* Make interface table entry NULL, as no helper IP is configured */
+        free(intfNode->serverArray);
         intfNode->serverArray = NULL;
-        node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable,
-                      intfNode->portName);
-        if (NULL != node)
+        if (0 != removed)
         {
-            shash_delete(&dhcpv6_relay_ctrl_cb_p->intfHashTable, node);
+            dhcpv6r_free_interface_node(intfNode);
         }
-        else
-        {
-            VLOG_ERR("Interface node not found in hash table : %s",
-                 intfNode->portName);
-        }
-        if (NULL != intfNode->portName)
-            free(intfNode->portName);
-
-        free(intfNode);
     }
+
     sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
-    return true;
 }
 
-
 /*
  * Function      : dhcpv6r_create_intfnode
  * Responsiblity : Allocate memory for interface entry
@@ -397,6 +573,9 @@ DHCPV6_RELAY_INTERFACE_NODE_T *dhcpv6r_create_intferface_node(char *pname)
 
     intfNode->addrCount = 0;
     intfNode->serverArray = NULL;
+    intfNode->ifIndex = if_nametoindex(pname);
+    intfNode->stats = relay_stats_intf_alloc(RELAY_STATS_KIND_DHCPV6R, pname);
+    dhcpv6r_update_mcast_membership(intfNode, true);
     shash_add(&dhcpv6_relay_ctrl_cb_p->intfHashTable, pname, intfNode);
     VLOG_INFO("Allocated interface table record for port : %s", pname);
 
@@ -404,212 +583,74 @@ DHCPV6_RELAY_INTERFACE_NODE_T *dhcpv6r_create_intferface_node(char *pname)
 }
 
 /*
- * Function      : dhcpv6r_handle_row_delete
- * Responsiblity : Process delete event for one or more ports records from
- *                 DHCP-Relay table
- * Parameters    : idl - idl reference
+ * Function      : dhcpv6r_flush_interface
+ * Responsiblity : Remove the DHCPv6-Relay configuration of an interface
+ * Parameters    : portName - interface name
  * Return        : none
  */
-void dhcpv6r_handle_row_delete(struct ovsdb_idl *idl)
+static void dhcpv6r_flush_interface(const char *portName)
 {
-    const struct ovsrec_dhcp_relay *rec = NULL;
     DHCPV6_RELAY_INTERFACE_NODE_T *intf = NULL;
-    struct shash_node *node = NULL, *next = NULL;
-    int iter = 0, count = 0;
-    DHCPV6_RELAY_SERVER_T **serverArray = NULL;
-    bool found = false;
-
-    /* Walk the server configuration hash table per "port" to
-     * see if the corresponding record is deleted */
-    SHASH_FOR_EACH_SAFE(node, next, &dhcpv6_relay_ctrl_cb_p->intfHashTable) {
-        found = false;
-        /* Iterate through dhcp relay table to find a match */
-        OVSREC_DHCP_RELAY_FOR_EACH(rec, idl) {
-            if ((NULL != rec->port) &&
-                !strncmp(rec->port->name, node->name,
-                         strlen(rec->port->name))) {
-                found = true;
-                break;
-            }
-        }
-
-        if (false == found) {
-            intf = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
-            serverArray = intf->serverArray;
-            count = intf->addrCount;
-            /* Delete the interface entry from hash table */
-            for (iter = 0; iter < count; iter++) {
-                dhcpv6r_remove_address(intf, serverArray[iter]->ipv6_address,
-                                      serverArray[iter]->egressIfName);
-            }
-        }
-    }
-    return;
-}
+    struct dhcpv6r_server_set none;
 
-/*
- * Function      : dhcpv6r_flush_removed_ucast_entries
- * Responsiblity : Check for ucast entries deleted in dhcp relay table
- *                 and remove from local cache
- * Parameters    : rec - DHCP-Relay OVSDB table record
- *                 intfNode - Interface entry
- * Return        : none
- */
-
-void dhcpv6r_flush_removed_ucast_entries(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                        const struct ovsrec_dhcp_relay *rec)
-{
-    char *ipv6_address = NULL;
-    int iter = 0, iter1 = 0;
-    bool found;
-
-    /* Collect the servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++) {
-        found = false;
-        ipv6_address = intfNode->serverArray[iter]->ipv6_address;
-        for (iter1 = 0; iter1 < rec->n_ipv6_ucast_server; iter1++) {
-            if (compare_server
-            (ipv6_address, rec->ipv6_ucast_server[iter], NULL, NULL))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (false == found) {
-            if(!dhcpv6r_remove_address(intfNode, ipv6_address, NULL))
-                VLOG_ERR("unicast ipv6 entry deletion in local cache failed");
-        }
+    intf = shash_find_data(&dhcpv6_relay_ctrl_cb_p->intfHashTable, portName);
+    if (NULL == intf) {
+        return;
     }
-}
-
-/*
- * Function      : dhcpv6r_get_ucast_entries_added
- * Responsiblity : Check for ucast entries added in dhcp relay table
- * Parameters    : rec - DHCP-Relay OVSDB table record
- *                 intfNode - Interface entry
- * Return        : none
- */
 
-void dhcpv6r_get_ucast_entries_added(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                        const struct ovsrec_dhcp_relay *rec)
-{
-    char *ipv6_address = NULL;
-    int iter = 0, iter1 = 0;
-    bool found;
-
-    for (iter = 0; iter < rec->n_ipv6_ucast_server; iter++) {
-        found = false;
-        for (iter1 = 0; iter1 < intfNode->addrCount; iter1++) {
-            ipv6_address = intfNode->serverArray[iter1]->ipv6_address;
-            if (compare_server
-                (ipv6_address, rec->ipv6_ucast_server[iter], NULL, NULL))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (false == found) {
-            if (!dhcpv6r_store_address(intfNode, rec->ipv6_ucast_server[iter], NULL))
-                VLOG_ERR("unicast ipv6 entry addition in local cache failed");
-        }
-    }
+    dhcpv6r_server_set_init(&none);
+    dhcpv6r_apply_server_delta(intf, &none, DHCPV6R_SCOPE_ALL);
+    dhcpv6r_server_set_destroy(&none);
 }
 
-#if 0 /* Code changes to be enabled once schema is pushed */
 /*
- * Function      : dhcpv6r_get_mcast_entries_added
- * Responsiblity : Check for mcast entries added in dhcp relay table
- * Parameters    : rec - DHCP-Relay OVSDB table record
- *                 intfNode - Interface entry
+ * Function      : dhcpv6r_handle_row_delete
+ * Responsiblity : Process delete event of a DHCP-Relay table record
+ * Parameters    : uuid - uuid of the deleted record
  * Return        : none
  */
-void dhcpv6r_get_mcast_entries_added(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
-                        const struct ovsrec_dhcp_relay *rec)
+void dhcpv6r_handle_row_delete(const struct uuid *uuid)
 {
-    char *outIfName = NULL, *ipv6_address = NULL, *egressIfName = NULL;
-    bool found;
-    const struct smap_node *smap_node = NULL;
-    int iter = 0;
+    struct relay_row_ref *ref;
 
-    SMAP_FOR_EACH(smap_node, &rec->ipv6_mcast_server) {
-        found = false;
-        if (smap_node->key)
-        {
-            /* get the first egressifName */
-            outIfName = strtok(smap_node->value, " ");
-            while(outIfName != NULL) {
-                for (iter = 0; iter < intfNode->addrCount; iter++) {
-                    ipv6_address = intfNode->serverArray[iter]->ipv6_address;
-                    egressIfName = intfNode->serverArray[iter]->egressIfName;
-                    if (compare_server
-                        (ipv6_address, smap_node->key, egressIfName, outIfName))
-                    {
-                        found = true;
-                        break;
-                    }
-                }
-                if (false == found) {
-                    if (!dhcpv6r_store_address(intfNode, smap_node->key, outIfName))
-                    VLOG_ERR("multicast ipv6 entry addition in local cache failed");
-
-                }
-                outIfName = strtok(NULL, " ");
-            }
-        }
+    ref = relay_row_map_find(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows, uuid);
+    if (NULL == ref) {
+        return;
     }
+
+    dhcpv6r_flush_interface(ref->portName);
+    relay_row_map_remove(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows, ref);
+    return;
 }
 
+#if 0 /* Code changes to be enabled once schema is pushed */
 /*
- * Function      : dhcpv6r_flush_removed_mcast_entries
- * Responsiblity : Check for mcast entries deleted in dhcp relay table
- *                 and remove from local cache
- * Parameters    : rec - DHCP-Relay OVSDB table record
- *                 intfNode - Interface entry
+ * Function      : dhcpv6r_server_set_add_mcast
+ * Responsiblity : Add the multicast servers of a DHCP-Relay record to a
+ *                 server set
+ * Parameters    : set - server set
+ *                 rec - DHCP-Relay OVSDB table record
  * Return        : none
  */
-void dhcpv6r_flush_removed_mcast_entries(DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
+static void dhcpv6r_server_set_add_mcast(struct dhcpv6r_server_set *set,
                         const struct ovsrec_dhcp_relay *rec)
 {
-    char *outIfName = NULL, *ipv6_address = NULL, *egressIfName = NULL;
-    bool found;
     const struct smap_node *smap_node = NULL;
-    int size = 0, iter = 0, iter1 = 0;
-    DHCPV6_RELAY_SERVER_T tempServers[MAX_SERVERS_PER_INTERFACE];
+    char *outIfNames, *outIfName, *savePtr = NULL;
 
-    memset(&tempServers, 0, sizeof(struct DHCPV6_RELAY_SERVER_T));
-    /* collect all the values from ovsdb */
     SMAP_FOR_EACH(smap_node, &rec->ipv6_mcast_server) {
-    if (smap_node->key)
-        /* get the first egressifName */
-        outIfName = strtok(smap_node->value, " ");
-        while(outIfName != NULL) {
-            tempServers[size].ipv6_address = xstrdup(smap_node->key);
-            tempServers[size].egressIfName = xstrdup(outIfName);
-            size++;
-            outIfName = strtok(NULL, " ");
-        }
-    }
-
-    /* Collect the mcast servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++) {
-        found = false;
-        ipv6_address = intfNode->serverArray[iter]->ipv6_address;
-        egressIfName = intfNode->serverArray[iter]->egressIfName;
-        for (iter1 = 0; iter1 < size; iter1++) {
-            if (compare_server(ipv6_address, tempServers[iter1].ipv6_address,
-                egressIfName, tempServers[iter1].egressIfName))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (false == found) {
-            if(!dhcpv6r_remove_address(intfNode, ipv6_address, egressIfName))
-                VLOG_ERR("multicast ipv6 entry deletion in local cache failed");
+        /* The value holds the space separated egress interface names */
+        outIfNames = xstrdup(smap_node->value);
+        for (outIfName = strtok_r(outIfNames, " ", &savePtr);
+             outIfName != NULL;
+             outIfName = strtok_r(NULL, " ", &savePtr)) {
+            dhcpv6r_server_set_add(set, smap_node->key, outIfName);
         }
+        free(outIfNames);
     }
 }
 #endif
+
 /*
  * Function      : dhcpv6_relay_handle_config_change
  * Responsiblity : Handle a record change in DHCP-Relay table
@@ -623,15 +664,38 @@ void dhcpv6r_handle_config_change(
     char *portName = NULL;
     struct shash_node *node;
     DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    struct dhcpv6r_server_set servers;
+    struct relay_row_ref *ref;
+    bool fresh;
+    int scope = 0;
+    size_t iter;
 
-    if ((NULL == rec) ||
-        (NULL == rec->port) ||
+    if (NULL == rec) {
+        return;
+    }
+
+    ref = relay_row_map_find(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows,
+                             &rec->header_.uuid);
+    if ((NULL == rec->port) ||
         (NULL == rec->vrf)) {
+        /* The record no longer configures an interface */
+        if (ref) {
+            dhcpv6r_flush_interface(ref->portName);
+            relay_row_map_remove(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows, ref);
+        }
         return;
     }
 
     portName = rec->port->name;
 
+    /* A record moved to another interface is applied there in full */
+    fresh = (NULL == ref) || strcmp(ref->portName, portName);
+    if (ref && fresh) {
+        dhcpv6r_flush_interface(ref->portName);
+    }
+    relay_row_map_set(&dhcpv6_relay_ctrl_cb_p->dhcpRelayRows,
+                      &rec->header_.uuid, portName, 0);
+
     /* Do lookup for the interface entry in hash table */
     node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable, portName);
     if (NULL == node) {
@@ -644,6 +708,12 @@ void dhcpv6r_handle_config_change(
     else
     {
         intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
+
+        /* The kernel interface may show up after the configuration */
+        if (0 == intfNode->ifIndex) {
+            intfNode->ifIndex = if_nametoindex(portName);
+            dhcpv6r_update_mcast_membership(intfNode, true);
+        }
     }
 /* FIXME: This will be removed after the schema changes got merged. */
 
@@ -658,20 +728,171 @@ void dhcpv6r_handle_config_change(
     }
 #endif
 
-    if (OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv6_ucast_server,
+    /* Both columns are diffed together, so that the entry is only freed
+     * once the last server of either kind is gone */
+    dhcpv6r_server_set_init(&servers);
+    if (fresh
+        || OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv6_ucast_server,
                                idl_seqno)) {
-        dhcpv6r_get_ucast_entries_added(intfNode, rec);
-        dhcpv6r_flush_removed_ucast_entries(intfNode, rec);
+        for (iter = 0; iter < rec->n_ipv6_ucast_server; iter++) {
+            dhcpv6r_server_set_add(&servers, rec->ipv6_ucast_server[iter],
+                                   NULL);
+        }
+        scope |= DHCPV6R_SCOPE_UCAST;
     }
 
 #if 0 /* Code changes to be enabled once schema is pushed */
-    if (OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv6_mcast_server,
+    if (fresh
+        || OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv6_mcast_server,
                            idl_seqno)) {
-        dhcpv6r_get_mcast_entries_added(intfNode, rec);
-        dhcpv6r_flush_removed_mcast_entries(intfNode, rec);
+        dhcpv6r_server_set_add_mcast(&servers, rec);
+        scope |= DHCPV6R_SCOPE_MCAST;
     }
 #endif
+
+    if (0 != scope) {
+        dhcpv6r_apply_server_delta(intfNode, &servers, scope);
+    }
+    dhcpv6r_server_set_destroy(&servers);
     return;
 }
 
+/*
+ * Function      : dhcpv6r_netlink_event
+ * Responsiblity : Track the kernel index of the configured interfaces, so
+ *                 that an interface created or recreated after the
+ *                 configuration starts relaying without waiting for the
+ *                 next configuration change.
+ * Parameters    : event - kernel interface event
+ *                 aux - unused
+ * Return        : none
+ */
+void dhcpv6r_netlink_event(const struct relay_netlink_event *event,
+                           void *aux OVS_UNUSED)
+{
+    DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    struct shash_node *node = NULL;
+    uint32_t ifIndex;
+
+    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+    SHASH_FOR_EACH (node, &dhcpv6_relay_ctrl_cb_p->intfHashTable) {
+        intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
+
+        switch (event->type) {
+        case RELAY_NETLINK_LINK_NEW:
+            if (strcmp(event->ifName, intfNode->portName)) {
+                continue;
+            }
+            ifIndex = event->ifIndex;
+            break;
+
+        case RELAY_NETLINK_LINK_DEL:
+            if (event->ifIndex != intfNode->ifIndex) {
+                continue;
+            }
+            /* The kernel dropped the group membership with the link */
+            ifIndex = 0;
+            break;
+
+        case RELAY_NETLINK_RESYNC:
+            ifIndex = if_nametoindex(intfNode->portName);
+            break;
+
+        default:
+            continue;
+        }
+
+        if (ifIndex != intfNode->ifIndex) {
+            VLOG_INFO("Interface %s index changed from %u to %u",
+                      intfNode->portName, intfNode->ifIndex, ifIndex);
+            intfNode->ifIndex = ifIndex;
+            dhcpv6r_update_mcast_membership(intfNode, true);
+        }
+    }
+    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+}
+
+/*
+ * Function      : dhcpv6r_restore_interface
+ * Responsiblity : Recreate an interface entry and its servers from a warm
+ *                 restart snapshot. Multicast servers whose outgoing
+ *                 interface does not exist any more are skipped.
+ * Parameters    : rec - interface snapshot record
+ * Return        : none
+ */
+void dhcpv6r_restore_interface(const DHCPV6R_SNAPSHOT_INTF *rec)
+{
+    DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    const DHCPV6R_SNAPSHOT_SERVER *server;
+    struct dhcpv6r_server_set servers;
+    DHCPV6_RELAY_SERVER_KEY key;
+    char portName[RELAY_SNAPSHOT_NAME_LEN];
+    char egressIfName[IF_NAMESIZE];
+    uint32_t iter;
+
+    ovs_strzcpy(portName, rec->portName, sizeof portName);
+    if (('\0' == portName[0])
+        || (NULL != shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable,
+                               portName))) {
+        return;
+    }
+
+    dhcpv6r_server_set_init(&servers);
+    for (iter = 0; iter < rec->n_servers; iter++) {
+        server = &rec->servers[iter];
+        memset(&key, 0, sizeof(key));
+        key.ipv6_address = server->ipv6_address;
+        ovs_strzcpy(egressIfName, server->egressIfName, sizeof egressIfName);
+        if ('\0' != egressIfName[0]) {
+            key.egressIfIndex = if_nametoindex(egressIfName);
+            if (0 == key.egressIfIndex) {
+                continue;
+            }
+        }
+        dhcpv6r_server_set_add_key(&servers, &key);
+    }
+
+    if (0 != servers.n) {
+        intfNode = dhcpv6r_create_intferface_node(portName);
+        if (NULL != intfNode) {
+            intfNode->dhcpv6_relay_pkt_counters =
+                                        rec->dhcpv6_relay_pkt_counters;
+            dhcpv6r_apply_server_delta(intfNode, &servers, DHCPV6R_SCOPE_ALL);
+            dhcpv6r_stats_publish(intfNode);
+        }
+    }
+    dhcpv6r_server_set_destroy(&servers);
+}
+
+/*
+ * Function      : dhcpv6r_reconcile_interfaces
+ * Responsiblity : Drop the restored interfaces which no DHCP-Relay record
+ *                 configures. Called once, after the first configuration
+ *                 walk following a snapshot restore.
+ * Parameters    : none
+ * Return        : none
+ */
+void dhcpv6r_reconcile_interfaces(void)
+{
+    struct shash_node *node = NULL, *next = NULL;
+    struct relay_row_ref *ref;
+    struct sset ports;
+    char *portName;
+
+    sset_init(&ports);
+    HMAP_FOR_EACH (ref, node, &dhcpv6_relay_ctrl_cb_p->dhcpRelayRows.rows) {
+        sset_add(&ports, ref->portName);
+    }
+
+    SHASH_FOR_EACH_SAFE (node, next, &dhcpv6_relay_ctrl_cb_p->intfHashTable) {
+        if (!sset_contains(&ports, node->name)) {
+            /* The entry is freed by the flush */
+            portName = xstrdup(node->name);
+            dhcpv6r_flush_interface(portName);
+            free(portName);
+        }
+    }
+    sset_destroy(&ports);
+}
+
 #endif /* FTR_DHCPV6_RELAY */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: dhcpv6_relay_recv.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Receive DHCPv6 packets from clients, relay agents and servers.
+ * - Pass them on to the right handler.
+ */
+
+#include <time.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
+#include "util.h"
+#include "dhcpv6_relay.h"
+
+VLOG_DEFINE_THIS_MODULE(dhcpv6_relay_recv);
+
+#ifdef FTR_DHCPV6_RELAY
+
+/*
+ * Function      : dhcpv6r_ctrl
+ * Responsiblity : Depending on the message type, relay the packet towards
+ *                 the servers or back to the client.
+ * Parameters    : pkt - DHCPv6 message
+ *                 size - size of the message
+ *                 txbuff - buffer to build a Relay-Forward header into
+ *                 src - source address of the message
+ *                 pktInfo - receiving interface
+ * Return        : none
+ */
+static void dhcpv6r_ctrl(uint8_t *pkt, int32_t size, uint8_t *txbuff,
+                         const struct sockaddr_in6 *src,
+                         const struct in6_pktinfo *pktInfo)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+
+    if (size < 1) {
+        return;
+    }
+
+    switch (pkt[0]) {
+    case DHCPV6_SOLICIT:
+    case DHCPV6_REQUEST:
+    case DHCPV6_CONFIRM:
+    case DHCPV6_RENEW:
+    case DHCPV6_REBIND:
+    case DHCPV6_RELEASE:
+    case DHCPV6_DECLINE:
+    case DHCPV6_INFORMATION_REQUEST:
+    case DHCPV6_RELAY_FORW:
+        /* Client message or message from a downstream relay agent */
+        dhcpv6r_relay_to_server(pkt, size, txbuff, src, pktInfo);
+        break;
+
+    case DHCPV6_RELAY_REPL:
+        dhcpv6r_relay_to_client(pkt, size, src, pktInfo);
+        break;
+
+    default:
+        VLOG_DBG_RL(&rl, "Ignoring DHCPv6 message type %d", pkt[0]);
+        break;
+    }
+}
+
+/*
+ * Function      : dhcpv6r_packet_recv
+ * Responsiblity : Reactor handler of the DHCPv6 server port. Queued
+ *                 packets are read and relayed in batches until the socket
+ *                 is empty or the budget is used.
+ * Parameters    : aux - unused
+ *                 budget - maximum number of packets to read
+ * Return        : true, to keep receiving on the socket
+ */
+bool dhcpv6r_packet_recv(void *aux OVS_UNUSED, int budget)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    struct mmsghdr msgs[DHCPV6_RELAY_BATCH_SIZE];
+    struct iovec iov[DHCPV6_RELAY_BATCH_SIZE];
+    struct sockaddr_in6 src[DHCPV6_RELAY_BATCH_SIZE];
+    union control6_u ctrl[DHCPV6_RELAY_BATCH_SIZE];
+    struct in6_pktinfo *pktInfo;
+    struct cmsghdr *cmptr;
+    struct timespec start, end;
+    uint8_t *txbuff;
+    int32_t count, iter;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (iter = 0; iter < DHCPV6_RELAY_BATCH_SIZE; iter++) {
+        iov[iter].iov_base = dhcpv6_relay_ctrl_cb_p->rcvbuff
+                             + iter * DHCPV6_RECV_BUFFER_SIZE;
+        iov[iter].iov_len = DHCPV6_RECV_BUFFER_SIZE;
+        msgs[iter].msg_hdr.msg_iov = &iov[iter];
+        msgs[iter].msg_hdr.msg_iovlen = 1;
+        msgs[iter].msg_hdr.msg_name = &src[iter];
+        msgs[iter].msg_hdr.msg_control = ctrl[iter].control;
+    }
+
+    while (0 < budget)
+    {
+        /* recvmmsg updates the lengths, restore them for every batch */
+        for (iter = 0; iter < DHCPV6_RELAY_BATCH_SIZE; iter++) {
+            msgs[iter].msg_hdr.msg_namelen = sizeof(src[iter]);
+            msgs[iter].msg_hdr.msg_controllen = sizeof(ctrl[iter]);
+        }
+
+        count = recvmmsg(dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd, msgs,
+                         MIN(budget, DHCPV6_RELAY_BATCH_SIZE),
+                         MSG_DONTWAIT, NULL);
+        if (count < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN != errno) {
+                VLOG_ERR_RL(&rl, "Failed to recvmmsg, errno : %d", errno);
+            }
+            return true;
+        }
+        budget -= count;
+
+        if (!dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_enable) {
+            continue;
+        }
+
+        for (iter = 0; iter < count; iter++) {
+            pktInfo = NULL;
+            for (cmptr = CMSG_FIRSTHDR(&msgs[iter].msg_hdr); cmptr;
+                 cmptr = CMSG_NXTHDR(&msgs[iter].msg_hdr, cmptr)) {
+                if (cmptr->cmsg_level == IPPROTO_IPV6
+                    && cmptr->cmsg_type == IPV6_PKTINFO) {
+                    pktInfo = (struct in6_pktinfo *)CMSG_DATA(cmptr);
+                    break;
+                }
+            }
+
+            if (NULL == pktInfo) {
+                VLOG_ERR("Received packet input interface is invalid");
+                continue;
+            }
+
+            txbuff = (uint8_t *)dhcpv6_relay_ctrl_cb_p->txbuff
+                     + iter * DHCPV6_RELAY_HEADROOM;
+
+            /* process the dhcpv6 packet */
+            if (relay_stats_enabled()) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                dhcpv6r_ctrl(iov[iter].iov_base, msgs[iter].msg_len, txbuff,
+                             &src[iter], pktInfo);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                relay_stats_record_packet(RELAY_STATS_KIND_DHCPV6R,
+                            (end.tv_sec - start.tv_sec) * 1000000000LL
+                            + (end.tv_nsec - start.tv_nsec));
+            } else {
+                dhcpv6r_ctrl(iov[iter].iov_base, msgs[iter].msg_len, txbuff,
+                             &src[iter], pktInfo);
+            }
+        }
+
+        /* Send everything relayed from this batch at once. Queued packets
+         * point into the receive buffers, so this must happen before the
+         * next recvmmsg. */
+        dhcpv6r_flush_tx_batch();
+    }
+    return true;
+}
+#endif /* FTR_DHCPV6_RELAY */
@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: dhcpv6_relay_xmit.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Encapsulate client messages into Relay-Forward messages and send them
+ *   to the configured servers.
+ * - Decapsulate Relay-Reply messages from the configured servers and send
+ *   them back to the client.
+ * - Batch transmissions into a single sendmmsg call. Relayed messages are
+ *   not copied, they are sent from the receive buffer.
+ */
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <sys/socket.h>
+#include <net/if.h>
+
+#include "dhcpv6_relay.h"
+
+VLOG_DEFINE_THIS_MODULE(dhcpv6_relay_xmit);
+
+#ifdef FTR_DHCPV6_RELAY
+
+/*
+ * Function      : dhcpv6r_queue_packet
+ * Responsiblity : Queue a packet for the next sendmmsg call. The UDP
+ *                 payload is the header followed by the data. Neither is
+ *                 copied, they must stay valid until the batch is flushed.
+ * Parameters    : hdr - start of the payload, NULL if there is none
+ *                 hdrLen - header length
+ *                 buf - rest of the payload
+ *                 len - length of the rest of the payload
+ *                 dst - destination address
+ *                 port - destination UDP port
+ *                 ifIndex - outgoing interface, 0 to let the kernel choose
+ * Return        : none
+ */
+static void dhcpv6r_queue_packet(const void *hdr, size_t hdrLen,
+                                 const void *buf, size_t len,
+                                 const struct in6_addr *dst, uint16_t port,
+                                 uint32_t ifIndex)
+{
+    DHCPV6_RELAY_TX_BATCH *batch = &dhcpv6_relay_ctrl_cb_p->tx_batch;
+    struct msghdr *msg;
+    struct cmsghdr *cmsg;
+    struct in6_pktinfo *pktInfo;
+    struct iovec *iov;
+    uint32_t index;
+
+    if (DHCPV6_RELAY_TX_BATCH_SIZE == batch->count) {
+        dhcpv6r_flush_tx_batch();
+    }
+
+    index = batch->count++;
+
+    memset(&batch->dest[index], 0, sizeof(batch->dest[index]));
+    batch->dest[index].sin6_family = AF_INET6;
+    batch->dest[index].sin6_port = htons(port);
+    batch->dest[index].sin6_addr = *dst;
+    if (IN6_IS_ADDR_LINKLOCAL(dst) || IN6_IS_ADDR_MC_LINKLOCAL(dst)) {
+        batch->dest[index].sin6_scope_id = ifIndex;
+    }
+
+    msg = &batch->msgs[index].msg_hdr;
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_name = &batch->dest[index];
+    msg->msg_namelen = sizeof(batch->dest[index]);
+    msg->msg_iov = batch->iov[index];
+
+    iov = batch->iov[index];
+    if (hdr) {
+        iov->iov_base = (void *)hdr;
+        iov->iov_len = hdrLen;
+        iov++;
+    }
+    iov->iov_base = (void *)buf;
+    iov->iov_len = len;
+    msg->msg_iovlen = iov - batch->iov[index] + 1;
+
+    if (ifIndex) {
+        /* Pin the outgoing interface, the source address is left to
+         * the kernel */
+        msg->msg_control = batch->ctrl[index].control;
+        msg->msg_controllen = sizeof(batch->ctrl[index].control);
+        cmsg = CMSG_FIRSTHDR(msg);
+        cmsg->cmsg_level = IPPROTO_IPV6;
+        cmsg->cmsg_type = IPV6_PKTINFO;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+        pktInfo = (struct in6_pktinfo *)CMSG_DATA(cmsg);
+        memset(pktInfo, 0, sizeof(*pktInfo));
+        pktInfo->ipi6_ifindex = ifIndex;
+    }
+}
+
+/*
+ * Function      : dhcpv6r_flush_tx_batch
+ * Responsiblity : Send all queued packets. A packet the kernel refuses is
+ *                 dropped and the rest of the batch is still sent.
+ * Parameters    : none
+ * Return        : none
+ */
+void dhcpv6r_flush_tx_batch(void)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    DHCPV6_RELAY_TX_BATCH *batch = &dhcpv6_relay_ctrl_cb_p->tx_batch;
+    char addr[INET6_ADDRSTRLEN];
+    uint32_t sent = 0;
+    int retVal;
+
+    while (sent < batch->count) {
+        retVal = sendmmsg(dhcpv6_relay_ctrl_cb_p->dhcpv6_relaySockFd,
+                          &batch->msgs[sent], batch->count - sent, 0);
+        if (retVal < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            VLOG_ERR_RL(&rl, "Failed to send DHCPv6 packet to %s, "
+                        "errno : %d",
+                        inet_ntop(AF_INET6, &batch->dest[sent].sin6_addr,
+                                  addr, sizeof(addr)), errno);
+            /* Skip the failed packet */
+            sent++;
+            continue;
+        }
+        sent += retVal;
+    }
+
+    batch->count = 0;
+}
+
+/*
+ * Function      : dhcpv6r_find_option
+ * Responsiblity : Find an option in a DHCPv6 option area.
+ * Parameters    : opts - start of the options
+ *                 len - length of the option area
+ *                 code - option code
+ *                 optLen - length of the option data, when found
+ * Return        : pointer to the option data, NULL if not found or the
+ *                 option area is malformed
+ */
+static const uint8_t *dhcpv6r_find_option(const uint8_t *opts, int32_t len,
+                                          uint16_t code, uint16_t *optLen)
+{
+    struct dhcpv6_option_hdr opt;
+
+    while (len >= (int32_t)DHCPV6_OPTION_HDR_LEN) {
+        memcpy(&opt, opts, DHCPV6_OPTION_HDR_LEN);
+        opts += DHCPV6_OPTION_HDR_LEN;
+        len -= DHCPV6_OPTION_HDR_LEN;
+        if (ntohs(opt.len) > len) {
+            return NULL;
+        }
+
+        if (ntohs(opt.code) == code) {
+            *optLen = ntohs(opt.len);
+            return opts;
+        }
+
+        opts += ntohs(opt.len);
+        len -= ntohs(opt.len);
+    }
+
+    return NULL;
+}
+
+/*
+ * Function      : dhcpv6r_put_option_hdr
+ * Responsiblity : Append an option header to a message being built.
+ * Parameters    : buf - position to write the option header at
+ *                 code - option code
+ *                 len - option data length
+ * Return        : position after the option header
+ */
+static uint8_t *dhcpv6r_put_option_hdr(uint8_t *buf, uint16_t code,
+                                       uint16_t len)
+{
+    struct dhcpv6_option_hdr opt;
+
+    opt.code = htons(code);
+    opt.len = htons(len);
+    memcpy(buf, &opt, DHCPV6_OPTION_HDR_LEN);
+    return buf + DHCPV6_OPTION_HDR_LEN;
+}
+
+/*
+ * Function      : dhcpv6r_put_option
+ * Responsiblity : Append an option to a message being built.
+ * Parameters    : buf - position to write the option at
+ *                 code - option code
+ *                 data - option data
+ *                 len - option data length
+ * Return        : position after the option
+ */
+static uint8_t *dhcpv6r_put_option(uint8_t *buf, uint16_t code,
+                                   const void *data, uint16_t len)
+{
+    buf = dhcpv6r_put_option_hdr(buf, code, len);
+    memcpy(buf, data, len);
+    return buf + len;
+}
+
+/*
+ * Function      : dhcpv6r_is_server
+ * Responsiblity : Check that a Relay-Reply comes from a server of the
+ *                 interface it is relayed to. Replies to a multicast
+ *                 server come from the unicast address of the server
+ *                 that answered, so any source on the egress interface of
+ *                 such a server is accepted.
+ * Parameters    : intfNode - Interface entry named by the Relay-Reply
+ *                 src - source of the Relay-Reply
+ *                 ifIndex - interface the Relay-Reply was received on
+ * Return        : true - if the source is a server of the interface
+ *                 false - otherwise
+ */
+static bool dhcpv6r_is_server(const DHCPV6_RELAY_INTERFACE_NODE_T *intfNode,
+                              const struct in6_addr *src, uint32_t ifIndex)
+{
+    const DHCPV6_RELAY_SERVER_T *server;
+    int32_t iter;
+
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        server = intfNode->serverArray[iter];
+        if (IN6_IS_ADDR_MULTICAST(&server->key.ipv6_address)) {
+            if (server->key.egressIfIndex == ifIndex) {
+                return true;
+            }
+        } else if (IN6_ARE_ADDR_EQUAL(&server->key.ipv6_address, src)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Function      : dhcpv6r_get_link_address
+ * Responsiblity : Get a global or site scoped address of an interface, to
+ *                 be used as link-address of a Relay-Forward message.
+ * Parameters    : ifName - interface name
+ *                 addr - address found, unspecified if none
+ * Return        : none
+ */
+static void dhcpv6r_get_link_address(const char *ifName,
+                                     struct in6_addr *addr)
+{
+    struct ifaddrs *ifaddr, *ifa;
+    const struct in6_addr *ip6;
+
+    *addr = in6addr_any;
+    if (getifaddrs(&ifaddr) < 0) {
+        return;
+    }
+
+    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || (ifa->ifa_addr->sa_family != AF_INET6)
+            || strncmp(ifName, ifa->ifa_name, IF_NAMESIZE)) {
+            continue;
+        }
+
+        ip6 = &((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr;
+        if (!IN6_IS_ADDR_LINKLOCAL(ip6) && !IN6_IS_ADDR_LOOPBACK(ip6)) {
+            *addr = *ip6;
+            break;
+        }
+    }
+
+    freeifaddrs(ifaddr);
+}
+
+/*
+ * Function      : dhcpv6r_get_client_mac
+ * Responsiblity : Recover the client MAC address from an EUI-64 based
+ *                 link-local source address (RFC 4291, appendix A).
+ * Parameters    : addr - client source address
+ *                 mac - MAC address, when found
+ * Return        : true - if the address is EUI-64 based
+ *                 false - otherwise
+ */
+static bool dhcpv6r_get_client_mac(const struct in6_addr *addr, uint8_t *mac)
+{
+    const uint8_t *bytes = addr->s6_addr;
+
+    if (!IN6_IS_ADDR_LINKLOCAL(addr)
+        || (0xff != bytes[11]) || (0xfe != bytes[12])) {
+        return false;
+    }
+
+    mac[0] = bytes[8] ^ 0x02;
+    mac[1] = bytes[9];
+    mac[2] = bytes[10];
+    mac[3] = bytes[13];
+    mac[4] = bytes[14];
+    mac[5] = bytes[15];
+    return true;
+}
+
+/*
+ * Function      : dhcpv6r_relay_to_server
+ * Responsiblity : Encapsulate a client (or downstream relay) message into a
+ *                 Relay-Forward message and send it to every server
+ *                 configured on the receiving interface. The message is
+ *                 not copied: the Relay-Forward header is built in txbuff
+ *                 and sent together with the message in the receive
+ *                 buffer.
+ * Parameters    : pkt - received DHCPv6 message
+ *                 size - message size
+ *                 txbuff - buffer to build the Relay-Forward header into,
+ *                          DHCPV6_RELAY_HEADROOM bytes long
+ *                 src - source of the message
+ *                 pktInfo - receiving interface
+ * Return        : none
+ */
+void dhcpv6r_relay_to_server(uint8_t *pkt, int32_t size, uint8_t *txbuff,
+                             const struct sockaddr_in6 *src,
+                             const struct in6_pktinfo *pktInfo)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    DHCPV6_RELAY_SERVER_T *server;
+    struct dhcpv6_relay_hdr hdr;
+    struct shash_node *node;
+    char ifName[IF_NAMESIZE];
+    uint8_t linkLayer[2 + ETH_ALEN];
+    uint8_t *pos;
+    struct in6_addr linkAddress = in6addr_any;
+    int32_t iter, queued = 0;
+
+    if (NULL == if_indextoname(pktInfo->ipi6_ifindex, ifName)) {
+        VLOG_ERR_RL(&rl, "Failed to convert ifindex to ifname : %d",
+                    pktInfo->ipi6_ifindex);
+        return;
+    }
+
+    if (DHCPV6_RELAY_FORW != pkt[0]) {
+        /* Client message, identify the link by an address of the
+         * receiving interface */
+        dhcpv6r_get_link_address(ifName, &linkAddress);
+    }
+
+    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+
+    node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable, ifName);
+    if (NULL == node) {
+        /* DHCPv6 relay is not configured on this interface */
+        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+        return;
+    }
+    intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_type = DHCPV6_RELAY_FORW;
+    hdr.link_address = linkAddress;
+    hdr.peer_address = src->sin6_addr;
+
+    if (DHCPV6_RELAY_FORW == pkt[0]) {
+        /* Message from a downstream relay agent */
+        if ((size < (int32_t)DHCPV6_RELAY_HDR_LEN)
+            || (pkt[1] >= DHCPV6_HOP_COUNT_LIMIT)) {
+            VLOG_DBG_RL(&rl, "Dropping Relay-Forward on %s, size : %d, "
+                        "hop count : %d", ifName, size,
+                        (size > 1) ? pkt[1] : 0);
+            INC_DHCPV6R_CLIENT_DROPS(intfNode);
+            sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+            return;
+        }
+        hdr.hop_count = pkt[1] + 1;
+    }
+
+    /* Build the Relay-Forward message */
+    memcpy(txbuff, &hdr, DHCPV6_RELAY_HDR_LEN);
+    pos = txbuff + DHCPV6_RELAY_HDR_LEN;
+
+    /* Interface-Id lets the Relay-Reply find its way back */
+    pos = dhcpv6r_put_option(pos, DHCPV6_OPTION_INTERFACE_ID,
+                             intfNode->portName,
+                             strnlen(intfNode->portName, IF_NAMESIZE));
+
+    if (dhcpv6_relay_ctrl_cb_p->dhcpv6_relay_option79_enable
+        && (DHCPV6_RELAY_FORW != pkt[0])
+        && dhcpv6r_get_client_mac(&src->sin6_addr, linkLayer + 2)) {
+        linkLayer[0] = 0;
+        linkLayer[1] = DHCPV6_LINKLAYER_ETHERNET;
+        pos = dhcpv6r_put_option(pos, DHCPV6_OPTION_CLIENT_LINKLAYER_ADDR,
+                                 linkLayer, sizeof(linkLayer));
+    }
+
+    /* The Relay Message option data is the message itself */
+    pos = dhcpv6r_put_option_hdr(pos, DHCPV6_OPTION_RELAY_MSG, size);
+
+    /* Fan out to all servers of the interface */
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        server = intfNode->serverArray[iter];
+        dhcpv6r_queue_packet(txbuff, pos - txbuff, pkt, size,
+                             &server->key.ipv6_address,
+                             DHCPV6_SERVER_PORT, server->key.egressIfIndex);
+        queued++;
+    }
+
+    if (queued) {
+        INC_DHCPV6R_CLIENT_SENT(intfNode);
+    } else {
+        INC_DHCPV6R_CLIENT_DROPS(intfNode);
+    }
+
+    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+}
+
+/*
+ * Function      : dhcpv6r_relay_to_client
+ * Responsiblity : Decapsulate a Relay-Reply message and send the inner
+ *                 message to the peer on the interface named by the
+ *                 Interface-Id option. Only Relay-Reply messages from a
+ *                 server of that interface are relayed.
+ * Parameters    : pkt - received Relay-Reply message
+ *                 size - message size
+ *                 src - source of the message
+ *                 pktInfo - receiving interface
+ * Return        : none
+ */
+void dhcpv6r_relay_to_client(uint8_t *pkt, int32_t size,
+                             const struct sockaddr_in6 *src,
+                             const struct in6_pktinfo *pktInfo)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    DHCPV6_RELAY_INTERFACE_NODE_T *intfNode = NULL;
+    struct dhcpv6_relay_hdr hdr;
+    struct shash_node *node;
+    struct in6_addr peerAddress;
+    const uint8_t *ifId, *relayMsg;
+    uint16_t ifIdLen = 0, relayMsgLen = 0;
+    char ifName[IF_NAMESIZE];
+    char addr[INET6_ADDRSTRLEN];
+
+    if (size < (int32_t)DHCPV6_RELAY_HDR_LEN) {
+        VLOG_DBG_RL(&rl, "Dropping short Relay-Reply from %s",
+                    inet_ntop(AF_INET6, &src->sin6_addr, addr,
+                              sizeof(addr)));
+        return;
+    }
+
+    memcpy(&hdr, pkt, DHCPV6_RELAY_HDR_LEN);
+    ifId = dhcpv6r_find_option(pkt + DHCPV6_RELAY_HDR_LEN,
+                               size - DHCPV6_RELAY_HDR_LEN,
+                               DHCPV6_OPTION_INTERFACE_ID, &ifIdLen);
+    if ((NULL == ifId) || (0 == ifIdLen) || (ifIdLen >= IF_NAMESIZE)) {
+        VLOG_DBG_RL(&rl, "Dropping Relay-Reply from %s without a valid "
+                    "Interface-Id", inet_ntop(AF_INET6, &src->sin6_addr,
+                                              addr, sizeof(addr)));
+        return;
+    }
+    memcpy(ifName, ifId, ifIdLen);
+    ifName[ifIdLen] = '\0';
+
+    sem_wait(&dhcpv6_relay_ctrl_cb_p->waitSem);
+
+    node = shash_find(&dhcpv6_relay_ctrl_cb_p->intfHashTable, ifName);
+    if (NULL == node) {
+        VLOG_DBG_RL(&rl, "Dropping Relay-Reply for unconfigured "
+                    "interface %s", ifName);
+        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+        return;
+    }
+    intfNode = (DHCPV6_RELAY_INTERFACE_NODE_T *)node->data;
+
+    if (!dhcpv6r_is_server(intfNode, &src->sin6_addr,
+                           pktInfo->ipi6_ifindex)) {
+        VLOG_DBG_RL(&rl, "Dropping Relay-Reply for %s from %s, which is "
+                    "not a configured server", ifName,
+                    inet_ntop(AF_INET6, &src->sin6_addr, addr,
+                              sizeof(addr)));
+        INC_DHCPV6R_SERVER_DROPS(intfNode);
+        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+        return;
+    }
+
+    relayMsg = dhcpv6r_find_option(pkt + DHCPV6_RELAY_HDR_LEN,
+                                   size - DHCPV6_RELAY_HDR_LEN,
+                                   DHCPV6_OPTION_RELAY_MSG, &relayMsgLen);
+    if ((NULL == relayMsg) || (0 == relayMsgLen)
+        || (0 == intfNode->ifIndex)) {
+        INC_DHCPV6R_SERVER_DROPS(intfNode);
+        sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+        return;
+    }
+
+    /* A nested Relay-Reply goes to the downstream relay agent */
+    peerAddress = hdr.peer_address;
+    dhcpv6r_queue_packet(NULL, 0, relayMsg, relayMsgLen, &peerAddress,
+                         (DHCPV6_RELAY_REPL == relayMsg[0])
+                         ? DHCPV6_SERVER_PORT : DHCPV6_CLIENT_PORT,
+                         intfNode->ifIndex);
+    INC_DHCPV6R_SERVER_SENT(intfNode);
+
+    sem_post(&dhcpv6_relay_ctrl_cb_p->waitSem);
+}
+#endif /* FTR_DHCPV6_RELAY */
@@ -36,6 +36,7 @@
 
 #include <stdio.h>
 #include <netinet/in.h>
+#include <netinet/ip6.h>
 #include <netinet/if_ether.h>
 #include <string.h>
 #include <stdlib.h>
@@ -47,6 +48,11 @@
 #include <unistd.h>
 #include <net/if.h>
 #include <assert.h>
+#include "relay_stats.h"
+#include "relay_netlink.h"
+#include "relay_rowmap.h"
+#include "relay_snapshot.h"
+#include "relay_reactor.h"
 
 
 #ifdef FTR_DHCPV6_RELAY
@@ -59,63 +65,224 @@ typedef struct DHCPV6_RELAY_PKT_COUNTER
     uint32_t    serv_valids; /* number of valid server responses */
 } DHCPV6_RELAY_PKT_COUNTER;
 
+/* Maximum number of entries allowed per INTERFACE. */
+#define MAX_SERVERS_PER_INTERFACE 8
+
+/* DHCPv6 UDP port numbers */
+#define DHCPV6_CLIENT_PORT   546
+#define DHCPV6_SERVER_PORT   547
+
+/* DHCPv6 message types (RFC 3315) */
+#define DHCPV6_SOLICIT              1
+#define DHCPV6_ADVERTISE            2
+#define DHCPV6_REQUEST              3
+#define DHCPV6_CONFIRM              4
+#define DHCPV6_RENEW                5
+#define DHCPV6_REBIND               6
+#define DHCPV6_REPLY                7
+#define DHCPV6_RELEASE              8
+#define DHCPV6_DECLINE              9
+#define DHCPV6_RECONFIGURE          10
+#define DHCPV6_INFORMATION_REQUEST  11
+#define DHCPV6_RELAY_FORW           12
+#define DHCPV6_RELAY_REPL           13
+
+/* DHCPv6 option codes used by the relay agent */
+#define DHCPV6_OPTION_RELAY_MSG              9
+#define DHCPV6_OPTION_INTERFACE_ID           18
+#define DHCPV6_OPTION_CLIENT_LINKLAYER_ADDR  79 /* RFC 6939 */
+
+#define DHCPV6_HOP_COUNT_LIMIT      32 /* RFC 3315 limit */
+#define DHCPV6_LINKLAYER_ETHERNET   1  /* hardware type of option 79 */
+#define DHCPV6_MCAST_HOP_LIMIT      32 /* hop limit for site scoped mcast */
+
+#define DHCPV6_RECV_BUFFER_SIZE     9228 /* Jumbo frame size */
+
+/* Room for the Relay-Forward header, the options added by the relay and
+ * the header of the Relay Message option. The relayed message itself is
+ * sent from the receive buffer. */
+#define DHCPV6_RELAY_HEADROOM       128
+
+/* Packets handled per recvmmsg/sendmmsg call */
+#define DHCPV6_RELAY_BATCH_SIZE     32
+
+/* Relay-Forward/Relay-Reply message header */
+struct dhcpv6_relay_hdr {
+    uint8_t msg_type;
+    uint8_t hop_count;
+    struct in6_addr link_address;
+    struct in6_addr peer_address;
+} __attribute__((packed));
+
+#define DHCPV6_RELAY_HDR_LEN     sizeof(struct dhcpv6_relay_hdr)
+
+/* DHCPv6 option header */
+struct dhcpv6_option_hdr {
+    uint16_t code;
+    uint16_t len;
+} __attribute__((packed));
+
+#define DHCPV6_OPTION_HDR_LEN    sizeof(struct dhcpv6_option_hdr)
+
+/* union to store IPv6 socket ancillary data */
+union control6_u {
+    struct cmsghdr align; /* this ensures alignment */
+    char control[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+};
+
+/* Packets queued for a single sendmmsg call. A Relay-Forward is queued
+ * once per destination server, all entries sharing the same header and
+ * payload. Each packet is sent from up to two buffers, a header built by
+ * the relay and a payload left in the receive buffer. */
+#define DHCPV6_RELAY_TX_BATCH_SIZE \
+            (DHCPV6_RELAY_BATCH_SIZE * MAX_SERVERS_PER_INTERFACE)
+
+typedef struct DHCPV6_RELAY_TX_BATCH
+{
+    uint32_t count; /* number of queued packets */
+    struct mmsghdr msgs[DHCPV6_RELAY_TX_BATCH_SIZE];
+    struct iovec iov[DHCPV6_RELAY_TX_BATCH_SIZE][2];
+    struct sockaddr_in6 dest[DHCPV6_RELAY_TX_BATCH_SIZE];
+    union control6_u ctrl[DHCPV6_RELAY_TX_BATCH_SIZE];
+} DHCPV6_RELAY_TX_BATCH;
+
 /* DHCPV6 Relay Control Block. */
 typedef struct DHCPV6_RELAY_CTRL_CB
 {
     int32_t dhcpv6_relaySockFd;    /* Socket to send/receive DHCP packets */
+    struct relay_reactor_source source; /* reactor registration of the
+                                           socket */
     sem_t waitSem;        /* Semaphore for concurrent access protection */
     bool dhcpv6_relay_enable; /* Flag to store dhcpv6-relay global status */
     bool dhcpv6_relay_option79_enable; /* Flag to store dhcpv6-relay option 79 status */
     struct shash intfHashTable; /* interface hash table handle */
     struct cmap serverHashMap;  /* server hash map handle */
-    char *rcvbuff; /* Buffer which is used to store ipv6 packet */
+    char *rcvbuff; /* Buffers which are used to store ipv6 packets, one
+                      per batch entry */
+    char *txbuff;  /* Buffers used to build Relay-Forward headers, one
+                      per batch entry */
     int32_t stats_interval;    /* statistics refresh interval */
     struct in6_addr agentIpv6Address; /* Store the DHCPv6 Relay Agents and Servers IPv6 address */
+    DHCPV6_RELAY_TX_BATCH tx_batch; /* Pending transmissions */
+    struct relay_row_map dhcpRelayRows; /* Applied DHCP_Relay records */
 } DHCPV6_RELAY_CTRL_CB;
 
+/* Server lookup key. Hashed and compared as raw bytes, so it must not
+ * contain padding. */
+typedef struct DHCPV6_RELAY_SERVER_KEY {
+  struct in6_addr ipv6_address; /* Server ipv6 address */
+  uint32_t egressIfIndex; /* Outgoing interface of a multicast server,
+                             0 for unicast servers */
+} DHCPV6_RELAY_SERVER_KEY;
+
 /* Server Address structure. */
 typedef struct DHCPV6_RELAY_SERVER_T {
   struct cmap_node cmap_node; /* cmap Node, used for hashing */
-  char* ipv6_address; /* Server ipv6 address */
+  DHCPV6_RELAY_SERVER_KEY key; /* Server address and outgoing interface */
   uint16_t   ref_count;  /* Counts how many interfaces are using the serverIP.
                             This field helps in deleting a server entry */
-  char *egressIfName; /* Name of outgoing interface */
 } DHCPV6_RELAY_SERVER_T;
 
 /* Interface Table Structure. */
 typedef struct DHCPV6_RELAY_INTERFACE_NODE_T
 {
   char  *portName; /* Name of the Interface */
+  uint32_t ifIndex; /* Kernel index of the Interface, 0 if unknown */
   uint8_t addrCount; /* Counts of configured servers */
   DHCPV6_RELAY_SERVER_T **serverArray; /* Pointer to the array server configs */
   DHCPV6_RELAY_PKT_COUNTER dhcpv6_relay_pkt_counters; /* Counts of dhcp-relay
                                                        statistics */
+  struct relay_stats_intf *stats; /* Shared memory statistics record */
 } DHCPV6_RELAY_INTERFACE_NODE_T;
 
 /*
  * Global variable declaration
  */
-extern DHCPV6_RELAY_CTRL_CB *dhcpv6_relay_ctrl_cb_p;
+/* Snapshot of a server of an interface. The outgoing interface is saved
+ * by name since kernel indexes do not survive an interface recreation. */
+typedef struct DHCPV6R_SNAPSHOT_SERVER {
+  struct in6_addr ipv6_address; /* Server ipv6 address */
+  char egressIfName[IF_NAMESIZE]; /* Outgoing interface of a multicast
+                                     server, empty for unicast servers */
+} DHCPV6R_SNAPSHOT_SERVER;
 
-/* Maximum number of entries allowed per INTERFACE. */
-#define MAX_SERVERS_PER_INTERFACE 8
+/* Snapshot of an interface, RELAY_SNAPSHOT_DHCPV6R_INTF section. The
+ * servers follow the fixed part. */
+typedef struct DHCPV6R_SNAPSHOT_INTF {
+  char portName[RELAY_SNAPSHOT_NAME_LEN]; /* Name of the Interface */
+  uint32_t n_servers; /* Number of servers */
+  DHCPV6_RELAY_PKT_COUNTER dhcpv6_relay_pkt_counters; /* dhcp-relay
+                                                       statistics */
+  DHCPV6R_SNAPSHOT_SERVER servers[];
+} DHCPV6R_SNAPSHOT_INTF;
+
+extern DHCPV6_RELAY_CTRL_CB *dhcpv6_relay_ctrl_cb_p;
 
-/* DHCPv6 multicast destination address */
+/* DHCPv6 multicast destination address. There is no implicit
+ * All_DHCP_Servers (FF05::1:3) destination: an interface only relays to
+ * its configured servers, which may include that group together with an
+ * egress interface. */
 #define DHCPV6_ALLAGENTS    "ff02::1:2"
-#define DHCPV6_ALLSERVERS   "FF05::1:3"
+
+/* Macros for dhcpv6-relay statistics counters */
+#define INC_DHCPV6R_CLIENT_DROPS(intfNode) \
+        do { \
+            intfNode->dhcpv6_relay_pkt_counters.client_drops++; \
+            dhcpv6r_stats_publish(intfNode); \
+        } while (0)
+#define INC_DHCPV6R_CLIENT_SENT(intfNode) \
+        do { \
+            intfNode->dhcpv6_relay_pkt_counters.client_valids++; \
+            dhcpv6r_stats_publish(intfNode); \
+        } while (0)
+#define INC_DHCPV6R_SERVER_DROPS(intfNode) \
+        do { \
+            intfNode->dhcpv6_relay_pkt_counters.serv_drops++; \
+            dhcpv6r_stats_publish(intfNode); \
+        } while (0)
+#define INC_DHCPV6R_SERVER_SENT(intfNode) \
+        do { \
+            intfNode->dhcpv6_relay_pkt_counters.serv_valids++; \
+            dhcpv6r_stats_publish(intfNode); \
+        } while (0)
 
 /* Function prototypes from dhcpv6_relay.c */
 
 extern void dhcpv6r_exit(void);
 extern bool dhcpv6r_init(void);
 extern void dhcpv6r_reconfigure(void);
+extern void dhcpv6r_snapshot_save(struct relay_snapshot *snap);
+extern void dhcpv6r_snapshot_restore(uint16_t type, const void *payload,
+                                     uint32_t length);
 
 /*
  * Function prototypes from dhcpv6_relay_config.c
  */
 void dhcpv6r_handle_config_change(
               const struct ovsrec_dhcp_relay *rec, uint32_t idl_seqno);
-void dhcpv6r_handle_row_delete(struct ovsdb_idl *idl);
+void dhcpv6r_handle_row_delete(const struct uuid *uuid);
+void dhcpv6r_stats_publish(const DHCPV6_RELAY_INTERFACE_NODE_T *intfNode);
+void dhcpv6r_netlink_event(const struct relay_netlink_event *event,
+                           void *aux);
+void dhcpv6r_restore_interface(const DHCPV6R_SNAPSHOT_INTF *rec);
+void dhcpv6r_reconcile_interfaces(void);
+void dhcpv6r_join_mcast_groups(void);
+
+/*
+ * Function prototypes from dhcpv6_relay_recv.c
+ */
+bool dhcpv6r_packet_recv(void *aux, int budget);
+
+/*
+ * Function prototypes from dhcpv6_relay_xmit.c
+ */
+void dhcpv6r_relay_to_server(uint8_t *pkt, int32_t size, uint8_t *txbuff,
+                             const struct sockaddr_in6 *src,
+                             const struct in6_pktinfo *pktInfo);
+void dhcpv6r_relay_to_client(uint8_t *pkt, int32_t size,
+                             const struct sockaddr_in6 *src,
+                             const struct in6_pktinfo *pktInfo);
+void dhcpv6r_flush_tx_batch(void);
 
 #endif /* FTR_DHCPV6_RELAY */
 #endif /* dhcpv6_relay.h */
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_netlink.h
+ */
+
+/*
+ * Kernel interface notifications. A rtnetlink socket subscribed to link
+ * and address changes is drained from the main loop, and every change is
+ * handed to the callbacks registered by the relay modules. Callbacks run
+ * in the main thread.
+ */
+
+#ifndef RELAY_NETLINK_H
+#define RELAY_NETLINK_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum relay_netlink_event_type {
+    RELAY_NETLINK_LINK_NEW,   /* interface created or changed */
+    RELAY_NETLINK_LINK_DEL,   /* interface removed */
+    RELAY_NETLINK_ADDR_NEW,   /* address added to an interface */
+    RELAY_NETLINK_ADDR_DEL,   /* address removed from an interface */
+    RELAY_NETLINK_RESYNC      /* notifications were lost, rescan all */
+};
+
+struct relay_netlink_event {
+    enum relay_netlink_event_type type;
+    uint32_t ifIndex;         /* kernel interface index, 0 for RESYNC */
+    const char *ifName;       /* interface name, link events only */
+};
+
+typedef void relay_netlink_cb(const struct relay_netlink_event *event,
+                              void *aux);
+
+/* Maximum number of registered callbacks */
+#define RELAY_NETLINK_MAX_CALLBACKS 4
+
+bool relay_netlink_init(void);
+void relay_netlink_exit(void);
+void relay_netlink_register(relay_netlink_cb *cb, void *aux);
+void relay_netlink_run(void);
+void relay_netlink_wait(void);
+
+#endif /* relay_netlink.h */
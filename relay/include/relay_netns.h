@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_netns.h
+ */
+
+/*
+ * Network namespace helpers. Each VRF is a network namespace named after
+ * the UUID of the VRF, see get_vrf_ns_from_name(). Namespaces are held by
+ * file descriptor; -1 stands for the namespace the daemon was started in.
+ */
+
+#ifndef RELAY_NETNS_H
+#define RELAY_NETNS_H 1
+
+#include <stdbool.h>
+
+/* Directory holding the VRF network namespaces */
+#define RELAY_NETNS_DIR "/var/run/netns"
+
+bool relay_netns_init(void);
+int relay_netns_open(const char *name);
+bool relay_netns_enter(int nsFd);
+int relay_netns_socket(int nsFd, int domain, int type, int protocol);
+
+#endif /* relay_netns.h */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_pool.h
+ */
+
+/*
+ * Fixed size object arena. Objects are carved out of large chunks, so
+ * entries allocated together stay close in memory, and freed objects are
+ * recycled through a free list instead of being returned to malloc.
+ * Chunks are only released when the pool is destroyed.
+ *
+ * The pool is not thread safe; callers serialize access.
+ */
+
+#ifndef RELAY_POOL_H
+#define RELAY_POOL_H 1
+
+#include <stddef.h>
+
+struct relay_pool_chunk;
+
+struct relay_pool {
+    size_t obj_size;                 /* object size, rounded for alignment */
+    size_t objs_per_chunk;           /* objects carved from each chunk */
+    struct relay_pool_chunk *chunks; /* all chunks of the pool */
+    void *free_list;                 /* recycled objects */
+    size_t n_free;                   /* objects on the free list */
+    size_t n_in_use;                 /* objects handed out */
+};
+
+void relay_pool_init(struct relay_pool *pool, size_t obj_size,
+                     size_t objs_per_chunk);
+void relay_pool_destroy(struct relay_pool *pool);
+void *relay_pool_alloc(struct relay_pool *pool);
+void relay_pool_free(struct relay_pool *pool, void *obj);
+
+#endif /* relay_pool.h */
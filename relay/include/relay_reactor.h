@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_reactor.h
+ */
+
+/*
+ * Receive reactor. A fixed pool of threads waits on one epoll set that
+ * holds every relay socket, whatever its VRF or address family.
+ *
+ * Sockets are registered edge triggered and one-shot, so a ready socket
+ * is handled by one thread at a time. The handler reads at most a budget
+ * of packets, then the socket is re-armed; if packets are still queued it
+ * goes to the back of the ready list, and a busy socket cannot starve the
+ * others.
+ *
+ * A source whose namespace cannot be entered is not handled; it is left
+ * disarmed and re-armed after RELAY_REACTOR_RETRY_MSEC.
+ *
+ * An eventfd in the set wakes all threads, for shutdown and for
+ * relay_reactor_synchronize(), which returns once every thread has
+ * finished the batch it was handling. After it returns, a removed source
+ * or a replaced configuration is no longer used by any thread.
+ */
+
+#ifndef RELAY_REACTOR_H
+#define RELAY_REACTOR_H 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Threads of the pool when not configured */
+#define RELAY_REACTOR_DEFAULT_THREADS 2
+#define RELAY_REACTOR_MAX_THREADS     16
+
+/* Packets read from a socket before the next ready socket is served */
+#define RELAY_REACTOR_BUDGET          64
+
+/* Events fetched by a thread at once */
+#define RELAY_REACTOR_MAX_EVENTS      16
+
+/* Delay before a source whose namespace could not be entered is served
+ * again, in ms */
+#define RELAY_REACTOR_RETRY_MSEC      1000
+
+/* Handler of a ready source. Reads until the socket would block or until
+ * budget packets were read. Runs in a pool thread, in the namespace of
+ * the source. Returns false if the socket is unusable; the source is then
+ * no longer reported until its owner removes it. */
+typedef bool relay_reactor_cb(void *aux, int budget);
+
+struct relay_reactor_source {
+    int fd;                   /* non-blocking socket */
+    int nsFd;                 /* namespace of the handler, -1 for the
+                                 daemon namespace */
+    relay_reactor_cb *cb;     /* handler */
+    void *aux;                /* handler argument */
+    ino_t nsId;               /* namespace identity, set by the reactor */
+};
+
+bool relay_reactor_init(int n_threads);
+void relay_reactor_exit(void);
+bool relay_reactor_add(struct relay_reactor_source *source);
+void relay_reactor_remove(struct relay_reactor_source *source);
+void relay_reactor_synchronize(void);
+
+#endif /* relay_reactor.h */
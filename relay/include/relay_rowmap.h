@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_rowmap.h
+ */
+
+/*
+ * Map of the OVSDB relay configuration rows applied so far, by row uuid.
+ * The columns of a deleted row can not be relied upon once the IDL
+ * reports the delete, so each entry remembers which interface (and UDP
+ * port) the row configured.
+ */
+
+#ifndef RELAY_ROWMAP_H
+#define RELAY_ROWMAP_H 1
+
+#include <stdint.h>
+
+#include "hmap.h"
+#include "uuid.h"
+
+struct relay_row_ref {
+    struct hmap_node node;    /* in relay_row_map, hashed by uuid */
+    struct uuid uuid;         /* OVSDB row uuid */
+    char *portName;           /* interface configured by the row */
+    int64_t udp_dport;        /* UDP port configured by the row, if any */
+};
+
+struct relay_row_map {
+    struct hmap rows;
+};
+
+void relay_row_map_init(struct relay_row_map *map);
+void relay_row_map_destroy(struct relay_row_map *map);
+struct relay_row_ref *relay_row_map_find(const struct relay_row_map *map,
+                                         const struct uuid *uuid);
+void relay_row_map_set(struct relay_row_map *map, const struct uuid *uuid,
+                       const char *portName, int64_t udp_dport);
+void relay_row_map_remove(struct relay_row_map *map,
+                          struct relay_row_ref *ref);
+
+#endif /* relay_rowmap.h */
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_snapshot.h
+ */
+
+/*
+ * Binary snapshot of the relay runtime state, used for warm restarts.
+ *
+ * The file starts with a header followed by typed sections. Each section
+ * is a section header and a payload owned by one relay module, padded to
+ * 8 bytes. The payload layouts are defined next to the module state they
+ * save. A snapshot from another version, or one failing the checksum, is
+ * ignored as a whole.
+ */
+
+#ifndef RELAY_SNAPSHOT_H
+#define RELAY_SNAPSHOT_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RELAY_SNAPSHOT_MAGIC     0x52534e50 /* "RSNP" */
+#define RELAY_SNAPSHOT_VERSION   1
+
+/* Snapshot file name, in the OVS run directory */
+#define RELAY_SNAPSHOT_FILE      "ops-relay.snapshot"
+
+/* Minimum time between two periodic snapshots, in ms */
+#define RELAY_SNAPSHOT_INTERVAL  30000
+
+/* Size of the interface name fields of the section payloads */
+#define RELAY_SNAPSHOT_NAME_LEN  64
+
+struct relay_snapshot_header {
+    uint32_t magic;           /* RELAY_SNAPSHOT_MAGIC */
+    uint16_t version;         /* RELAY_SNAPSHOT_VERSION */
+    uint16_t header_size;     /* sizeof(struct relay_snapshot_header) */
+    uint64_t size;            /* file size, including this header */
+    uint32_t checksum;        /* hash of everything after the header */
+    uint32_t pid;             /* process which wrote the snapshot */
+    int64_t saved_at;         /* wall clock time of the snapshot */
+};
+
+struct relay_snapshot_section {
+    uint16_t type;            /* enum relay_snapshot_type */
+    uint16_t reserved;
+    uint32_t length;          /* payload length, without padding */
+};
+
+enum relay_snapshot_type {
+    RELAY_SNAPSHOT_UDPFWD_GLOBAL = 1,  /* UDPFWD_SNAPSHOT_GLOBAL */
+    RELAY_SNAPSHOT_UDPFWD_INTF,        /* UDPFWD_SNAPSHOT_INTF */
+    RELAY_SNAPSHOT_DHCPV6R_INTF        /* DHCPV6R_SNAPSHOT_INTF */
+};
+
+/* Snapshot being built */
+struct relay_snapshot {
+    char *data;               /* header and sections */
+    size_t size;              /* bytes used */
+    size_t allocated;         /* bytes allocated */
+    size_t section;           /* offset of the open section header */
+};
+
+/* Snapshot being read */
+struct relay_snapshot_reader {
+    const char *base;         /* mapped file */
+    size_t size;              /* mapped size */
+    size_t offset;            /* next section */
+};
+
+void relay_snapshot_init(struct relay_snapshot *snap);
+void relay_snapshot_destroy(struct relay_snapshot *snap);
+void relay_snapshot_section_start(struct relay_snapshot *snap,
+                                  enum relay_snapshot_type type);
+void relay_snapshot_put(struct relay_snapshot *snap, const void *data,
+                        size_t length);
+void relay_snapshot_section_end(struct relay_snapshot *snap);
+bool relay_snapshot_write(struct relay_snapshot *snap, const char *path);
+
+bool relay_snapshot_open(struct relay_snapshot_reader *reader,
+                         const char *path);
+bool relay_snapshot_next(struct relay_snapshot_reader *reader,
+                         uint16_t *type, const void **payload,
+                         uint32_t *length);
+void relay_snapshot_close(struct relay_snapshot_reader *reader);
+
+#endif /* relay_snapshot.h */
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_stats.h
+ */
+
+/*
+ * Layout of the relay statistics shared memory segment and the API of the
+ * reader library. This header is shared between ops-relay (writer) and
+ * external collectors (readers), so it must not depend on OVS headers.
+ *
+ * Every record is protected by a sequence lock. The writer makes the
+ * sequence odd before an update and even after it; a reader copies the
+ * record and retries if the sequence was odd or changed meanwhile.
+ * The sequence lock admits a single writer at a time: within ops-relay the
+ * interface records are written between relay_stats_intf_write_begin()
+ * and relay_stats_intf_write_end(), and the global records under a lock
+ * per kind, whatever thread writes them.
+ */
+
+#ifndef RELAY_STATS_H
+#define RELAY_STATS_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Default name of the segment under /dev/shm */
+#define RELAY_STATS_SHM_DEFAULT_NAME "/ops-relay-stats"
+
+#define RELAY_STATS_MAGIC   0x52454c53 /* "RELS" */
+
+/* Bumped on incompatible layout changes. Version 3 appended kernel_drops
+ * to the global records, which moved every record after the first for
+ * readers that indexed global[] by their own sizeof. Readers must honour
+ * the sizes in the header; any further growth still needs a bump. */
+#define RELAY_STATS_VERSION 3
+
+#define RELAY_STATS_MAX_INTERFACES  1024
+#define RELAY_STATS_NAME_LEN        32
+#define RELAY_STATS_MAX_COUNTERS    16
+
+/* Bucket i counts packets processed in [2^i, 2^(i+1)) nanoseconds */
+#define RELAY_STATS_LATENCY_BUCKETS 32
+
+/* Owner of a record. Counter indexes are interpreted per kind. */
+enum relay_stats_kind {
+    RELAY_STATS_KIND_UDPFWD = 0,  /* IPv4 DHCP relay / UDP forwarder */
+    RELAY_STATS_KIND_DHCPV6R,     /* DHCPv6 relay */
+    RELAY_STATS_KIND_MAX
+};
+
+/* Counters of RELAY_STATS_KIND_UDPFWD interface records */
+enum relay_stats_udpfwd_counter {
+    RELAY_STATS_DHCPR_CLIENT_DROPS = 0,
+    RELAY_STATS_DHCPR_CLIENT_VALIDS,
+    RELAY_STATS_DHCPR_SERVER_DROPS,
+    RELAY_STATS_DHCPR_SERVER_VALIDS,
+    RELAY_STATS_DHCPR_CLIENT_DROPS_OPTION82,
+    RELAY_STATS_DHCPR_CLIENT_VALIDS_OPTION82,
+    RELAY_STATS_DHCPR_SERVER_DROPS_OPTION82,
+    RELAY_STATS_DHCPR_SERVER_VALIDS_OPTION82,
+    RELAY_STATS_UDPFWD_MAX_COUNTER
+};
+
+/* Counters of RELAY_STATS_KIND_DHCPV6R interface records */
+enum relay_stats_dhcpv6r_counter {
+    RELAY_STATS_DHCPV6R_CLIENT_DROPS = 0,
+    RELAY_STATS_DHCPV6R_CLIENT_VALIDS,
+    RELAY_STATS_DHCPV6R_SERVER_DROPS,
+    RELAY_STATS_DHCPV6R_SERVER_VALIDS,
+    RELAY_STATS_DHCPV6R_MAX_COUNTER
+};
+
+/* Per packet-path record, one per enum relay_stats_kind */
+struct relay_stats_global {
+    uint32_t seq;         /* sequence lock */
+    uint32_t pad;
+    uint64_t rx_packets;  /* packets handed to the relay engine */
+    uint64_t latency_sum_ns; /* total processing time */
+    uint64_t latency[RELAY_STATS_LATENCY_BUCKETS]; /* log2 histogram */
+    uint64_t kernel_drops; /* packets dropped by the kernel because the
+                              socket receive queue was full */
+};
+
+/* Per interface record */
+struct relay_stats_intf {
+    uint32_t seq;         /* sequence lock */
+    uint16_t in_use;      /* record is assigned to an interface */
+    uint16_t kind;        /* enum relay_stats_kind */
+    char name[RELAY_STATS_NAME_LEN]; /* interface name */
+    uint64_t counters[RELAY_STATS_MAX_COUNTERS];
+};
+
+/* Segment header, followed by max_interfaces interface records. The
+ * global records are global_size bytes apart; readers must not index
+ * global[] with their own record size. */
+struct relay_stats_header {
+    uint32_t magic;            /* RELAY_STATS_MAGIC, written last */
+    uint32_t version;          /* RELAY_STATS_VERSION */
+    uint32_t header_size;      /* offset of the first interface record */
+    uint32_t intf_size;        /* size of an interface record */
+    uint32_t global_size;      /* size of a global record */
+    uint32_t max_interfaces;   /* number of interface records */
+    uint32_t pid;              /* pid of the writer */
+    uint32_t pad;
+    uint64_t start_time;       /* writer start time, seconds since epoch */
+    struct relay_stats_global global[RELAY_STATS_KIND_MAX];
+};
+
+/*
+ * Sequence lock helpers
+ */
+static inline void relay_stats_write_begin(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void relay_stats_write_end(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline void relay_stats_store(uint64_t *counter, uint64_t value)
+{
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+/*
+ * Reader library
+ */
+struct relay_stats_reader;
+
+int relay_stats_open(const char *name, struct relay_stats_reader **readerp);
+void relay_stats_close(struct relay_stats_reader *reader);
+uint32_t relay_stats_max_interfaces(const struct relay_stats_reader *reader);
+uint32_t relay_stats_writer_pid(const struct relay_stats_reader *reader);
+bool relay_stats_read_global(const struct relay_stats_reader *reader,
+                             enum relay_stats_kind kind,
+                             struct relay_stats_global *global);
+bool relay_stats_read_intf(const struct relay_stats_reader *reader,
+                           uint32_t index, struct relay_stats_intf *intf);
+const char *relay_stats_counter_name(enum relay_stats_kind kind,
+                                     uint32_t counter);
+uint32_t relay_stats_n_counters(enum relay_stats_kind kind);
+
+/*
+ * Writer side, implemented in ops-relay
+ */
+bool relay_stats_init(const char *name);
+void relay_stats_exit(void);
+bool relay_stats_enabled(void);
+struct relay_stats_intf *relay_stats_intf_alloc(enum relay_stats_kind kind,
+                                                const char *name);
+void relay_stats_intf_free(struct relay_stats_intf *intf);
+void relay_stats_intf_write_begin(struct relay_stats_intf *intf);
+void relay_stats_intf_write_end(struct relay_stats_intf *intf);
+void relay_stats_record_kernel_drops(enum relay_stats_kind kind,
+                                     uint64_t drops);
+void relay_stats_record_packet(enum relay_stats_kind kind,
+                               uint64_t latency_ns);
+
+#endif /* relay_stats.h */
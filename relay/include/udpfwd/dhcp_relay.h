@@ -37,7 +37,7 @@
  * DHCP-Relay macro definitions
  */
 #define BOOTPOPTLEN   64
-#define DHCPOPTLEN(TAGP) (*(((char *)TAGP) + 1)) /* Get DHCP option length */
+#define DHCPOPTLEN(TAGP) (*(((uint8_t *)TAGP) + 1)) /* Get DHCP option len */
 #define DFLTDHCPLEN      sizeof(struct dhcp_packet) /* Default DHCP message size */
 #define OPTBODY(TAGP)    (((char *)TAGP) + 2) /* Get contents of DHCP option */
 #define DHCP_PKTLEN(UDP)      (ntohs(UDP->uh_ulen) - UDPHDR_LENGTH)
@@ -49,6 +49,12 @@
  */
 #define MINBOOTPLEN  (DFLTDHCPLEN - DFLTOPTLEN + 5)
 
+/*
+ * Shortest DHCP payload the relay processes: the fixed fields and the
+ * magic cookie (or the first 4 bytes of the options of a bootp packet).
+ */
+#define DHCP_MIN_PKTLEN  (DFLTDHCPLEN - DFLTOPTLEN + MAGIC_LEN)
+
 #define PAD                  ((uint8_t)   0)
 #define OPT_OVERLOAD         ((uint8_t)  52)
 #define DHCP_MSGTYPE         ((uint8_t)  53)
@@ -88,23 +94,47 @@ typedef struct DHCP_OPTION_82_OPTIONS
 
 /* Macros for dhcp-relay statistics counters */
 #define INC_UDPF_DHCPR_CLIENT_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_drops++
+        do { \
+            intfNode->dhcp_relay_pkt_counters.client_drops++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
 #define INC_UDPF_DHCPR_CLIENT_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.client_valids++
+        do { \
+            intfNode->dhcp_relay_pkt_counters.client_valids++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
 #define INC_UDPF_DHCPR_SERVER_DROPS(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_drops++
+        do { \
+            intfNode->dhcp_relay_pkt_counters.serv_drops++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
 #define INC_UDPF_DHCPR_SERVER_SENT(intfNode)  \
-            intfNode->dhcp_relay_pkt_counters.serv_valids++
+        do { \
+            intfNode->dhcp_relay_pkt_counters.serv_valids++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
 
 /* Macros for Option 82 statistics counters */
-#define INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.client_drops_with_option82++
-#define INC_UDPF_DHCPR_OPT82_CLIENT_SENT(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.client_valids_with_option82++
-#define INC_UDPF_DHCPR_OPT82_SERVER_DROPS(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.serv_drops_with_option82++
-#define INC_UDPF_DHCPR_OPT82_SERVER_SENT(intfNode) \
-        intfNode->dhcp_relay_pkt_counters.serv_valids_with_option82++
+#define INC_UDPF_DHCPR_OPT82_CLIENT_DROPS(intfNode)  \
+        do { \
+            intfNode->dhcp_relay_pkt_counters.client_drops_with_option82++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
+#define INC_UDPF_DHCPR_OPT82_CLIENT_SENT(intfNode)  \
+        do { \
+            intfNode->dhcp_relay_pkt_counters.client_valids_with_option82++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
+#define INC_UDPF_DHCPR_OPT82_SERVER_DROPS(intfNode)  \
+        do { \
+            intfNode->dhcp_relay_pkt_counters.serv_drops_with_option82++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
+#define INC_UDPF_DHCPR_OPT82_SERVER_SENT(intfNode)  \
+        do { \
+            intfNode->dhcp_relay_pkt_counters.serv_valids_with_option82++; \
+            UDPFWD_INTF_COUNT(intfNode); \
+        } while (0)
 
 /* The following macros will return pkt counters values  */
 #define UDPF_DHCPR_CLIENT_DROPS(intfNode)  \
@@ -29,6 +29,8 @@
 #include "shash.h"
 #include "cmap.h"
 #include "semaphore.h"
+#include "ovs-atomic.h"
+#include "seq.h"
 #include "openvswitch/types.h"
 #include "openvswitch/vlog.h"
 #include "vswitch-idl.h"
@@ -48,8 +50,14 @@
 #include <netinet/ip.h>
 #include <unistd.h>
 #include <net/if.h>
+#include <net/if_arp.h>
 #include <assert.h>
 #include "udpfwd_common.h"
+#include "relay_stats.h"
+#include "relay_pool.h"
+#include "relay_rowmap.h"
+#include "relay_snapshot.h"
+#include "relay_reactor.h"
 
 typedef uint32_t IP_ADDRESS;     /* IP Address. */
 
@@ -60,8 +68,6 @@ typedef uint8_t MAC_ADDRESS[6];
 
 #define RECV_BUFFER_SIZE 9228 /* Jumbo frame size */
 
-#define IDL_POLL_INTERVAL 5
-
 #define IP_ADDRESS_NULL   ((IP_ADDRESS)0L)
 #define IP_ADDRESS_BCAST  ((IP_ADDRESS)0xffffffff)
 
@@ -80,6 +86,18 @@ typedef uint8_t MAC_ADDRESS[6];
 /* statistics refresh default interval  */
 #define STATS_UPDATE_DEFAULT_INTERVAL    5000
 
+/* Bounds of the receive buffer of the relay sockets, in bytes. A socket
+ * starts at the minimum and its buffer doubles whenever the kernel
+ * reports drops, up to the maximum. */
+#define SYSTEM_OTHER_CONFIG_MAP_UDPFWD_RCVBUF_MIN "udpfwd-rcvbuf-min"
+#define SYSTEM_OTHER_CONFIG_MAP_UDPFWD_RCVBUF_MAX "udpfwd-rcvbuf-max"
+#define UDPFWD_RCVBUF_DEFAULT_MIN  (256 * 1024)
+#define UDPFWD_RCVBUF_DEFAULT_MAX  (8 * 1024 * 1024)
+
+/* Depths of the receive scheduler queues, in packets */
+#define SYSTEM_OTHER_CONFIG_MAP_UDPFWD_QUEUE_DHCP "udpfwd-queue-dhcp"
+#define SYSTEM_OTHER_CONFIG_MAP_UDPFWD_QUEUE_FWD  "udpfwd-queue-udp-forward"
+
 #ifdef FTR_DHCP_RELAY
 /* structure needed for statistics counters */
 typedef struct DHCP_RELAY_PKT_COUNTER
@@ -115,35 +133,176 @@ struct csum_construct {
     char payload[RECV_BUFFER_SIZE];
 };
 
+/* Time between two attempts to open a failed VRF context, in ms. The
+ * interval doubles after every failed attempt, up to the maximum. */
+#define UDPFWD_VRF_RETRY_INTERVAL     1000
+#define UDPFWD_VRF_MAX_RETRY_INTERVAL 30000
+
+/* Receive errors in a row after which a socket is re-created */
+#define UDPFWD_RECV_MAX_ERRORS 16
+
+/* Traffic classes of the receive scheduler, in priority order. A VRF
+ * context keeps a queue per class across receive rounds. Every round
+ * reads packets into the queues, then serves the classes in strict
+ * priority, so that a flood of forwarded broadcasts does not delay DHCP
+ * relay. Packets a round does not serve wait for the next one. */
+enum udpfwd_class {
+    UDPFWD_CLASS_DHCP = 0,  /* DHCP relay */
+    UDPFWD_CLASS_FWD,       /* other forwarded UDP protocols */
+    UDPFWD_CLASS_MAX
+};
+
+/* Packets a class may hold queued, packets arriving on a full queue are
+ * dropped. The default depths let a round queue a full budget of either
+ * class. */
+#define UDPFWD_CLASS_DHCP_DEPTH (2 * RELAY_REACTOR_BUDGET)
+#define UDPFWD_CLASS_FWD_DEPTH  RELAY_REACTOR_BUDGET
+#define UDPFWD_CLASS_MAX_DEPTH  (4 * RELAY_REACTOR_BUDGET)
+
+/* Receive slots of a VRF context: every queue full, plus one to read
+ * the packet being classified */
+#define UDPFWD_RX_SLOTS (UDPFWD_CLASS_MAX * UDPFWD_CLASS_MAX_DEPTH + 1)
+
+/* Counters of a traffic class */
+typedef struct UDPFWD_CLASS_STATS_T
+{
+    atomic_uint64_t queued;   /* packets queued for relay */
+    atomic_uint64_t dropped;  /* packets dropped on a full queue */
+} UDPFWD_CLASS_STATS_T;
+
+/* Packet read in a receive round, waiting for its class to be served */
+typedef struct UDPFWD_RX_SLOT_T
+{
+    char *buff;                /* packet, RECV_BUFFER_SIZE bytes, allocated
+                                  on first use */
+    int32_t size;              /* packet size */
+    struct in_pktinfo pktInfo; /* receiving interface */
+} UDPFWD_RX_SLOT_T;
+
+/* Queue of a traffic class, a ring of slot indexes */
+typedef struct UDPFWD_RX_QUEUE_T
+{
+    uint16_t head;             /* oldest packet */
+    uint16_t count;            /* packets queued */
+    uint16_t slots[UDPFWD_CLASS_MAX_DEPTH];
+} UDPFWD_RX_QUEUE_T;
+
+/* Recently programmed ARP entries of a VRF. Replies to the same client
+ * (OFFER then ACK) would otherwise install the same entry again. */
+#define UDPFWD_ARP_CACHE_SIZE 256   /* entries, a power of 2 */
+#define UDPFWD_ARP_CACHE_TTL  10000 /* ms, well below the kernel aging */
+
+typedef struct UDPFWD_ARP_CACHE_ENTRY_T
+{
+    long long int expires; /* entry is stale from this time, in ms */
+    uint32_t ifIndex;      /* output interface */
+    IP_ADDRESS ip;         /* client IP address */
+    struct sockaddr ha;    /* client hardware address */
+} UDPFWD_ARP_CACHE_ENTRY_T;
+
+/* Receive context of a VRF. Each VRF has its own socket, opened in the
+ * VRF network namespace and served by the receive reactor, so that relay
+ * load in one VRF does not hold up another. */
+typedef struct UDPFWD_VRF_CTX_T
+{
+    char *name;           /* VRF name */
+    char *nsName;         /* VRF namespace name, NULL for the default VRF */
+    int32_t nsFd;         /* VRF namespace, -1 for the default VRF */
+    int32_t sockFd;       /* Socket to send/receive UDP packets */
+    UDPFWD_RX_SLOT_T slots[UDPFWD_RX_SLOTS]; /* received packets */
+    uint16_t freeSlots[UDPFWD_RX_SLOTS]; /* stack of unused slots */
+    uint16_t n_free;
+    UDPFWD_RX_QUEUE_T queues[UDPFWD_CLASS_MAX]; /* packets waiting for
+                                                   their class to be
+                                                   served, reactor only */
+    struct relay_reactor_source source; /* reactor registration */
+    bool active;          /* socket open and registered */
+    atomic_bool broken;   /* socket failed, to be re-created by the main
+                             thread */
+    uint32_t rxErrors;    /* receive errors in a row, reactor only */
+    long long int retryTime; /* next attempt to open, main thread only */
+    int retryInterval;    /* current interval between attempts */
+    uint32_t rxqDrops;    /* last kernel drop count of the socket */
+    uint32_t rcvbufSize;  /* receive buffer size requested */
+    UDPFWD_ARP_CACHE_ENTRY_T arpCache[UDPFWD_ARP_CACHE_SIZE]; /* reactor
+                                                                 only */
+} UDPFWD_VRF_CTX_T;
+
 /* UDP Forwarder Control Block. */
 typedef struct UDPF_CTRL_CB
 {
-    int32_t udpSockFd;    /* Socket to send/receive UDP packets */
     sem_t waitSem;        /* Semaphore for concurrent access protection */
     struct shash intfHashTable; /* interface hash table handle */
     struct cmap serverHashMap;  /* server hash map handle */
     FEATURE_CONFIG feature_config;
-    char *rcvbuff; /* Buffer which is used to store udp packet */
+    struct shash vrfTable; /* UDPFWD_VRF_CTX_T entries by namespace
+                              name, DEFAULT_VRF_NAME for the
+                              default VRF */
+    struct seq *vrf_seq;   /* Changed when a VRF socket failed */
+    atomic_uint rcvbufMin; /* receive buffer bounds of the VRF sockets */
+    atomic_uint rcvbufMax;
+    UDPFWD_CLASS_STATS_T classStats[UDPFWD_CLASS_MAX]; /* receive
+                                                          scheduler */
+    atomic_uint classDepth[UDPFWD_CLASS_MAX]; /* queue depths */
     int32_t stats_interval;    /* statistics refresh interval */
     struct csum_construct udp_csum_construct; /* UDP checksum construct */
+    atomic_uint64_t generation; /* Change generation, bumped on every
+                                   configuration update and on dumps
+                                   reporting counter updates */
+    atomic_uint64_t config_generation; /* Generation of the last
+                                          configuration update */
+    uint64_t removed_generation; /* Generation at which an interface
+                                    entry was last freed */
+    struct relay_pool serverPool; /* Arena of UDPFWD_SERVER_T entries */
+    struct seq *stats_seq;  /* Changed when counters first move after a
+                               statistics refresh */
+    atomic_bool stats_dirty; /* Counters changed since the last refresh */
+    struct relay_row_map dhcpRelayRows; /* Applied DHCP_Relay records */
+    struct relay_row_map bcastFwdRows;  /* Applied UDP_Bcast_Forwarder
+                                           records */
 } UDPFWD_CTRL_CB;
 
-/* Server Address structure. */
+/* Servers kept inside the interface entry before spilling to the heap */
+#define UDPFWD_INLINE_SERVERS 4
+
+/* Maximum number of servers accepted per interface by the daemon */
+#define UDPFWD_MAX_SERVERS_PER_INTERFACE 1024
+
+/* Number of server entries allocated at once */
+#define UDPFWD_SERVER_POOL_CHUNK 256
+
+/* Server Address structure. One entry exists per distinct server; it
+ * tracks how many interfaces use the server. */
 typedef struct UDPFWD_SERVER_T {
   struct cmap_node cmap_node; /* cmap Node, used for hashing */
   IP_ADDRESS ip_address; /* Server IP address */
   uint16_t   udp_port;   /* UDP Port Number */
-  uint16_t   ref_count;  /* Counts how many interfaces are using the serverIP.
+  uint32_t   ref_count;  /* Counts how many interfaces are using the serverIP.
                             This field helps in deleting a server entry */
 } UDPFWD_SERVER_T;
 
+/* Server of an interface, stored by value so that the forwarding loop
+ * walks a contiguous array */
+typedef struct UDPFWD_SERVER_REF_T {
+  IP_ADDRESS ip_address; /* Server IP address */
+  uint16_t   udp_port;   /* UDP Port Number */
+} UDPFWD_SERVER_REF_T;
+
 /* Interface Table Structure. */
 typedef struct UDPFWD_INTERFACE_NODE_T
 {
   char  *portName; /* Name of the Interface */
-  uint8_t addrCount; /* Counts of configured servers */
-  UDPFWD_SERVER_T **serverArray; /* Pointer to the array server configs */
+  uint16_t addrCount; /* Counts of configured servers */
+  uint16_t addrAlloc; /* Capacity of the servers array */
+  UDPFWD_SERVER_REF_T *servers; /* Configured servers, either inlineServers
+                                   or a heap array */
+  UDPFWD_SERVER_REF_T inlineServers[UDPFWD_INLINE_SERVERS];
   IP_ADDRESS bootp_gw; /* store bootp gateway IP address */
+  uint64_t generation; /* Generation of the last change on this entry */
+  uint64_t countersGeneration; /* Generation at which counter changes were
+                                  last reported */
+  bool countersDirty; /* Counters changed since countersGeneration */
+  struct relay_stats_intf *stats; /* Shared memory statistics record */
 #ifdef FTR_DHCP_RELAY
   DHCP_RELAY_PKT_COUNTER dhcp_relay_pkt_counters; /* Counts of dhcp-relay
                                                      statistics */
@@ -157,10 +316,59 @@ typedef enum DB_OP_TYPE_t {
     TABLE_OP_MAX
 } TABLE_OP_TYPE_t;
 
+/* Snapshot of the global state, RELAY_SNAPSHOT_UDPFWD_GLOBAL section */
+typedef struct UDPFWD_SNAPSHOT_GLOBAL {
+  uint64_t generation;       /* Change generation */
+  feature_bmap config;       /* Feature configuration status */
+  uint16_t reserved;
+  uint32_t policy;           /* DHCP-Relay option 82 policy */
+  uint32_t r_id;             /* DHCP-Relay option 82 remote-id */
+  int32_t stats_interval;    /* statistics refresh interval */
+} UDPFWD_SNAPSHOT_GLOBAL;
+
+/* Snapshot of a server of an interface */
+typedef struct UDPFWD_SNAPSHOT_SERVER {
+  IP_ADDRESS ip_address;     /* Server IP address */
+  uint16_t udp_port;         /* UDP Port Number */
+  uint16_t reserved;
+} UDPFWD_SNAPSHOT_SERVER;
+
+/* Snapshot of an interface, RELAY_SNAPSHOT_UDPFWD_INTF section. The
+ * servers follow the fixed part. */
+typedef struct UDPFWD_SNAPSHOT_INTF {
+  char portName[RELAY_SNAPSHOT_NAME_LEN]; /* Name of the Interface */
+  IP_ADDRESS bootp_gw;       /* bootp gateway IP address */
+  uint32_t n_servers;        /* Number of servers */
+#ifdef FTR_DHCP_RELAY
+  DHCP_RELAY_PKT_COUNTER dhcp_relay_pkt_counters; /* dhcp-relay
+                                                     statistics */
+#endif /* FTR_DHCP_RELAY */
+  UDPFWD_SNAPSHOT_SERVER servers[];
+} UDPFWD_SNAPSHOT_INTF;
+
+/* Stamp an interface entry with a fresh change generation and publish
+ * its counters to shared memory */
+#define UDPFWD_INTF_TOUCH(intfNode) \
+        do { \
+            (intfNode)->generation = udpfwd_next_generation(); \
+            udpfwd_stats_publish(intfNode); \
+        } while (0)
+
+/* Publish the counters of an interface entry after a packet counter
+ * update. Counter updates are stamped with a generation when a dump
+ * reports them, not per packet. */
+#define UDPFWD_INTF_COUNT(intfNode) \
+        do { \
+            (intfNode)->countersDirty = true; \
+            udpfwd_stats_publish(intfNode); \
+            udpfwd_stats_changed(); \
+        } while (0)
+
 /* union to store socket ancillary data */
 union control_u {
     struct cmsghdr align; /* this ensures alignment */
-    char control[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    char control[CMSG_SPACE(sizeof(struct in_pktinfo))
+                 + CMSG_SPACE(sizeof(uint32_t))]; /* SO_RXQ_OVFL */
 };
 
 /* union to store pktinfo meta data */
@@ -178,8 +386,40 @@ extern UDPFWD_CTRL_CB *udpfwd_ctrl_cb_p;
  * Function prototypes from udpfwd.c
  */
 extern bool udpfwd_init(void);
+extern bool udpfwd_module_init(void);
+extern void update_feature_state(UDPFWD_FEATURE feature,
+                                 FEATURE_STATUS state);
+#ifdef FTR_DHCP_RELAY
+extern void update_option82_policy(char *value);
+extern void update_option82_remote_id(char *value);
+#endif /* FTR_DHCP_RELAY */
 extern void udpfwd_reconfigure(void);
+extern void udpfwd_run(void);
+extern void udpfwd_wait(void);
 extern void udpfwd_exit(void);
+extern uint64_t udpfwd_next_generation(void);
+extern void udpfwd_stats_changed(void);
+extern void udpfwd_snapshot_save(struct relay_snapshot *snap);
+extern void udpfwd_snapshot_restore(uint16_t type, const void *payload,
+                                    uint32_t length);
+
+/*
+ * Function prototypes from udpfwd_vrf.c
+ */
+void udpfwd_vrf_init(void);
+void udpfwd_vrf_exit(void);
+void udpfwd_vrf_reconfigure(void);
+void udpfwd_vrf_run(void);
+void udpfwd_vrf_wait(void);
+int32_t udpfwd_vrf_sock(void);
+void udpfwd_vrf_rxq_drops(UDPFWD_VRF_CTX_T *ctx, uint32_t count);
+void udpfwd_vrf_set_arp(struct arpreq *req, uint32_t ifIndex);
+
+/*
+ * Function prototypes from udpfwd_recv.c
+ */
+bool udp_packet_recv(UDPFWD_VRF_CTX_T *ctx, int budget);
+void udpfwd_ctrl(void *pkt, int32_t size, struct in_pktinfo *pktInfo);
 
 /*
  * Function prototypes from udpfwd_xmit.c
@@ -192,10 +432,15 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
  */
 void udpfwd_handle_dhcp_relay_config_change(
               const struct ovsrec_dhcp_relay *rec, uint32_t idl_seqno);
-void udpfwd_handle_dhcp_relay_row_delete(struct ovsdb_idl *idl);
-void udpfwd_handle_udp_bcast_forwarder_row_delete(struct ovsdb_idl *idl);
+void udpfwd_handle_dhcp_relay_row_delete(const struct uuid *uuid);
+void udpfwd_handle_udp_bcast_forwarder_row_delete(const struct uuid *uuid);
 void udpfwd_handle_udp_bcast_forwarder_config_change(
               const struct ovsrec_udp_bcast_forwarder_server *rec);
 void refresh_dhcp_relay_stats(void);
+UDPFWD_SERVER_T *udpfwd_get_server_entry(IP_ADDRESS ipaddress,
+                                         uint16_t udpPort);
+void udpfwd_stats_publish(const UDPFWD_INTERFACE_NODE_T *intfNode);
+void udpfwd_restore_interface(const UDPFWD_SNAPSHOT_INTF *rec);
+void udpfwd_reconcile_interfaces(void);
 
 #endif /* udpfwd.h */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: ops_relay_stats.c
+ *
+ */
+
+/*
+ * ops-relay-stats: print the counters exported by ops-relay in shared
+ * memory (ops-relay --stats-shm) without contacting the daemon.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "relay_stats.h"
+
+static const char *kind_name[RELAY_STATS_KIND_MAX] = {
+    "udpfwd",  /* RELAY_STATS_KIND_UDPFWD */
+    "dhcpv6r", /* RELAY_STATS_KIND_DHCPV6R */
+};
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS]\n"
+           "Print ops-relay statistics from shared memory.\n\n"
+           "  -n, --name=NAME       segment name (default: %s)\n"
+           "  -i, --interval=MSEC   repeat every MSEC milliseconds\n"
+           "  -c, --count=N         stop after N samples\n"
+           "  -z, --non-zero        skip interfaces with all counters zero\n"
+           "  -h, --help            display this help message\n",
+           prog, RELAY_STATS_SHM_DEFAULT_NAME);
+}
+
+/*
+ * Function      : print_global
+ * Responsiblity : Print a packet path record with its latency histogram.
+ * Parameters    : reader - reader handle
+ *                 kind - packet path
+ * Return        : none
+ */
+static void print_global(const struct relay_stats_reader *reader,
+                         enum relay_stats_kind kind)
+{
+    struct relay_stats_global global;
+    int bucket;
+
+    if (!relay_stats_read_global(reader, kind, &global)) {
+        printf("%s: snapshot failed\n", kind_name[kind]);
+        return;
+    }
+
+    printf("%s: rx_packets=%llu avg_latency_ns=%llu kernel_drops=%llu\n",
+           kind_name[kind],
+           (unsigned long long)global.rx_packets,
+           (unsigned long long)(global.rx_packets
+                                ? global.latency_sum_ns / global.rx_packets
+                                : 0),
+           (unsigned long long)global.kernel_drops);
+    for (bucket = 0; bucket < RELAY_STATS_LATENCY_BUCKETS; bucket++) {
+        if (global.latency[bucket]) {
+            printf("  latency < %llu ns : %llu\n", 2ULL << bucket,
+                   (unsigned long long)global.latency[bucket]);
+        }
+    }
+}
+
+/*
+ * Function      : print_interfaces
+ * Responsiblity : Print all interface records in use.
+ * Parameters    : reader - reader handle
+ *                 non_zero - skip records with all counters zero
+ * Return        : none
+ */
+static void print_interfaces(const struct relay_stats_reader *reader,
+                             bool non_zero)
+{
+    struct relay_stats_intf intf;
+    uint32_t index, counter, n_counters;
+    bool zero;
+
+    for (index = 0; index < relay_stats_max_interfaces(reader); index++) {
+        if (!relay_stats_read_intf(reader, index, &intf))
+            continue;
+
+        n_counters = relay_stats_n_counters(intf.kind);
+        zero = true;
+        for (counter = 0; counter < n_counters; counter++)
+            zero = zero && !intf.counters[counter];
+        if (non_zero && zero)
+            continue;
+
+        printf("%s %s:", kind_name[intf.kind], intf.name);
+        for (counter = 0; counter < n_counters; counter++) {
+            printf(" %s=%llu", relay_stats_counter_name(intf.kind, counter),
+                   (unsigned long long)intf.counters[counter]);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"name",     required_argument, NULL, 'n'},
+        {"interval", required_argument, NULL, 'i'},
+        {"count",    required_argument, NULL, 'c'},
+        {"non-zero", no_argument,       NULL, 'z'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct relay_stats_reader *reader;
+    const char *name = NULL;
+    long interval = 0, count = 1, sample;
+    enum relay_stats_kind kind;
+    bool non_zero = false;
+    int c, error;
+
+    while ((c = getopt_long(argc, argv, "n:i:c:zh", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            name = optarg;
+            break;
+        case 'i':
+            interval = atol(optarg);
+            count = 0;
+            break;
+        case 'c':
+            count = atol(optarg);
+            break;
+        case 'z':
+            non_zero = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    error = relay_stats_open(name, &reader);
+    if (error) {
+        fprintf(stderr, "%s: cannot open statistics segment %s: %s\n",
+                argv[0], name ? name : RELAY_STATS_SHM_DEFAULT_NAME,
+                strerror(error));
+        return EXIT_FAILURE;
+    }
+
+    for (sample = 0; !count || sample < count; sample++) {
+        if (sample) {
+            usleep(interval * 1000);
+            printf("\n");
+        }
+        for (kind = 0; kind < RELAY_STATS_KIND_MAX; kind++)
+            print_global(reader, kind);
+        print_interfaces(reader, non_zero);
+        fflush(stdout);
+    }
+
+    relay_stats_close(reader);
+    return EXIT_SUCCESS;
+}
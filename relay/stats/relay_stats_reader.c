@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_stats_reader.c
+ *
+ */
+
+/*
+ * Reader side of the relay statistics shared memory segment. The library
+ * maps the segment read-only and never blocks or signals the writer.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "relay_stats.h"
+
+/* Give up on a record after this many torn reads */
+#define RELAY_STATS_READ_RETRIES 1000
+
+struct relay_stats_reader {
+    const struct relay_stats_header *hdr; /* mapped segment */
+    size_t size;                          /* mapped size */
+};
+
+static const char *udpfwd_counter_names[RELAY_STATS_UDPFWD_MAX_COUNTER] = {
+    "client_drops",                /* RELAY_STATS_DHCPR_CLIENT_DROPS */
+    "client_valids",               /* RELAY_STATS_DHCPR_CLIENT_VALIDS */
+    "server_drops",                /* RELAY_STATS_DHCPR_SERVER_DROPS */
+    "server_valids",               /* RELAY_STATS_DHCPR_SERVER_VALIDS */
+    "client_drops_with_option82",  /* ..._CLIENT_DROPS_OPTION82 */
+    "client_valids_with_option82", /* ..._CLIENT_VALIDS_OPTION82 */
+    "server_drops_with_option82",  /* ..._SERVER_DROPS_OPTION82 */
+    "server_valids_with_option82", /* ..._SERVER_VALIDS_OPTION82 */
+};
+
+static const char *dhcpv6r_counter_names[RELAY_STATS_DHCPV6R_MAX_COUNTER] = {
+    "client_drops",                /* RELAY_STATS_DHCPV6R_CLIENT_DROPS */
+    "client_valids",               /* RELAY_STATS_DHCPV6R_CLIENT_VALIDS */
+    "server_drops",                /* RELAY_STATS_DHCPV6R_SERVER_DROPS */
+    "server_valids",               /* RELAY_STATS_DHCPV6R_SERVER_VALIDS */
+};
+
+/*
+ * Function      : relay_stats_open
+ * Responsiblity : Map a statistics segment and validate its layout.
+ * Parameters    : name - segment name, NULL for the default
+ *                 readerp - reader handle on success
+ * Return        : 0 - on success
+ *                 errno value - otherwise
+ */
+int relay_stats_open(const char *name, struct relay_stats_reader **readerp)
+{
+    const struct relay_stats_header *hdr;
+    struct relay_stats_reader *reader;
+    struct stat st;
+    int fd, error;
+
+    *readerp = NULL;
+    fd = shm_open(name ? name : RELAY_STATS_SHM_DEFAULT_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return errno;
+
+    if (fstat(fd, &st) < 0) {
+        error = errno;
+        close(fd);
+        return error;
+    }
+
+    if (st.st_size < (off_t)sizeof(struct relay_stats_header)) {
+        close(fd);
+        return EPROTO;
+    }
+
+    hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    error = errno;
+    close(fd);
+    if (MAP_FAILED == hdr)
+        return error;
+
+    if ((__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != RELAY_STATS_MAGIC)
+        || (hdr->version != RELAY_STATS_VERSION)
+        || (hdr->intf_size < sizeof(struct relay_stats_intf))
+        || (hdr->global_size < sizeof(struct relay_stats_global))
+        || ((size_t)hdr->header_size
+            < offsetof(struct relay_stats_header, global)
+              + (size_t)RELAY_STATS_KIND_MAX * hdr->global_size)
+        || ((size_t)hdr->header_size
+            + (size_t)hdr->max_interfaces * hdr->intf_size
+            > (size_t)st.st_size)) {
+        munmap((void *)hdr, st.st_size);
+        return EPROTO;
+    }
+
+    reader = calloc(1, sizeof *reader);
+    if (NULL == reader) {
+        munmap((void *)hdr, st.st_size);
+        return ENOMEM;
+    }
+
+    reader->hdr = hdr;
+    reader->size = st.st_size;
+    *readerp = reader;
+    return 0;
+}
+
+/*
+ * Function      : relay_stats_close
+ * Responsiblity : Unmap a statistics segment.
+ * Parameters    : reader - reader handle, may be NULL
+ * Return        : none
+ */
+void relay_stats_close(struct relay_stats_reader *reader)
+{
+    if (NULL == reader)
+        return;
+
+    munmap((void *)reader->hdr, reader->size);
+    free(reader);
+}
+
+uint32_t relay_stats_max_interfaces(const struct relay_stats_reader *reader)
+{
+    return reader->hdr->max_interfaces;
+}
+
+uint32_t relay_stats_writer_pid(const struct relay_stats_reader *reader)
+{
+    return reader->hdr->pid;
+}
+
+/*
+ * Function      : relay_stats_read_begin/relay_stats_read_retry
+ * Responsiblity : Reader side of the sequence lock.
+ */
+static uint32_t relay_stats_read_begin(const uint32_t *seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static bool relay_stats_read_retry(const uint32_t *seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || (__atomic_load_n(seq, __ATOMIC_RELAXED) != start);
+}
+
+/*
+ * Function      : relay_stats_copy_counters
+ * Responsiblity : Copy counters written concurrently by the daemon.
+ */
+static void relay_stats_copy_counters(uint64_t *dst, const uint64_t *src,
+                                      size_t n)
+{
+    size_t iter;
+
+    for (iter = 0; iter < n; iter++)
+        dst[iter] = __atomic_load_n(&src[iter], __ATOMIC_RELAXED);
+}
+
+/*
+ * Function      : relay_stats_read_global
+ * Responsiblity : Take a consistent snapshot of a packet path record. The
+ *                 records are global_size bytes apart, which may be more
+ *                 than the size known to the reader.
+ * Parameters    : reader - reader handle
+ *                 kind - packet path
+ *                 global - snapshot
+ * Return        : true - on success
+ *                 false - if no consistent snapshot could be taken
+ */
+bool relay_stats_read_global(const struct relay_stats_reader *reader,
+                             enum relay_stats_kind kind,
+                             struct relay_stats_global *global)
+{
+    const struct relay_stats_header *hdr = reader->hdr;
+    const struct relay_stats_global *src;
+    uint32_t seq;
+    int retries;
+
+    if ((unsigned int)kind >= RELAY_STATS_KIND_MAX)
+        return false;
+
+    src = (const struct relay_stats_global *)((const char *)hdr
+                + offsetof(struct relay_stats_header, global)
+                + (size_t)kind * hdr->global_size);
+
+    for (retries = 0; retries < RELAY_STATS_READ_RETRIES; retries++) {
+        seq = relay_stats_read_begin(&src->seq);
+        global->seq = seq;
+        global->rx_packets = __atomic_load_n(&src->rx_packets,
+                                             __ATOMIC_RELAXED);
+        global->latency_sum_ns = __atomic_load_n(&src->latency_sum_ns,
+                                                 __ATOMIC_RELAXED);
+        relay_stats_copy_counters(global->latency, src->latency,
+                                  RELAY_STATS_LATENCY_BUCKETS);
+        global->kernel_drops = __atomic_load_n(&src->kernel_drops,
+                                               __ATOMIC_RELAXED);
+        if (!relay_stats_read_retry(&src->seq, seq))
+            return true;
+        sched_yield();
+    }
+
+    return false;
+}
+
+/*
+ * Function      : relay_stats_read_intf
+ * Responsiblity : Take a consistent snapshot of an interface record.
+ * Parameters    : reader - reader handle
+ *                 index - record index, below relay_stats_max_interfaces()
+ *                 intf - snapshot
+ * Return        : true - if the record is in use
+ *                 false - if it is free or no consistent snapshot could be
+ *                         taken
+ */
+bool relay_stats_read_intf(const struct relay_stats_reader *reader,
+                           uint32_t index, struct relay_stats_intf *intf)
+{
+    const struct relay_stats_header *hdr = reader->hdr;
+    const struct relay_stats_intf *src;
+    uint32_t seq;
+    int retries;
+
+    if (index >= hdr->max_interfaces)
+        return false;
+
+    src = (const struct relay_stats_intf *)((const char *)hdr
+                                            + hdr->header_size
+                                            + index * hdr->intf_size);
+
+    for (retries = 0; retries < RELAY_STATS_READ_RETRIES; retries++) {
+        seq = relay_stats_read_begin(&src->seq);
+        intf->seq = seq;
+        intf->in_use = __atomic_load_n(&src->in_use, __ATOMIC_RELAXED);
+        intf->kind = __atomic_load_n(&src->kind, __ATOMIC_RELAXED);
+        memcpy(intf->name, src->name, sizeof(intf->name));
+        relay_stats_copy_counters(intf->counters, src->counters,
+                                  RELAY_STATS_MAX_COUNTERS);
+        if (!relay_stats_read_retry(&src->seq, seq)) {
+            intf->name[RELAY_STATS_NAME_LEN - 1] = '\0';
+            return intf->in_use && (intf->kind < RELAY_STATS_KIND_MAX);
+        }
+        sched_yield();
+    }
+
+    return false;
+}
+
+/*
+ * Function      : relay_stats_n_counters
+ * Responsiblity : Number of counters used by a record kind.
+ */
+uint32_t relay_stats_n_counters(enum relay_stats_kind kind)
+{
+    switch (kind) {
+    case RELAY_STATS_KIND_UDPFWD:
+        return RELAY_STATS_UDPFWD_MAX_COUNTER;
+    case RELAY_STATS_KIND_DHCPV6R:
+        return RELAY_STATS_DHCPV6R_MAX_COUNTER;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Function      : relay_stats_counter_name
+ * Responsiblity : Name of a counter of a record kind.
+ */
+const char *relay_stats_counter_name(enum relay_stats_kind kind,
+                                     uint32_t counter)
+{
+    if (counter >= relay_stats_n_counters(kind))
+        return NULL;
+
+    return (RELAY_STATS_KIND_UDPFWD == kind) ? udpfwd_counter_names[counter]
+                                             : dhcpv6r_counter_names[counter];
+}
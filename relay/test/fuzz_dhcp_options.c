@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: fuzz_dhcp_options.c
+ */
+
+/*
+ * Fuzz target of the DHCP option scanners. The input is used as:
+ *
+ * - an option field for dhcpScanOpt(), in a buffer of its exact size,
+ * - a DHCP payload received by the relay for dhcpPickupOpt(), looking up
+ *   the options the relay reads, and the relay agent information option
+ *   found is checked by dhcp_relay_validate_agent_option() for both
+ *   remote-id types.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/ip.h>
+
+#include "util.h"
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "relay_fuzz.h"
+
+/* Options looked up by the relay */
+static const uint8_t fuzz_tags[] = {
+    DHCP_MSGTYPE, DHCP_SERVER_ID, DHCP_MAXMSGSIZE, DHCP_AGENT_OPTIONS,
+};
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char ifName[] = RELAY_FUZZ_CLIENT_INTF;
+    DHCP_OPTION_82_OPTIONS info;
+    struct dhcp_packet *dhcp;
+    uint8_t *field, *pkt, *opt, overload = 0;
+    size_t iter;
+
+    relay_fuzz_env_init();
+
+    /* Option field */
+    field = xmemdup(data, size);
+    for (iter = 0; iter < ARRAY_SIZE(fuzz_tags); iter++) {
+        dhcpScanOpt(field, field + size, fuzz_tags[iter], &overload);
+    }
+    free(field);
+
+    /* DHCP payload, as udpfwd_ctrl() hands it to the DHCP relay */
+    if (size < DHCP_MIN_PKTLEN) {
+        return 0;
+    }
+    pkt = relay_fuzz_env_packet(data, size, sizeof(struct ip)
+                                            + UDPHDR_LENGTH);
+    if (NULL == pkt) {
+        return 0;
+    }
+    dhcp = (struct dhcp_packet *) (pkt + sizeof(struct ip) + UDPHDR_LENGTH);
+
+    for (iter = 0; iter < ARRAY_SIZE(fuzz_tags); iter++) {
+        opt = dhcpPickupOpt(dhcp, size, fuzz_tags[iter]);
+        if ((NULL == opt) || (DHCP_AGENT_OPTIONS != fuzz_tags[iter])) {
+            continue;
+        }
+
+        memset(&info, 0, sizeof info);
+        dhcp_relay_validate_agent_option((const uint8_t *) OPTBODY(opt),
+                                         DHCPOPTLEN(opt), ifName, &info,
+                                         REMOTE_ID_MAC);
+        dhcp_relay_validate_agent_option((const uint8_t *) OPTBODY(opt),
+                                         DHCPOPTLEN(opt), ifName, &info,
+                                         REMOTE_ID_IP);
+    }
+
+    return 0;
+}
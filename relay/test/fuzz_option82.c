@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: fuzz_option82.c
+ */
+
+/*
+ * Fuzz target of the option 82 rewrite,
+ * process_dhcp_relay_option82_message(). The input is a configuration
+ * selector byte followed by a DHCP payload. The target puts the payload
+ * behind IP and UDP headers udpfwd_ctrl() accepts, in the receive buffer,
+ * and checks that the rewritten datagram is consistent and stays within
+ * the buffer.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "util.h"
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "relay_fuzz.h"
+
+/* IP header length with RELAY_FUZZ_IP_OPTIONS */
+#define FUZZ_IP_HL_OPTIONS 15
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char ifName[] = RELAY_FUZZ_CLIENT_INTF;
+    DHCP_OPTION_82_OPTIONS info;
+    OPTION82_RESULT_t result;
+    struct dhcp_packet *dhcp;
+    struct udphdr *udph;
+    struct in_addr addr;
+    struct ip *iph;
+    IP_ADDRESS bootp_gw = 0;
+    uint8_t *pkt, selector;
+    size_t hdr_len, dhcp_len;
+
+    relay_fuzz_env_init();
+
+    if (size < 1 + DHCP_MIN_PKTLEN) {
+        return 0;
+    }
+    selector = data[0];
+    dhcp_len = size - 1;
+    hdr_len = ((selector & RELAY_FUZZ_IP_OPTIONS)
+               ? FUZZ_IP_HL_OPTIONS * 4 : sizeof(struct ip)) + UDPHDR_LENGTH;
+
+    pkt = relay_fuzz_env_packet(data + 1, dhcp_len, hdr_len);
+    if (NULL == pkt) {
+        return 0;
+    }
+    relay_fuzz_env_config(selector);
+
+    iph = (struct ip *) pkt;
+    iph->ip_v = IPVERSION;
+    iph->ip_hl = (hdr_len - UDPHDR_LENGTH) / 4;
+    iph->ip_len = htons(hdr_len + dhcp_len);
+    iph->ip_ttl = IPDEFTTL;
+    iph->ip_p = IPPROTO_UDP;
+    if (iph->ip_hl > sizeof(struct ip) / 4) {
+        memset(pkt + sizeof(struct ip), IPOPT_NOP,
+               iph->ip_hl * 4 - sizeof(struct ip));
+    }
+
+    udph = (struct udphdr *) (pkt + iph->ip_hl * 4);
+    udph->uh_ulen = htons(UDPHDR_LENGTH + dhcp_len);
+    udph->uh_dport = htons(DHCPS_PORT);
+    dhcp = (struct dhcp_packet *) (pkt + hdr_len);
+
+    memset(&info, 0, sizeof info);
+    if (BOOTREQUEST == dhcp->op) {
+        udph->uh_sport = htons(DHCPC_PORT);
+        inet_pton(AF_INET, RELAY_FUZZ_CLIENT_IP, &addr);
+        info.ip_addr = addr.s_addr;
+        if (selector & RELAY_FUZZ_BOOTP_GW) {
+            inet_pton(AF_INET, RELAY_FUZZ_BOOTP_GW_IP, &addr);
+            bootp_gw = addr.s_addr;
+        }
+    } else {
+        udph->uh_sport = htons(DHCPS_PORT);
+    }
+
+    result = process_dhcp_relay_option82_message(pkt, &info,
+                                                 RELAY_FUZZ_CLIENT_IFINDEX,
+                                                 ifName, bootp_gw);
+    if (DROPPED == result) {
+        return 0;
+    }
+
+    /* The relay transmits ip_len bytes of the receive buffer */
+    if ((ntohs(iph->ip_len) > RECV_BUFFER_SIZE)
+        || (ntohs(iph->ip_len) != iph->ip_hl * 4 + ntohs(udph->uh_ulen))
+        || (DHCP_PKTLEN(udph) < (int32_t) DHCP_MIN_PKTLEN)) {
+        ovs_abort(0, "inconsistent datagram, ip_len %u, uh_ulen %u",
+                  ntohs(iph->ip_len), ntohs(udph->uh_ulen));
+    }
+
+    /* Message type lookup of the reply path, on the rewritten options */
+    dhcpPickupOpt(dhcp, DHCP_PKTLEN(udph), DHCP_MSGTYPE);
+    return 0;
+}
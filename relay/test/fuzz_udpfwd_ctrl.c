@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: fuzz_udpfwd_ctrl.c
+ */
+
+/*
+ * Fuzz target of the receive dispatch, udpfwd_ctrl(). The input is a
+ * configuration selector byte followed by a raw IPv4 packet, received
+ * on the interface of its source subnet (the client interface for
+ * unknown sources). The packets the relay transmits must come from the
+ * receive buffer.
+ */
+
+#include <netinet/ip.h>
+
+#include "util.h"
+#include "udpfwd.h"
+#include "relay_test.h"
+#include "relay_fuzz.h"
+
+/*
+ * Function      : fuzz_tx
+ * Responsiblity : Transmit handler checking the size of relayed packets
+ * Parameters    : pkt - IPv4 packet
+ *                 size - packet size
+ *                 aux - unused
+ * Return        : none
+ */
+static void fuzz_tx(const void *pkt OVS_UNUSED, size_t size,
+                    void *aux OVS_UNUSED)
+{
+    if (size > RECV_BUFFER_SIZE) {
+        ovs_abort(0, "relayed %"PRIuSIZE" bytes from the receive buffer",
+                  size);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const struct relay_test_intf *intf;
+    struct in_pktinfo pktInfo;
+    struct ip *iph;
+    uint8_t *pkt;
+
+    relay_fuzz_env_init();
+
+    if (size < 1) {
+        return 0;
+    }
+    pkt = relay_fuzz_env_packet(data + 1, size - 1, 0);
+    if (NULL == pkt) {
+        return 0;
+    }
+    relay_fuzz_env_config(data[0]);
+    relay_test_set_tx(fuzz_tx, NULL);
+
+    /* Short inputs leave the source address cleared in the buffer, the
+     * packet is then received on the client interface */
+    iph = (struct ip *) pkt;
+    intf = relay_test_ingress(iph,
+                              relay_test_find_interface(
+                                  RELAY_FUZZ_CLIENT_INTF));
+    relay_test_pktinfo(intf, iph, &pktInfo);
+
+    udpfwd_ctrl(pkt, size - 1, &pktInfo);
+    return 0;
+}
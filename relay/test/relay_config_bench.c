@@ -0,0 +1,1029 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_config_bench.c
+ *
+ */
+
+/*
+ * relay-config-bench: measure how ops-relay copes with configuration
+ * churn. A private ovsdb-server is started on a temporary database, a
+ * writer process pushes a scripted configuration through its own IDL,
+ * and this process follows it with the relay configuration handlers, the
+ * way relay_run() does in the daemon:
+ *
+ * - setup: System, default VRF and the ports,
+ * - populate: helper addresses and broadcast forwarder servers on every
+ *   interface, in one transaction,
+ * - flap: rounds of helper list changes on a subset of the interfaces,
+ * - delete: removal of the relay configuration of all interfaces.
+ *
+ * For every phase the benchmark reports the time until the relay applied
+ * the change, the time spent in the reconfigure handlers, the resident
+ * memory and the allocations. A probe thread relays a DHCP request in a
+ * loop meanwhile, and reports how long the packet path was stalled by the
+ * configuration handlers holding the module lock.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/udp.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "dirs.h"
+#include "ovs-atomic.h"
+#include "poll-loop.h"
+#include "smap.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "openswitch-dflt.h"
+#include "udpfwd.h"
+#include "dhcp_relay.h"
+#include "dhcpv6_relay.h"
+#include "relay_common.h"
+#include "relay_reactor.h"
+#include "relay_test.h"
+
+/* Defaults of the scripted configuration */
+#define BENCH_DEFAULT_INTERFACES        10000
+#define BENCH_DEFAULT_HELPERS           8
+#define BENCH_DEFAULT_BCAST_SERVERS     2
+#define BENCH_DEFAULT_FLAP_ROUNDS       10
+#define BENCH_DEFAULT_FLAP_INTERFACES   1000
+#define BENCH_MAX_SERVERS               16
+
+/* Broadcast forwarder port of the configured servers (NetBIOS name) */
+#define BENCH_BCAST_PORT                137
+
+/* Interface of the probe packets */
+#define BENCH_PROBE_PORT                "probe"
+#define BENCH_PROBE_INTERFACE           "probe,1,10.255.255.1/24"
+
+/* A probe packet slower than this counts as a packet path stall */
+#define BENCH_STALL_NS                  1000000ULL
+
+/* Seconds to wait for ovsdb-server to create its socket */
+#define BENCH_SERVER_TIMEOUT            10
+
+/* Steps of the scripted configuration, sent to the writer */
+enum bench_step {
+    BENCH_SETUP,
+    BENCH_POPULATE,
+    BENCH_FLAP,
+    BENCH_DELETE,
+    BENCH_EXIT,
+};
+
+struct bench_cmd {
+    enum bench_step step;
+    int round;
+};
+
+struct bench_params {
+    int n_intfs;                /* configured interfaces */
+    int n_helpers;              /* dhcp-relay helpers per interface */
+    int n_bcast;                /* broadcast forwarder servers per interface */
+    int flap_rounds;            /* helper list change transactions */
+    int flap_intfs;             /* interfaces changed in each round */
+    bool dhcpv6;                /* run the DHCPv6 relay module too */
+};
+
+/* Measurements of a phase */
+struct bench_phase {
+    const char *name;
+    int pushes;                 /* transactions */
+    uint64_t latency_ns;        /* push until applied by the relay */
+    uint64_t max_latency_ns;
+    uint64_t reconf_ns;         /* time in the reconfigure handlers */
+    uint64_t max_reconf_ns;
+    uint64_t rss_kib;           /* resident memory at the end */
+    uint64_t allocs;            /* allocator calls */
+    uint64_t probes;            /* probe packets relayed */
+    uint64_t probe_max_ns;      /* slowest probe packet */
+    uint64_t stalls;            /* probe packets over BENCH_STALL_NS */
+};
+
+/* Probe thread state */
+static atomic_bool probe_stop = ATOMIC_VAR_INIT(false);
+static atomic_uint probe_phase = ATOMIC_VAR_INIT(0);
+static atomic_uint64_t probe_count = ATOMIC_VAR_INIT(0);
+static atomic_uint64_t probe_stalls = ATOMIC_VAR_INIT(0);
+static atomic_uint64_t probe_max_ns = ATOMIC_VAR_INIT(0);
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS]\n"
+           "Measure the relay configuration handlers under churn.\n\n"
+           "  -n, --interfaces=N        interfaces to configure "
+           "(default: %d)\n"
+           "  -H, --helpers=N           helper addresses per interface "
+           "(default: %d)\n"
+           "  -b, --bcast-servers=N     broadcast forwarder servers per\n"
+           "                            interface, 0 for none (default: %d)\n"
+           "  -r, --flap-rounds=N       helper list changes (default: %d)\n"
+           "  -f, --flap-interfaces=N   interfaces changed per round "
+           "(default: %d)\n"
+           "      --dhcpv6              configure IPv6 helpers and run the\n"
+           "                            DHCPv6 relay module\n"
+           "      --schema=FILE         database schema (default: %s)\n"
+           "      --ovsdb-server=PROG   ovsdb-server to run\n"
+           "      --ovsdb-tool=PROG     ovsdb-tool to create the database\n"
+           "  -v, --verbose[=SPEC]      set the log levels of the relay "
+           "modules\n"
+           "  -h, --help                display this help message\n",
+           prog, BENCH_DEFAULT_INTERFACES, BENCH_DEFAULT_HELPERS,
+           BENCH_DEFAULT_BCAST_SERVERS, BENCH_DEFAULT_FLAP_ROUNDS,
+           BENCH_DEFAULT_FLAP_INTERFACES, "PKGDATADIR/vswitch.ovsschema");
+}
+
+/*
+ * Function      : bench_spawn
+ * Responsiblity : Start a program, terminated along with the benchmark
+ * Parameters    : argv - program and arguments
+ * Return        : process id, -1 on failure
+ */
+static pid_t bench_spawn(char *const argv[])
+{
+    pid_t pid = fork();
+
+    if (0 == pid) {
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        execvp(argv[0], argv);
+        fprintf(stderr, "cannot run %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    return pid;
+}
+
+/*
+ * Function      : bench_run_program
+ * Responsiblity : Run a program to completion
+ * Parameters    : argv - program and arguments
+ * Return        : true if the program succeeded
+ */
+static bool bench_run_program(char *const argv[])
+{
+    pid_t pid = bench_spawn(argv);
+    int status;
+
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid))
+        return false;
+    return WIFEXITED(status) && (0 == WEXITSTATUS(status));
+}
+
+/*
+ * Function      : bench_start_server
+ * Responsiblity : Create a database in a directory and serve it with a
+ *                 private ovsdb-server
+ * Parameters    : dir - working directory
+ *                 schema - database schema
+ *                 server - ovsdb-server program
+ *                 tool - ovsdb-tool program
+ *                 pidp - ovsdb-server process id
+ * Return        : remote of the database, NULL on failure
+ */
+static char *bench_start_server(const char *dir, const char *schema,
+                                const char *server, const char *tool,
+                                pid_t *pidp)
+{
+    char *db = xasprintf("%s/conf.db", dir);
+    char *sock = xasprintf("%s/db.sock", dir);
+    char *remote_arg = xasprintf("--remote=punix:%s", sock);
+    char *ctl = xasprintf("--unixctl=%s/ovsdb-server.ctl", dir);
+    char *create[] = { (char *) tool, "create", db, (char *) schema, NULL };
+    char *serve[] = { (char *) server, db, remote_arg, ctl, "-vconsole:warn",
+                      NULL };
+    char *result = NULL;
+    int iter;
+
+    *pidp = -1;
+    if (!bench_run_program(create)) {
+        fprintf(stderr, "cannot create %s from %s\n", db, schema);
+        goto out;
+    }
+
+    *pidp = bench_spawn(serve);
+    if (*pidp < 0)
+        goto out;
+
+    for (iter = 0; iter < BENCH_SERVER_TIMEOUT * 10; iter++) {
+        if (0 == access(sock, F_OK)) {
+            result = xasprintf("unix:%s", sock);
+            break;
+        }
+        usleep(100000);
+    }
+    if (NULL == result)
+        fprintf(stderr, "%s did not start\n", server);
+
+out:
+    free(db);
+    free(sock);
+    free(remote_arg);
+    free(ctl);
+    return result;
+}
+
+/*
+ * Function      : bench_stop_server
+ * Responsiblity : Stop ovsdb-server and remove its files
+ * Parameters    : dir - working directory
+ *                 pid - ovsdb-server process id
+ * Return        : none
+ */
+static void bench_stop_server(const char *dir, pid_t pid)
+{
+    static const char *files[] = {
+        "conf.db", ".conf.db.~lock~", "db.sock", "ovsdb-server.ctl",
+    };
+    char *path;
+    size_t iter;
+
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+
+    for (iter = 0; iter < ARRAY_SIZE(files); iter++) {
+        path = xasprintf("%s/%s", dir, files[iter]);
+        unlink(path);
+        free(path);
+    }
+    rmdir(dir);
+}
+
+/*
+ * Function      : bench_idl_sync
+ * Responsiblity : Run an IDL until it has the contents of a database
+ *                 configuration generation (System:cur_cfg).
+ * Parameters    : widl - IDL
+ *                 cfg - generation to wait for
+ * Return        : none
+ */
+static void bench_idl_sync(struct ovsdb_idl *widl, int64_t cfg)
+{
+    const struct ovsrec_system *system;
+
+    for (;;) {
+        ovsdb_idl_run(widl);
+        system = ovsrec_system_first(widl);
+        if (system && (system->cur_cfg >= cfg))
+            return;
+        if (!ovsdb_idl_is_alive(widl))
+            ovs_fatal(0, "lost the database connection");
+        ovsdb_idl_wait(widl);
+        poll_block();
+    }
+}
+
+/*
+ * Function      : bench_commit
+ * Responsiblity : Commit a writer transaction, stamped with a new
+ *                 configuration generation
+ * Parameters    : widl - writer IDL
+ *                 txn - transaction
+ *                 cfg - generation of the transaction
+ * Return        : none
+ */
+static void bench_commit(struct ovsdb_idl *widl, struct ovsdb_idl_txn *txn,
+                         int64_t cfg)
+{
+    enum ovsdb_idl_txn_status status;
+
+    ovsrec_system_set_cur_cfg(ovsrec_system_first(widl), cfg);
+    status = ovsdb_idl_txn_commit_block(txn);
+    if ((TXN_SUCCESS != status) && (TXN_UNCHANGED != status)) {
+        ovs_fatal(0, "transaction %lld failed: %s", (long long) cfg,
+                  ovsdb_idl_txn_status_to_string(status));
+    }
+    ovsdb_idl_txn_destroy(txn);
+}
+
+/*
+ * Function      : bench_helpers
+ * Responsiblity : Build the helper list of a flap round. The helpers are
+ *                 shared by all interfaces; odd rounds replace the last one.
+ * Parameters    : buff - address storage, BENCH_MAX_SERVERS entries
+ *                 helpers - filled address pointers
+ *                 n - helpers per interface
+ *                 round - flap round, 0 before the first change
+ * Return        : none
+ */
+static void bench_helpers(char buff[][INET_ADDRSTRLEN], char **helpers,
+                          int n, int round)
+{
+    int iter;
+
+    for (iter = 0; iter < n; iter++) {
+        if ((iter == n - 1) && (round & 1)) {
+            snprintf(buff[iter], INET_ADDRSTRLEN, "198.51.100.%d", iter + 1);
+        } else {
+            snprintf(buff[iter], INET_ADDRSTRLEN, "192.0.2.%d", iter + 1);
+        }
+        helpers[iter] = buff[iter];
+    }
+}
+
+/*
+ * Function      : bench_push_setup
+ * Responsiblity : Create the System row, the default VRF and the ports.
+ *                 The probe interface gets its helpers right away.
+ * Parameters    : widl - writer IDL
+ *                 p - benchmark parameters
+ *                 cfg - generation of the transaction
+ * Return        : none
+ */
+static void bench_push_setup(struct ovsdb_idl *widl,
+                             const struct bench_params *p, int64_t cfg)
+{
+    char buff[BENCH_MAX_SERVERS][INET_ADDRSTRLEN];
+    char *helpers[BENCH_MAX_SERVERS];
+    const struct ovsrec_system *system;
+    struct ovsrec_dhcp_relay *relay;
+    struct ovsrec_port **ports;
+    struct ovsrec_vrf *vrf;
+    struct ovsdb_idl_txn *txn;
+    struct smap other_config;
+    char name[16];
+    int iter;
+
+    txn = ovsdb_idl_txn_create(widl);
+    system = ovsrec_system_first(widl);
+    if (NULL == system)
+        system = ovsrec_system_insert(txn);
+
+    smap_init(&other_config);
+    smap_add(&other_config, SYSTEM_OTHER_CONFIG_MAP_UDP_BCAST_FWD_ENABLED,
+             "true");
+    ovsrec_system_set_other_config(system, &other_config);
+    smap_destroy(&other_config);
+
+    vrf = ovsrec_vrf_insert(txn);
+    ovsrec_vrf_set_name(vrf, DEFAULT_VRF_NAME);
+    ovsrec_system_set_vrfs(system, &vrf, 1);
+
+    /* Port 0 is the probe interface */
+    ports = xcalloc(p->n_intfs + 1, sizeof *ports);
+    for (iter = 0; iter <= p->n_intfs; iter++) {
+        ports[iter] = ovsrec_port_insert(txn);
+        if (iter) {
+            snprintf(name, sizeof name, "%d", iter);
+            ovsrec_port_set_name(ports[iter], name);
+        } else {
+            ovsrec_port_set_name(ports[iter], BENCH_PROBE_PORT);
+        }
+    }
+    ovsrec_vrf_set_ports(vrf, ports, p->n_intfs + 1);
+
+    bench_helpers(buff, helpers, p->n_helpers, 0);
+    relay = ovsrec_dhcp_relay_insert(txn);
+    ovsrec_dhcp_relay_set_port(relay, ports[0]);
+    ovsrec_dhcp_relay_set_vrf(relay, vrf);
+    ovsrec_dhcp_relay_set_ipv4_ucast_server(relay, helpers, p->n_helpers);
+
+    bench_commit(widl, txn, cfg);
+    free(ports);
+}
+
+/*
+ * Function      : bench_push_populate
+ * Responsiblity : Configure the helpers and broadcast forwarder servers
+ *                 of all interfaces, in one transaction
+ * Parameters    : widl - writer IDL
+ *                 p - benchmark parameters
+ *                 cfg - generation of the transaction
+ * Return        : none
+ */
+static void bench_push_populate(struct ovsdb_idl *widl,
+                                const struct bench_params *p, int64_t cfg)
+{
+    char buff[BENCH_MAX_SERVERS][INET_ADDRSTRLEN];
+    char bcast_buff[BENCH_MAX_SERVERS][INET_ADDRSTRLEN];
+    char *helpers[BENCH_MAX_SERVERS], *bcast[BENCH_MAX_SERVERS];
+    char *helpers6[] = { "2001:db8::1" };
+    struct ovsrec_udp_bcast_forwarder_server *server;
+    const struct ovsrec_port *port;
+    const struct ovsrec_vrf *vrf;
+    struct ovsrec_dhcp_relay *relay;
+    struct ovsdb_idl_txn *txn;
+    int iter;
+
+    bench_helpers(buff, helpers, p->n_helpers, 0);
+    for (iter = 0; iter < p->n_bcast; iter++) {
+        snprintf(bcast_buff[iter], INET_ADDRSTRLEN, "192.0.2.%d", 101 + iter);
+        bcast[iter] = bcast_buff[iter];
+    }
+
+    txn = ovsdb_idl_txn_create(widl);
+    vrf = ovsrec_vrf_first(widl);
+    OVSREC_PORT_FOR_EACH (port, widl) {
+        if (!strcmp(port->name, BENCH_PROBE_PORT))
+            continue;
+
+        relay = ovsrec_dhcp_relay_insert(txn);
+        ovsrec_dhcp_relay_set_port(relay, port);
+        ovsrec_dhcp_relay_set_vrf(relay, vrf);
+        ovsrec_dhcp_relay_set_ipv4_ucast_server(relay, helpers,
+                                                p->n_helpers);
+        if (p->dhcpv6) {
+            ovsrec_dhcp_relay_set_ipv6_ucast_server(relay, helpers6,
+                                                    ARRAY_SIZE(helpers6));
+        }
+
+        if (p->n_bcast) {
+            server = ovsrec_udp_bcast_forwarder_server_insert(txn);
+            ovsrec_udp_bcast_forwarder_server_set_src_port(server, port);
+            ovsrec_udp_bcast_forwarder_server_set_dest_vrf(server, vrf);
+            ovsrec_udp_bcast_forwarder_server_set_udp_dport(server,
+                                                        BENCH_BCAST_PORT);
+            ovsrec_udp_bcast_forwarder_server_set_ipv4_ucast_server(server,
+                                                        bcast, p->n_bcast);
+        }
+    }
+    bench_commit(widl, txn, cfg);
+}
+
+/*
+ * Function      : bench_push_flap
+ * Responsiblity : Change the helper list of the first interfaces
+ * Parameters    : widl - writer IDL
+ *                 p - benchmark parameters
+ *                 round - flap round, from 1
+ *                 cfg - generation of the transaction
+ * Return        : none
+ */
+static void bench_push_flap(struct ovsdb_idl *widl,
+                            const struct bench_params *p, int round,
+                            int64_t cfg)
+{
+    char buff[BENCH_MAX_SERVERS][INET_ADDRSTRLEN];
+    char *helpers[BENCH_MAX_SERVERS];
+    const struct ovsrec_dhcp_relay *relay;
+    struct ovsdb_idl_txn *txn;
+    int index;
+
+    bench_helpers(buff, helpers, p->n_helpers, round);
+
+    txn = ovsdb_idl_txn_create(widl);
+    OVSREC_DHCP_RELAY_FOR_EACH (relay, widl) {
+        if (relay->port && str_to_int(relay->port->name, 10, &index)
+            && (index <= p->flap_intfs)) {
+            ovsrec_dhcp_relay_set_ipv4_ucast_server(relay, helpers,
+                                                    p->n_helpers);
+        }
+    }
+    bench_commit(widl, txn, cfg);
+}
+
+/*
+ * Function      : bench_push_delete
+ * Responsiblity : Remove the relay configuration of all interfaces but
+ *                 the probe interface, in one transaction
+ * Parameters    : widl - writer IDL
+ *                 cfg - generation of the transaction
+ * Return        : none
+ */
+static void bench_push_delete(struct ovsdb_idl *widl, int64_t cfg)
+{
+    const struct ovsrec_udp_bcast_forwarder_server *server;
+    const struct ovsrec_dhcp_relay *relay;
+    struct ovsdb_idl_txn *txn;
+
+    txn = ovsdb_idl_txn_create(widl);
+    OVSREC_DHCP_RELAY_FOR_EACH (relay, widl) {
+        if (relay->port && strcmp(relay->port->name, BENCH_PROBE_PORT))
+            ovsrec_dhcp_relay_delete(relay);
+    }
+    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH (server, widl) {
+        ovsrec_udp_bcast_forwarder_server_delete(server);
+    }
+    bench_commit(widl, txn, cfg);
+}
+
+/*
+ * Function      : bench_writer
+ * Responsiblity : Writer process main loop: push the requested steps and
+ *                 reply with the generation of each push once the writer
+ *                 IDL has it.
+ * Parameters    : remote - database remote
+ *                 p - benchmark parameters
+ *                 cmd_fd - step requests
+ *                 reply_fd - step replies
+ * Return        : does not return
+ */
+static void bench_writer(const char *remote, const struct bench_params *p,
+                         int cmd_fd, int reply_fd)
+{
+    struct ovsdb_idl *widl;
+    struct bench_cmd cmd;
+    unsigned int seqno;
+    int64_t cfg = 0;
+
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    widl = ovsdb_idl_create(remote, &ovsrec_idl_class, true, true);
+
+    /* Initial contents, the database may be empty */
+    seqno = ovsdb_idl_get_seqno(widl);
+    while (seqno == ovsdb_idl_get_seqno(widl)) {
+        ovsdb_idl_run(widl);
+        ovsdb_idl_wait(widl);
+        if (seqno == ovsdb_idl_get_seqno(widl))
+            poll_block();
+    }
+
+    while (read(cmd_fd, &cmd, sizeof cmd) == sizeof cmd) {
+        if (BENCH_EXIT == cmd.step)
+            break;
+
+        cfg++;
+        switch (cmd.step) {
+        case BENCH_SETUP:
+            bench_push_setup(widl, p, cfg);
+            break;
+        case BENCH_POPULATE:
+            bench_push_populate(widl, p, cfg);
+            break;
+        case BENCH_FLAP:
+            bench_push_flap(widl, p, cmd.round, cfg);
+            break;
+        case BENCH_DELETE:
+            bench_push_delete(widl, cfg);
+            break;
+        default:
+            break;
+        }
+
+        /* Later steps edit the rows of this one */
+        bench_idl_sync(widl, cfg);
+        if (write(reply_fd, &cfg, sizeof cfg) != sizeof cfg)
+            break;
+    }
+
+    ovsdb_idl_destroy(widl);
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * Function      : bench_probe_packet
+ * Responsiblity : Build the DHCPDISCOVER relayed by the probe thread
+ * Parameters    : pkt - RECV_BUFFER_SIZE bytes buffer
+ * Return        : packet size
+ */
+static int32_t bench_probe_packet(uint8_t *pkt)
+{
+    static const uint8_t options[] = {
+        0x63, 0x82, 0x53, 0x63,     /* magic cookie */
+        DHCP_MSGTYPE, 1, 1,         /* DHCPDISCOVER */
+        END,
+    };
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    int32_t size = sizeof *iph + sizeof *udph + sizeof *dhcp;
+
+    memset(pkt, 0, size);
+    iph->ip_v = 4;
+    iph->ip_hl = sizeof *iph / 4;
+    iph->ip_len = htons(size);
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_src.s_addr = INADDR_ANY;
+    iph->ip_dst.s_addr = INADDR_BROADCAST;
+
+    udph->uh_sport = htons(DHCPC_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(size - sizeof *iph);
+
+    dhcp->op = BOOTREQUEST;
+    dhcp->htype = 1;
+    dhcp->hlen = 6;
+    dhcp->xid = htonl(0x62656e63);
+    dhcp->chaddr[0] = 0x02;
+    dhcp->chaddr[5] = 0x01;
+    memcpy(dhcp->options, options, sizeof options);
+
+    return size;
+}
+
+/*
+ * Function      : bench_probe_main
+ * Responsiblity : Probe thread: relay a DHCP request in a loop and record
+ *                 the slowest packet of the current phase.
+ * Parameters    : aux - unused
+ * Return        : NULL
+ */
+static void *bench_probe_main(void *aux OVS_UNUSED)
+{
+    uint8_t template[RECV_BUFFER_SIZE], *buff;
+    const struct relay_test_intf *intf;
+    struct in_pktinfo pktInfo;
+    uint64_t start, elapsed, max = 0, orig;
+    unsigned int phase, seen = 0;
+    int32_t size;
+    bool stop;
+
+    buff = xmalloc(RECV_BUFFER_SIZE);
+    size = bench_probe_packet(template);
+    intf = relay_test_find_interface(BENCH_PROBE_PORT);
+    relay_test_pktinfo(intf, (struct ip *) template, &pktInfo);
+
+    for (;;) {
+        atomic_read_relaxed(&probe_stop, &stop);
+        if (stop)
+            break;
+
+        atomic_read_relaxed(&probe_phase, &phase);
+        if (phase != seen) {
+            seen = phase;
+            max = 0;
+        }
+
+        memcpy(buff, template, size);
+        start = relay_test_nsec();
+        udpfwd_ctrl(buff, size, &pktInfo);
+        elapsed = relay_test_nsec() - start;
+
+        atomic_add_relaxed(&probe_count, 1, &orig);
+        if (elapsed > BENCH_STALL_NS)
+            atomic_add_relaxed(&probe_stalls, 1, &orig);
+        if (elapsed > max) {
+            max = elapsed;
+            atomic_store_relaxed(&probe_max_ns, max);
+        }
+    }
+
+    free(buff);
+    return NULL;
+}
+
+/*
+ * Function      : bench_reader_sync
+ * Responsiblity : Follow the database until the relay applied a
+ *                 configuration generation, running the reconfigure
+ *                 handlers like relay_run().
+ * Parameters    : cfg - generation to wait for
+ *                 dhcpv6 - run the DHCPv6 relay handlers
+ *                 reply_fd - writer replies
+ *                 phase - measurements
+ * Return        : none
+ */
+static void bench_reader_sync(int64_t cfg, bool dhcpv6, int reply_fd,
+                              struct bench_phase *phase)
+{
+    const struct ovsrec_system *system;
+    uint32_t new_idl_seqno;
+    uint64_t start, elapsed;
+    bool replied = false;
+    int64_t reply;
+
+    for (;;) {
+        ovsdb_idl_run(idl);
+
+        new_idl_seqno = ovsdb_idl_get_seqno(idl);
+        if (new_idl_seqno != idl_seqno) {
+            start = relay_test_nsec();
+            udpfwd_reconfigure();
+            if (dhcpv6)
+                dhcpv6r_reconfigure();
+            ovsdb_idl_track_clear(idl);
+            idl_seqno = new_idl_seqno;
+            elapsed = relay_test_nsec() - start;
+
+            phase->reconf_ns += elapsed;
+            phase->max_reconf_ns = MAX(phase->max_reconf_ns, elapsed);
+        }
+
+        system = ovsrec_system_first(idl);
+        if (replied && system && (system->cur_cfg >= cfg))
+            return;
+
+        /* The writer replies once the push is committed; it is only
+         * waited for to notice a failed writer */
+        if (!replied) {
+            struct pollfd pfd = { .fd = reply_fd, .events = POLLIN };
+
+            if (poll(&pfd, 1, 0) > 0) {
+                if ((read(reply_fd, &reply, sizeof reply) != sizeof reply)
+                    || (reply != cfg)) {
+                    ovs_fatal(0, "configuration writer failed");
+                }
+                replied = true;
+                continue;
+            }
+            poll_fd_wait(reply_fd, POLLIN);
+        }
+
+        ovsdb_idl_wait(idl);
+        poll_block();
+    }
+}
+
+/*
+ * Function      : bench_phase_begin
+ * Responsiblity : Start measuring a phase
+ * Parameters    : phase - measurements
+ *                 name - phase name
+ * Return        : none
+ */
+static void bench_phase_begin(struct bench_phase *phase, const char *name)
+{
+    unsigned int orig;
+
+    memset(phase, 0, sizeof *phase);
+    phase->name = name;
+    phase->allocs = relay_test_allocations();
+    atomic_read_relaxed(&probe_count, &phase->probes);
+    atomic_read_relaxed(&probe_stalls, &phase->stalls);
+
+    atomic_store_relaxed(&probe_max_ns, 0);
+    atomic_add_relaxed(&probe_phase, 1, &orig);
+}
+
+/*
+ * Function      : bench_phase_end
+ * Responsiblity : Complete and print the measurements of a phase
+ * Parameters    : phase - measurements
+ * Return        : none
+ */
+static void bench_phase_end(struct bench_phase *phase)
+{
+    uint64_t value;
+
+    phase->allocs = relay_test_allocations() - phase->allocs;
+    phase->rss_kib = relay_test_rss_kib();
+    atomic_read_relaxed(&probe_count, &value);
+    phase->probes = value - phase->probes;
+    atomic_read_relaxed(&probe_stalls, &value);
+    phase->stalls = value - phase->stalls;
+    atomic_read_relaxed(&probe_max_ns, &phase->probe_max_ns);
+
+    printf("%-9s %6d %10.2f %10.2f %10.2f %10.2f %9llu %10llu %9llu "
+           "%11.1f %7llu\n",
+           phase->name, phase->pushes,
+           phase->latency_ns / 1e6 / MAX(phase->pushes, 1),
+           phase->max_latency_ns / 1e6,
+           phase->reconf_ns / 1e6, phase->max_reconf_ns / 1e6,
+           (unsigned long long) phase->rss_kib,
+           (unsigned long long) phase->allocs,
+           (unsigned long long) phase->probes,
+           phase->probe_max_ns / 1e3,
+           (unsigned long long) phase->stalls);
+    fflush(stdout);
+}
+
+/*
+ * Function      : bench_push
+ * Responsiblity : Request a step from the writer and wait until the relay
+ *                 applied it
+ * Parameters    : cmd_fd, reply_fd - writer pipes
+ *                 step - configuration step
+ *                 round - flap round
+ *                 cfg - generation of the step
+ *                 dhcpv6 - run the DHCPv6 relay handlers
+ *                 phase - measurements
+ * Return        : none
+ */
+static void bench_push(int cmd_fd, int reply_fd, enum bench_step step,
+                       int round, int64_t cfg, bool dhcpv6,
+                       struct bench_phase *phase)
+{
+    struct bench_cmd cmd = { .step = step, .round = round };
+    uint64_t start, elapsed;
+
+    start = relay_test_nsec();
+    if (write(cmd_fd, &cmd, sizeof cmd) != sizeof cmd)
+        ovs_fatal(errno, "cannot reach the configuration writer");
+    bench_reader_sync(cfg, dhcpv6, reply_fd, phase);
+    elapsed = relay_test_nsec() - start;
+
+    phase->pushes++;
+    phase->latency_ns += elapsed;
+    phase->max_latency_ns = MAX(phase->max_latency_ns, elapsed);
+}
+
+/*
+ * Function      : bench_parse_count
+ * Responsiblity : Parse a count option
+ * Parameters    : prog - program name
+ *                 arg - option value
+ *                 min, max - valid range
+ *                 countp - parsed count
+ * Return        : none, exits on invalid values
+ */
+static void bench_parse_count(const char *prog, const char *arg, int min,
+                              int max, int *countp)
+{
+    if (!str_to_int(arg, 10, countp) || (*countp < min) || (*countp > max)) {
+        fprintf(stderr, "%s: %s is not between %d and %d\n", prog, arg,
+                min, max);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    enum {
+        OPT_DHCPV6 = UCHAR_MAX + 1,
+        OPT_SCHEMA,
+        OPT_OVSDB_SERVER,
+        OPT_OVSDB_TOOL,
+    };
+    static const struct option long_options[] = {
+        {"interfaces",      required_argument, NULL, 'n'},
+        {"helpers",         required_argument, NULL, 'H'},
+        {"bcast-servers",   required_argument, NULL, 'b'},
+        {"flap-rounds",     required_argument, NULL, 'r'},
+        {"flap-interfaces", required_argument, NULL, 'f'},
+        {"dhcpv6",          no_argument,       NULL, OPT_DHCPV6},
+        {"schema",          required_argument, NULL, OPT_SCHEMA},
+        {"ovsdb-server",    required_argument, NULL, OPT_OVSDB_SERVER},
+        {"ovsdb-tool",      required_argument, NULL, OPT_OVSDB_TOOL},
+        {"verbose",         optional_argument, NULL, 'v'},
+        {"help",            no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct bench_params p = {
+        .n_intfs = BENCH_DEFAULT_INTERFACES,
+        .n_helpers = BENCH_DEFAULT_HELPERS,
+        .n_bcast = BENCH_DEFAULT_BCAST_SERVERS,
+        .flap_rounds = BENCH_DEFAULT_FLAP_ROUNDS,
+        .flap_intfs = BENCH_DEFAULT_FLAP_INTERFACES,
+        .dhcpv6 = false,
+    };
+    const char *server = "ovsdb-server", *tool = "ovsdb-tool";
+    char *schema = NULL, *remote, dir[] = "/tmp/relay-config-bench.XXXXXX";
+    int cmd_pipe[2], reply_pipe[2], c, round;
+    struct bench_cmd cmd = { .step = BENCH_EXIT };
+    struct bench_phase phase;
+    pid_t server_pid, writer_pid;
+    pthread_t probe;
+    int64_t cfg = 0;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_WARN);
+
+    while ((c = getopt_long(argc, argv, "n:H:b:r:f:v::h", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            bench_parse_count(argv[0], optarg, 1, 1000000, &p.n_intfs);
+            break;
+        case 'H':
+            bench_parse_count(argv[0], optarg, 1, BENCH_MAX_SERVERS,
+                              &p.n_helpers);
+            break;
+        case 'b':
+            bench_parse_count(argv[0], optarg, 0, BENCH_MAX_SERVERS,
+                              &p.n_bcast);
+            break;
+        case 'r':
+            bench_parse_count(argv[0], optarg, 0, INT_MAX, &p.flap_rounds);
+            break;
+        case 'f':
+            bench_parse_count(argv[0], optarg, 1, INT_MAX, &p.flap_intfs);
+            break;
+        case OPT_DHCPV6:
+            p.dhcpv6 = true;
+            break;
+        case OPT_SCHEMA:
+            schema = xstrdup(optarg);
+            break;
+        case OPT_OVSDB_SERVER:
+            server = optarg;
+            break;
+        case OPT_OVSDB_TOOL:
+            tool = optarg;
+            break;
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (NULL == schema)
+        schema = xasprintf("%s/vswitch.ovsschema", ovs_pkgdatadir());
+
+    ovsrec_init();
+
+    if (NULL == mkdtemp(dir))
+        ovs_fatal(errno, "cannot create a working directory");
+    remote = bench_start_server(dir, schema, server, tool, &server_pid);
+    if (NULL == remote) {
+        bench_stop_server(dir, server_pid);
+        return EXIT_FAILURE;
+    }
+
+    /* The writer is a separate process, so that only the relay side of
+     * the configuration is measured here */
+    if (pipe(cmd_pipe) || pipe(reply_pipe))
+        ovs_fatal(errno, "pipe failed");
+    writer_pid = fork();
+    if (writer_pid < 0)
+        ovs_fatal(errno, "fork failed");
+    if (0 == writer_pid) {
+        close(cmd_pipe[1]);
+        close(reply_pipe[0]);
+        bench_writer(remote, &p, cmd_pipe[0], reply_pipe[1]);
+    }
+    close(cmd_pipe[0]);
+    close(reply_pipe[1]);
+
+    /* Relay side, set up as by the daemon */
+    idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
+    idl_seqno = ovsdb_idl_get_seqno(idl);
+    ovsdb_idl_add_table(idl, &ovsrec_table_system);
+    ovsdb_idl_add_column(idl, &ovsrec_system_col_cur_cfg);
+    ovsdb_idl_add_column(idl, &ovsrec_system_col_other_config);
+    udpfwd_init();
+    if (p.dhcpv6) {
+        relay_reactor_init(1);
+        dhcpv6r_init();
+    }
+
+    relay_test_add_interface(BENCH_PROBE_INTERFACE);
+    pthread_create(&probe, NULL, bench_probe_main, NULL);
+
+    printf("interfaces=%d helpers=%d bcast-servers=%d flap-rounds=%d "
+           "flap-interfaces=%d dhcpv6=%s\n\n",
+           p.n_intfs, p.n_helpers, p.n_bcast, p.flap_rounds, p.flap_intfs,
+           p.dhcpv6 ? "yes" : "no");
+    printf("%-9s %6s %10s %10s %10s %10s %9s %10s %9s %11s %7s\n",
+           "phase", "pushes", "avg_ms", "max_ms", "reconf_ms",
+           "max_rcf_ms", "rss_kib", "allocs", "probes", "probe_max_us",
+           "stalls");
+
+    bench_phase_begin(&phase, "setup");
+    bench_push(cmd_pipe[1], reply_pipe[0], BENCH_SETUP, 0, ++cfg, p.dhcpv6,
+               &phase);
+    bench_phase_end(&phase);
+
+    bench_phase_begin(&phase, "populate");
+    bench_push(cmd_pipe[1], reply_pipe[0], BENCH_POPULATE, 0, ++cfg,
+               p.dhcpv6, &phase);
+    bench_phase_end(&phase);
+
+    if (p.flap_rounds) {
+        bench_phase_begin(&phase, "flap");
+        for (round = 1; round <= p.flap_rounds; round++) {
+            bench_push(cmd_pipe[1], reply_pipe[0], BENCH_FLAP, round, ++cfg,
+                       p.dhcpv6, &phase);
+        }
+        bench_phase_end(&phase);
+    }
+
+    bench_phase_begin(&phase, "delete");
+    bench_push(cmd_pipe[1], reply_pipe[0], BENCH_DELETE, 0, ++cfg, p.dhcpv6,
+               &phase);
+    bench_phase_end(&phase);
+
+    /* Tear down */
+    atomic_store_relaxed(&probe_stop, true);
+    pthread_join(probe, NULL);
+    if (write(cmd_pipe[1], &cmd, sizeof cmd) == sizeof cmd)
+        waitpid(writer_pid, NULL, 0);
+    if (p.dhcpv6) {
+        relay_reactor_exit();
+        dhcpv6r_exit();
+    }
+    udpfwd_exit();
+    ovsdb_idl_destroy(idl);
+    bench_stop_server(dir, server_pid);
+
+    free(remote);
+    free(schema);
+    return EXIT_SUCCESS;
+}
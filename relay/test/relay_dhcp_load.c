@@ -0,0 +1,1209 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_dhcp_load.c
+ *
+ */
+
+/*
+ * relay-dhcp-load: DHCP load generator for soak and scale tests of a
+ * running ops-relay on a Linux host. The relay sits between two network
+ * namespaces, typically connected with veth pairs:
+ *
+ * - the client side emulates N DHCP clients on one interface. Requests are
+ *   sent as broadcast Ethernet frames from the MAC address of each client,
+ *   and replies are captured in promiscuous mode, so unicast replies to
+ *   the leased addresses are seen as well.
+ * - the server side is a DHCP server stub answering every relayed request
+ *   from a lease derived from the client MAC address. It echoes the relay
+ *   agent information option as RFC 3046 requires.
+ *
+ * Clients run DORA (discover, offer, request, ack), rebinding renewals and
+ * INFORMs at the configured rates. Each request is a transaction waiting
+ * for one reply; the report gives the throughput, the lost transactions
+ * and the reply latency percentiles of each transaction type.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if_arp.h>
+#include <netinet/udp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "ovs-atomic.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "udpfwd.h"
+#include "udpfwd_util.h"
+#include "dhcp_relay.h"
+#include "relay_netns.h"
+#include "relay_test.h"
+
+/* Defaults of the load */
+#define LOAD_DEFAULT_CLIENTS        1000
+#define LOAD_DEFAULT_DURATION       10
+#define LOAD_DEFAULT_TIMEOUT_MS     2000
+#define LOAD_DEFAULT_LEASE_PLEN     16
+
+/* Requests sent between two receive rounds */
+#define LOAD_SEND_BURST             256
+
+/* Receive buffer of the client and server sockets */
+#define LOAD_SOCK_BUFFER            (8 * 1024 * 1024)
+
+/* Lease time handed out by the server stub, seconds */
+#define LOAD_LEASE_TIME             3600
+
+/* Client index in the transaction id; the high byte is a sequence
+ * number, so that late replies of an earlier transaction are told apart */
+#define LOAD_MAX_CLIENTS            (1 << 24)
+#define LOAD_XID(INDEX, SEQ)        (((uint32_t) (SEQ) << 24) | (INDEX))
+#define LOAD_XID_INDEX(XID)         ((XID) & (LOAD_MAX_CLIENTS - 1))
+
+/* DHCP options used by the clients and the server stub */
+#define LOAD_OPT_SUBNET_MASK        ((uint8_t)  1)
+#define LOAD_OPT_REQUESTED_IP       ((uint8_t) 50)
+#define LOAD_OPT_LEASE_TIME         ((uint8_t) 51)
+
+/* Client state */
+enum load_state {
+    LOAD_INIT,                  /* no lease */
+    LOAD_SELECTING,             /* discover sent */
+    LOAD_REQUESTING,            /* request for an offer sent */
+    LOAD_BOUND,                 /* leased, idle */
+    LOAD_REBINDING,             /* renewal request sent */
+    LOAD_INFORMING,             /* inform sent */
+};
+
+/* Transaction types, each waiting for one reply */
+enum load_txn {
+    LOAD_TXN_DISCOVER,          /* discover, offer */
+    LOAD_TXN_SELECT,            /* request, ack */
+    LOAD_TXN_RENEW,             /* rebinding request, ack */
+    LOAD_TXN_INFORM,            /* inform, ack */
+    LOAD_TXN_MAX
+};
+
+static const char *load_txn_names[LOAD_TXN_MAX] = {
+    "discover", "select", "renew", "inform",
+};
+
+struct load_client {
+    uint32_t xid;               /* transaction in progress */
+    uint8_t state;              /* enum load_state */
+    uint8_t seq;                /* transaction sequence number */
+    struct in_addr addr;        /* offered or leased address */
+    struct in_addr server_id;   /* server of the offer or lease */
+    uint64_t sent_ns;           /* send time of the transaction */
+};
+
+/* Transaction waiting for a reply, in send order */
+struct load_pending {
+    uint32_t index;
+    uint32_t xid;
+    uint64_t deadline_ns;
+};
+
+struct load_stats {
+    uint64_t sent;
+    uint64_t replied;
+    uint64_t naks;
+    uint64_t lost;
+    uint32_t *latency_us;       /* reply latencies */
+    size_t n_latency;
+    size_t allocated_latency;
+};
+
+struct load_params {
+    const char *client_netns;
+    const char *client_intf;
+    const char *server_netns;
+    struct in_addr server_addr;
+    bool server;                /* run the server stub */
+    int n_clients;
+    int discover_rate;          /* DORA per second, 0 for all at once */
+    int renew_rate;             /* renewals per second */
+    int inform_rate;            /* informs per second */
+    int duration;               /* seconds */
+    int timeout_ms;
+    int lease_plen;             /* prefix length of the client subnet */
+    bool option82;              /* clients add a relay agent option */
+    bool broadcast;             /* clients ask for broadcast replies */
+};
+
+/* Client side state */
+struct load_gen {
+    const struct load_params *p;
+    int sock;                   /* packet socket of the client interface */
+    int ifIndex;
+    struct load_client *clients;
+    struct load_pending *pending;
+    size_t pending_head, n_pending, allocated_pending;
+    size_t outstanding;         /* transactions waiting for a reply */
+    uint32_t discover_cursor, renew_cursor, inform_cursor;
+    uint64_t discovers, renews, informs;    /* transactions started */
+    uint64_t bound;             /* completed DORAs */
+    struct load_stats stats[LOAD_TXN_MAX];
+};
+
+/* Server stub state */
+struct load_server {
+    int sock;
+    struct in_addr addr;
+    int lease_plen;
+    atomic_bool stop;
+    atomic_uint64_t requests;
+    atomic_uint64_t requests_option82;
+    atomic_uint64_t replies;
+};
+
+static const uint8_t load_cookie[MAGIC_LEN] = RFC1048_MAGIC;
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS]\n"
+           "Emulate DHCP clients and a DHCP server around ops-relay.\n\n"
+           "  -i, --client-interface=IF  interface of the clients (required)\n"
+           "      --client-netns=NAME    namespace of the client interface\n"
+           "  -s, --server-address=IP    address of the server stub, the\n"
+           "                             helper address of the relay\n"
+           "      --server-netns=NAME    namespace of the server stub\n"
+           "      --no-server            use an external DHCP server\n"
+           "  -n, --clients=N            emulated clients (default: %d)\n"
+           "      --discover-rate=N      DORA per second, 0 to start all\n"
+           "                             clients at once (default: 0)\n"
+           "      --renew-rate=N         renewals per second (default: 0)\n"
+           "      --inform-rate=N        informs per second (default: 0)\n"
+           "  -d, --duration=SEC         load duration (default: %d)\n"
+           "  -t, --timeout=MS           reply timeout (default: %d)\n"
+           "      --lease-plen=N         prefix length of the client subnet\n"
+           "                             (default: %d)\n"
+           "      --option82             clients add a relay agent option,\n"
+           "                             as a snooping access switch does\n"
+           "      --broadcast            clients ask for broadcast replies\n"
+           "  -v, --verbose[=SPEC]       set the log levels\n"
+           "  -h, --help                 display this help message\n",
+           prog, LOAD_DEFAULT_CLIENTS, LOAD_DEFAULT_DURATION,
+           LOAD_DEFAULT_TIMEOUT_MS, LOAD_DEFAULT_LEASE_PLEN);
+}
+
+/*
+ * Function      : load_lease
+ * Responsiblity : Address leased to a client, in the subnet of the relay
+ *                 interface the request came from
+ * Parameters    : giaddr - relay interface address
+ *                 plen - prefix length of the subnet
+ *                 chaddr - client hardware address
+ * Return        : leased address
+ */
+static struct in_addr load_lease(struct in_addr giaddr, int plen,
+                                 const uint8_t *chaddr)
+{
+    uint32_t mask = plen ? htonl(~0U << (32 - plen)) : 0;
+    uint32_t host = ((uint32_t) chaddr[3] << 16) | (chaddr[4] << 8)
+                    | chaddr[5];
+    struct in_addr addr;
+
+    /* Host 0 is the subnet, skip the relay address */
+    addr.s_addr = (giaddr.s_addr & mask) | (htonl(host + 1) & ~mask);
+    if (addr.s_addr == giaddr.s_addr)
+        addr.s_addr = (giaddr.s_addr & mask) | (htonl(host + 2) & ~mask);
+    return addr;
+}
+
+/*
+ * Function      : load_put_option
+ * Responsiblity : Append an option to a DHCP options field
+ * Parameters    : opt - write position
+ *                 tag - option tag
+ *                 len - option length
+ *                 data - option value
+ * Return        : next write position
+ */
+static uint8_t *load_put_option(uint8_t *opt, uint8_t tag, uint8_t len,
+                                const void *data)
+{
+    *opt++ = tag;
+    *opt++ = len;
+    memcpy(opt, data, len);
+    return opt + len;
+}
+
+/*
+ * Function      : load_msgtype
+ * Responsiblity : Get the message type of a DHCP packet
+ * Parameters    : dhcp - DHCP packet
+ *                 len - packet length
+ * Return        : message type, 0 if there is none
+ */
+static uint8_t load_msgtype(struct dhcp_packet *dhcp, int32_t len)
+{
+    uint8_t *opt;
+
+    if ((len < MINBOOTPLEN)
+        || memcmp(dhcp->options, load_cookie, MAGIC_LEN))
+        return 0;
+
+    opt = dhcpPickupOpt(dhcp, len, DHCP_MSGTYPE);
+    return (opt && (DHCPOPTLEN(opt) == 1)) ? *OPTBODY(opt) : 0;
+}
+
+/*
+ * Function      : load_server_reply
+ * Responsiblity : Build the reply of the server stub to a relayed request
+ * Parameters    : srv - server stub
+ *                 req - request
+ *                 len - request length
+ *                 type - request message type
+ *                 reply - reply buffer, sizeof(struct dhcp_packet) bytes
+ * Return        : reply length, 0 if the request is not answered
+ */
+static int32_t load_server_reply(struct load_server *srv,
+                                 struct dhcp_packet *req, int32_t len,
+                                 uint8_t type, struct dhcp_packet *reply)
+{
+    uint32_t lease_time = htonl(LOAD_LEASE_TIME);
+    uint32_t mask = htonl(~0U << (32 - srv->lease_plen));
+    uint8_t *opt, *agent;
+    uint8_t reply_type;
+
+    memset(reply, 0, sizeof *reply);
+    reply->op = BOOTREPLY;
+    reply->htype = req->htype;
+    reply->hlen = req->hlen;
+    reply->xid = req->xid;
+    reply->flags = req->flags;
+    reply->giaddr = req->giaddr;
+    memcpy(reply->chaddr, req->chaddr, DHCP_CHADDR_MAX);
+
+    switch (type) {
+    case DHCPDISCOVER:
+        reply_type = DHCPOFFER;
+        reply->yiaddr = load_lease(req->giaddr, srv->lease_plen,
+                                   req->chaddr);
+        break;
+    case DHCPREQUEST:
+        reply_type = DHCPACK;
+        reply->ciaddr = req->ciaddr;
+        reply->yiaddr = load_lease(req->giaddr, srv->lease_plen,
+                                   req->chaddr);
+        break;
+    case DHCPINFORM:
+        /* No lease, the relay delivers the ack to ciaddr */
+        reply_type = DHCPACK;
+        reply->ciaddr = req->ciaddr;
+        break;
+    default:
+        return 0;
+    }
+
+    opt = reply->options;
+    memcpy(opt, load_cookie, MAGIC_LEN);
+    opt += MAGIC_LEN;
+    opt = load_put_option(opt, DHCP_MSGTYPE, 1, &reply_type);
+    opt = load_put_option(opt, DHCP_SERVER_ID, 4, &srv->addr);
+    if (DHCPINFORM != type) {
+        opt = load_put_option(opt, LOAD_OPT_LEASE_TIME, 4, &lease_time);
+        opt = load_put_option(opt, LOAD_OPT_SUBNET_MASK, 4, &mask);
+    }
+
+    /* Echo the relay agent information (RFC 3046 2.2) */
+    agent = dhcpPickupOpt(req, len, DHCP_AGENT_OPTIONS);
+    if (agent) {
+        opt = load_put_option(opt, DHCP_AGENT_OPTIONS,
+                              (uint8_t) DHCPOPTLEN(agent), OPTBODY(agent));
+    }
+    *opt++ = END;
+
+    return MAX(opt - (uint8_t *) reply, (long) DFLTBOOTPLEN);
+}
+
+/*
+ * Function      : load_server_main
+ * Responsiblity : Server stub thread: answer relayed requests until
+ *                 stopped. Requests that did not go through a relay are
+ *                 ignored.
+ * Parameters    : aux - server stub
+ * Return        : NULL
+ */
+static void *load_server_main(void *aux)
+{
+    struct load_server *srv = aux;
+    struct dhcp_packet *req, *reply;
+    struct sockaddr_in from, to;
+    socklen_t from_len;
+    struct pollfd pfd;
+    uint64_t orig;
+    ssize_t len;
+    int32_t reply_len;
+    uint8_t type;
+    bool stop;
+
+    req = xmalloc(RECV_BUFFER_SIZE);
+    reply = xmalloc(sizeof *reply);
+    pfd.fd = srv->sock;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        atomic_read_relaxed(&srv->stop, &stop);
+        if (stop)
+            break;
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+
+        from_len = sizeof from;
+        len = recvfrom(srv->sock, req, RECV_BUFFER_SIZE, MSG_DONTWAIT,
+                       (struct sockaddr *) &from, &from_len);
+        if ((len < MINBOOTPLEN) || (BOOTREQUEST != req->op)
+            || (IP_ADDRESS_NULL == req->giaddr.s_addr))
+            continue;
+
+        type = load_msgtype(req, len);
+        atomic_add_relaxed(&srv->requests, 1, &orig);
+        if (dhcpPickupOpt(req, len, DHCP_AGENT_OPTIONS))
+            atomic_add_relaxed(&srv->requests_option82, 1, &orig);
+
+        reply_len = load_server_reply(srv, req, len, type, reply);
+        if (0 == reply_len)
+            continue;
+
+        /* Replies go to the relay agent, on the server port */
+        memset(&to, 0, sizeof to);
+        to.sin_family = AF_INET;
+        to.sin_addr = req->giaddr;
+        to.sin_port = htons(DHCPS_PORT);
+        if (sendto(srv->sock, reply, reply_len, 0, (struct sockaddr *) &to,
+                   sizeof to) == reply_len) {
+            atomic_add_relaxed(&srv->replies, 1, &orig);
+        }
+    }
+
+    free(req);
+    free(reply);
+    return NULL;
+}
+
+/*
+ * Function      : load_server_open
+ * Responsiblity : Open the socket of the server stub
+ * Parameters    : srv - server stub
+ *                 nsFd - namespace of the server, -1 for the current one
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+static bool load_server_open(struct load_server *srv, int nsFd)
+{
+    struct sockaddr_in addr;
+    int on = 1, size = LOAD_SOCK_BUFFER;
+
+    srv->sock = relay_netns_socket(nsFd, AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (srv->sock < 0)
+        return false;
+
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(DHCPS_PORT);
+    setsockopt(srv->sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    setsockopt(srv->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+    return 0 == bind(srv->sock, (struct sockaddr *) &addr, sizeof addr);
+}
+
+/*
+ * Function      : load_client_open
+ * Responsiblity : Open the packet socket of the client interface, in
+ *                 promiscuous mode to see unicast replies to the leases
+ * Parameters    : gen - client side
+ *                 nsFd - namespace of the clients, -1 for the current one
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+static bool load_client_open(struct load_gen *gen, int nsFd)
+{
+    struct packet_mreq mreq;
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    int size = LOAD_SOCK_BUFFER;
+
+    gen->sock = relay_netns_socket(nsFd, AF_PACKET, SOCK_RAW,
+                                   htons(ETH_P_IP));
+    if (gen->sock < 0)
+        return false;
+
+    /* The index is looked up in the namespace of the socket */
+    memset(&ifr, 0, sizeof ifr);
+    ovs_strzcpy(ifr.ifr_name, gen->p->client_intf, sizeof ifr.ifr_name);
+    if (ioctl(gen->sock, SIOCGIFINDEX, &ifr) < 0)
+        return false;
+    gen->ifIndex = ifr.ifr_ifindex;
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = gen->ifIndex;
+    if (bind(gen->sock, (struct sockaddr *) &sll, sizeof sll) < 0)
+        return false;
+
+    memset(&mreq, 0, sizeof mreq);
+    mreq.mr_ifindex = gen->ifIndex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    setsockopt(gen->sock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+               sizeof mreq);
+    setsockopt(gen->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+    fcntl(gen->sock, F_SETFL, fcntl(gen->sock, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+/*
+ * Function      : load_client_mac
+ * Responsiblity : Hardware address of an emulated client, locally
+ *                 administered, with the client index in the low bytes
+ * Parameters    : index - client index
+ *                 mac - address
+ * Return        : none
+ */
+static void load_client_mac(uint32_t index, uint8_t *mac)
+{
+    mac[0] = 0x02;
+    mac[1] = 0x4c;
+    mac[2] = 0x44;
+    mac[3] = index >> 16;
+    mac[4] = index >> 8;
+    mac[5] = index;
+}
+
+/*
+ * Function      : load_send
+ * Responsiblity : Send a client request as a broadcast frame and record
+ *                 the transaction
+ * Parameters    : gen - client side
+ *                 index - client index
+ *                 type - DHCP message type
+ *                 txn - transaction type
+ * Return        : true if the request was sent
+ */
+static bool load_send(struct load_gen *gen, uint32_t index, uint8_t type,
+                      enum load_txn txn)
+{
+    uint8_t frame[ETH_HLEN + sizeof(struct ip) + sizeof(struct udphdr)
+                  + sizeof(struct dhcp_packet)];
+    struct load_client *client = &gen->clients[index];
+    struct ether_header *eth = (struct ether_header *) frame;
+    struct ip *iph = (struct ip *) (eth + 1);
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    uint32_t circuit_id = htonl(index);
+    uint8_t agent[2 + sizeof circuit_id];
+    struct load_pending *pending;
+    struct sockaddr_ll sll;
+    uint8_t *opt;
+
+    memset(frame, 0, sizeof frame);
+    memset(eth->ether_dhost, 0xff, ETH_ALEN);
+    load_client_mac(index, eth->ether_shost);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    /* A zero transaction id stands for none */
+    if (0 == ++client->seq)
+        client->seq = 1;
+    client->xid = LOAD_XID(index, client->seq);
+
+    dhcp->op = BOOTREQUEST;
+    dhcp->htype = ARPHRD_ETHER;
+    dhcp->hlen = ETH_ALEN;
+    dhcp->xid = htonl(client->xid);
+    if (gen->p->broadcast)
+        dhcp->flags = htons(UDPFWD_DHCP_BROADCAST_FLAG);
+    load_client_mac(index, dhcp->chaddr);
+
+    opt = dhcp->options;
+    memcpy(opt, load_cookie, MAGIC_LEN);
+    opt += MAGIC_LEN;
+    opt = load_put_option(opt, DHCP_MSGTYPE, 1, &type);
+    switch (txn) {
+    case LOAD_TXN_SELECT:
+        opt = load_put_option(opt, LOAD_OPT_REQUESTED_IP, 4, &client->addr);
+        opt = load_put_option(opt, DHCP_SERVER_ID, 4, &client->server_id);
+        break;
+    case LOAD_TXN_RENEW:
+    case LOAD_TXN_INFORM:
+        dhcp->ciaddr = client->addr;
+        break;
+    default:
+        break;
+    }
+    if (gen->p->option82) {
+        agent[0] = DHCP_RAI_CIRCUIT_ID;
+        agent[1] = sizeof circuit_id;
+        memcpy(&agent[2], &circuit_id, sizeof circuit_id);
+        opt = load_put_option(opt, DHCP_AGENT_OPTIONS, sizeof agent, agent);
+    }
+    *opt = END;
+
+    udph->uh_sport = htons(DHCPC_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(sizeof *udph + sizeof *dhcp);
+
+    iph->ip_v = 4;
+    iph->ip_hl = sizeof *iph / 4;
+    iph->ip_len = htons(sizeof *iph + sizeof *udph + sizeof *dhcp);
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_src = dhcp->ciaddr;
+    iph->ip_dst.s_addr = INADDR_BROADCAST;
+    iph->ip_sum = in_cksum((uint16_t *) iph, sizeof *iph, 0);
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = gen->ifIndex;
+    sll.sll_halen = ETH_ALEN;
+    memset(sll.sll_addr, 0xff, ETH_ALEN);
+
+    client->sent_ns = relay_test_nsec();
+    if (sendto(gen->sock, frame, sizeof frame, 0, (struct sockaddr *) &sll,
+               sizeof sll) != sizeof frame) {
+        return false;
+    }
+    gen->stats[txn].sent++;
+    gen->outstanding++;
+
+    /* The timeout is the same for all transactions, the queue is in
+     * deadline order */
+    if (gen->pending_head + gen->n_pending == gen->allocated_pending) {
+        if (gen->pending_head) {
+            memmove(gen->pending, &gen->pending[gen->pending_head],
+                    gen->n_pending * sizeof *gen->pending);
+            gen->pending_head = 0;
+        } else {
+            gen->pending = x2nrealloc(gen->pending, &gen->allocated_pending,
+                                      sizeof *gen->pending);
+        }
+    }
+    pending = &gen->pending[gen->pending_head + gen->n_pending++];
+    pending->index = index;
+    pending->xid = client->xid;
+    pending->deadline_ns = client->sent_ns
+                           + (uint64_t) gen->p->timeout_ms * 1000000;
+    return true;
+}
+
+/*
+ * Function      : load_txn_of
+ * Responsiblity : Transaction type of a client state
+ * Parameters    : state - client state
+ * Return        : transaction type, LOAD_TXN_MAX if none is in progress
+ */
+static enum load_txn load_txn_of(enum load_state state)
+{
+    switch (state) {
+    case LOAD_SELECTING:
+        return LOAD_TXN_DISCOVER;
+    case LOAD_REQUESTING:
+        return LOAD_TXN_SELECT;
+    case LOAD_REBINDING:
+        return LOAD_TXN_RENEW;
+    case LOAD_INFORMING:
+        return LOAD_TXN_INFORM;
+    default:
+        return LOAD_TXN_MAX;
+    }
+}
+
+/*
+ * Function      : load_complete
+ * Responsiblity : Complete the transaction in progress of a client
+ * Parameters    : gen - client side
+ *                 client - client
+ *                 txn - transaction type
+ *                 now - reply time
+ * Return        : none
+ */
+static void load_complete(struct load_gen *gen, struct load_client *client,
+                          enum load_txn txn, uint64_t now)
+{
+    struct load_stats *stats = &gen->stats[txn];
+
+    if (stats->n_latency == stats->allocated_latency) {
+        stats->latency_us = x2nrealloc(stats->latency_us,
+                                       &stats->allocated_latency,
+                                       sizeof *stats->latency_us);
+    }
+    stats->latency_us[stats->n_latency++] =
+        MIN((now - client->sent_ns) / 1000, UINT32_MAX);
+    stats->replied++;
+    gen->outstanding--;
+    client->xid = 0;
+}
+
+/*
+ * Function      : load_receive
+ * Responsiblity : Handle a captured frame: advance the client the reply
+ *                 belongs to
+ * Parameters    : gen - client side
+ *                 frame - Ethernet frame
+ *                 len - frame length
+ * Return        : none
+ */
+static void load_receive(struct load_gen *gen, uint8_t *frame, ssize_t len)
+{
+    struct ether_header *eth = (struct ether_header *) frame;
+    struct ip *iph = (struct ip *) (eth + 1);
+    struct udphdr *udph;
+    struct dhcp_packet *dhcp;
+    struct load_client *client;
+    enum load_txn txn;
+    uint32_t xid, index;
+    int32_t dhcp_len;
+    uint8_t type, *opt;
+    uint64_t now;
+
+    if ((len < (ssize_t) (ETH_HLEN + sizeof *iph + sizeof *udph))
+        || (ntohs(eth->ether_type) != ETHERTYPE_IP)
+        || (IPPROTO_UDP != iph->ip_p))
+        return;
+
+    udph = (struct udphdr *) ((uint8_t *) iph + iph->ip_hl * 4);
+    dhcp = (struct dhcp_packet *) (udph + 1);
+    dhcp_len = len - ((uint8_t *) dhcp - frame);
+    if ((ntohs(udph->uh_dport) != DHCPC_PORT) || (BOOTREPLY != dhcp->op))
+        return;
+
+    type = load_msgtype(dhcp, dhcp_len);
+    xid = ntohl(dhcp->xid);
+    index = LOAD_XID_INDEX(xid);
+    if ((index >= (uint32_t) gen->p->n_clients)
+        || (gen->clients[index].xid != xid))
+        return;
+
+    client = &gen->clients[index];
+    txn = load_txn_of(client->state);
+    if (LOAD_TXN_MAX == txn)
+        return;
+
+    now = relay_test_nsec();
+    if (DHCPNAK == type) {
+        load_complete(gen, client, txn, now);
+        gen->stats[txn].naks++;
+        client->state = LOAD_INIT;
+        return;
+    }
+
+    switch (client->state) {
+    case LOAD_SELECTING:
+        if (DHCPOFFER != type)
+            return;
+        opt = dhcpPickupOpt(dhcp, dhcp_len, DHCP_SERVER_ID);
+        if ((NULL == opt) || (DHCPOPTLEN(opt) != 4))
+            return;
+        load_complete(gen, client, txn, now);
+        client->addr = dhcp->yiaddr;
+        memcpy(&client->server_id, OPTBODY(opt), 4);
+        client->state = LOAD_REQUESTING;
+        if (!load_send(gen, index, DHCPREQUEST, LOAD_TXN_SELECT))
+            client->state = LOAD_INIT;
+        break;
+    case LOAD_REQUESTING:
+        if (DHCPACK != type)
+            return;
+        load_complete(gen, client, txn, now);
+        client->state = LOAD_BOUND;
+        gen->bound++;
+        break;
+    case LOAD_REBINDING:
+    case LOAD_INFORMING:
+        if (DHCPACK != type)
+            return;
+        load_complete(gen, client, txn, now);
+        client->state = LOAD_BOUND;
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Function      : load_expire
+ * Responsiblity : Count the transactions without a reply in time as lost.
+ *                 Clients that lost a lease request start over.
+ * Parameters    : gen - client side
+ *                 now - current time
+ * Return        : none
+ */
+static void load_expire(struct load_gen *gen, uint64_t now)
+{
+    struct load_pending *pending;
+    struct load_client *client;
+    enum load_txn txn;
+
+    while (gen->n_pending) {
+        pending = &gen->pending[gen->pending_head];
+        if (pending->deadline_ns > now)
+            break;
+        gen->pending_head++;
+        gen->n_pending--;
+
+        client = &gen->clients[pending->index];
+        if (client->xid != pending->xid)
+            continue;
+
+        txn = load_txn_of(client->state);
+        gen->stats[txn].lost++;
+        gen->outstanding--;
+        client->xid = 0;
+        client->state = ((LOAD_REBINDING == client->state)
+                         || (LOAD_INFORMING == client->state))
+                        ? LOAD_BOUND : LOAD_INIT;
+    }
+    if (0 == gen->n_pending)
+        gen->pending_head = 0;
+}
+
+/*
+ * Function      : load_pick
+ * Responsiblity : Find the next idle client in a state, round robin
+ * Parameters    : gen - client side
+ *                 cursor - round robin position
+ *                 any_idle - also accept idle clients without a lease
+ * Return        : client index, -1 if no client is idle
+ */
+static int load_pick(struct load_gen *gen, uint32_t *cursor, bool any_idle)
+{
+    struct load_client *client;
+    int iter;
+
+    for (iter = 0; iter < gen->p->n_clients; iter++) {
+        client = &gen->clients[*cursor];
+        *cursor = (*cursor + 1) % gen->p->n_clients;
+        if ((LOAD_BOUND == client->state)
+            || (any_idle && (LOAD_INIT == client->state)))
+            return client - gen->clients;
+    }
+    return -1;
+}
+
+/*
+ * Function      : load_due
+ * Responsiblity : Number of transactions due at a rate
+ * Parameters    : rate - transactions per second
+ *                 elapsed_ns - time since the start
+ *                 started - transactions started so far
+ * Return        : transactions to start now
+ */
+static uint64_t load_due(int rate, uint64_t elapsed_ns, uint64_t started)
+{
+    uint64_t due = elapsed_ns / 1000 * rate / 1000000;
+
+    return (due > started) ? due - started : 0;
+}
+
+/*
+ * Function      : load_issue
+ * Responsiblity : Start the transactions due, at most LOAD_SEND_BURST
+ * Parameters    : gen - client side
+ *                 elapsed_ns - time since the start
+ * Return        : none
+ */
+static void load_issue(struct load_gen *gen, uint64_t elapsed_ns)
+{
+    const struct load_params *p = gen->p;
+    uint64_t due;
+    int budget = LOAD_SEND_BURST, index;
+
+    /* Without a rate, every client starts DORA once, at the start */
+    if (p->discover_rate) {
+        due = load_due(p->discover_rate, elapsed_ns, gen->discovers);
+    } else {
+        due = p->n_clients - MIN(gen->discovers, (uint64_t) p->n_clients);
+    }
+    for (; due && budget; due--, budget--) {
+        /* Bound clients start over, as after a reboot */
+        index = load_pick(gen, &gen->discover_cursor, true);
+        if (index < 0)
+            break;
+        gen->discovers++;
+        gen->clients[index].state = LOAD_SELECTING;
+        if (!load_send(gen, index, DHCPDISCOVER, LOAD_TXN_DISCOVER))
+            gen->clients[index].state = LOAD_INIT;
+    }
+
+    due = load_due(p->renew_rate, elapsed_ns, gen->renews);
+    for (; due && budget; due--, budget--) {
+        index = load_pick(gen, &gen->renew_cursor, false);
+        if (index < 0)
+            break;
+        gen->renews++;
+        gen->clients[index].state = LOAD_REBINDING;
+        if (!load_send(gen, index, DHCPREQUEST, LOAD_TXN_RENEW))
+            gen->clients[index].state = LOAD_BOUND;
+    }
+
+    due = load_due(p->inform_rate, elapsed_ns, gen->informs);
+    for (; due && budget; due--, budget--) {
+        index = load_pick(gen, &gen->inform_cursor, false);
+        if (index < 0)
+            break;
+        gen->informs++;
+        gen->clients[index].state = LOAD_INFORMING;
+        if (!load_send(gen, index, DHCPINFORM, LOAD_TXN_INFORM))
+            gen->clients[index].state = LOAD_BOUND;
+    }
+}
+
+/*
+ * Function      : load_run
+ * Responsiblity : Client side main loop: issue transactions for the
+ *                 duration, then wait for the last replies
+ * Parameters    : gen - client side
+ * Return        : elapsed time in nanoseconds
+ */
+static uint64_t load_run(struct load_gen *gen)
+{
+    uint64_t start, now, stop_issue, stop;
+    uint8_t frame[ETH_FRAME_LEN];
+    struct sockaddr_ll from;
+    struct pollfd pfd;
+    socklen_t from_len;
+    ssize_t len;
+    int iter;
+
+    pfd.fd = gen->sock;
+    pfd.events = POLLIN;
+
+    start = relay_test_nsec();
+    stop_issue = start + (uint64_t) gen->p->duration * 1000000000ULL;
+    stop = stop_issue + (uint64_t) gen->p->timeout_ms * 1000000;
+
+    for (now = start; now < stop; now = relay_test_nsec()) {
+        if (now < stop_issue) {
+            load_issue(gen, now - start);
+        } else if (0 == gen->outstanding) {
+            break;
+        }
+        load_expire(gen, now);
+
+        poll(&pfd, 1, 1);
+        for (iter = 0; iter < LOAD_SEND_BURST; iter++) {
+            from_len = sizeof from;
+            len = recvfrom(gen->sock, frame, sizeof frame, 0,
+                           (struct sockaddr *) &from, &from_len);
+            if (len < 0)
+                break;
+            if (PACKET_OUTGOING != from.sll_pkttype)
+                load_receive(gen, frame, len);
+        }
+    }
+    load_expire(gen, UINT64_MAX);
+
+    return relay_test_nsec() - start;
+}
+
+/*
+ * Function      : load_compare_u32
+ * Responsiblity : qsort comparison of latencies
+ */
+static int load_compare_u32(const void *a_, const void *b_)
+{
+    uint32_t a = *(const uint32_t *) a_;
+    uint32_t b = *(const uint32_t *) b_;
+
+    return (a > b) - (a < b);
+}
+
+/*
+ * Function      : load_percentile
+ * Responsiblity : Get a percentile of sorted latencies
+ * Parameters    : stats - transaction statistics, latencies sorted
+ *                 pct - percentile
+ * Return        : latency in microseconds
+ */
+static uint32_t load_percentile(const struct load_stats *stats, double pct)
+{
+    size_t rank;
+
+    if (0 == stats->n_latency)
+        return 0;
+    rank = (size_t) (pct / 100 * (stats->n_latency - 1) + 0.5);
+    return stats->latency_us[rank];
+}
+
+/*
+ * Function      : load_report
+ * Responsiblity : Print the results of the run
+ * Parameters    : gen - client side
+ *                 srv - server stub, NULL when not running
+ *                 elapsed_ns - run time
+ * Return        : none
+ */
+static void load_report(struct load_gen *gen, struct load_server *srv,
+                        uint64_t elapsed_ns)
+{
+    double seconds = elapsed_ns / 1e9;
+    uint64_t replies = 0, requests, requests_option82, srv_replies;
+    struct load_stats *stats;
+    int txn;
+
+    printf("%-9s %9s %9s %7s %7s %7s %9s %9s %9s %9s %9s\n",
+           "txn", "sent", "replied", "naks", "lost", "loss%", "p50_us",
+           "p90_us", "p99_us", "p99.9_us", "max_us");
+    for (txn = 0; txn < LOAD_TXN_MAX; txn++) {
+        stats = &gen->stats[txn];
+        if (0 == stats->sent)
+            continue;
+        qsort(stats->latency_us, stats->n_latency, sizeof *stats->latency_us,
+              load_compare_u32);
+        replies += stats->replied;
+        printf("%-9s %9llu %9llu %7llu %7llu %7.2f %9u %9u %9u %9u %9u\n",
+               load_txn_names[txn],
+               (unsigned long long) stats->sent,
+               (unsigned long long) stats->replied,
+               (unsigned long long) stats->naks,
+               (unsigned long long) stats->lost,
+               100.0 * stats->lost / stats->sent,
+               load_percentile(stats, 50), load_percentile(stats, 90),
+               load_percentile(stats, 99), load_percentile(stats, 99.9),
+               load_percentile(stats, 100));
+    }
+
+    printf("\nelapsed: %.3f s\n", seconds);
+    printf("throughput: %.0f replies/sec, %.0f leases/sec (%llu leases)\n",
+           replies / seconds, gen->bound / seconds,
+           (unsigned long long) gen->bound);
+
+    if (srv) {
+        atomic_read_relaxed(&srv->requests, &requests);
+        atomic_read_relaxed(&srv->requests_option82, &requests_option82);
+        atomic_read_relaxed(&srv->replies, &srv_replies);
+        printf("server: %llu relayed requests (%llu with option 82), "
+               "%llu replies\n",
+               (unsigned long long) requests,
+               (unsigned long long) requests_option82,
+               (unsigned long long) srv_replies);
+    }
+}
+
+/*
+ * Function      : load_parse_count
+ * Responsiblity : Parse a count option
+ * Parameters    : prog - program name
+ *                 arg - option value
+ *                 min, max - valid range
+ *                 countp - parsed count
+ * Return        : none, exits on invalid values
+ */
+static void load_parse_count(const char *prog, const char *arg, int min,
+                             int max, int *countp)
+{
+    if (!str_to_int(arg, 10, countp) || (*countp < min) || (*countp > max)) {
+        fprintf(stderr, "%s: %s is not between %d and %d\n", prog, arg,
+                min, max);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    enum {
+        OPT_CLIENT_NETNS = UCHAR_MAX + 1,
+        OPT_SERVER_NETNS,
+        OPT_NO_SERVER,
+        OPT_DISCOVER_RATE,
+        OPT_RENEW_RATE,
+        OPT_INFORM_RATE,
+        OPT_LEASE_PLEN,
+        OPT_OPTION82,
+        OPT_BROADCAST,
+    };
+    static const struct option long_options[] = {
+        {"client-interface", required_argument, NULL, 'i'},
+        {"client-netns",     required_argument, NULL, OPT_CLIENT_NETNS},
+        {"server-address",   required_argument, NULL, 's'},
+        {"server-netns",     required_argument, NULL, OPT_SERVER_NETNS},
+        {"no-server",        no_argument,       NULL, OPT_NO_SERVER},
+        {"clients",          required_argument, NULL, 'n'},
+        {"discover-rate",    required_argument, NULL, OPT_DISCOVER_RATE},
+        {"renew-rate",       required_argument, NULL, OPT_RENEW_RATE},
+        {"inform-rate",      required_argument, NULL, OPT_INFORM_RATE},
+        {"duration",         required_argument, NULL, 'd'},
+        {"timeout",          required_argument, NULL, 't'},
+        {"lease-plen",       required_argument, NULL, OPT_LEASE_PLEN},
+        {"option82",         no_argument,       NULL, OPT_OPTION82},
+        {"broadcast",        no_argument,       NULL, OPT_BROADCAST},
+        {"verbose",          optional_argument, NULL, 'v'},
+        {"help",             no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct load_params p = {
+        .server = true,
+        .n_clients = LOAD_DEFAULT_CLIENTS,
+        .duration = LOAD_DEFAULT_DURATION,
+        .timeout_ms = LOAD_DEFAULT_TIMEOUT_MS,
+        .lease_plen = LOAD_DEFAULT_LEASE_PLEN,
+    };
+    struct load_server srv;
+    struct load_gen gen;
+    pthread_t server_thread;
+    int clientNs = -1, serverNs = -1, c, txn;
+    uint64_t elapsed_ns;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_WARN);
+
+    while ((c = getopt_long(argc, argv, "i:s:n:d:t:v::h", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'i':
+            p.client_intf = optarg;
+            break;
+        case OPT_CLIENT_NETNS:
+            p.client_netns = optarg;
+            break;
+        case 's':
+            if (inet_pton(AF_INET, optarg, &p.server_addr) != 1) {
+                fprintf(stderr, "%s: invalid address %s\n", argv[0], optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_SERVER_NETNS:
+            p.server_netns = optarg;
+            break;
+        case OPT_NO_SERVER:
+            p.server = false;
+            break;
+        case 'n':
+            load_parse_count(argv[0], optarg, 1, LOAD_MAX_CLIENTS - 1,
+                             &p.n_clients);
+            break;
+        case OPT_DISCOVER_RATE:
+            load_parse_count(argv[0], optarg, 0, INT_MAX, &p.discover_rate);
+            break;
+        case OPT_RENEW_RATE:
+            load_parse_count(argv[0], optarg, 0, INT_MAX, &p.renew_rate);
+            break;
+        case OPT_INFORM_RATE:
+            load_parse_count(argv[0], optarg, 0, INT_MAX, &p.inform_rate);
+            break;
+        case 'd':
+            load_parse_count(argv[0], optarg, 1, INT_MAX, &p.duration);
+            break;
+        case 't':
+            load_parse_count(argv[0], optarg, 1, INT_MAX, &p.timeout_ms);
+            break;
+        case OPT_LEASE_PLEN:
+            load_parse_count(argv[0], optarg, 8, 30, &p.lease_plen);
+            break;
+        case OPT_OPTION82:
+            p.option82 = true;
+            break;
+        case OPT_BROADCAST:
+            p.broadcast = true;
+            break;
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((NULL == p.client_intf)
+        || (p.server && (IP_ADDRESS_NULL == p.server_addr.s_addr))) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!relay_netns_init())
+        return EXIT_FAILURE;
+    if (p.client_netns) {
+        clientNs = relay_netns_open(p.client_netns);
+        if (clientNs < 0)
+            return EXIT_FAILURE;
+    }
+    if (p.server_netns) {
+        serverNs = relay_netns_open(p.server_netns);
+        if (serverNs < 0)
+            return EXIT_FAILURE;
+    }
+
+    memset(&gen, 0, sizeof gen);
+    gen.p = &p;
+    gen.clients = xcalloc(p.n_clients, sizeof *gen.clients);
+    if (!load_client_open(&gen, clientNs)) {
+        fprintf(stderr, "%s: cannot capture on %s: %s\n", argv[0],
+                p.client_intf, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    memset(&srv, 0, sizeof srv);
+    if (p.server) {
+        srv.addr = p.server_addr;
+        srv.lease_plen = p.lease_plen;
+        atomic_init(&srv.stop, false);
+        atomic_init(&srv.requests, 0);
+        atomic_init(&srv.requests_option82, 0);
+        atomic_init(&srv.replies, 0);
+        if (!load_server_open(&srv, serverNs)) {
+            fprintf(stderr, "%s: cannot open the server port: %s\n",
+                    argv[0], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        pthread_create(&server_thread, NULL, load_server_main, &srv);
+    }
+
+    printf("clients=%d discover-rate=%d renew-rate=%d inform-rate=%d "
+           "duration=%ds timeout=%dms option82=%s broadcast=%s\n\n",
+           p.n_clients, p.discover_rate, p.renew_rate, p.inform_rate,
+           p.duration, p.timeout_ms, p.option82 ? "yes" : "no",
+           p.broadcast ? "yes" : "no");
+
+    elapsed_ns = load_run(&gen);
+
+    if (p.server) {
+        atomic_store_relaxed(&srv.stop, true);
+        pthread_join(server_thread, NULL);
+    }
+    load_report(&gen, p.server ? &srv : NULL, elapsed_ns);
+
+    if (p.server)
+        close(srv.sock);
+    close(gen.sock);
+    for (txn = 0; txn < LOAD_TXN_MAX; txn++) {
+        free(gen.stats[txn].latency_us);
+    }
+    free(gen.pending);
+    free(gen.clients);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_fuzz.h
+ */
+
+/*
+ * Fuzz targets of the DHCP relay packet path. Each target defines the
+ * libFuzzer entry point LLVMFuzzerTestOneInput(). With libFuzzer the
+ * fuzzer provides main(); other builds link relay_fuzz_main.c, which runs
+ * the target on files, for AFL and for reproducing crashes.
+ *
+ * The targets run in the offline environment of relay_test.h, configured
+ * by relay_fuzz_env_init():
+ *
+ * - interface "1" (ifindex 1, 10.0.0.1/24), the client side, with the
+ *   dhcp-relay helper address 10.0.1.2 and the UDP broadcast forwarder
+ *   server 10.0.1.3 on port 137,
+ * - interface "2" (ifindex 2, 10.0.1.1/24), the server side.
+ *
+ * The first byte of the inputs of the option 82 and dispatch targets is a
+ * configuration selector, so that the fuzzer explores every policy.
+ */
+
+#ifndef RELAY_FUZZ_H
+#define RELAY_FUZZ_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Configuration selector bits */
+#define RELAY_FUZZ_POLICY_MASK    0x03  /* keep, replace, drop, option 82
+                                         * disabled */
+#define RELAY_FUZZ_REMOTE_ID_IP   0x04  /* remote-id ip, mac otherwise */
+#define RELAY_FUZZ_VALIDATE       0x08  /* option 82 validation enabled */
+#define RELAY_FUZZ_NO_HOP_COUNT   0x10  /* hop count increment disabled */
+#define RELAY_FUZZ_BOOTP_GW       0x20  /* bootp gateway on interface 1 */
+#define RELAY_FUZZ_IP_OPTIONS     0x40  /* 40 bytes of IP options, for the
+                                         * targets building the headers */
+
+/* Interfaces of the environment */
+#define RELAY_FUZZ_CLIENT_INTF    "1"
+#define RELAY_FUZZ_CLIENT_IFINDEX 1
+#define RELAY_FUZZ_CLIENT_IP      "10.0.0.1"
+#define RELAY_FUZZ_BOOTP_GW_IP    "10.0.0.1"
+#define RELAY_FUZZ_SERVER_IP      "10.0.1.2"
+#define RELAY_FUZZ_BCAST_PORT     137
+
+/* Entry point of the targets */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Environment */
+void relay_fuzz_env_init(void);
+void relay_fuzz_env_config(uint8_t selector);
+uint8_t *relay_fuzz_env_packet(const uint8_t *data, size_t size,
+                               size_t offset);
+
+#endif /* relay_fuzz.h */
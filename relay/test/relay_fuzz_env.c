@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_fuzz_env.c
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Configuration of the offline environment shared by the fuzz targets.
+ * - The receive buffer the targets hand to the packet path.
+ */
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "udpfwd.h"
+#include "relay_test.h"
+#include "relay_fuzz.h"
+
+/* Receive buffer, allocated on its own so that the sanitizers catch any
+ * access past the RECV_BUFFER_SIZE bytes of a receive slot */
+static uint8_t *fuzz_buff;
+
+/*
+ * Function      : relay_fuzz_env_init
+ * Responsiblity : Set up the interfaces and the configuration of the
+ *                 packet path, once per process
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_fuzz_env_init(void)
+{
+    if (fuzz_buff) {
+        return;
+    }
+
+    set_program_name("relay-fuzz");
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    if (!relay_test_add_interface(RELAY_FUZZ_CLIENT_INTF ",1,"
+                                  RELAY_FUZZ_CLIENT_IP "/24,"
+                                  "02:00:00:00:00:01")
+        || !relay_test_add_interface("2,2,10.0.1.1/24,02:00:00:00:00:02")
+        || !relay_test_add_server(RELAY_FUZZ_CLIENT_INTF ","
+                                  RELAY_FUZZ_SERVER_IP)
+        || !relay_test_add_server(RELAY_FUZZ_CLIENT_INTF ",10.0.1.3,"
+                                  OVS_STRINGIZE(RELAY_FUZZ_BCAST_PORT))) {
+        ovs_fatal(0, "invalid fuzzing environment");
+    }
+
+    udpfwd_module_init();
+    update_feature_state(UDP_BCAST_FORWARDER, ENABLE);
+    relay_test_config_apply();
+
+    fuzz_buff = xmalloc(RECV_BUFFER_SIZE);
+}
+
+/*
+ * Function      : relay_fuzz_env_config
+ * Responsiblity : Apply the configuration of a configuration selector
+ * Parameters    : selector - RELAY_FUZZ_* bits
+ * Return        : none
+ */
+void relay_fuzz_env_config(uint8_t selector)
+{
+    static const char *policies[] = { "keep", "replace", "drop" };
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    struct in_addr bootp_gw;
+    size_t policy = selector & RELAY_FUZZ_POLICY_MASK;
+
+    if (policy < ARRAY_SIZE(policies)) {
+        update_feature_state(DHCP_RELAY_OPTION82, ENABLE);
+        update_option82_policy((char *) policies[policy]);
+    } else {
+        update_feature_state(DHCP_RELAY_OPTION82, DISABLE);
+    }
+    update_option82_remote_id((selector & RELAY_FUZZ_REMOTE_ID_IP)
+                              ? (char *) "ip" : (char *) "mac");
+    update_feature_state(DHCP_RELAY_OPTION82_VALIDATE,
+                         (selector & RELAY_FUZZ_VALIDATE)
+                         ? ENABLE : DISABLE);
+    update_feature_state(DHCP_RELAY_HOP_COUNT_INCREMENT,
+                         (selector & RELAY_FUZZ_NO_HOP_COUNT)
+                         ? DISABLE : ENABLE);
+
+    intfNode = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable,
+                               RELAY_FUZZ_CLIENT_INTF);
+    if (intfNode) {
+        inet_pton(AF_INET, RELAY_FUZZ_BOOTP_GW_IP, &bootp_gw);
+        intfNode->bootp_gw = (selector & RELAY_FUZZ_BOOTP_GW)
+                             ? bootp_gw.s_addr : 0;
+    }
+}
+
+/*
+ * Function      : relay_fuzz_env_packet
+ * Responsiblity : Copy an input into the receive buffer, as the receive
+ *                 path of the relay would. The rest of the buffer is
+ *                 cleared, for crashes to reproduce from the input alone.
+ * Parameters    : data - input
+ *                 size - input size
+ *                 offset - offset of the input in the buffer
+ * Return        : receive buffer, NULL if the input does not fit in the
+ *                 RECV_BUFFER_SIZE - 1 bytes a receive reads at most
+ */
+uint8_t *relay_fuzz_env_packet(const uint8_t *data, size_t size,
+                               size_t offset)
+{
+    if (offset + size > RECV_BUFFER_SIZE - 1) {
+        return NULL;
+    }
+
+    memset(fuzz_buff, 0, offset);
+    memcpy(fuzz_buff + offset, data, size);
+    memset(fuzz_buff + offset + size, 0, RECV_BUFFER_SIZE - offset - size);
+    return fuzz_buff;
+}
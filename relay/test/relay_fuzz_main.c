@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_fuzz_main.c
+ */
+
+/*
+ * Driver of the fuzz targets for the builds without libFuzzer. Each
+ * argument is an input file, or a directory of input files such as a
+ * corpus; without arguments the input is read from the standard input,
+ * the way afl-fuzz runs a target. A crash reproduces by running the
+ * target on the saved input.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "relay_fuzz.h"
+
+/*
+ * Function      : fuzz_run_stream
+ * Responsiblity : Run the target on the content of a stream
+ * Parameters    : stream - input
+ *                 name - input name, for the errors
+ * Return        : 0 on success, errno value otherwise
+ */
+static int fuzz_run_stream(FILE *stream, const char *name)
+{
+    uint8_t *data = NULL;
+    size_t size = 0, allocated = 0, n;
+
+    for (;;) {
+        if (size == allocated) {
+            data = x2nrealloc(data, &allocated, 1);
+        }
+        n = fread(data + size, 1, allocated - size, stream);
+        if (0 == n) {
+            break;
+        }
+        size += n;
+    }
+    if (ferror(stream)) {
+        fprintf(stderr, "%s: read error\n", name);
+        free(data);
+        return EIO;
+    }
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    return 0;
+}
+
+/*
+ * Function      : fuzz_run_file
+ * Responsiblity : Run the target on a file, or on each file of a
+ *                 directory
+ * Parameters    : path - file or directory
+ * Return        : 0 on success, errno value of the first failure otherwise
+ */
+static int fuzz_run_file(const char *path)
+{
+    struct dirent *entry;
+    struct stat st;
+    FILE *stream;
+    DIR *dir;
+    char *file;
+    int error = 0, retval;
+
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, ovs_strerror(errno));
+        return errno;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        dir = opendir(path);
+        if (NULL == dir) {
+            fprintf(stderr, "%s: %s\n", path, ovs_strerror(errno));
+            return errno;
+        }
+        while ((entry = readdir(dir)) != NULL) {
+            if ('.' == entry->d_name[0]) {
+                continue;
+            }
+            file = xasprintf("%s/%s", path, entry->d_name);
+            retval = fuzz_run_file(file);
+            error = error ? error : retval;
+            free(file);
+        }
+        closedir(dir);
+        return error;
+    }
+
+    stream = fopen(path, "rb");
+    if (NULL == stream) {
+        fprintf(stderr, "%s: %s\n", path, ovs_strerror(errno));
+        return errno;
+    }
+    error = fuzz_run_stream(stream, path);
+    fclose(stream);
+    return error;
+}
+
+int main(int argc, char *argv[])
+{
+    int iter, error = 0, retval;
+
+    if (argc < 2) {
+        return fuzz_run_stream(stdin, "stdin") ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    for (iter = 1; iter < argc; iter++) {
+        retval = fuzz_run_file(argv[iter]);
+        error = error ? error : retval;
+    }
+    return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
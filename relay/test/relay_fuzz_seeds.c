@@ -0,0 +1,668 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_fuzz_seeds.c
+ */
+
+/*
+ * relay-fuzz-seeds: write the seed corpus of the fuzz targets. The seeds
+ * are the messages of the dhcp-relay and UDP broadcast forwarder
+ * component tests, addressed to the interfaces of relay_fuzz.h, and the
+ * IPv4 UDP packets of the pcap files given:
+ *
+ *   OUTDIR/dhcp-options/  DHCP payloads
+ *   OUTDIR/option82/      selector byte and DHCP payload
+ *   OUTDIR/udpfwd-ctrl/   selector byte and IPv4 packet
+ *
+ * The option 82 and dispatch seeds are written for several configuration
+ * selectors.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "udpfwd.h"
+#include "udpfwd_util.h"
+#include "dhcp_relay.h"
+#include "relay_test.h"
+#include "relay_fuzz.h"
+
+/* Corpus directories of the targets */
+#define SEED_DIR_OPTIONS  "dhcp-options"
+#define SEED_DIR_OPTION82 "option82"
+#define SEED_DIR_CTRL     "udpfwd-ctrl"
+
+/* Options of the seeds */
+#define SEED_OPT_REQUESTED_IP ((uint8_t) 50)
+#define SEED_OPT_PARAM_LIST   ((uint8_t) 55)
+#define SEED_OPT_CLIENT_ID    ((uint8_t) 61)
+
+/* Addresses of the seeds, see relay_fuzz.h */
+#define SEED_CLIENT_ADDR      "10.0.0.100"
+#define SEED_BCAST_SOURCE     "10.0.0.5"
+#define SEED_BCAST_DEST       "10.0.0.255"
+
+/* Payload of the jumbo request, close to a full receive buffer */
+#define SEED_JUMBO_LEN        (RECV_BUFFER_SIZE - 1 - sizeof(struct ip) \
+                               - UDPHDR_LENGTH)
+
+/* Configuration selectors of the option 82 and dispatch seeds */
+static const uint8_t seed_selectors[] = {
+    0,                                                  /* keep, mac */
+    1,                                                  /* replace, mac */
+    2,                                                  /* drop */
+    3,                                                  /* option 82 off */
+    1 | RELAY_FUZZ_REMOTE_ID_IP | RELAY_FUZZ_VALIDATE,
+    1 | RELAY_FUZZ_BOOTP_GW | RELAY_FUZZ_IP_OPTIONS
+      | RELAY_FUZZ_NO_HOP_COUNT,
+};
+
+static const uint8_t seed_cookie[MAGIC_LEN] = RFC1048_MAGIC;
+static const uint8_t seed_chaddr[6] = { 0x02, 0, 0, 0, 0x10, 0x01 };
+static const uint8_t seed_relay_mac[6] = { 0x02, 0, 0, 0, 0, 0x01 };
+
+/* DHCP payload of a scenario, returns the payload length */
+typedef size_t seed_build_fn(uint8_t *payload);
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS] OUTDIR [FILE.pcap...]\n"
+           "Write the seed corpus of the relay fuzz targets to OUTDIR.\n\n"
+           "  -h, --help            display this help message\n",
+           prog);
+}
+
+/*
+ * Function      : seed_put_option
+ * Responsiblity : Append an option to a DHCP options field
+ * Parameters    : opt - write position
+ *                 tag - option tag
+ *                 len - option length
+ *                 data - option value
+ * Return        : next write position
+ */
+static uint8_t *seed_put_option(uint8_t *opt, uint8_t tag, uint8_t len,
+                                const void *data)
+{
+    *opt++ = tag;
+    *opt++ = len;
+    memcpy(opt, data, len);
+    return opt + len;
+}
+
+/*
+ * Function      : seed_put_agent
+ * Responsiblity : Append the relay agent information option the relay
+ *                 adds on the client interface
+ * Parameters    : opt - write position
+ *                 remote_id - remote-id type
+ * Return        : next write position
+ */
+static uint8_t *seed_put_agent(uint8_t *opt,
+                               DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
+{
+    uint32_t circuit_id = htonl(RELAY_FUZZ_CLIENT_IFINDEX);
+    struct in_addr addr;
+    uint8_t *len;
+
+    *opt++ = DHCP_AGENT_OPTIONS;
+    len = opt++;
+    opt = seed_put_option(opt, DHCP_RAI_CIRCUIT_ID, sizeof circuit_id,
+                          &circuit_id);
+    if (REMOTE_ID_IP == remote_id) {
+        inet_pton(AF_INET, RELAY_FUZZ_CLIENT_IP, &addr);
+        opt = seed_put_option(opt, DHCP_RAI_REMOTE_ID, sizeof addr.s_addr,
+                              &addr.s_addr);
+    } else {
+        opt = seed_put_option(opt, DHCP_RAI_REMOTE_ID, sizeof seed_relay_mac,
+                              seed_relay_mac);
+    }
+    *len = opt - len - 1;
+    return opt;
+}
+
+/*
+ * Function      : seed_header
+ * Responsiblity : Fill the fixed fields of a DHCP message
+ * Parameters    : payload - DHCP payload
+ *                 op - BOOTREQUEST or BOOTREPLY
+ *                 msgtype - DHCP message type, 0 for a bootp message
+ * Return        : start of the options, after the cookie
+ */
+static uint8_t *seed_header(uint8_t *payload, uint8_t op, uint8_t msgtype)
+{
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) payload;
+    uint8_t *opt = dhcp->options;
+
+    memset(dhcp, 0, sizeof *dhcp);
+    dhcp->op = op;
+    dhcp->htype = ARPHRD_ETHER;
+    dhcp->hlen = sizeof seed_chaddr;
+    dhcp->xid = htonl(0x3903f326);
+    memcpy(dhcp->chaddr, seed_chaddr, sizeof seed_chaddr);
+    if (BOOTREPLY == op) {
+        inet_pton(AF_INET, SEED_CLIENT_ADDR, &dhcp->yiaddr);
+        inet_pton(AF_INET, RELAY_FUZZ_CLIENT_IP, &dhcp->giaddr);
+    }
+
+    if (msgtype) {
+        memcpy(opt, seed_cookie, MAGIC_LEN);
+        opt += MAGIC_LEN;
+        opt = seed_put_option(opt, DHCP_MSGTYPE, 1, &msgtype);
+    }
+    return opt;
+}
+
+/*
+ * Function      : seed_end
+ * Responsiblity : Terminate the options, padded to the bootp minimum
+ * Parameters    : payload - DHCP payload
+ *                 opt - write position
+ * Return        : payload length
+ */
+static size_t seed_end(uint8_t *payload, uint8_t *opt)
+{
+    size_t len;
+
+    *opt++ = END;
+    len = opt - payload;
+    return MAX(len, DFLTBOOTPLEN);
+}
+
+/*
+ * Function      : seed_discover
+ * Responsiblity : Discover, as sent by the client of the component tests
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_discover(uint8_t *payload)
+{
+    static const uint8_t params[] = { 1, 3, 6, 15, 28, 51, 58, 59 };
+    uint8_t client_id[1 + sizeof seed_chaddr] = { ARPHRD_ETHER };
+    uint16_t max_size = htons(1500);
+    uint8_t *opt;
+
+    memcpy(&client_id[1], seed_chaddr, sizeof seed_chaddr);
+    opt = seed_header(payload, BOOTREQUEST, DHCPDISCOVER);
+    opt = seed_put_option(opt, SEED_OPT_CLIENT_ID, sizeof client_id,
+                          client_id);
+    opt = seed_put_option(opt, DHCP_MAXMSGSIZE, sizeof max_size, &max_size);
+    opt = seed_put_option(opt, SEED_OPT_PARAM_LIST, sizeof params, params);
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_request_agent
+ * Responsiblity : Request through a snooping switch that added option 82
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_request_agent(uint8_t *payload)
+{
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) payload;
+    struct in_addr addr;
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREQUEST, DHCPREQUEST);
+    inet_pton(AF_INET, SEED_CLIENT_ADDR, &addr);
+    opt = seed_put_option(opt, SEED_OPT_REQUESTED_IP, sizeof addr.s_addr,
+                          &addr.s_addr);
+    inet_pton(AF_INET, RELAY_FUZZ_SERVER_IP, &addr);
+    opt = seed_put_option(opt, DHCP_SERVER_ID, sizeof addr.s_addr,
+                          &addr.s_addr);
+    opt = seed_put_agent(opt, REMOTE_ID_MAC);
+    inet_pton(AF_INET, "10.0.0.2", &dhcp->giaddr);
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_request_padded
+ * Responsiblity : Request with padding before the end option, where option
+ *                 82 goes
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_request_padded(uint8_t *payload)
+{
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREQUEST, DHCPREQUEST);
+    memset(opt, PAD, 16);
+    return seed_end(payload, opt + 16);
+}
+
+/*
+ * Function      : seed_request_maxsize
+ * Responsiblity : Request with a maximum message size option that option 82
+ *                 would exceed
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_request_maxsize(uint8_t *payload)
+{
+    uint16_t max_size = htons(MAX_DHCP_MESSAGE_SIZE);
+    uint8_t value[250];
+    uint8_t *opt;
+
+    memset(value, 'x', sizeof value);
+    opt = seed_header(payload, BOOTREQUEST, DHCPDISCOVER);
+    opt = seed_put_option(opt, DHCP_MAXMSGSIZE, sizeof max_size, &max_size);
+    opt = seed_put_option(opt, SEED_OPT_CLIENT_ID, sizeof value, value);
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_request_jumbo
+ * Responsiblity : Request filling the receive buffer, leaving no room for
+ *                 option 82
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_request_jumbo(uint8_t *payload)
+{
+    uint8_t value[255];
+    uint8_t *opt, *end = payload + SEED_JUMBO_LEN - 1;
+
+    memset(value, 'x', sizeof value);
+    opt = seed_header(payload, BOOTREQUEST, DHCPREQUEST);
+    while (opt + 2 + sizeof value < end) {
+        opt = seed_put_option(opt, SEED_OPT_CLIENT_ID, sizeof value, value);
+    }
+    memset(opt, PAD, end - opt);
+    return seed_end(payload, end);
+}
+
+/*
+ * Function      : seed_offer_mac
+ * Responsiblity : Offer from the server, with the option 82 of the relay,
+ *                 remote-id mac
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_offer_mac(uint8_t *payload)
+{
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREPLY, DHCPOFFER);
+    opt = seed_put_agent(opt, REMOTE_ID_MAC);
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_ack_ip
+ * Responsiblity : Ack from the server, with the option 82 of the relay,
+ *                 remote-id ip
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_ack_ip(uint8_t *payload)
+{
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREPLY, DHCPACK);
+    opt = seed_put_agent(opt, REMOTE_ID_IP);
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_nak
+ * Responsiblity : Nak, relayed as a broadcast
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_nak(uint8_t *payload)
+{
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) payload;
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREPLY, DHCPNAK);
+    dhcp->yiaddr.s_addr = 0;
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_inform_ack
+ * Responsiblity : Ack of an inform, sent to ciaddr
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_inform_ack(uint8_t *payload)
+{
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) payload;
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREPLY, DHCPACK);
+    dhcp->ciaddr = dhcp->yiaddr;
+    dhcp->yiaddr.s_addr = 0;
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_overload
+ * Responsiblity : Reply whose message type is in the overloaded file field
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_overload(uint8_t *payload)
+{
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) payload;
+    uint8_t overload = FILE_ISOPT, msgtype = DHCPACK;
+    uint8_t *opt;
+
+    opt = seed_header(payload, BOOTREPLY, 0);
+    memcpy(opt, seed_cookie, MAGIC_LEN);
+    opt = seed_put_option(opt + MAGIC_LEN, OPT_OVERLOAD, 1, &overload);
+    *seed_put_option(dhcp->file, DHCP_MSGTYPE, 1, &msgtype) = END;
+    return seed_end(payload, opt);
+}
+
+/*
+ * Function      : seed_bootp
+ * Responsiblity : Bootp request, without the cookie
+ * Parameters    : payload - DHCP payload
+ * Return        : payload length
+ */
+static size_t seed_bootp(uint8_t *payload)
+{
+    seed_header(payload, BOOTREQUEST, 0);
+    return DFLTBOOTPLEN;
+}
+
+/* DHCP scenarios */
+static const struct seed_scenario {
+    const char *name;
+    seed_build_fn *build;
+} seed_scenarios[] = {
+    {"discover",        seed_discover},
+    {"request-agent",   seed_request_agent},
+    {"request-padded",  seed_request_padded},
+    {"request-maxsize", seed_request_maxsize},
+    {"request-jumbo",   seed_request_jumbo},
+    {"offer-mac",       seed_offer_mac},
+    {"ack-ip",          seed_ack_ip},
+    {"nak",             seed_nak},
+    {"inform-ack",      seed_inform_ack},
+    {"overload",        seed_overload},
+    {"bootp",           seed_bootp},
+};
+
+/*
+ * Function      : seed_ip_packet
+ * Responsiblity : Put IPv4 and UDP headers in front of a UDP payload
+ * Parameters    : pkt - packet, the payload is at the UDP payload offset
+ *                 len - payload length
+ *                 src, dst - addresses
+ *                 sport, dport - UDP ports
+ * Return        : packet length
+ */
+static size_t seed_ip_packet(uint8_t *pkt, size_t len, const char *src,
+                             const char *dst, uint16_t sport, uint16_t dport)
+{
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+
+    memset(iph, 0, sizeof *iph + sizeof *udph);
+    udph->uh_sport = htons(sport);
+    udph->uh_dport = htons(dport);
+    udph->uh_ulen = htons(sizeof *udph + len);
+
+    iph->ip_v = IPVERSION;
+    iph->ip_hl = sizeof *iph / 4;
+    iph->ip_len = htons(sizeof *iph + sizeof *udph + len);
+    iph->ip_ttl = IPDEFTTL;
+    iph->ip_p = IPPROTO_UDP;
+    inet_pton(AF_INET, src, &iph->ip_src);
+    inet_pton(AF_INET, dst, &iph->ip_dst);
+    iph->ip_sum = in_cksum((uint16_t *) iph, sizeof *iph, 0);
+    return sizeof *iph + sizeof *udph + len;
+}
+
+/*
+ * Function      : seed_write
+ * Responsiblity : Write a seed, optionally prefixed with a selector
+ * Parameters    : outdir - corpus directory
+ *                 target - target directory
+ *                 name - seed name
+ *                 selector - selector byte, -1 for none
+ *                 data - seed
+ *                 len - seed length
+ * Return        : true on success
+ */
+static bool seed_write(const char *outdir, const char *target,
+                       const char *name, int selector, const void *data,
+                       size_t len)
+{
+    char *dir, *file;
+    FILE *stream;
+    bool ok;
+
+    dir = xasprintf("%s/%s", outdir, target);
+    if ((mkdir(dir, 0755) < 0) && (EEXIST != errno)) {
+        fprintf(stderr, "%s: %s\n", dir, ovs_strerror(errno));
+        free(dir);
+        return false;
+    }
+
+    file = (selector < 0) ? xasprintf("%s/%s", dir, name)
+                          : xasprintf("%s/%s-%02x", dir, name, selector);
+    stream = fopen(file, "wb");
+    if (NULL == stream) {
+        fprintf(stderr, "%s: %s\n", file, ovs_strerror(errno));
+        free(file);
+        free(dir);
+        return false;
+    }
+
+    ok = (selector < 0) || (EOF != fputc(selector, stream));
+    ok = ok && (fwrite(data, 1, len, stream) == len);
+    ok = (0 == fclose(stream)) && ok;
+    if (!ok) {
+        fprintf(stderr, "%s: write error\n", file);
+    }
+    free(file);
+    free(dir);
+    return ok;
+}
+
+/*
+ * Function      : seed_write_packet
+ * Responsiblity : Write the seeds of an IPv4 packet, for every target the
+ *                 packet reaches
+ * Parameters    : outdir - corpus directory
+ *                 name - seed name
+ *                 pkt - IPv4 packet
+ *                 len - packet length
+ * Return        : true on success
+ */
+static bool seed_write_packet(const char *outdir, const char *name,
+                              const uint8_t *pkt, size_t len)
+{
+    const struct ip *iph = (const struct ip *) pkt;
+    const struct udphdr *udph;
+    size_t iter, hdr_len;
+    bool ok = true;
+
+    for (iter = 0; iter < ARRAY_SIZE(seed_selectors); iter++) {
+        ok = ok && seed_write(outdir, SEED_DIR_CTRL, name,
+                              seed_selectors[iter], pkt, len);
+    }
+
+    /* DHCP payload of the packets udpfwd_ctrl() hands to the relay */
+    if ((len < sizeof *iph) || (IPPROTO_UDP != iph->ip_p)) {
+        return ok;
+    }
+    hdr_len = iph->ip_hl * 4 + UDPHDR_LENGTH;
+    if (len < hdr_len + DHCP_MIN_PKTLEN) {
+        return ok;
+    }
+    udph = (const struct udphdr *) (pkt + iph->ip_hl * 4);
+    if ((DHCPS_PORT != ntohs(udph->uh_dport))
+        && (DHCPC_PORT != ntohs(udph->uh_dport))) {
+        return ok;
+    }
+
+    ok = ok && seed_write(outdir, SEED_DIR_OPTIONS, name, -1,
+                          pkt + hdr_len, len - hdr_len);
+    for (iter = 0; iter < ARRAY_SIZE(seed_selectors); iter++) {
+        ok = ok && seed_write(outdir, SEED_DIR_OPTION82, name,
+                              seed_selectors[iter], pkt + hdr_len,
+                              len - hdr_len);
+    }
+    return ok;
+}
+
+/*
+ * Function      : seed_write_scenarios
+ * Responsiblity : Write the seeds of the DHCP and UDP broadcast forwarder
+ *                 scenarios
+ * Parameters    : outdir - corpus directory
+ * Return        : true on success
+ */
+static bool seed_write_scenarios(const char *outdir)
+{
+    const size_t hdr_len = sizeof(struct ip) + UDPHDR_LENGTH;
+    const struct seed_scenario *scenario;
+    uint8_t *pkt, *payload;
+    size_t iter, len;
+    bool ok = true;
+
+    pkt = xzalloc(RECV_BUFFER_SIZE);
+    payload = pkt + hdr_len;
+
+    for (iter = 0; ok && (iter < ARRAY_SIZE(seed_scenarios)); iter++) {
+        scenario = &seed_scenarios[iter];
+        memset(pkt, 0, RECV_BUFFER_SIZE);
+        len = scenario->build(payload);
+        if (BOOTREQUEST == payload[0]) {
+            len = seed_ip_packet(pkt, len, "0.0.0.0", "255.255.255.255",
+                                 DHCPC_PORT, DHCPS_PORT);
+        } else {
+            len = seed_ip_packet(pkt, len, RELAY_FUZZ_SERVER_IP,
+                                 RELAY_FUZZ_CLIENT_IP, DHCPS_PORT,
+                                 DHCPS_PORT);
+        }
+        ok = seed_write_packet(outdir, scenario->name, pkt, len);
+    }
+
+    /* NetBIOS name query to the UDP broadcast forwarder server port */
+    if (ok) {
+        memset(pkt, 0, RECV_BUFFER_SIZE);
+        memcpy(payload, "\x80\x94\x01\x10\x00\x01", 6);
+        len = seed_ip_packet(pkt, 50, SEED_BCAST_SOURCE, SEED_BCAST_DEST,
+                             RELAY_FUZZ_BCAST_PORT, RELAY_FUZZ_BCAST_PORT);
+        ok = seed_write_packet(outdir, "bcast-netbios", pkt, len);
+    }
+
+    free(pkt);
+    return ok;
+}
+
+/*
+ * Function      : seed_write_pcap
+ * Responsiblity : Write the seeds of the packets of a pcap file
+ * Parameters    : outdir - corpus directory
+ *                 file_name - pcap file
+ * Return        : true on success
+ */
+static bool seed_write_pcap(const char *outdir, const char *file_name)
+{
+    struct relay_test_trace trace;
+    const char *base = strrchr(file_name, '/');
+    char *name;
+    size_t iter;
+    bool ok = true;
+    int error;
+
+    base = base ? base + 1 : file_name;
+    relay_test_trace_init(&trace);
+    error = relay_test_pcap_load(file_name, &trace);
+    if (error) {
+        fprintf(stderr, "%s: %s\n", file_name, ovs_strerror(error));
+        relay_test_trace_destroy(&trace);
+        return false;
+    }
+
+    for (iter = 0; ok && (iter < trace.n); iter++) {
+        if (trace.pkts[iter].size > RECV_BUFFER_SIZE - 1) {
+            continue;
+        }
+        name = xasprintf("%s-%"PRIuSIZE, base, iter);
+        ok = seed_write_packet(outdir, name, trace.pkts[iter].data,
+                               trace.pkts[iter].size);
+        free(name);
+    }
+
+    relay_test_trace_destroy(&trace);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *outdir;
+    int c;
+
+    set_program_name(argv[0]);
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    outdir = argv[optind++];
+    if ((mkdir(outdir, 0755) < 0) && (EEXIST != errno)) {
+        fprintf(stderr, "%s: %s\n", outdir, ovs_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (!seed_write_scenarios(outdir)) {
+        return EXIT_FAILURE;
+    }
+    for (; optind < argc; optind++) {
+        if (!seed_write_pcap(outdir, argv[optind])) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,994 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_microbench.c
+ *
+ */
+
+/*
+ * relay-microbench: time the hot helper functions of the DHCP relay
+ * packet path on fixed inputs:
+ *
+ * - in_cksum() over the header and packet sizes of the relay,
+ * - dhcpScanOpt() and dhcpPickupOpt(), with and without option overload,
+ * - process_dhcp_relay_option82_message() for each policy and remote-id,
+ *   on requests and replies,
+ * - dhcp_relay_validate_agent_option(),
+ * - the interface resolvers of udpfwd_util.c,
+ * - shash_find() on the relay interface table.
+ *
+ * The functions depending on the interfaces run at several interface table
+ * sizes, against the fake interface table of the offline environment; the
+ * cost of a real getifaddrs() on the host is reported on its own. Results
+ * are ns/op and, where the kernel provides the counter, instructions/op.
+ * They can be saved as JSON and compared with a saved baseline.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <net/ethernet.h>
+#include <netinet/udp.h>
+
+#include "json.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "udpfwd.h"
+#include "udpfwd_util.h"
+#include "dhcp_relay.h"
+#include "relay_test.h"
+
+/* Defaults of the runs */
+#define MB_DEFAULT_SIZES        "1,16,256,4096"
+#define MB_DEFAULT_MIN_TIME_MS  200
+#define MB_DEFAULT_REPEAT       5
+#define MB_DEFAULT_THRESHOLD    10
+#define MB_MAX_SIZES            16
+#define MB_MAX_REPEAT           101
+
+/* Iterations of the first calibration run */
+#define MB_CALIBRATE_ITERATIONS 1000
+
+/* Filler option of the generated option fields */
+#define MB_OPT_FILLER           ((uint8_t) 224)
+
+/* Options looked up by the scan benchmarks */
+#define MB_OPT_CLIENT_ID        ((uint8_t)  61)
+#define MB_OPT_PARAM_LIST       ((uint8_t)  55)
+
+/* Real interface lookups of the host, bound with --wrap */
+int __real_getifaddrs(struct ifaddrs **ifap);
+void __real_freeifaddrs(struct ifaddrs *ifa);
+
+/* Inputs of a run at one interface table size */
+struct mb_ctx {
+    int size;                           /* interfaces in the table */
+    const struct relay_test_intf *intf; /* interface under test, the last */
+    char **names;                       /* interface names */
+    uint8_t *buff;                      /* RECV_BUFFER_SIZE work buffer */
+    uint8_t data[1500];                 /* checksum input */
+    uint8_t scan[DFLTOPTLEN];           /* option field to scan */
+    struct dhcp_packet plain;           /* dhcpPickupOpt() inputs */
+    struct dhcp_packet overload;
+    int32_t plain_len, overload_len;
+    uint8_t request[RECV_BUFFER_SIZE];  /* IPv4 DHCP request */
+    uint8_t request82[RECV_BUFFER_SIZE];/* request with option 82 */
+    uint8_t reply_mac[RECV_BUFFER_SIZE];/* reply with option 82 */
+    uint8_t reply_ip[RECV_BUFFER_SIZE];
+    int32_t request_len, request82_len, reply_mac_len, reply_ip_len;
+    uint8_t agent_mac[16];              /* option 82 sub-options */
+    uint8_t agent_ip[16];
+    int32_t agent_mac_len, agent_ip_len;
+};
+
+typedef uint64_t mb_run_fn(struct mb_ctx *ctx, int arg, uint64_t n);
+
+struct mb_bench {
+    const char *name;
+    bool sized;                 /* runs at each interface table size */
+    mb_run_fn *run;
+    int arg;
+    const char *policy;         /* option 82 configuration of the run */
+    const char *remote_id;
+};
+
+/* Measurement of a benchmark */
+struct mb_result {
+    char *name;
+    uint64_t iterations;
+    double ns_per_op;
+    double instructions_per_op; /* negative if not counted */
+};
+
+/* Results are summed here, so that the compiler keeps the calls */
+static volatile uint64_t mb_sink;
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS]\n"
+           "Time the hot functions of the DHCP relay packet path.\n\n"
+           "  -s, --sizes=N,...     interface table sizes, up to %d\n"
+           "                        (default: %s)\n"
+           "  -f, --filter=TEXT     run the benchmarks whose name contains\n"
+           "                        TEXT\n"
+           "  -m, --min-time=MS     minimum time of a measurement\n"
+           "                        (default: %d)\n"
+           "  -r, --repeat=N        measurements per benchmark, the median\n"
+           "                        is reported (default: %d)\n"
+           "  -o, --json=FILE       save the results as JSON\n"
+           "  -b, --baseline=FILE   compare with saved results, fail on\n"
+           "                        regressions\n"
+           "  -t, --threshold=PCT   allowed slowdown from the baseline\n"
+           "                        (default: %d)\n"
+           "  -l, --list            list the benchmarks\n"
+           "  -v, --verbose[=SPEC]  set the log levels of the relay modules\n"
+           "  -h, --help            display this help message\n",
+           prog, RELAY_TEST_MAX_INTERFACES, MB_DEFAULT_SIZES,
+           MB_DEFAULT_MIN_TIME_MS, MB_DEFAULT_REPEAT, MB_DEFAULT_THRESHOLD);
+}
+
+/*
+ * Benchmarks. Each runs its function n times and returns a value derived
+ * from the results.
+ */
+
+static uint64_t mb_packet_copy(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                               uint64_t n)
+{
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        memcpy(ctx->buff, ctx->request, ctx->request_len);
+        sum += ctx->buff[iter & 63];
+    }
+    return sum;
+}
+
+static uint64_t mb_in_cksum(struct mb_ctx *ctx, int arg, uint64_t n)
+{
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += in_cksum((uint16_t *) ctx->data, arg, 0);
+    }
+    return sum;
+}
+
+static uint64_t mb_scan_opt(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                            uint64_t n)
+{
+    uint64_t iter, sum = 0;
+    uint8_t overload = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += (uintptr_t) dhcpScanOpt(ctx->scan, ctx->scan + sizeof ctx->scan,
+                                       MB_OPT_CLIENT_ID, &overload);
+    }
+    return sum;
+}
+
+static uint64_t mb_pickup_opt(struct mb_ctx *ctx, int arg, uint64_t n)
+{
+    struct dhcp_packet *dhcp = arg ? &ctx->overload : &ctx->plain;
+    int32_t len = arg ? ctx->overload_len : ctx->plain_len;
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += (uintptr_t) dhcpPickupOpt(dhcp, len, MB_OPT_CLIENT_ID);
+    }
+    return sum;
+}
+
+/* Option 82 processing edits the packet, each call gets a fresh copy;
+ * packet_copy gives the cost of the copy */
+static uint64_t mb_option82(struct mb_ctx *ctx, int arg, uint64_t n)
+{
+    static const struct {
+        size_t offset, len_offset;
+    } inputs[] = {
+        { offsetof(struct mb_ctx, request),
+          offsetof(struct mb_ctx, request_len) },
+        { offsetof(struct mb_ctx, request82),
+          offsetof(struct mb_ctx, request82_len) },
+        { offsetof(struct mb_ctx, reply_mac),
+          offsetof(struct mb_ctx, reply_mac_len) },
+        { offsetof(struct mb_ctx, reply_ip),
+          offsetof(struct mb_ctx, reply_ip_len) },
+    };
+    const uint8_t *pkt = (uint8_t *) ctx + inputs[arg].offset;
+    int32_t len = *(int32_t *) ((uint8_t *) ctx + inputs[arg].len_offset);
+    DHCP_OPTION_82_OPTIONS info;
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        memcpy(ctx->buff, pkt, len);
+        memset(&info, 0, sizeof info);
+        info.ip_addr = ctx->intf->ip;
+        sum += process_dhcp_relay_option82_message(ctx->buff, &info,
+                                               ctx->intf->ifIndex,
+                                               (char *) ctx->intf->name,
+                                               ctx->intf->ip);
+    }
+    return sum;
+}
+
+static uint64_t mb_validate(struct mb_ctx *ctx, int arg, uint64_t n)
+{
+    const uint8_t *agent = arg == REMOTE_ID_MAC ? ctx->agent_mac
+                                                : ctx->agent_ip;
+    int32_t len = arg == REMOTE_ID_MAC ? ctx->agent_mac_len
+                                       : ctx->agent_ip_len;
+    DHCP_OPTION_82_OPTIONS info;
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += dhcp_relay_validate_agent_option(agent, len,
+                                                (char *) ctx->intf->name,
+                                                &info, arg);
+    }
+    return sum;
+}
+
+static uint64_t mb_lowest_ip(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                             uint64_t n)
+{
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += getLowestIpOnInterface((char *) ctx->intf->name);
+    }
+    return sum;
+}
+
+static uint64_t mb_ip_exists(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                             uint64_t n)
+{
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += ipExistsOnInterface((char *) ctx->intf->name, ctx->intf->ip);
+    }
+    return sum;
+}
+
+static uint64_t mb_ifindex_from_ip(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                                   uint64_t n)
+{
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += getIfIndexfromIpAddress(ctx->intf->ip);
+    }
+    return sum;
+}
+
+static uint64_t mb_mac_from_ifname(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                                   uint64_t n)
+{
+    uint64_t iter, sum = 0;
+    MAC_ADDRESS mac;
+
+    for (iter = 0; iter < n; iter++) {
+        getMacfromIfname(mac, (char *) ctx->intf->name);
+        sum += mac[5];
+    }
+    return sum;
+}
+
+static uint64_t mb_shash_find(struct mb_ctx *ctx, int arg OVS_UNUSED,
+                              uint64_t n)
+{
+    struct shash *table = &udpfwd_ctrl_cb_p->intfHashTable;
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        sum += (uintptr_t) shash_find(table, ctx->names[iter % ctx->size]);
+    }
+    return sum;
+}
+
+static uint64_t mb_system_getifaddrs(struct mb_ctx *ctx OVS_UNUSED,
+                                     int arg OVS_UNUSED, uint64_t n)
+{
+    struct ifaddrs *ifaddr;
+    uint64_t iter, sum = 0;
+
+    for (iter = 0; iter < n; iter++) {
+        if (0 == __real_getifaddrs(&ifaddr)) {
+            sum += (uintptr_t) ifaddr;
+            __real_freeifaddrs(ifaddr);
+        }
+    }
+    return sum;
+}
+
+static const struct mb_bench benchmarks[] = {
+    {"packet_copy",                      false, mb_packet_copy, 0, NULL, NULL},
+    {"in_cksum/len=20",                  false, mb_in_cksum, 20, NULL, NULL},
+    {"in_cksum/len=300",                 false, mb_in_cksum, 300, NULL, NULL},
+    {"in_cksum/len=576",                 false, mb_in_cksum, 576, NULL, NULL},
+    {"in_cksum/len=1500",                false, mb_in_cksum, 1500, NULL, NULL},
+    {"dhcpScanOpt",                      false, mb_scan_opt, 0, NULL, NULL},
+    {"dhcpPickupOpt/plain",              false, mb_pickup_opt, 0, NULL, NULL},
+    {"dhcpPickupOpt/overload",           false, mb_pickup_opt, 1, NULL, NULL},
+    {"option82/request/mac",             true, mb_option82, 0, "keep", "mac"},
+    {"option82/request/ip",              true, mb_option82, 0, "keep", "ip"},
+    {"option82/request82/keep/mac",      true, mb_option82, 1, "keep", "mac"},
+    {"option82/request82/keep/ip",       true, mb_option82, 1, "keep", "ip"},
+    {"option82/request82/replace/mac",   true, mb_option82, 1, "replace",
+     "mac"},
+    {"option82/request82/replace/ip",    true, mb_option82, 1, "replace",
+     "ip"},
+    {"option82/request82/drop/mac",      true, mb_option82, 1, "drop", "mac"},
+    {"option82/request82/drop/ip",       true, mb_option82, 1, "drop", "ip"},
+    {"option82/reply/mac",               true, mb_option82, 2, "keep", "mac"},
+    {"option82/reply/ip",                true, mb_option82, 3, "keep", "ip"},
+    {"validate_agent_option/mac",        true, mb_validate, REMOTE_ID_MAC,
+     NULL, NULL},
+    {"validate_agent_option/ip",         true, mb_validate, REMOTE_ID_IP,
+     NULL, NULL},
+    {"getLowestIpOnInterface",           true, mb_lowest_ip, 0, NULL, NULL},
+    {"ipExistsOnInterface",              true, mb_ip_exists, 0, NULL, NULL},
+    {"getIfIndexfromIpAddress",          true, mb_ifindex_from_ip, 0, NULL,
+     NULL},
+    {"getMacfromIfname",                 true, mb_mac_from_ifname, 0, NULL,
+     NULL},
+    {"shash_find/intfHashTable",         true, mb_shash_find, 0, NULL, NULL},
+    {"getifaddrs/system",                false, mb_system_getifaddrs, 0, NULL,
+     NULL},
+};
+
+/*
+ * Function      : mb_put_option
+ * Responsiblity : Append an option to a DHCP options field
+ * Parameters    : opt - write position
+ *                 tag - option tag
+ *                 len - option length
+ *                 data - option value, NULL for a filler value
+ * Return        : next write position
+ */
+static uint8_t *mb_put_option(uint8_t *opt, uint8_t tag, uint8_t len,
+                              const void *data)
+{
+    *opt++ = tag;
+    *opt++ = len;
+    if (data) {
+        memcpy(opt, data, len);
+    } else {
+        memset(opt, tag, len);
+    }
+    return opt + len;
+}
+
+/*
+ * Function      : mb_put_agent
+ * Responsiblity : Write the sub-options of a relay agent option, as the
+ *                 relay adds them on an interface
+ * Parameters    : buf - write position
+ *                 intf - interface
+ *                 remote_id - remote-id type
+ * Return        : sub-options length
+ */
+static int32_t mb_put_agent(uint8_t *buf, const struct relay_test_intf *intf,
+                            DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
+{
+    uint32_t circuit_id = htonl(intf->ifIndex);
+    uint8_t *opt = buf;
+
+    opt = mb_put_option(opt, DHCP_RAI_CIRCUIT_ID, sizeof circuit_id,
+                        &circuit_id);
+    if (REMOTE_ID_MAC == remote_id) {
+        opt = mb_put_option(opt, DHCP_RAI_REMOTE_ID, MAC_HEADER_LENGTH,
+                            intf->mac);
+    } else {
+        opt = mb_put_option(opt, DHCP_RAI_REMOTE_ID, sizeof intf->ip,
+                            &intf->ip);
+    }
+    return opt - buf;
+}
+
+/*
+ * Function      : mb_build_packet
+ * Responsiblity : Build an IPv4 DHCP packet as received by the relay: a
+ *                 DHCPDISCOVER of a typical client, or its offer
+ * Parameters    : pkt - RECV_BUFFER_SIZE buffer
+ *                 ctx - run inputs
+ *                 op - BOOTREQUEST or BOOTREPLY
+ *                 remote_id - relay agent option to add, REMOTE_ID_INVALID
+ *                             for none
+ * Return        : packet length
+ */
+static int32_t mb_build_packet(uint8_t *pkt, const struct mb_ctx *ctx,
+                               uint8_t op,
+                               DHCP_RELAY_OPTION82_REMOTE_ID remote_id)
+{
+    static const uint8_t cookie[MAGIC_LEN] = RFC1048_MAGIC;
+    static const uint8_t params[] = { 1, 3, 6, 15, 28, 42, 51, 54, 58, 59 };
+    uint8_t type = (BOOTREQUEST == op) ? DHCPDISCOVER : DHCPOFFER;
+    struct ip *iph = (struct ip *) pkt;
+    struct udphdr *udph = (struct udphdr *) (iph + 1);
+    struct dhcp_packet *dhcp = (struct dhcp_packet *) (udph + 1);
+    uint8_t client_id[7] = { 1, 0x02, 0, 0, 0, 0, 0x01 };
+    uint8_t agent[16];
+    int32_t len;
+    uint8_t *opt;
+
+    memset(pkt, 0, RECV_BUFFER_SIZE);
+    dhcp->op = op;
+    dhcp->htype = 1;
+    dhcp->hlen = ETH_ALEN;
+    dhcp->xid = htonl(0x6d62656e);
+    memcpy(dhcp->chaddr, &client_id[1], ETH_ALEN);
+    if ((BOOTREPLY == op) || (REMOTE_ID_INVALID != remote_id))
+        dhcp->giaddr.s_addr = ctx->intf->ip;
+
+    opt = dhcp->options;
+    memcpy(opt, cookie, MAGIC_LEN);
+    opt += MAGIC_LEN;
+    opt = mb_put_option(opt, DHCP_MSGTYPE, 1, &type);
+    opt = mb_put_option(opt, MB_OPT_CLIENT_ID, sizeof client_id, client_id);
+    opt = mb_put_option(opt, MB_OPT_PARAM_LIST, sizeof params, params);
+    if (REMOTE_ID_INVALID != remote_id) {
+        len = mb_put_agent(agent, ctx->intf, remote_id);
+        opt = mb_put_option(opt, DHCP_AGENT_OPTIONS, len, agent);
+    }
+    *opt = END;
+
+    /* Full size message, as most clients send */
+    len = sizeof *iph + sizeof *udph + sizeof *dhcp;
+    iph->ip_v = 4;
+    iph->ip_hl = sizeof *iph / 4;
+    iph->ip_len = htons(len);
+    iph->ip_ttl = 64;
+    iph->ip_p = IPPROTO_UDP;
+    iph->ip_src.s_addr = (BOOTREPLY == op) ? htonl(0xc0000201) : INADDR_ANY;
+    iph->ip_dst.s_addr = (BOOTREPLY == op) ? ctx->intf->ip
+                                           : INADDR_BROADCAST;
+    udph->uh_sport = htons((BOOTREPLY == op) ? DHCPS_PORT : DHCPC_PORT);
+    udph->uh_dport = htons(DHCPS_PORT);
+    udph->uh_ulen = htons(len - sizeof *iph);
+    return len;
+}
+
+/*
+ * Function      : mb_build_inputs
+ * Responsiblity : Build the inputs that do not depend on the interfaces
+ * Parameters    : ctx - run inputs
+ * Return        : none
+ */
+static void mb_build_inputs(struct mb_ctx *ctx)
+{
+    static const uint8_t cookie[MAGIC_LEN] = RFC1048_MAGIC;
+    uint8_t client_id[7] = { 1, 0x02, 0, 0, 0, 0, 0x01 };
+    uint8_t overload = BOTH_AREOPT;
+    uint32_t seed = 0x2545f491;
+    uint8_t *opt;
+    size_t iter;
+
+    /* Checksum input, fixed pseudo-random bytes */
+    for (iter = 0; iter < sizeof ctx->data; iter++) {
+        seed = seed * 1103515245 + 12345;
+        ctx->data[iter] = seed >> 16;
+    }
+
+    /* Option field with the looked up option after 32 others */
+    opt = ctx->scan;
+    for (iter = 0; iter < 32; iter++) {
+        opt = mb_put_option(opt, MB_OPT_FILLER + (iter & 7), 6, NULL);
+    }
+    opt = mb_put_option(opt, MB_OPT_CLIENT_ID, sizeof client_id, client_id);
+    *opt = END;
+
+    /* Option found in the options field */
+    memset(&ctx->plain, 0, sizeof ctx->plain);
+    opt = ctx->plain.options;
+    memcpy(opt, cookie, MAGIC_LEN);
+    opt += MAGIC_LEN;
+    for (iter = 0; iter < 8; iter++) {
+        opt = mb_put_option(opt, MB_OPT_FILLER + iter, 4, NULL);
+    }
+    opt = mb_put_option(opt, MB_OPT_CLIENT_ID, sizeof client_id, client_id);
+    *opt = END;
+    ctx->plain_len = sizeof ctx->plain;
+
+    /* Overload: the whole options field, then file, then sname */
+    memset(&ctx->overload, 0, sizeof ctx->overload);
+    opt = ctx->overload.options;
+    memcpy(opt, cookie, MAGIC_LEN);
+    opt += MAGIC_LEN;
+    opt = mb_put_option(opt, OPT_OVERLOAD, 1, &overload);
+    for (iter = 0; iter < 8; iter++) {
+        opt = mb_put_option(opt, MB_OPT_FILLER + iter, 4, NULL);
+    }
+    *opt = END;
+    opt = ctx->overload.file;
+    for (iter = 0; iter < 4; iter++) {
+        opt = mb_put_option(opt, MB_OPT_FILLER + iter, 4, NULL);
+    }
+    *opt = END;
+    opt = ctx->overload.sname;
+    opt = mb_put_option(opt, MB_OPT_CLIENT_ID, sizeof client_id, client_id);
+    *opt = END;
+    ctx->overload_len = sizeof ctx->overload;
+}
+
+/*
+ * Function      : mb_grow_table
+ * Responsiblity : Grow the fake interface table and the relay interface
+ *                 table to a size, and build the inputs on its last
+ *                 interface
+ * Parameters    : ctx - run inputs
+ *                 size - interfaces
+ * Return        : true on success
+ */
+static bool mb_grow_table(struct mb_ctx *ctx, int size)
+{
+    char arg[64], name[IF_NAMESIZE];
+    int index;
+
+    ctx->names = xrealloc(ctx->names, size * sizeof *ctx->names);
+    for (index = ctx->size + 1; index <= size; index++) {
+        snprintf(name, sizeof name, "%d", index);
+        snprintf(arg, sizeof arg, "%s,%d,10.%d.%d.1/24", name, index,
+                 index >> 8, index & 0xff);
+        if (!relay_test_add_interface(arg))
+            return false;
+        snprintf(arg, sizeof arg, "%s,192.0.2.1", name);
+        relay_test_add_server(arg);
+        ctx->names[index - 1] = xstrdup(name);
+    }
+    relay_test_config_apply();
+
+    ctx->size = size;
+    ctx->intf = relay_test_find_interface(ctx->names[size - 1]);
+
+    ctx->request_len = mb_build_packet(ctx->request, ctx, BOOTREQUEST,
+                                       REMOTE_ID_INVALID);
+    ctx->request82_len = mb_build_packet(ctx->request82, ctx, BOOTREQUEST,
+                                         REMOTE_ID_MAC);
+    ctx->reply_mac_len = mb_build_packet(ctx->reply_mac, ctx, BOOTREPLY,
+                                         REMOTE_ID_MAC);
+    ctx->reply_ip_len = mb_build_packet(ctx->reply_ip, ctx, BOOTREPLY,
+                                        REMOTE_ID_IP);
+    ctx->agent_mac_len = mb_put_agent(ctx->agent_mac, ctx->intf,
+                                      REMOTE_ID_MAC);
+    ctx->agent_ip_len = mb_put_agent(ctx->agent_ip, ctx->intf, REMOTE_ID_IP);
+    return true;
+}
+
+/*
+ * Function      : mb_compare_double
+ * Responsiblity : qsort comparison of measurements
+ */
+static int mb_compare_double(const void *a_, const void *b_)
+{
+    double a = *(const double *) a_;
+    double b = *(const double *) b_;
+
+    return (a > b) - (a < b);
+}
+
+/*
+ * Function      : mb_measure
+ * Responsiblity : Measure a benchmark: calibrate the iterations to the
+ *                 minimum time, then take the median of the repetitions
+ * Parameters    : bench - benchmark
+ *                 ctx - run inputs
+ *                 min_time_ms - minimum time of a measurement
+ *                 repeat - measurements
+ *                 result - filled measurement, name excepted
+ * Return        : none
+ */
+static void mb_measure(const struct mb_bench *bench, struct mb_ctx *ctx,
+                       int min_time_ms, int repeat, struct mb_result *result)
+{
+    double ns[MB_MAX_REPEAT], instructions[MB_MAX_REPEAT];
+    uint64_t n = MB_CALIBRATE_ITERATIONS, start, elapsed, start_insn;
+    uint64_t min_ns = (uint64_t) min_time_ms * 1000000;
+    bool counted = relay_test_has_instructions();
+    int iter;
+
+    if (bench->policy)
+        update_option82_policy((char *) bench->policy);
+    if (bench->remote_id)
+        update_option82_remote_id((char *) bench->remote_id);
+
+    /* Calibration, also warms the caches */
+    for (;;) {
+        start = relay_test_nsec();
+        mb_sink += bench->run(ctx, bench->arg, n);
+        elapsed = relay_test_nsec() - start;
+        if (elapsed >= min_ns / 10)
+            break;
+        n *= 2;
+    }
+    n = MAX(n, n * min_ns / MAX(elapsed, 1));
+
+    for (iter = 0; iter < repeat; iter++) {
+        start_insn = relay_test_instructions();
+        start = relay_test_nsec();
+        mb_sink += bench->run(ctx, bench->arg, n);
+        elapsed = relay_test_nsec() - start;
+        instructions[iter] = (double) (relay_test_instructions() - start_insn)
+                             / n;
+        ns[iter] = (double) elapsed / n;
+    }
+    qsort(ns, repeat, sizeof ns[0], mb_compare_double);
+    qsort(instructions, repeat, sizeof instructions[0], mb_compare_double);
+
+    result->iterations = n;
+    result->ns_per_op = ns[repeat / 2];
+    result->instructions_per_op = counted ? instructions[repeat / 2] : -1;
+}
+
+/*
+ * Function      : mb_json_number
+ * Responsiblity : Get a number member of a JSON object
+ * Parameters    : object - JSON object
+ *                 name - member name
+ * Return        : value, negative if missing
+ */
+static double mb_json_number(const struct json *object, const char *name)
+{
+    const struct json *value = shash_find_data(object->u.object, name);
+
+    if (value && (JSON_REAL == value->type))
+        return value->u.real;
+    if (value && (JSON_INTEGER == value->type))
+        return value->u.integer;
+    return -1;
+}
+
+/*
+ * Function      : mb_load_baseline
+ * Responsiblity : Read the benchmarks of a saved result file
+ * Parameters    : file_name - JSON file written with --json
+ * Return        : the "benchmarks" object, NULL on failure. The caller
+ *                 destroys the returned document with json_destroy() on
+ *                 its root, available in *rootp.
+ */
+static const struct json *mb_load_baseline(const char *file_name,
+                                           struct json **rootp)
+{
+    const struct json *benchmarks;
+    struct json *root;
+
+    root = json_from_file(file_name);
+    *rootp = root;
+    if (JSON_STRING == root->type) {
+        fprintf(stderr, "cannot read %s: %s\n", file_name, root->u.string);
+        return NULL;
+    }
+    if (JSON_OBJECT != root->type)
+        return NULL;
+
+    benchmarks = shash_find_data(root->u.object, "benchmarks");
+    return (benchmarks && (JSON_OBJECT == benchmarks->type)) ? benchmarks
+                                                              : NULL;
+}
+
+/*
+ * Function      : mb_check
+ * Responsiblity : Compare a result with the baseline. Instructions are
+ *                 compared when both sides counted them, they do not
+ *                 depend on the load of the machine; time otherwise.
+ * Parameters    : result - measurement
+ *                 baseline - saved benchmarks, NULL for none
+ *                 threshold - allowed slowdown, percent
+ *                 deltap - change from the baseline, percent
+ * Return        : true if the result is a regression
+ */
+static bool mb_check(const struct mb_result *result,
+                     const struct json *baseline, int threshold,
+                     double *deltap)
+{
+    const struct json *saved;
+    double before, after;
+
+    *deltap = 0;
+    if (NULL == baseline)
+        return false;
+    saved = shash_find_data(baseline->u.object, result->name);
+    if ((NULL == saved) || (JSON_OBJECT != saved->type))
+        return false;
+
+    before = mb_json_number(saved, "instructions_per_op");
+    after = result->instructions_per_op;
+    if ((before <= 0) || (after < 0)) {
+        before = mb_json_number(saved, "ns_per_op");
+        after = result->ns_per_op;
+    }
+    if (before <= 0)
+        return false;
+
+    *deltap = (after - before) * 100 / before;
+    return *deltap > threshold;
+}
+
+/*
+ * Function      : mb_save
+ * Responsiblity : Save the results as JSON
+ * Parameters    : file_name - output file
+ *                 results - measurements
+ *                 n - number of measurements
+ * Return        : 0 on success, errno otherwise
+ */
+static int mb_save(const char *file_name, const struct mb_result *results,
+                   size_t n)
+{
+    struct json *root, *benchmarks, *entry;
+    FILE *file;
+    char *text;
+    size_t iter;
+    int error = 0;
+
+    benchmarks = json_object_create();
+    for (iter = 0; iter < n; iter++) {
+        entry = json_object_create();
+        json_object_put(entry, "iterations",
+                        json_integer_create(results[iter].iterations));
+        json_object_put(entry, "ns_per_op",
+                        json_real_create(results[iter].ns_per_op));
+        if (results[iter].instructions_per_op >= 0) {
+            json_object_put(entry, "instructions_per_op",
+                        json_real_create(results[iter].instructions_per_op));
+        }
+        json_object_put(benchmarks, results[iter].name, entry);
+    }
+    root = json_object_create();
+    json_object_put(root, "benchmarks", benchmarks);
+
+    text = json_to_string(root, JSSF_PRETTY | JSSF_SORT);
+    file = fopen(file_name, "w");
+    if ((NULL == file) || (fprintf(file, "%s\n", text) < 0))
+        error = errno;
+    if (file && fclose(file) && !error)
+        error = errno;
+
+    free(text);
+    json_destroy(root);
+    return error;
+}
+
+/*
+ * Function      : mb_parse_sizes
+ * Responsiblity : Parse the interface table sizes, in increasing order
+ * Parameters    : arg - comma separated sizes
+ *                 sizes - parsed sizes, MB_MAX_SIZES entries
+ * Return        : number of sizes, 0 if invalid
+ */
+static int mb_parse_sizes(const char *arg, int *sizes)
+{
+    char *copy = xstrdup(arg), *save = NULL, *token;
+    int n = 0, size;
+
+    for (token = strtok_r(copy, ",", &save); token;
+         token = strtok_r(NULL, ",", &save)) {
+        if ((n == MB_MAX_SIZES) || !str_to_int(token, 10, &size)
+            || (size < 1) || (size > RELAY_TEST_MAX_INTERFACES)
+            || (n && (size <= sizes[n - 1]))) {
+            n = 0;
+            break;
+        }
+        sizes[n++] = size;
+    }
+    free(copy);
+    return n;
+}
+
+/*
+ * Function      : mb_parse_count
+ * Responsiblity : Parse a count option
+ * Parameters    : prog - program name
+ *                 arg - option value
+ *                 min, max - valid range
+ *                 countp - parsed count
+ * Return        : none, exits on invalid values
+ */
+static void mb_parse_count(const char *prog, const char *arg, int min,
+                           int max, int *countp)
+{
+    if (!str_to_int(arg, 10, countp) || (*countp < min) || (*countp > max)) {
+        fprintf(stderr, "%s: %s is not between %d and %d\n", prog, arg,
+                min, max);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"sizes",     required_argument, NULL, 's'},
+        {"filter",    required_argument, NULL, 'f'},
+        {"min-time",  required_argument, NULL, 'm'},
+        {"repeat",    required_argument, NULL, 'r'},
+        {"json",      required_argument, NULL, 'o'},
+        {"baseline",  required_argument, NULL, 'b'},
+        {"threshold", required_argument, NULL, 't'},
+        {"list",      no_argument,       NULL, 'l'},
+        {"verbose",   optional_argument, NULL, 'v'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *filter = NULL, *output = NULL, *baseline_file = NULL;
+    int sizes[MB_MAX_SIZES], n_sizes, size_iter, c, error;
+    int min_time_ms = MB_DEFAULT_MIN_TIME_MS, repeat = MB_DEFAULT_REPEAT;
+    int threshold = MB_DEFAULT_THRESHOLD, regressions = 0;
+    const struct json *baseline = NULL;
+    struct json *baseline_root = NULL;
+    struct mb_result *results = NULL, *result;
+    size_t n_results = 0, allocated_results = 0, iter;
+    const struct mb_bench *bench;
+    struct mb_ctx *ctx;
+    char delta[32];
+    double change;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_WARN);
+    n_sizes = mb_parse_sizes(MB_DEFAULT_SIZES, sizes);
+
+    while ((c = getopt_long(argc, argv, "s:f:m:r:o:b:t:lv::h", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 's':
+            n_sizes = mb_parse_sizes(optarg, sizes);
+            if (0 == n_sizes) {
+                fprintf(stderr, "%s: invalid sizes %s\n", argv[0], optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'm':
+            mb_parse_count(argv[0], optarg, 1, 60000, &min_time_ms);
+            break;
+        case 'r':
+            mb_parse_count(argv[0], optarg, 1, MB_MAX_REPEAT, &repeat);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'b':
+            baseline_file = optarg;
+            break;
+        case 't':
+            mb_parse_count(argv[0], optarg, 0, 1000, &threshold);
+            break;
+        case 'l':
+            for (iter = 0; iter < ARRAY_SIZE(benchmarks); iter++) {
+                printf("%s%s\n", benchmarks[iter].name,
+                       benchmarks[iter].sized ? "/intfs=N" : "");
+            }
+            return EXIT_SUCCESS;
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (baseline_file) {
+        baseline = mb_load_baseline(baseline_file, &baseline_root);
+        if (NULL == baseline) {
+            fprintf(stderr, "%s: %s has no benchmark results\n", argv[0],
+                    baseline_file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Both option 82 directions are processed, replies are validated */
+    udpfwd_module_init();
+    update_feature_state(DHCP_RELAY_OPTION82, ENABLE);
+    update_feature_state(DHCP_RELAY_OPTION82_VALIDATE, ENABLE);
+
+    ctx = xzalloc(sizeof *ctx);
+    ctx->buff = xmalloc(RECV_BUFFER_SIZE);
+    mb_build_inputs(ctx);
+
+    printf("instructions/op: %s\n\n", relay_test_has_instructions()
+           ? "counted" : "not available (no hardware counter access)");
+    printf("%-48s %12s %14s %10s\n", "benchmark", "ns/op", "instructions/op",
+           "change");
+
+    /* The unsized benchmarks run with the smallest table */
+    for (size_iter = 0; size_iter < n_sizes; size_iter++) {
+        if (!mb_grow_table(ctx, sizes[size_iter])) {
+            fprintf(stderr, "%s: cannot create %d interfaces\n", argv[0],
+                    sizes[size_iter]);
+            return EXIT_FAILURE;
+        }
+
+        for (iter = 0; iter < ARRAY_SIZE(benchmarks); iter++) {
+            bench = &benchmarks[iter];
+            if ((!bench->sized && size_iter)
+                || (filter && !strstr(bench->name, filter)))
+                continue;
+
+            if (n_results == allocated_results) {
+                results = x2nrealloc(results, &allocated_results,
+                                     sizeof *results);
+            }
+            result = &results[n_results++];
+            result->name = bench->sized
+                           ? xasprintf("%s/intfs=%d", bench->name,
+                                       sizes[size_iter])
+                           : xstrdup(bench->name);
+            mb_measure(bench, ctx, min_time_ms, repeat, result);
+
+            delta[0] = '\0';
+            if (mb_check(result, baseline, threshold, &change)) {
+                snprintf(delta, sizeof delta, "%+.1f%% !", change);
+                regressions++;
+            } else if (baseline) {
+                snprintf(delta, sizeof delta, "%+.1f%%", change);
+            }
+
+            if (result->instructions_per_op >= 0) {
+                printf("%-48s %12.1f %14.1f %10s\n", result->name,
+                       result->ns_per_op, result->instructions_per_op,
+                       delta);
+            } else {
+                printf("%-48s %12.1f %14s %10s\n", result->name,
+                       result->ns_per_op, "n/a", delta);
+            }
+            fflush(stdout);
+        }
+    }
+
+    if (output) {
+        error = mb_save(output, results, n_results);
+        if (error) {
+            fprintf(stderr, "%s: cannot write %s: %s\n", argv[0], output,
+                    strerror(error));
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (baseline) {
+        printf("\n%d regressions over %d%% from %s\n", regressions,
+               threshold, baseline_file);
+        json_destroy(baseline_root);
+    }
+
+    for (iter = 0; iter < n_results; iter++) {
+        free(results[iter].name);
+    }
+    free(results);
+    for (size_iter = 0; size_iter < ctx->size; size_iter++) {
+        free(ctx->names[size_iter]);
+    }
+    free(ctx->names);
+    free(ctx->buff);
+    free(ctx);
+    return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
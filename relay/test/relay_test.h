@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_test.h
+ */
+
+/*
+ * Offline environment for running the relay packet path outside of the
+ * switch. The harnesses link the packet path sources with:
+ *
+ * - a fake interface table, served to the packet path through the
+ *   getifaddrs(), if_nameindex() and if_indextoname() wrappers,
+ * - a sendmsg() wrapper handing the transmitted packets to the harness,
+ * - an in-memory configuration source replacing the OVSDB tables,
+ * - test doubles for the VRF sockets of udpfwd_vrf.c,
+ * - allocation counting, a cycle counter and an instruction counter for
+ *   the reports.
+ *
+ * The wrappers are bound with the linker option --wrap, see
+ * RELAY_TEST_WRAP_FLAGS in relay/test/CMakeLists.txt.
+ */
+
+#ifndef RELAY_TEST_H
+#define RELAY_TEST_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <net/if.h>
+
+/* Descriptor of the relay sockets of the VRF test double. sendmsg() on
+ * any other descriptor reaches the kernel. */
+#define RELAY_TEST_SOCK_FD INT32_MAX
+
+/* Maximum number of fake interfaces */
+#define RELAY_TEST_MAX_INTERFACES 4096
+
+/* Fake interface */
+struct relay_test_intf {
+    char name[IF_NAMESIZE];
+    uint32_t ifIndex;
+    uint32_t ip;                /* network byte order */
+    uint32_t mask;              /* network byte order */
+    uint8_t mac[6];
+};
+
+/* Transmitted packet handler */
+typedef void relay_test_tx_cb(const void *pkt, size_t size, void *aux);
+
+/* Fake interfaces */
+bool relay_test_add_interface(const char *arg);
+const struct relay_test_intf *relay_test_find_interface(const char *name);
+const struct relay_test_intf *relay_test_ingress(const struct ip *iph,
+                                          const struct relay_test_intf *dflt);
+void relay_test_pktinfo(const struct relay_test_intf *intf,
+                        const struct ip *iph, struct in_pktinfo *pktInfo);
+
+/* In-memory configuration source */
+bool relay_test_add_server(const char *arg);
+void relay_test_config_apply(void);
+
+/* Transmit capture */
+void relay_test_set_tx(relay_test_tx_cb *cb, void *aux);
+
+/* Counters of the environment */
+uint64_t relay_test_tx_packets(void);
+uint64_t relay_test_tx_bad_checksums(void);
+uint64_t relay_test_arp_updates(void);
+uint64_t relay_test_allocations(void);
+uint64_t relay_test_cycles(void);
+bool relay_test_has_cycles(void);
+uint64_t relay_test_instructions(void);
+bool relay_test_has_instructions(void);
+uint64_t relay_test_nsec(void);
+uint64_t relay_test_rss_kib(void);
+
+/* Packet trace of IPv4 packets read from pcap files */
+struct relay_test_packet {
+    uint8_t *data;              /* IPv4 header onwards */
+    uint32_t size;
+};
+
+struct relay_test_trace {
+    struct relay_test_packet *pkts;
+    size_t n;
+    size_t allocated;
+};
+
+void relay_test_trace_init(struct relay_test_trace *trace);
+void relay_test_trace_destroy(struct relay_test_trace *trace);
+void relay_test_trace_add(struct relay_test_trace *trace, const void *pkt,
+                          uint32_t size);
+int relay_test_pcap_load(const char *file_name,
+                         struct relay_test_trace *trace);
+FILE *relay_test_pcap_create(const char *file_name);
+void relay_test_pcap_write(FILE *file, const void *pkt, size_t size);
+
+#endif /* relay_test.h */
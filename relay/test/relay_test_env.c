@@ -0,0 +1,639 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_test_env.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Fake interface table behind the interface lookup wrappers.
+ * - In-memory configuration source for the relay interfaces.
+ * - Capture of the packets transmitted by the packet path.
+ * - Allocation, cycle and instruction counters of the harnesses.
+ */
+
+#include <errno.h>
+#include <ifaddrs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/perf_event.h>
+#include <net/ethernet.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RELAY_TEST_HAS_TSC 1
+#endif
+
+#include "ovs-atomic.h"
+#include "shash.h"
+#include "util.h"
+#include "udpfwd.h"
+#include "relay_test.h"
+
+/* Globals of relay_main.c used by the packet path */
+struct ovsdb_idl *idl;
+uint32_t idl_seqno;
+
+/* Fake interface table, and the views of it returned by the wrappers */
+static struct relay_test_intf intfs[RELAY_TEST_MAX_INTERFACES];
+static size_t n_intfs;
+static struct ifaddrs ifa_list[2 * RELAY_TEST_MAX_INTERFACES];
+static struct sockaddr_ll ifa_ll[RELAY_TEST_MAX_INTERFACES];
+static struct sockaddr_in ifa_addr[RELAY_TEST_MAX_INTERFACES];
+static struct sockaddr_in ifa_mask[RELAY_TEST_MAX_INTERFACES];
+static struct if_nameindex if_list[RELAY_TEST_MAX_INTERFACES + 1];
+
+/* Interfaces of the configuration source, by name */
+static struct shash config_intfs = SHASH_INITIALIZER(&config_intfs);
+
+/* Transmit capture */
+static relay_test_tx_cb *tx_cb;
+static void *tx_aux;
+static uint8_t tx_buff[65536];
+static uint64_t tx_packets;
+static uint64_t tx_bad_checksums;
+
+/* Instructions retired in user space by the thread that first reads them:
+ * -2 until the counter is opened, -1 if the kernel does not provide it */
+static int instructions_fd = -2;
+
+/* Calls to the allocator, from any code linked in the harness */
+static atomic_uint64_t n_allocations = ATOMIC_VAR_INIT(0);
+
+ssize_t __real_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
+/*
+ * Function      : relay_test_rebuild
+ * Responsiblity : Regenerate the getifaddrs() and if_nameindex() views of
+ *                 the interface table, one AF_PACKET and one AF_INET
+ *                 entry per interface.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_test_rebuild(void)
+{
+    struct relay_test_intf *intf;
+    struct ifaddrs *ifa;
+    size_t iter;
+
+    memset(ifa_list, 0, sizeof ifa_list);
+    memset(if_list, 0, sizeof if_list);
+
+    for (iter = 0; iter < n_intfs; iter++) {
+        intf = &intfs[iter];
+
+        ifa_ll[iter].sll_family = AF_PACKET;
+        ifa_ll[iter].sll_ifindex = intf->ifIndex;
+        ifa_ll[iter].sll_halen = ETH_ALEN;
+        memcpy(ifa_ll[iter].sll_addr, intf->mac, ETH_ALEN);
+
+        ifa_addr[iter].sin_family = AF_INET;
+        ifa_addr[iter].sin_addr.s_addr = intf->ip;
+        ifa_mask[iter].sin_family = AF_INET;
+        ifa_mask[iter].sin_addr.s_addr = intf->mask;
+
+        ifa = &ifa_list[2 * iter];
+        ifa->ifa_name = intf->name;
+        ifa->ifa_flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST;
+        ifa->ifa_addr = (struct sockaddr *) &ifa_ll[iter];
+        ifa->ifa_next = ifa + 1;
+
+        ifa++;
+        ifa->ifa_name = intf->name;
+        ifa->ifa_flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST;
+        ifa->ifa_addr = (struct sockaddr *) &ifa_addr[iter];
+        ifa->ifa_netmask = (struct sockaddr *) &ifa_mask[iter];
+        ifa->ifa_next = (iter + 1 < n_intfs) ? ifa + 1 : NULL;
+
+        if_list[iter].if_index = intf->ifIndex;
+        if_list[iter].if_name = intf->name;
+    }
+}
+
+/*
+ * Function      : relay_test_add_interface
+ * Responsiblity : Add a fake interface described as
+ *                 NAME,IFINDEX,IP/PLEN[,MAC]
+ * Parameters    : arg - interface description
+ * Return        : true on success, false if the description is invalid
+ */
+bool relay_test_add_interface(const char *arg)
+{
+    struct relay_test_intf *intf;
+    char *copy, *save = NULL, *name, *index, *addr, *plen, *mac;
+    struct in_addr ip;
+    int ifIndex, len;
+    bool ok = false;
+
+    if (n_intfs >= RELAY_TEST_MAX_INTERFACES)
+        return false;
+
+    copy = xstrdup(arg);
+    name = strtok_r(copy, ",", &save);
+    index = strtok_r(NULL, ",", &save);
+    addr = strtok_r(NULL, ",", &save);
+    mac = strtok_r(NULL, ",", &save);
+    plen = addr ? strchr(addr, '/') : NULL;
+    if (plen)
+        *plen++ = '\0';
+
+    if (!name || (strlen(name) >= IF_NAMESIZE)
+        || !index || !str_to_int(index, 10, &ifIndex) || (ifIndex <= 0)
+        || !addr || (1 != inet_pton(AF_INET, addr, &ip))
+        || !plen || !str_to_int(plen, 10, &len) || (len < 0) || (len > 32)
+        || relay_test_find_interface(name)) {
+        goto out;
+    }
+
+    intf = &intfs[n_intfs];
+    memset(intf, 0, sizeof *intf);
+    ovs_strzcpy(intf->name, name, sizeof intf->name);
+    intf->ifIndex = ifIndex;
+    intf->ip = ip.s_addr;
+    intf->mask = len ? htonl(~0U << (32 - len)) : 0;
+
+    if (mac) {
+        if (6 != sscanf(mac, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+                        &intf->mac[0], &intf->mac[1], &intf->mac[2],
+                        &intf->mac[3], &intf->mac[4], &intf->mac[5])) {
+            goto out;
+        }
+    } else {
+        /* Locally administered address derived from the ifindex */
+        intf->mac[0] = 0x02;
+        intf->mac[2] = (ifIndex >> 24) & 0xff;
+        intf->mac[3] = (ifIndex >> 16) & 0xff;
+        intf->mac[4] = (ifIndex >> 8) & 0xff;
+        intf->mac[5] = ifIndex & 0xff;
+    }
+
+    n_intfs++;
+    relay_test_rebuild();
+    ok = true;
+
+out:
+    free(copy);
+    return ok;
+}
+
+/*
+ * Function      : relay_test_find_interface
+ * Responsiblity : Look up a fake interface by name
+ * Parameters    : name - interface name
+ * Return        : interface, NULL if not found
+ */
+const struct relay_test_intf *relay_test_find_interface(const char *name)
+{
+    size_t iter;
+
+    for (iter = 0; iter < n_intfs; iter++) {
+        if (!strncmp(intfs[iter].name, name, IF_NAMESIZE))
+            return &intfs[iter];
+    }
+    return NULL;
+}
+
+/*
+ * Function      : relay_test_ingress
+ * Responsiblity : Pick the interface a replayed packet arrives on: the
+ *                 interface whose subnet holds the source address.
+ * Parameters    : iph - IPv4 header of the packet
+ *                 dflt - interface of the packets of unknown sources,
+ *                        NULL for the first interface
+ * Return        : interface, NULL if there is none
+ */
+const struct relay_test_intf *relay_test_ingress(const struct ip *iph,
+                                          const struct relay_test_intf *dflt)
+{
+    uint32_t src = iph->ip_src.s_addr;
+    size_t iter;
+
+    if (INADDR_ANY != src) {
+        for (iter = 0; iter < n_intfs; iter++) {
+            if ((src & intfs[iter].mask)
+                == (intfs[iter].ip & intfs[iter].mask)) {
+                return &intfs[iter];
+            }
+        }
+    }
+
+    if (dflt)
+        return dflt;
+    return n_intfs ? &intfs[0] : NULL;
+}
+
+/*
+ * Function      : relay_test_pktinfo
+ * Responsiblity : Fill the IP_PKTINFO data the kernel reports for a
+ *                 packet received on an interface.
+ * Parameters    : intf - ingress interface
+ *                 iph - IPv4 header of the packet
+ *                 pktInfo - filled packet information
+ * Return        : none
+ */
+void relay_test_pktinfo(const struct relay_test_intf *intf,
+                        const struct ip *iph, struct in_pktinfo *pktInfo)
+{
+    memset(pktInfo, 0, sizeof *pktInfo);
+    pktInfo->ipi_ifindex = intf->ifIndex;
+    pktInfo->ipi_spec_dst.s_addr = intf->ip;
+    pktInfo->ipi_addr = iph->ip_dst;
+}
+
+/*
+ * Function      : relay_test_add_server
+ * Responsiblity : Add a server to the configuration source, described as
+ *                 NAME,IP[,PORT]. Port 67 (the default) configures a
+ *                 dhcp-relay helper address, other ports a UDP broadcast
+ *                 forwarder server.
+ * Parameters    : arg - server description
+ * Return        : true on success, false if the description is invalid
+ */
+bool relay_test_add_server(const char *arg)
+{
+    UDPFWD_SNAPSHOT_INTF *rec;
+    char *copy, *save = NULL, *name, *addr, *port;
+    struct in_addr ip;
+    int udpPort = DHCPS_PORT;
+    bool ok = false;
+
+    copy = xstrdup(arg);
+    name = strtok_r(copy, ",", &save);
+    addr = strtok_r(NULL, ",", &save);
+    port = strtok_r(NULL, ",", &save);
+
+    if (!name || (strlen(name) >= RELAY_SNAPSHOT_NAME_LEN)
+        || !addr || (1 != inet_pton(AF_INET, addr, &ip))
+        || (port && (!str_to_int(port, 10, &udpPort)
+                     || (udpPort <= 0) || (udpPort > UINT16_MAX)))) {
+        goto out;
+    }
+
+    rec = shash_find_data(&config_intfs, name);
+    if (NULL == rec) {
+        rec = xzalloc(sizeof *rec);
+        ovs_strzcpy(rec->portName, name, sizeof rec->portName);
+        shash_add(&config_intfs, name, rec);
+    }
+
+    rec = xrealloc(rec, sizeof *rec
+                        + (rec->n_servers + 1) * sizeof rec->servers[0]);
+    rec->servers[rec->n_servers].ip_address = ip.s_addr;
+    rec->servers[rec->n_servers].udp_port = udpPort;
+    rec->servers[rec->n_servers].reserved = 0;
+    rec->n_servers++;
+    shash_replace(&config_intfs, name, rec);
+    ok = true;
+
+out:
+    free(copy);
+    return ok;
+}
+
+/*
+ * Function      : relay_test_config_apply
+ * Responsiblity : Create the interface entries of the configuration
+ *                 source, through the same path as a snapshot restore.
+ * Parameters    : none
+ * Return        : none
+ */
+void relay_test_config_apply(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH (node, &config_intfs) {
+        udpfwd_restore_interface(node->data);
+    }
+    shash_clear_free_data(&config_intfs);
+}
+
+/*
+ * Function      : relay_test_set_tx
+ * Responsiblity : Set the handler of the transmitted packets
+ * Parameters    : cb - handler, NULL to only count the packets
+ *                 aux - handler argument
+ * Return        : none
+ */
+void relay_test_set_tx(relay_test_tx_cb *cb, void *aux)
+{
+    tx_cb = cb;
+    tx_aux = aux;
+}
+
+/*
+ * Function      : relay_test_tx_packets
+ * Responsiblity : Get the number of packets transmitted by the relay
+ * Parameters    : none
+ * Return        : packet count
+ */
+uint64_t relay_test_tx_packets(void)
+{
+    return tx_packets;
+}
+
+/*
+ * Function      : relay_test_tx_bad_checksums
+ * Responsiblity : Get the number of transmitted packets with a wrong IP
+ *                 header checksum
+ * Parameters    : none
+ * Return        : packet count
+ */
+uint64_t relay_test_tx_bad_checksums(void)
+{
+    return tx_bad_checksums;
+}
+
+/*
+ * Function      : relay_test_allocations
+ * Responsiblity : Get the number of calls to the allocator so far
+ * Parameters    : none
+ * Return        : allocation count, 0 if allocations are not counted
+ */
+uint64_t relay_test_allocations(void)
+{
+    uint64_t count;
+
+    atomic_read_relaxed(&n_allocations, &count);
+    return count;
+}
+
+/*
+ * Function      : relay_test_has_cycles
+ * Responsiblity : Check if relay_test_cycles() reads a cycle counter
+ * Parameters    : none
+ * Return        : true if cycles are counted
+ */
+bool relay_test_has_cycles(void)
+{
+#ifdef RELAY_TEST_HAS_TSC
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Function      : relay_test_cycles
+ * Responsiblity : Read the CPU cycle counter
+ * Parameters    : none
+ * Return        : cycles, 0 if the architecture has no usable counter
+ */
+uint64_t relay_test_cycles(void)
+{
+#ifdef RELAY_TEST_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Function      : relay_test_instructions_open
+ * Responsiblity : Open the hardware instruction counter of the calling
+ *                 thread, once. It is missing on virtual machines without a
+ *                 performance monitoring unit and when perf_event_paranoid
+ *                 forbids it.
+ * Parameters    : none
+ * Return        : none
+ */
+static void relay_test_instructions_open(void)
+{
+    struct perf_event_attr attr;
+
+    if (-2 != instructions_fd)
+        return;
+
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    instructions_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (instructions_fd < 0)
+        instructions_fd = -1;
+}
+
+/*
+ * Function      : relay_test_has_instructions
+ * Responsiblity : Check if relay_test_instructions() reads a counter
+ * Parameters    : none
+ * Return        : true if instructions are counted
+ */
+bool relay_test_has_instructions(void)
+{
+    relay_test_instructions_open();
+    return instructions_fd >= 0;
+}
+
+/*
+ * Function      : relay_test_instructions
+ * Responsiblity : Read the instructions retired in user space by the
+ *                 thread that opened the counter
+ * Parameters    : none
+ * Return        : instructions, 0 if they are not counted
+ */
+uint64_t relay_test_instructions(void)
+{
+    uint64_t count;
+
+    relay_test_instructions_open();
+    if ((instructions_fd < 0)
+        || (read(instructions_fd, &count, sizeof count) != sizeof count))
+        return 0;
+    return count;
+}
+
+/*
+ * Function      : relay_test_nsec
+ * Responsiblity : Read the monotonic clock
+ * Parameters    : none
+ * Return        : time in nanoseconds
+ */
+uint64_t relay_test_nsec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Function      : relay_test_rss_kib
+ * Responsiblity : Read the resident set size of the process
+ * Parameters    : none
+ * Return        : resident memory in KiB, 0 if unknown
+ */
+uint64_t relay_test_rss_kib(void)
+{
+    unsigned long long size, resident;
+    FILE *file;
+    int n;
+
+    file = fopen("/proc/self/statm", "r");
+    if (NULL == file)
+        return 0;
+    n = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+
+    return (2 == n) ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
+
+/*
+ * Wrappers of the libc calls of the packet path, bound with --wrap.
+ */
+
+int __wrap_getifaddrs(struct ifaddrs **ifap)
+{
+    *ifap = n_intfs ? ifa_list : NULL;
+    return 0;
+}
+
+void __wrap_freeifaddrs(struct ifaddrs *ifa OVS_UNUSED)
+{
+}
+
+struct if_nameindex *__wrap_if_nameindex(void)
+{
+    return if_list;
+}
+
+void __wrap_if_freenameindex(struct if_nameindex *ptr OVS_UNUSED)
+{
+}
+
+char *__wrap_if_indextoname(unsigned int ifindex, char *ifname)
+{
+    size_t iter;
+
+    for (iter = 0; iter < n_intfs; iter++) {
+        if (intfs[iter].ifIndex == ifindex) {
+            return strncpy(ifname, intfs[iter].name, IF_NAMESIZE);
+        }
+    }
+    errno = ENXIO;
+    return NULL;
+}
+
+unsigned int __wrap_if_nametoindex(const char *ifname)
+{
+    const struct relay_test_intf *intf = relay_test_find_interface(ifname);
+
+    if (NULL == intf) {
+        errno = ENODEV;
+        return 0;
+    }
+    return intf->ifIndex;
+}
+
+/*
+ * Function      : relay_test_ip_cksum_ok
+ * Responsiblity : Verify the IP header checksum of a transmitted packet
+ * Parameters    : pkt - IPv4 packet
+ *                 size - packet size
+ * Return        : true - if the header is complete and its checksum valid
+ *                 false - otherwise
+ */
+static bool relay_test_ip_cksum_ok(const uint8_t *pkt, size_t size)
+{
+    size_t iter, hlen;
+    uint32_t sum = 0;
+
+    if (size < sizeof(struct ip))
+        return false;
+
+    hlen = ((const struct ip *) pkt)->ip_hl * 4;
+    if ((hlen < sizeof(struct ip)) || (hlen > size))
+        return false;
+
+    for (iter = 0; iter < hlen; iter += 2) {
+        sum += (pkt[iter] << 8) | pkt[iter + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return 0xffff == sum;
+}
+
+ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    size_t iter, len = 0;
+
+    /* Descriptors the harness opened itself are real sockets */
+    if (RELAY_TEST_SOCK_FD != sockfd)
+        return __real_sendmsg(sockfd, msg, flags);
+
+    for (iter = 0; iter < msg->msg_iovlen; iter++) {
+        if (len + msg->msg_iov[iter].iov_len > sizeof tx_buff) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        memcpy(tx_buff + len, msg->msg_iov[iter].iov_base,
+               msg->msg_iov[iter].iov_len);
+        len += msg->msg_iov[iter].iov_len;
+    }
+
+    tx_packets++;
+    if (!relay_test_ip_cksum_ok(tx_buff, len))
+        tx_bad_checksums++;
+    if (tx_cb)
+        tx_cb(tx_buff, len, tx_aux);
+    return len;
+}
+
+#if defined(__GLIBC__) && !defined(RELAY_TEST_SANITIZE)
+/*
+ * Allocator interposition. The definitions in the executable take
+ * precedence over libc for the harness and the shared libraries it
+ * loads, so allocations made inside the OVS libraries are counted too.
+ * Sanitized builds (RELAY_TEST_SANITIZE) leave the allocator to the
+ * sanitizer runtime.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    uint64_t orig;
+
+    atomic_add_relaxed(&n_allocations, 1, &orig);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    uint64_t orig;
+
+    atomic_add_relaxed(&n_allocations, 1, &orig);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    uint64_t orig;
+
+    atomic_add_relaxed(&n_allocations, 1, &orig);
+    return __libc_realloc(ptr, size);
+}
+#endif /* __GLIBC__ && !RELAY_TEST_SANITIZE */
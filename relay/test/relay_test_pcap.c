@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: relay_test_pcap.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Load the IPv4 UDP packets of a pcap file into a packet trace.
+ * - Write raw IPv4 packets to a pcap file.
+ */
+
+#include <byteswap.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+
+#include "util.h"
+#include "relay_test.h"
+
+/* pcap file format */
+#define PCAP_MAGIC              0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAP_VERSION_MAJOR      2
+#define PCAP_VERSION_MINOR      4
+#define PCAP_SNAPLEN            65535
+
+/* Link types of the packets */
+#define PCAP_LINKTYPE_ETHERNET  1
+#define PCAP_LINKTYPE_RAW       101
+#define PCAP_LINKTYPE_LINUX_SLL 113
+#define PCAP_LINKTYPE_IPV4      228
+
+#define ETH_TYPE_IP             0x0800
+#define ETH_TYPE_VLAN           0x8100
+#define ETH_TYPE_QINQ           0x88a8
+
+struct pcap_file_hdr {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_hdr {
+    uint32_t ts_sec;
+    uint32_t ts_subsec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+/*
+ * Function      : relay_test_trace_init
+ * Responsiblity : Initialize an empty packet trace
+ * Parameters    : trace - packet trace
+ * Return        : none
+ */
+void relay_test_trace_init(struct relay_test_trace *trace)
+{
+    trace->pkts = NULL;
+    trace->n = 0;
+    trace->allocated = 0;
+}
+
+/*
+ * Function      : relay_test_trace_destroy
+ * Responsiblity : Free the packets of a trace
+ * Parameters    : trace - packet trace
+ * Return        : none
+ */
+void relay_test_trace_destroy(struct relay_test_trace *trace)
+{
+    size_t iter;
+
+    for (iter = 0; iter < trace->n; iter++) {
+        free(trace->pkts[iter].data);
+    }
+    free(trace->pkts);
+    relay_test_trace_init(trace);
+}
+
+/*
+ * Function      : relay_test_trace_add
+ * Responsiblity : Append a copy of a packet to a trace
+ * Parameters    : trace - packet trace
+ *                 pkt - IPv4 packet
+ *                 size - packet size
+ * Return        : none
+ */
+void relay_test_trace_add(struct relay_test_trace *trace, const void *pkt,
+                          uint32_t size)
+{
+    if (trace->n >= trace->allocated) {
+        trace->pkts = x2nrealloc(trace->pkts, &trace->allocated,
+                                 sizeof *trace->pkts);
+    }
+    trace->pkts[trace->n].data = xmemdup(pkt, size);
+    trace->pkts[trace->n].size = size;
+    trace->n++;
+}
+
+/*
+ * Function      : pcap_ipv4_offset
+ * Responsiblity : Locate the IPv4 header of a captured frame
+ * Parameters    : linktype - link type of the capture
+ *                 frame - captured frame
+ *                 len - captured length
+ * Return        : offset of the IPv4 header, -1 if the frame is not IPv4
+ */
+static int pcap_ipv4_offset(uint32_t linktype, const uint8_t *frame,
+                            uint32_t len)
+{
+    uint32_t offset;
+    uint16_t type;
+
+    switch (linktype) {
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_IPV4:
+        return 0;
+
+    case PCAP_LINKTYPE_LINUX_SLL:
+        if (len < 16)
+            return -1;
+        type = (frame[14] << 8) | frame[15];
+        return (ETH_TYPE_IP == type) ? 16 : -1;
+
+    case PCAP_LINKTYPE_ETHERNET:
+        offset = 12;
+        for (;;) {
+            if (len < offset + 2)
+                return -1;
+            type = (frame[offset] << 8) | frame[offset + 1];
+            if ((ETH_TYPE_VLAN != type) && (ETH_TYPE_QINQ != type))
+                break;
+            offset += 4;
+        }
+        return (ETH_TYPE_IP == type) ? (int)(offset + 2) : -1;
+
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Function      : pcap_udp_length
+ * Responsiblity : Validate a captured IPv4 packet as an unfragmented UDP
+ *                 datagram, the only traffic the relay sockets receive.
+ * Parameters    : pkt - IPv4 packet
+ *                 len - captured length
+ * Return        : IPv4 total length, 0 if the packet is not usable
+ */
+static uint32_t pcap_udp_length(const uint8_t *pkt, uint32_t len)
+{
+    const struct ip *iph = (const struct ip *) pkt;
+    uint32_t hlen, tot_len;
+
+    if (len < sizeof(struct ip) || 4 != iph->ip_v)
+        return 0;
+
+    hlen = iph->ip_hl * 4;
+    tot_len = ntohs(iph->ip_len);
+    if ((hlen < sizeof(struct ip))
+        || (tot_len < hlen + sizeof(struct udphdr))
+        || (tot_len > len)
+        || (IPPROTO_UDP != iph->ip_p)
+        || (ntohs(iph->ip_off) & (IP_MF | IP_OFFMASK))) {
+        return 0;
+    }
+
+    return tot_len;
+}
+
+/*
+ * Function      : relay_test_pcap_load
+ * Responsiblity : Append the IPv4 UDP packets of a pcap file to a trace.
+ *                 Link layer headers and trailing padding are stripped,
+ *                 other packets are skipped.
+ * Parameters    : file_name - pcap file
+ *                 trace - packet trace
+ * Return        : 0 on success, errno value otherwise
+ */
+int relay_test_pcap_load(const char *file_name,
+                         struct relay_test_trace *trace)
+{
+    struct pcap_file_hdr fh;
+    struct pcap_record_hdr rh;
+    uint8_t *frame;
+    uint32_t len, tot_len;
+    bool swapped;
+    FILE *file;
+    int offset, error = 0;
+
+    file = fopen(file_name, "rb");
+    if (NULL == file)
+        return errno;
+
+    if (1 != fread(&fh, sizeof fh, 1, file)) {
+        fclose(file);
+        return EINVAL;
+    }
+
+    if ((PCAP_MAGIC == fh.magic) || (PCAP_MAGIC_NSEC == fh.magic)) {
+        swapped = false;
+    } else if ((PCAP_MAGIC == bswap_32(fh.magic))
+               || (PCAP_MAGIC_NSEC == bswap_32(fh.magic))) {
+        swapped = true;
+        fh.linktype = bswap_32(fh.linktype);
+    } else {
+        fclose(file);
+        return EINVAL;
+    }
+
+    frame = xmalloc(PCAP_SNAPLEN);
+    while (1 == fread(&rh, sizeof rh, 1, file)) {
+        len = swapped ? bswap_32(rh.incl_len) : rh.incl_len;
+        if (len > PCAP_SNAPLEN) {
+            error = EINVAL;
+            break;
+        }
+        if (len && (1 != fread(frame, len, 1, file))) {
+            error = EINVAL;
+            break;
+        }
+
+        offset = pcap_ipv4_offset(fh.linktype, frame, len);
+        if (offset < 0)
+            continue;
+
+        tot_len = pcap_udp_length(frame + offset, len - offset);
+        if (tot_len)
+            relay_test_trace_add(trace, frame + offset, tot_len);
+    }
+
+    if (!error && ferror(file))
+        error = EIO;
+
+    free(frame);
+    fclose(file);
+    return error;
+}
+
+/*
+ * Function      : relay_test_pcap_create
+ * Responsiblity : Create a pcap file for raw IPv4 packets
+ * Parameters    : file_name - pcap file
+ * Return        : file, NULL on failure with errno set
+ */
+FILE *relay_test_pcap_create(const char *file_name)
+{
+    struct pcap_file_hdr fh;
+    FILE *file;
+
+    file = fopen(file_name, "wb");
+    if (NULL == file)
+        return NULL;
+
+    memset(&fh, 0, sizeof fh);
+    fh.magic = PCAP_MAGIC;
+    fh.version_major = PCAP_VERSION_MAJOR;
+    fh.version_minor = PCAP_VERSION_MINOR;
+    fh.snaplen = PCAP_SNAPLEN;
+    fh.linktype = PCAP_LINKTYPE_RAW;
+    if (1 != fwrite(&fh, sizeof fh, 1, file)) {
+        fclose(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+/*
+ * Function      : relay_test_pcap_write
+ * Responsiblity : Append a raw IPv4 packet to a pcap file. Replayed
+ *                 packets carry no meaningful time, the records are
+ *                 stamped with the wall clock.
+ * Parameters    : file - pcap file
+ *                 pkt - IPv4 packet
+ *                 size - packet size
+ * Return        : none
+ */
+void relay_test_pcap_write(FILE *file, const void *pkt, size_t size)
+{
+    struct pcap_record_hdr rh;
+    struct timespec now;
+
+    if (size > PCAP_SNAPLEN)
+        size = PCAP_SNAPLEN;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    rh.ts_sec = now.tv_sec;
+    rh.ts_subsec = now.tv_nsec / 1000;
+    rh.incl_len = size;
+    rh.orig_len = size;
+    fwrite(&rh, sizeof rh, 1, file);
+    fwrite(pkt, size, 1, file);
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_replay.c
+ *
+ */
+
+/*
+ * udpfwd-replay: replay captured DHCP and broadcast UDP traffic through
+ * the udpfwd packet path (udpfwd_ctrl) without a switch, a database or
+ * sockets. The relayed packets can be captured to a pcap file, and the
+ * replay reports the packet rate, cycles and allocations per packet.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "udpfwd.h"
+#include "relay_test.h"
+
+/*
+ * Function      : usage
+ * Responsiblity : Utility usage help display
+ * Parameters    : prog - program name
+ * Return        : none
+ */
+static void usage(const char *prog)
+{
+    printf("usage: %s [OPTIONS] FILE.pcap...\n"
+           "Replay IPv4 UDP packets through the udpfwd packet path.\n\n"
+           "  -i, --interface=NAME,IFINDEX,IP/PLEN[,MAC]\n"
+           "                        add a relay interface\n"
+           "  -s, --server=NAME,IP[,PORT]\n"
+           "                        add a server on an interface, port 67\n"
+           "                        (default) is a dhcp-relay helper address\n"
+           "  -g, --ingress=NAME    interface of packets from unknown sources\n"
+           "                        (default: first interface)\n"
+           "      --option82=POLICY enable option 82 with keep, replace or\n"
+           "                        drop policy\n"
+           "  -o, --output=FILE     capture the relayed packets to FILE\n"
+           "  -l, --loops=N         replay the input N times (default: 1)\n"
+           "  -v, --verbose[=SPEC]  set the log levels of the relay modules\n"
+           "  -h, --help            display this help message\n",
+           prog);
+}
+
+/*
+ * Function      : capture_packet
+ * Responsiblity : Transmit handler writing relayed packets to pcap
+ * Parameters    : pkt - IPv4 packet
+ *                 size - packet size
+ *                 aux - pcap file
+ * Return        : none
+ */
+static void capture_packet(const void *pkt, size_t size, void *aux)
+{
+    relay_test_pcap_write(aux, pkt, size);
+}
+
+/*
+ * Function      : replay
+ * Responsiblity : Run all packets of a trace through udpfwd_ctrl once.
+ *                 Packets are copied to a receive sized buffer first,
+ *                 the relay edits them in place.
+ * Parameters    : trace - packet trace
+ *                 pktInfo - receive information of each packet
+ *                 buff - RECV_BUFFER_SIZE bytes work buffer
+ * Return        : none
+ */
+static void replay(const struct relay_test_trace *trace,
+                   struct in_pktinfo *pktInfo, uint8_t *buff)
+{
+    size_t iter;
+
+    for (iter = 0; iter < trace->n; iter++) {
+        memcpy(buff, trace->pkts[iter].data, trace->pkts[iter].size);
+        udpfwd_ctrl(buff, trace->pkts[iter].size, &pktInfo[iter]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    enum {
+        OPT_OPTION82 = UCHAR_MAX + 1,
+    };
+    static const struct option long_options[] = {
+        {"interface", required_argument, NULL, 'i'},
+        {"server",    required_argument, NULL, 's'},
+        {"ingress",   required_argument, NULL, 'g'},
+        {"option82",  required_argument, NULL, OPT_OPTION82},
+        {"output",    required_argument, NULL, 'o'},
+        {"loops",     required_argument, NULL, 'l'},
+        {"verbose",   optional_argument, NULL, 'v'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    const struct relay_test_intf *ingress = NULL, *intf;
+    const char *ingress_name = NULL, *output = NULL, *policy = NULL;
+    struct relay_test_trace trace, input;
+    struct in_pktinfo *pktInfo;
+    uint64_t start_ns, elapsed_ns, start_cycles, cycles;
+    uint64_t start_allocs, allocs, start_tx, packets;
+    uint8_t *buff;
+    size_t iter, oversized = 0;
+    FILE *capture = NULL;
+    int c, loop, loops = 1, error;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_WARN);
+
+    while ((c = getopt_long(argc, argv, "i:s:g:o:l:v::h", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'i':
+            if (!relay_test_add_interface(optarg)) {
+                fprintf(stderr, "%s: invalid interface %s\n", argv[0],
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            if (!relay_test_add_server(optarg)) {
+                fprintf(stderr, "%s: invalid server %s\n", argv[0], optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'g':
+            ingress_name = optarg;
+            break;
+        case OPT_OPTION82:
+            policy = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'l':
+            if (!str_to_int(optarg, 10, &loops) || (loops < 1)) {
+                fprintf(stderr, "%s: invalid loop count %s\n", argv[0],
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'v':
+            vlog_set_verbosity(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (ingress_name) {
+        ingress = relay_test_find_interface(ingress_name);
+        if (NULL == ingress) {
+            fprintf(stderr, "%s: unknown ingress interface %s\n", argv[0],
+                    ingress_name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Packet path configuration, both features on */
+    udpfwd_module_init();
+    update_feature_state(UDP_BCAST_FORWARDER, ENABLE);
+    if (policy) {
+        update_feature_state(DHCP_RELAY_OPTION82, ENABLE);
+        update_option82_policy((char *) policy);
+    }
+    relay_test_config_apply();
+
+    /* Load the input, without the packets no receive buffer can hold */
+    relay_test_trace_init(&input);
+    relay_test_trace_init(&trace);
+    for (; optind < argc; optind++) {
+        error = relay_test_pcap_load(argv[optind], &input);
+        if (error) {
+            fprintf(stderr, "%s: cannot read %s: %s\n", argv[0],
+                    argv[optind], strerror(error));
+            return EXIT_FAILURE;
+        }
+    }
+    for (iter = 0; iter < input.n; iter++) {
+        if (input.pkts[iter].size > RECV_BUFFER_SIZE) {
+            oversized++;
+            continue;
+        }
+        relay_test_trace_add(&trace, input.pkts[iter].data,
+                             input.pkts[iter].size);
+    }
+    relay_test_trace_destroy(&input);
+
+    if (0 == trace.n) {
+        fprintf(stderr, "%s: no IPv4 UDP packets to replay\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pktInfo = xcalloc(trace.n, sizeof *pktInfo);
+    for (iter = 0; iter < trace.n; iter++) {
+        intf = relay_test_ingress((struct ip *) trace.pkts[iter].data,
+                                  ingress);
+        if (NULL == intf) {
+            fprintf(stderr, "%s: no interface to receive on, use "
+                    "--interface\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        relay_test_pktinfo(intf, (struct ip *) trace.pkts[iter].data,
+                           &pktInfo[iter]);
+    }
+    buff = xmalloc(RECV_BUFFER_SIZE);
+
+    /* The capture is a separate pass, so that writing the file is not
+     * measured */
+    if (output) {
+        capture = relay_test_pcap_create(output);
+        if (NULL == capture) {
+            fprintf(stderr, "%s: cannot create %s: %s\n", argv[0], output,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+        relay_test_set_tx(capture_packet, capture);
+        replay(&trace, pktInfo, buff);
+        relay_test_set_tx(NULL, NULL);
+        fclose(capture);
+    }
+
+    start_tx = relay_test_tx_packets();
+    start_allocs = relay_test_allocations();
+    start_ns = relay_test_nsec();
+    start_cycles = relay_test_cycles();
+    for (loop = 0; loop < loops; loop++) {
+        replay(&trace, pktInfo, buff);
+    }
+    cycles = relay_test_cycles() - start_cycles;
+    elapsed_ns = relay_test_nsec() - start_ns;
+    allocs = relay_test_allocations() - start_allocs;
+    packets = (uint64_t) trace.n * loops;
+
+    printf("input: %zu packets, %zu oversized packets skipped\n",
+           trace.n, oversized);
+    printf("replayed: %llu packets in %d loops\n",
+           (unsigned long long) packets, loops);
+    printf("relayed: %llu packets, %llu arp updates\n",
+           (unsigned long long) (relay_test_tx_packets() - start_tx),
+           (unsigned long long) relay_test_arp_updates());
+    printf("elapsed: %.3f ms\n", elapsed_ns / 1e6);
+    printf("packets/sec: %.0f\n",
+           elapsed_ns ? packets * 1e9 / elapsed_ns : 0.0);
+    if (relay_test_has_cycles()) {
+        printf("cycles/packet: %.1f\n", (double) cycles / packets);
+    } else {
+        printf("cycles/packet: n/a\n");
+    }
+    printf("allocations/packet: %.3f (%llu allocations)\n",
+           (double) allocs / packets, (unsigned long long) allocs);
+
+    /* Relayed packets must carry a valid IP header checksum */
+    if (relay_test_tx_bad_checksums()) {
+        fprintf(stderr, "%s: %llu relayed packets with a bad IP header "
+                "checksum\n", argv[0],
+                (unsigned long long) relay_test_tx_bad_checksums());
+        error = EXIT_FAILURE;
+    } else {
+        error = EXIT_SUCCESS;
+    }
+
+    free(buff);
+    free(pktInfo);
+    relay_test_trace_destroy(&trace);
+    return error;
+}
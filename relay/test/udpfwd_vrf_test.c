@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_vrf_test.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Test double of udpfwd_vrf.c for the offline harnesses. There are no
+ *   VRF sockets, the packet path transmits on RELAY_TEST_SOCK_FD and ARP
+ *   entries are only counted.
+ */
+
+#include "udpfwd.h"
+#include "relay_test.h"
+
+static uint64_t arp_updates;
+
+void udpfwd_vrf_init(void)
+{
+}
+
+void udpfwd_vrf_exit(void)
+{
+}
+
+void udpfwd_vrf_reconfigure(void)
+{
+}
+
+void udpfwd_vrf_run(void)
+{
+}
+
+void udpfwd_vrf_wait(void)
+{
+}
+
+int32_t udpfwd_vrf_sock(void)
+{
+    return RELAY_TEST_SOCK_FD;
+}
+
+void udpfwd_vrf_rxq_drops(UDPFWD_VRF_CTX_T *ctx OVS_UNUSED,
+                          uint32_t count OVS_UNUSED)
+{
+}
+
+void udpfwd_vrf_set_arp(struct arpreq *req OVS_UNUSED,
+                        uint32_t ifIndex OVS_UNUSED)
+{
+    arp_updates++;
+}
+
+/*
+ * Function      : relay_test_arp_updates
+ * Responsiblity : Get the number of ARP entries the relay programmed
+ * Parameters    : none
+ * Return        : ARP update count
+ */
+uint64_t relay_test_arp_updates(void)
+{
+    return arp_updates;
+}
@@ -53,6 +53,11 @@ uint8_t * dhcpScanOpt(uint8_t *opt, uint8_t *optend,
                             uint8_t tag, uint8_t *ovld_opt)
 {
     while (opt < optend) {
+        /* Stop at an option running past the end of the field */
+        if ((*opt != PAD) && (*opt != END)
+            && ((opt + 2 > optend) || (opt + 2 + DHCPOPTLEN(opt) > optend))) {
+            break;
+        }
         if (*opt == tag) {
             return(opt);
         }
@@ -63,7 +68,7 @@ uint8_t * dhcpScanOpt(uint8_t *opt, uint8_t *optend,
             opt++;
         }
         else {
-            if (*opt == OPT_OVERLOAD) {
+            if ((*opt == OPT_OVERLOAD) && (DHCPOPTLEN(opt) > 0)) {
                 if (ovld_opt != NULL) {
                     *ovld_opt = *OPTBODY(opt);
                 }
@@ -258,7 +263,8 @@ int32_t dhcp_relay_validate_agent_option(const uint8_t *buf, int32_t buflen,
         return DHCP_RELAY_INVALID_OPTION_82;
 
     /* Convert circuit id in string format back to unsigned int */
-    circuit_id = ((circuit_id_ptr[0] << 24) + (circuit_id_ptr[1] << 16) +
+    circuit_id = (((CIRCUIT_ID_t) circuit_id_ptr[0] << 24) +
+                  (circuit_id_ptr[1] << 16) +
                   (circuit_id_ptr[2] << 8) + circuit_id_ptr[3]);
 
     /* Check that the remote_id is correct based on our current config */
@@ -359,6 +365,17 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
     sp = option_parser_ptr;
     while (option_parser_ptr < max)
     {
+        /* An option running past the end of the packet is malformed */
+        if ((*option_parser_ptr != PAD) && (*option_parser_ptr != END)
+            && ((option_parser_ptr + DHCP_OPTION_HEADER_LENGTH > max)
+                || (option_parser_ptr + DHCP_OPTION_HEADER_LENGTH
+                    + option_parser_ptr[1] > max)))
+        {
+            VLOG_ERR("Pkt dropped. option %u runs past the end of the packet",
+                     *option_parser_ptr);
+            return DROPPED;
+        }
+
         switch (*option_parser_ptr)
         {
         /* Skip padding... */
@@ -524,8 +541,10 @@ OPTION82_RESULT_t process_dhcp_relay_option82_message(void *pkt, DHCP_OPTION_82_
         length = sp - ((uint8_t *)dhcp);
         packlen = (length + dhcp_relay_get_option82_len(remote_id));
 
-        /* Check if there enough space to add new option */
-        opt82 = (RECV_BUFFER_SIZE > packlen);
+        /* Check if there enough space to add new option, behind the IP
+         * and UDP headers in the receive buffer */
+        opt82 = (RECV_BUFFER_SIZE
+                 > (iph->ip_hl * 4) + UDPHDR_LENGTH + packlen);
 
         /* If there is max dhcp size option in the pkt, check if we will exceed
         * this size.  If so, do not add option82.  */
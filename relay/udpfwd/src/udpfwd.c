@@ -26,6 +26,7 @@
 
 /* Linux includes */
 #include <errno.h>
+#include <inttypes.h>
 #include <timeval.h>
 #include <getopt.h>
 #include <limits.h>
@@ -59,6 +60,7 @@
 #include "openswitch-dflt.h"
 #include "coverage.h"
 #include "svec.h"
+#include "json.h"
 
 #include "relay_common.h"
 #include "udpfwd_util.h"
@@ -68,78 +70,32 @@
  * Global variable declarations.
  */
 
-/* udp socket receiver thread handle */
-pthread_t udpBcastRecv_thread;
-
 /* Structure to store value of unixctl arguments */
 struct dump_params {
     char *ifName; /* Name of the Interface */
     uint16_t port; /* udp destination port */
+    UDPFWD_FEATURE feature; /* feature filter, INVALID_FEATURE for all */
+    bool json; /* dump in JSON format */
+    uint64_t changed_since; /* dump only entries changed after this
+                               generation */
 };
 
+#define UDPFWD_DUMP_USAGE \
+    "[--json] [interface NAME] [port N] [feature NAME] " \
+    "[--changed-since=GENERATION]"
+
 /* UDP forwarder global configuration context */
 UDPFWD_CTRL_CB udpfwd_ctrl_cb;
 UDPFWD_CTRL_CB *udpfwd_ctrl_cb_p = &udpfwd_ctrl_cb;
 
 VLOG_DEFINE_THIS_MODULE(udpfwd);
 
-/**
- * External Function Declarations
- */
-extern void *udp_packet_recv(void *args);
-
-/*
- * Function      : udpfwd_module_init
- * Responsiblity : Initialization routine for udp broadcast forwarder module
- * Parameters    : none
- * Return        : sockfd, on success
- *                 -1, on failure
- */
-/* FIXME: Socket needs to be created per VRF basis based on the
- * configuration
- */
-int create_udp_socket(void)
-{
-    int32_t sock = -1;
-    int32_t val = 1;
-    int retVal = -1;
-
-    VLOG_INFO("Creating UDP send socket");
-
-    /* Create socket to send UDP packets to client or server */
-    sock = socket(PF_INET, SOCK_RAW, IPPROTO_UDP);
-    if (-1 == sock) {
-        VLOG_ERR("Failed to create UDP socket");
-        return -1;
-    }
-
-    retVal = setsockopt(sock, IPPROTO_IP, IP_PKTINFO,
-                        (char *)&val, sizeof(val));
-    if (0 != retVal) {
-        VLOG_ERR("Failed to set IP_PKTINFO socket option : %d", retVal);
-        close(sock);
-        return -1;
-    }
-
-    retVal = setsockopt(sock, IPPROTO_IP, IP_HDRINCL,
-                        (char *)&val, sizeof(val));
-    if (0 != retVal) {
-        VLOG_ERR("Failed to set IP_HDRINCL socket option : %d", retVal);
-        close(sock);
-        return -1;
-    }
-
-    retVal = setsockopt(sock, SOL_SOCKET, SO_BROADCAST,
-                       (char *)&val, sizeof (val));
-    if (0 != retVal) {
-        VLOG_ERR("Failed to set broadcast socket option : %d", retVal);
-        close(sock);
-        return -1;
-    }
-
-    VLOG_INFO("UDP send socket created successfully");
-    return sock;
-}
+#ifdef FTR_DHCP_RELAY
+COVERAGE_DEFINE(udpfwd_dhcp_relay_rows);
+#endif /* FTR_DHCP_RELAY */
+#ifdef FTR_UDP_BCAST_FWD
+COVERAGE_DEFINE(udpfwd_bcast_fwd_rows);
+#endif /* FTR_UDP_BCAST_FWD */
 
 /*
  * Function      : udpfwd_set_default_config
@@ -183,6 +139,16 @@ void udpfwd_set_default_config(void)
     udpfwd_ctrl_cb_p->stats_interval = STATS_UPDATE_DEFAULT_INTERVAL;
 #endif /* FTR_DHCP_RELAY */
 
+    /* Set receive buffer bounds */
+    atomic_init(&udpfwd_ctrl_cb_p->rcvbufMin, UDPFWD_RCVBUF_DEFAULT_MIN);
+    atomic_init(&udpfwd_ctrl_cb_p->rcvbufMax, UDPFWD_RCVBUF_DEFAULT_MAX);
+
+    /* Set receive scheduler queue depths */
+    atomic_init(&udpfwd_ctrl_cb_p->classDepth[UDPFWD_CLASS_DHCP],
+                UDPFWD_CLASS_DHCP_DEPTH);
+    atomic_init(&udpfwd_ctrl_cb_p->classDepth[UDPFWD_CLASS_FWD],
+                UDPFWD_CLASS_FWD_DEPTH);
+
     return;
 }
 
@@ -196,10 +162,13 @@ void udpfwd_set_default_config(void)
 bool udpfwd_module_init(void)
 {
     int32_t retVal;
-    int32_t sock;
 
     memset(udpfwd_ctrl_cb_p, 0, sizeof(UDPFWD_CTRL_CB));
 
+    /* Statistics are pushed once at startup */
+    udpfwd_ctrl_cb_p->stats_seq = seq_create();
+    atomic_init(&udpfwd_ctrl_cb_p->stats_dirty, true);
+
     /* Set feature default configuration status */
     udpfwd_set_default_config();
 
@@ -211,45 +180,110 @@ bool udpfwd_module_init(void)
         return false;
     }
 
-    /* Create UDP socket */
-    if (-1 == (sock = create_udp_socket()))
-    {
-        VLOG_FATAL("Failed to create broadcast socket");
-        return false;
-    }
+    /* Initialize server hash table */
+    shash_init(&udpfwd_ctrl_cb_p->intfHashTable);
 
-    udpfwd_ctrl_cb_p->udpSockFd = sock;
+    /* Initialize server hash map and the arena backing its entries */
+    cmap_init(&udpfwd_ctrl_cb_p->serverHashMap);
+    relay_pool_init(&udpfwd_ctrl_cb_p->serverPool, sizeof(UDPFWD_SERVER_T),
+                    UDPFWD_SERVER_POOL_CHUNK);
 
-    /* Allocate memory for packet recieve buffer */
-    udpfwd_ctrl_cb_p->rcvbuff = (char *) calloc(RECV_BUFFER_SIZE, sizeof(char));
+    /* Initialize the maps of applied configuration records */
+    relay_row_map_init(&udpfwd_ctrl_cb_p->dhcpRelayRows);
+    relay_row_map_init(&udpfwd_ctrl_cb_p->bcastFwdRows);
 
-    if (NULL == udpfwd_ctrl_cb_p->rcvbuff)
-    {
-        close(udpfwd_ctrl_cb_p->udpSockFd);
-        VLOG_FATAL(" Memory allocation for receive buffer failed\n");
-        return false;
+    /* Start receiving in the default VRF, the other VRFs follow the
+     * configuration */
+    udpfwd_vrf_init();
+
+    return true;
+}
+
+/*
+ * Function      : udpfwd_stats_changed
+ * Responsiblity : Schedule a statistics refresh after a counter update.
+ *                 Called from the packet receive path.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_stats_changed(void)
+{
+    bool dirty;
+
+    /* Only the first change after a refresh wakes up the main loop, the
+     * refresh timer takes care of the rest */
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->stats_dirty, &dirty);
+    if (!dirty) {
+        atomic_store_relaxed(&udpfwd_ctrl_cb_p->stats_dirty, true);
+        seq_change(udpfwd_ctrl_cb_p->stats_seq);
     }
+}
 
-    /* Initialize server hash table */
-    shash_init(&udpfwd_ctrl_cb_p->intfHashTable);
+/*
+ * Function      : udpfwd_next_generation
+ * Responsiblity : Allocate a new change generation. Called on
+ *                 configuration changes only, packet counters do not
+ *                 move the generation.
+ * Parameters    : none
+ * Return        : new generation number
+ */
+uint64_t udpfwd_next_generation(void)
+{
+    uint64_t orig;
 
-    /* Initialize server hash map */
-    cmap_init(&udpfwd_ctrl_cb_p->serverHashMap);
+    atomic_add(&udpfwd_ctrl_cb_p->generation, 1, &orig);
+    atomic_store(&udpfwd_ctrl_cb_p->config_generation, orig + 1);
 
-    /* Create UDP broadcast receiver thread */
-    retVal = pthread_create(&udpBcastRecv_thread, (pthread_attr_t *)NULL,
-                            udp_packet_recv, NULL);
-    if (0 != retVal)
-    {
-        free(udpfwd_ctrl_cb_p->rcvbuff);
-        close(udpfwd_ctrl_cb_p->udpSockFd);
-        cmap_destroy(&udpfwd_ctrl_cb_p->serverHashMap);
-        VLOG_FATAL("Failed to create UDP broadcast packet receiver thread : %d",
-                 retVal);
-        return false;
+    /* Statistics rows follow the interface configuration */
+    udpfwd_stats_changed();
+    return orig + 1;
+}
+
+/*
+ * Function      : udpfwd_stamp_counters
+ * Responsiblity : Give the interfaces whose counters changed since the
+ *                 last dump a new generation, so that a dump reports them
+ *                 as changed. One generation covers all of them, however
+ *                 many packets were counted. The configuration generation,
+ *                 which drives the snapshot, does not move. Called with
+ *                 waitSem held.
+ * Parameters    : none
+ * Return        : none
+ */
+static void udpfwd_stamp_counters(void)
+{
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    struct shash_node *node;
+    uint64_t generation = 0;
+
+    SHASH_FOR_EACH(node, &udpfwd_ctrl_cb_p->intfHashTable) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
+        if (!intfNode->countersDirty)
+            continue;
+
+        if (0 == generation) {
+            atomic_add(&udpfwd_ctrl_cb_p->generation, 1, &generation);
+            generation++;
+        }
+        intfNode->countersGeneration = generation;
+        intfNode->countersDirty = false;
     }
+}
 
-    return true;
+/*
+ * Function      : udpfwd_intf_changed_since
+ * Responsiblity : Check whether the configuration or the counters of an
+ *                 interface changed after a generation
+ * Parameters    : intfNode - Interface entry
+ *                 since - generation, 0 for any
+ * Return        : true - if the interface changed
+ *                 false - otherwise
+ */
+static bool udpfwd_intf_changed_since(const UDPFWD_INTERFACE_NODE_T *intfNode,
+                                      uint64_t since)
+{
+    return (intfNode->generation > since)
+           || (intfNode->countersGeneration > since);
 }
 
 /*
@@ -272,6 +306,7 @@ void update_feature_state(UDPFWD_FEATURE feature, FEATURE_STATUS state)
         VLOG_INFO("%s config change. old : %d, new : %d",
                   feature_name[feature], prev_state, state);
         set_feature_status(config, feature, state);
+        udpfwd_next_generation();
     }
 
     return;
@@ -300,6 +335,7 @@ void update_option82_policy(char *value)
 
         /* update global structure with the new policy value. */
         udpfwd_ctrl_cb_p->feature_config.policy = policy;
+        udpfwd_next_generation();
     }
 
     return;
@@ -325,6 +361,7 @@ void update_option82_remote_id(char *value)
 
         /* update global structure with the new remote_id value. */
         udpfwd_ctrl_cb_p->feature_config.r_id = r_id;
+        udpfwd_next_generation();
     }
 
     return;
@@ -351,6 +388,74 @@ void update_stats_refresh_interval(const char *value)
 }
 #endif /* FTR_DHCP_RELAY */
 
+/*
+ * Function      : update_rcvbuf_bounds
+ * Responsiblity : Check for receive buffer bounds update. Sockets pick up
+ *                 the new bounds the next time their buffer is resized.
+ * Parameters    : min_value - minimum buffer size, NULL for the default
+ *                 max_value - maximum buffer size, NULL for the default
+ * Return        : none
+ */
+void update_rcvbuf_bounds(const char *min_value, const char *max_value)
+{
+    unsigned int min_size = UDPFWD_RCVBUF_DEFAULT_MIN;
+    unsigned int max_size = UDPFWD_RCVBUF_DEFAULT_MAX;
+    unsigned int old_min, old_max;
+
+    if (min_value && (0 < atoi(min_value)))
+        min_size = atoi(min_value);
+    if (max_value && (0 < atoi(max_value)))
+        max_size = atoi(max_value);
+
+    if (min_size > max_size) {
+        VLOG_ERR("Invalid receive buffer bounds, min : %u, max : %u",
+                 min_size, max_size);
+        return;
+    }
+
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->rcvbufMin, &old_min);
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->rcvbufMax, &old_max);
+    if ((old_min != min_size) || (old_max != max_size)) {
+        VLOG_INFO("receive buffer bounds changed. old : %u-%u, new : %u-%u",
+                  old_min, old_max, min_size, max_size);
+        atomic_store_relaxed(&udpfwd_ctrl_cb_p->rcvbufMin, min_size);
+        atomic_store_relaxed(&udpfwd_ctrl_cb_p->rcvbufMax, max_size);
+    }
+}
+
+/*
+ * Function      : update_queue_depth
+ * Responsiblity : Check for a receive scheduler queue depth update.
+ *                 Packets already queued beyond a lowered depth are still
+ *                 relayed.
+ * Parameters    : class - traffic class
+ *                 value - depth in packets, NULL for the default
+ * Return        : none
+ */
+static void update_queue_depth(enum udpfwd_class class, const char *value)
+{
+    unsigned int depth = (UDPFWD_CLASS_DHCP == class)
+                         ? UDPFWD_CLASS_DHCP_DEPTH : UDPFWD_CLASS_FWD_DEPTH;
+    unsigned int old_depth;
+
+    if (value) {
+        if ((0 >= atoi(value)) || (UDPFWD_CLASS_MAX_DEPTH < atoi(value))) {
+            VLOG_ERR("Invalid queue depth %s for traffic class %d, "
+                     "valid range 1-%d", value, class,
+                     UDPFWD_CLASS_MAX_DEPTH);
+            return;
+        }
+        depth = atoi(value);
+    }
+
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->classDepth[class], &old_depth);
+    if (old_depth != depth) {
+        VLOG_INFO("queue depth of traffic class %d changed. old : %u, "
+                  "new : %u", class, old_depth, depth);
+        atomic_store_relaxed(&udpfwd_ctrl_cb_p->classDepth[class], depth);
+    }
+}
+
 /*
  * Function      : udpfwd_process_globalconfig_update
  * Responsiblity : Process system table update notifications related to udp
@@ -451,6 +556,20 @@ void udpfwd_process_globalconfig_update(void)
         if (value)
             update_stats_refresh_interval(value);
 #endif /* FTR_DHCP_RELAY */
+
+        /* Check if there is a change in receive buffer bounds */
+        update_rcvbuf_bounds(smap_get(&system_row->other_config,
+                                 SYSTEM_OTHER_CONFIG_MAP_UDPFWD_RCVBUF_MIN),
+                             smap_get(&system_row->other_config,
+                                 SYSTEM_OTHER_CONFIG_MAP_UDPFWD_RCVBUF_MAX));
+
+        /* Check if there is a change in receive queue depths */
+        update_queue_depth(UDPFWD_CLASS_DHCP,
+                           smap_get(&system_row->other_config,
+                                    SYSTEM_OTHER_CONFIG_MAP_UDPFWD_QUEUE_DHCP));
+        update_queue_depth(UDPFWD_CLASS_FWD,
+                           smap_get(&system_row->other_config,
+                                    SYSTEM_OTHER_CONFIG_MAP_UDPFWD_QUEUE_FWD));
     }
 
     return;
@@ -466,40 +585,23 @@ void udpfwd_process_globalconfig_update(void)
  */
 void dhcp_relay_server_config_update(void)
 {
-    const struct ovsrec_dhcp_relay *rec_first = NULL;
     const struct ovsrec_dhcp_relay *rec = NULL;
-
-    /* Check for server configuration changes */
-    rec_first = ovsrec_dhcp_relay_first(idl);
-    if (NULL == rec_first) {
-        /* Check if last entry from the table is deleted */
-        udpfwd_handle_dhcp_relay_row_delete(idl);
-        return;
-    }
-
-    if (!OVSREC_IDL_ANY_TABLE_ROWS_INSERTED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_MODIFIED(rec_first, idl_seqno)) {
-        /* FIXME: Log to be removed after initial round of testing */
-        VLOG_DBG("No table changes updates");
-        return;
-    }
-
-    /* Process row delete notification */
-    if (OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)) {
-        udpfwd_handle_dhcp_relay_row_delete(idl);
-    }
-
-    /* Process row insert/modify notifications */
-    OVSREC_DHCP_RELAY_FOR_EACH (rec, idl) {
-        if (OVSREC_IDL_IS_ROW_INSERTED(rec, idl_seqno)
-            || OVSREC_IDL_IS_ROW_MODIFIED(rec, idl_seqno)) {
+    uint32_t n_rows = 0;
+
+    /* Only the records changed since the last run are tracked */
+    OVSREC_DHCP_RELAY_FOR_EACH_TRACKED (rec, idl) {
+        n_rows++;
+        if (ovsrec_dhcp_relay_is_deleted(rec)) {
+            udpfwd_handle_dhcp_relay_row_delete(&rec->header_.uuid);
+        } else {
             udpfwd_handle_dhcp_relay_config_change(rec, idl_seqno);
         }
     }
 
-    /* FIXME: Handle the case of NULL port column value. Currently
-     * "no interface" command doesn't seem to be working */
+    if (n_rows) {
+        COVERAGE_ADD(udpfwd_dhcp_relay_rows, n_rows);
+        VLOG_DBG("Processed %u DHCP-Relay records", n_rows);
+    }
 
     return;
 }
@@ -516,48 +618,39 @@ void dhcp_relay_server_config_update(void)
 void udp_bcast_forwarder_server_config_update(void)
 {
     const struct ovsrec_udp_bcast_forwarder_server *rec = NULL;
-    const struct ovsrec_udp_bcast_forwarder_server *rec_first = NULL;
-
-    /* Check for server configuration changes */
-    rec_first = ovsrec_udp_bcast_forwarder_server_first(idl);
-    if (NULL == rec_first) {
-        /* Check if last entry from the table is deleted */
-        udpfwd_handle_udp_bcast_forwarder_row_delete(idl);
-        return;
-    }
-
-    if (!OVSREC_IDL_ANY_TABLE_ROWS_INSERTED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)
-        && !OVSREC_IDL_ANY_TABLE_ROWS_MODIFIED(rec_first, idl_seqno)) {
-        /* FIXME: Log to be removed after initial round of testing */
-        VLOG_DBG("No table changes updates");
-        return;
-    }
-
-    /* Process row delete notification */
-    if (OVSREC_IDL_ANY_TABLE_ROWS_DELETED(rec_first, idl_seqno)) {
-        udpfwd_handle_udp_bcast_forwarder_row_delete(idl);
-    }
-
-    /* Process row insert/modify notifications */
-    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH (rec, idl) {
-        if (OVSREC_IDL_IS_ROW_INSERTED(rec, idl_seqno)
-            || OVSREC_IDL_IS_ROW_MODIFIED(rec, idl_seqno)) {
+    uint32_t n_rows = 0;
+
+    /* Only the records changed since the last run are tracked */
+    OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH_TRACKED (rec, idl) {
+        n_rows++;
+        if (ovsrec_udp_bcast_forwarder_server_is_deleted(rec)) {
+            udpfwd_handle_udp_bcast_forwarder_row_delete(&rec->header_.uuid);
+        } else {
             udpfwd_handle_udp_bcast_forwarder_config_change(rec);
         }
     }
 
-    /* FIXME: Handle the case of NULL port column value. Currently
-     * "no interface" command doesn't seem to be working */
+    if (n_rows) {
+        COVERAGE_ADD(udpfwd_bcast_fwd_rows, n_rows);
+        VLOG_DBG("Processed %u UDP-Bcast-Forwarder records", n_rows);
+    }
 
     return;
 }
 #endif /* FTR_UDP_BCAST_FWD */
 
 #ifdef FTR_DHCP_RELAY
+/* Time of the next statistics refresh */
+static long long int stats_timer = LLONG_MIN;
+static int stats_timer_interval;
+
+/* stats_seq value the main loop last looked at */
+static uint64_t stats_seqno;
+
 /*
  * Function      : run_stats_update
  * Responsiblity : To update interface dhcp-relay statistics if necessary.
+ *                 Nothing is written while the counters are unchanged.
  * Parameters    : none
  * Return        : none
  */
@@ -565,8 +658,11 @@ static void
 run_stats_update(void)
 {
     int stats_interval;
-    static int stats_timer_interval;
-    static long long int stats_timer = LLONG_MIN;
+    bool dirty;
+
+    /* Read before the flag, a change racing with the check wakes up the
+     * next poll_block */
+    stats_seqno = seq_read(udpfwd_ctrl_cb_p->stats_seq);
 
     /* Statistics update interval should always be greater than or equal to
      * 5000 ms. */
@@ -577,33 +673,87 @@ run_stats_update(void)
         stats_timer = LLONG_MIN;
     }
 
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->stats_dirty, &dirty);
+    if (!dirty) {
+        return;
+    }
+
     /* Rate limit the update. */
     if (time_msec() >= stats_timer) {
-
+        atomic_store_relaxed(&udpfwd_ctrl_cb_p->stats_dirty, false);
         refresh_dhcp_relay_stats();
         stats_timer = time_msec() + stats_timer_interval;
     }
 }
+
+/*
+ * Function      : wait_stats_update
+ * Responsiblity : Arrange for the main loop to wake up when a statistics
+ *                 refresh is due.
+ * Parameters    : none
+ * Return        : none
+ */
+static void
+wait_stats_update(void)
+{
+    bool dirty;
+
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->stats_dirty, &dirty);
+    if (dirty) {
+        poll_timer_wait_until(stats_timer);
+    } else {
+        seq_wait(udpfwd_ctrl_cb_p->stats_seq, stats_seqno);
+    }
+}
 #endif /* FTR_DHCP_RELAY */
 
 /*
- * Function      : udpfwd_reconfigure
- * Responsiblity : Process the table update notifications from OVSDB for the
+ * Function      : udpfwd_run
+ * Responsiblity : Periodic processing from the main loop, independent of
  *                 configuration changes.
  * Parameters    : none
  * Return        : none
  */
-void udpfwd_reconfigure(void)
+void udpfwd_run(void)
 {
+    udpfwd_vrf_run();
 
 #ifdef FTR_DHCP_RELAY
-    /* Update statistics */
     run_stats_update();
 #endif /* FTR_DHCP_RELAY */
+}
+
+/*
+ * Function      : udpfwd_wait
+ * Responsiblity : Register the events udpfwd_run needs to be called for.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_wait(void)
+{
+    udpfwd_vrf_wait();
+
+#ifdef FTR_DHCP_RELAY
+    wait_stats_update();
+#endif /* FTR_DHCP_RELAY */
+}
+
+/*
+ * Function      : udpfwd_reconfigure
+ * Responsiblity : Process the table update notifications from OVSDB for the
+ *                 configuration changes.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_reconfigure(void)
+{
 
     /* Check for global configuration changes in system table */
     udpfwd_process_globalconfig_update();
 
+    /* Start or stop the receive contexts of added or removed VRFs */
+    udpfwd_vrf_reconfigure();
+
 #ifdef FTR_DHCP_RELAY
     /* Process dhcp_relay table updates */
     dhcp_relay_server_config_update();
@@ -617,6 +767,50 @@ void udpfwd_reconfigure(void)
     return;
 }
 
+/*
+ * Function      : udpfwd_server_ref_count
+ * Responsiblity : Get the number of interfaces using a server.
+ * Parameters    : server - server of an interface
+ * Return        : reference count
+ */
+static uint32_t udpfwd_server_ref_count(const UDPFWD_SERVER_REF_T *server)
+{
+    const UDPFWD_SERVER_T *entry;
+
+    entry = udpfwd_get_server_entry(server->ip_address, server->udp_port);
+    return entry ? entry->ref_count : 0;
+}
+
+/*
+ * Function      : udpfwd_server_matches
+ * Responsiblity : Check whether a server entry passes the port and feature
+ *                 filters of a dump request.
+ * Parameters    : server - server entry
+ *                 params - dump filters
+ * Return        : true - if the server is to be dumped
+ *                 false - otherwise
+ */
+static bool udpfwd_server_matches(const UDPFWD_SERVER_REF_T *server,
+                                  const struct dump_params *params)
+{
+    if (params->port && (params->port != server->udp_port))
+        return false;
+
+#ifdef FTR_DHCP_RELAY
+    if ((DHCP_RELAY == params->feature)
+        && (DHCPS_PORT != server->udp_port))
+        return false;
+#endif /* FTR_DHCP_RELAY */
+
+#ifdef FTR_UDP_BCAST_FWD
+    if ((UDP_BCAST_FORWARDER == params->feature)
+        && (DHCPS_PORT == server->udp_port))
+        return false;
+#endif /* FTR_UDP_BCAST_FWD */
+
+    return true;
+}
+
 /*
  * Function      : udpfwd_interface_dump
  * Responsiblity : Function dumps information about server IP address,
@@ -628,69 +822,259 @@ void udpfwd_reconfigure(void)
  * Return        : none
  */
 static void udpfwd_interface_dump(struct shash_node *node,
-                                  struct ds *ds, uint16_t udp_port)
+                                  struct ds *ds, struct dump_params *params)
 {
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T **serverArray = NULL;
+    const UDPFWD_SERVER_REF_T *server = NULL;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
     int32_t iter = 0;
     bool found = false;
     struct in_addr ip_addr;
 
     intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
-    serverArray = intfNode->serverArray;
 
     /* Print all configured server IP addresses along with port number */
     ds_put_format(ds, "Interface %s: %d\n", intfNode->portName,
                       intfNode->addrCount);
 
 #ifdef FTR_DHCP_RELAY
-    /* Print dhcp-relay statistics */
-    ds_put_format(ds, "client request dropped packets = %d\n",
-                  UDPF_DHCPR_CLIENT_DROPS(intfNode));
-    ds_put_format(ds, "client request valid packets = %d\n",
-                  UDPF_DHCPR_CLIENT_SENT(intfNode));
-    ds_put_format(ds, "server request dropped packets = %d\n",
-                  UDPF_DHCPR_SERVER_DROPS(intfNode));
-    ds_put_format(ds, "server request valid packets = %d\n",
-                  UDPF_DHCPR_SERVER_SENT(intfNode));
-
-    ds_put_format(ds, "client request dropped packets with option 82 = %d\n",
-                  UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "client request valid packets with option 82 = %d\n",
-                  UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "server request dropped packets with option 82 = %d\n",
-                  UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode));
-    ds_put_format(ds, "server request valid packets with option 82 = %d\n",
-                  UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode));
-
-    /* Print bootp gateway */
-    ip_addr.s_addr = intfNode->bootp_gw;
-    ds_put_format(ds, "%s\n", inet_ntoa(ip_addr));
+    if ((INVALID_FEATURE == params->feature)
+        || (DHCP_RELAY == params->feature)) {
+        /* Print dhcp-relay statistics */
+        ds_put_format(ds, "client request dropped packets = %d\n",
+                      UDPF_DHCPR_CLIENT_DROPS(intfNode));
+        ds_put_format(ds, "client request valid packets = %d\n",
+                      UDPF_DHCPR_CLIENT_SENT(intfNode));
+        ds_put_format(ds, "server request dropped packets = %d\n",
+                      UDPF_DHCPR_SERVER_DROPS(intfNode));
+        ds_put_format(ds, "server request valid packets = %d\n",
+                      UDPF_DHCPR_SERVER_SENT(intfNode));
+
+        ds_put_format(ds, "client request dropped packets with option 82 = %d\n",
+                      UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode));
+        ds_put_format(ds, "client request valid packets with option 82 = %d\n",
+                      UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode));
+        ds_put_format(ds, "server request dropped packets with option 82 = %d\n",
+                      UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode));
+        ds_put_format(ds, "server request valid packets with option 82 = %d\n",
+                      UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode));
+
+        /* Print bootp gateway */
+        ip_addr.s_addr = intfNode->bootp_gw;
+        ds_put_format(ds, "%s\n", inet_ntoa(ip_addr));
+    }
 #endif /* FTR_DHCP_RELAY */
 
     for(iter = 0; iter < intfNode->addrCount; iter++)
     {
-        server = serverArray[iter];
-        if(udp_port && (udp_port != server->udp_port))
+        server = &intfNode->servers[iter];
+        if (!udpfwd_server_matches(server, params))
             continue;
         found = true;
         ds_put_format(ds, "Port %d - ", server->udp_port);
         ip_addr.s_addr = server->ip_address;
-        ds_put_format(ds, "%s,%d\n", inet_ntoa(ip_addr), server->ref_count);
+        ds_put_format(ds, "%s,%d\n", inet_ntoa(ip_addr),
+                      udpfwd_server_ref_count(server));
     }
 
-    if(!found && udp_port)
+    if(!found && params->port)
         ds_put_format(ds, "No IP address associated with this port: %d\n",
-                      udp_port);
+                      params->port);
 
     return;
 }
 
+/*
+ * Function      : udpfwd_interface_to_json
+ * Responsiblity : Build the JSON representation of an interface entry.
+ * Parameters    : intfNode - interface entry
+ *                 params - dump filters
+ * Return        : json object, owned by the caller
+ */
+static struct json *udpfwd_interface_to_json(
+                      const UDPFWD_INTERFACE_NODE_T *intfNode,
+                      const struct dump_params *params)
+{
+    struct json *intf, *servers, *server_json;
+    const UDPFWD_SERVER_REF_T *server;
+    struct in_addr ip_addr;
+    int32_t iter;
+#ifdef FTR_DHCP_RELAY
+    struct json *counters;
+#endif /* FTR_DHCP_RELAY */
+
+    intf = json_object_create();
+    json_object_put(intf, "generation",
+                    json_integer_create(intfNode->generation));
+    json_object_put(intf, "counters_generation",
+                    json_integer_create(intfNode->countersGeneration));
+    json_object_put(intf, "server_count",
+                    json_integer_create(intfNode->addrCount));
+
+#ifdef FTR_DHCP_RELAY
+    if ((INVALID_FEATURE == params->feature)
+        || (DHCP_RELAY == params->feature)) {
+        ip_addr.s_addr = intfNode->bootp_gw;
+        json_object_put_string(intf, "bootp_gateway", inet_ntoa(ip_addr));
+
+        counters = json_object_create();
+        json_object_put(counters, "client_drops",
+            json_integer_create(UDPF_DHCPR_CLIENT_DROPS(intfNode)));
+        json_object_put(counters, "client_valids",
+            json_integer_create(UDPF_DHCPR_CLIENT_SENT(intfNode)));
+        json_object_put(counters, "server_drops",
+            json_integer_create(UDPF_DHCPR_SERVER_DROPS(intfNode)));
+        json_object_put(counters, "server_valids",
+            json_integer_create(UDPF_DHCPR_SERVER_SENT(intfNode)));
+        json_object_put(counters, "client_drops_with_option82",
+            json_integer_create(
+                UDPF_DHCPR_CLIENT_DROPS_WITH_OPTION82(intfNode)));
+        json_object_put(counters, "client_valids_with_option82",
+            json_integer_create(
+                UDPF_DHCPR_CLIENT_SENT_WITH_OPTION82(intfNode)));
+        json_object_put(counters, "server_drops_with_option82",
+            json_integer_create(
+                UDPF_DHCPR_SERVER_DROPS_WITH_OPTION82(intfNode)));
+        json_object_put(counters, "server_valids_with_option82",
+            json_integer_create(
+                UDPF_DHCPR_SERVER_SENT_WITH_OPTION82(intfNode)));
+        json_object_put(intf, "dhcp_relay_statistics", counters);
+    }
+#endif /* FTR_DHCP_RELAY */
+
+    servers = json_array_create_empty();
+    for (iter = 0; iter < intfNode->addrCount; iter++) {
+        server = &intfNode->servers[iter];
+        if (!udpfwd_server_matches(server, params))
+            continue;
+
+        server_json = json_object_create();
+        ip_addr.s_addr = server->ip_address;
+        json_object_put_string(server_json, "ip", inet_ntoa(ip_addr));
+        json_object_put(server_json, "port",
+                        json_integer_create(server->udp_port));
+        json_object_put(server_json, "ref_count",
+                        json_integer_create(udpfwd_server_ref_count(server)));
+        json_array_add(servers, server_json);
+    }
+    json_object_put(intf, "servers", servers);
+
+    return intf;
+}
+
+/*
+ * Function      : udpfwd_features_to_json
+ * Responsiblity : Build the JSON representation of the global feature state.
+ * Parameters    : params - dump filters
+ * Return        : json object, owned by the caller
+ */
+static struct json *udpfwd_features_to_json(const struct dump_params *params)
+{
+    struct json *features = json_object_create();
+#if defined(FTR_DHCP_RELAY) || defined(FTR_UDP_BCAST_FWD)
+    feature_bmap config = udpfwd_ctrl_cb_p->feature_config.config;
+#endif /* (FTR_DHCP_RELAY | FTR_UDP_BCAST_FWD) */
+
+#ifdef FTR_UDP_BCAST_FWD
+    if ((INVALID_FEATURE == params->feature)
+        || (UDP_BCAST_FORWARDER == params->feature)) {
+        json_object_put(features, "udp_bcast_forwarder", json_boolean_create(
+                        get_feature_status(config, UDP_BCAST_FORWARDER)));
+    }
+#endif /* FTR_UDP_BCAST_FWD */
+
+#ifdef FTR_DHCP_RELAY
+    if ((INVALID_FEATURE == params->feature)
+        || (DHCP_RELAY == params->feature)) {
+        json_object_put(features, "dhcp_relay", json_boolean_create(
+                        get_feature_status(config, DHCP_RELAY)));
+        json_object_put(features, "dhcp_relay_hop_count_increment",
+                        json_boolean_create(get_feature_status(config,
+                                    DHCP_RELAY_HOP_COUNT_INCREMENT)));
+        json_object_put(features, "dhcp_relay_option82", json_boolean_create(
+                        get_feature_status(config, DHCP_RELAY_OPTION82)));
+        json_object_put(features, "dhcp_relay_option82_validate",
+                        json_boolean_create(get_feature_status(config,
+                                    DHCP_RELAY_OPTION82_VALIDATE)));
+        json_object_put_string(features, "dhcp_relay_option82_policy",
+                      policy_name[udpfwd_ctrl_cb_p->feature_config.policy]);
+        json_object_put_string(features, "dhcp_relay_option82_remote_id",
+                      remote_id_name[udpfwd_ctrl_cb_p->feature_config.r_id]);
+    }
+#endif /* FTR_DHCP_RELAY */
+
+    return features;
+}
+
+/*
+ * Function      : udpfwd_dump_since
+ * Responsiblity : Get the generation the dump is a delta from. A delta
+ *                 can not carry removed interfaces, so after a removal
+ *                 the full table is dumped.
+ * Parameters    : params - dump filters
+ * Return        : generation, 0 for a full dump
+ */
+static uint64_t udpfwd_dump_since(const struct dump_params *params)
+{
+    uint64_t since = params->changed_since;
+
+    if (since && (since < udpfwd_ctrl_cb_p->removed_generation)) {
+        since = 0;
+    }
+    return since;
+}
+
+/*
+ * Function      : udpfwd_interfaces_dump_json
+ * Responsiblity : Function dumps feature state and interface information
+ *                 as a JSON object into dynamic string ds. When a
+ *                 changed-since generation is given, only the interfaces
+ *                 whose configuration or counters changed after it are
+ *                 included, unless an interface was removed since then,
+ *                 in which case the full table is dumped and "full" is
+ *                 set to true.
+ * Parameters    : ds - output buffer
+ *                 params - dump filters
+ * Return        : none
+ */
+static void udpfwd_interfaces_dump_json(struct ds *ds,
+                                        struct dump_params *params)
+{
+    struct json *top, *interfaces;
+    struct shash_node *node;
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    uint64_t generation;
+    uint64_t since = udpfwd_dump_since(params);
+
+    atomic_read(&udpfwd_ctrl_cb_p->generation, &generation);
+
+    top = json_object_create();
+    json_object_put(top, "generation", json_integer_create(generation));
+    json_object_put(top, "full", json_boolean_create(!since));
+    json_object_put(top, "features", udpfwd_features_to_json(params));
+
+    interfaces = json_object_create();
+    SHASH_FOR_EACH(node, &udpfwd_ctrl_cb_p->intfHashTable) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
+        if (params->ifName && strcmp(params->ifName, intfNode->portName))
+            continue;
+        if (!udpfwd_intf_changed_since(intfNode, since))
+            continue;
+        json_object_put(interfaces, intfNode->portName,
+                        udpfwd_interface_to_json(intfNode, params));
+    }
+    json_object_put(top, "interfaces", interfaces);
+
+    json_to_ds(top, JSSF_SORT, ds);
+    json_destroy(top);
+}
+
 /*
  * Function      : udpfwd_interfaces_dump
  * Responsiblity : Function dumps information about interfaces
- *                 into dynamic string ds.
+ *                 into dynamic string ds. A changed-since generation
+ *                 filters the interfaces as in the JSON dump, and the
+ *                 generation of the dump and whether it is full are
+ *                 reported first.
  * Parameters    : ds - output buffer
  *                 params - structure which has interface name
  *                 and udp destination port number
@@ -699,33 +1083,52 @@ static void udpfwd_interface_dump(struct shash_node *node,
 static void udpfwd_interfaces_dump(struct ds *ds, struct dump_params *params)
 {
     struct shash_node *node, *temp;
+    UDPFWD_INTERFACE_NODE_T *intfNode;
+    uint64_t generation;
+    uint64_t since = udpfwd_dump_since(params);
 #if defined(FTR_DHCP_RELAY) || defined(FTR_UDP_BCAST_FWD)
     feature_bmap config = udpfwd_ctrl_cb_p->feature_config.config;
 #endif /* (FTR_DHCP_RELAY | FTR_UDP_BCAST_FWD) */
 
+    if (params->changed_since) {
+        atomic_read(&udpfwd_ctrl_cb_p->generation, &generation);
+        ds_put_format(ds, "Generation : %"PRIu64"\n", generation);
+        ds_put_format(ds, "Full dump : %d\n", !since);
+    }
+
 #ifdef FTR_UDP_BCAST_FWD
-    ds_put_format(ds, "UDP Bcast Forwarder : %d\n",
-                      get_feature_status(config, UDP_BCAST_FORWARDER));
+    if ((INVALID_FEATURE == params->feature)
+        || (UDP_BCAST_FORWARDER == params->feature)) {
+        ds_put_format(ds, "UDP Bcast Forwarder : %d\n",
+                          get_feature_status(config, UDP_BCAST_FORWARDER));
+    }
 #endif /* FTR_UDP_BCAST_FWD */
 
 #ifdef FTR_DHCP_RELAY
-    ds_put_format(ds, "DHCP Relay : %d\n", get_feature_status(config, DHCP_RELAY));
-    ds_put_format(ds, "DHCP Relay hop-count-increment : %d\n",
+    if ((INVALID_FEATURE == params->feature)
+        || (DHCP_RELAY == params->feature)) {
+        ds_put_format(ds, "DHCP Relay : %d\n",
+                          get_feature_status(config, DHCP_RELAY));
+        ds_put_format(ds, "DHCP Relay hop-count-increment : %d\n",
                       get_feature_status(config, DHCP_RELAY_HOP_COUNT_INCREMENT));
-    ds_put_format(ds, "DHCP Relay Option82 : %d\n",
-                      get_feature_status(config, DHCP_RELAY_OPTION82));
-    ds_put_format(ds, "DHCP Relay Option82 validate : %d\n",
+        ds_put_format(ds, "DHCP Relay Option82 : %d\n",
+                          get_feature_status(config, DHCP_RELAY_OPTION82));
+        ds_put_format(ds, "DHCP Relay Option82 validate : %d\n",
                       get_feature_status(config, DHCP_RELAY_OPTION82_VALIDATE));
-    ds_put_format(ds, "DHCP Relay Option82 policy : %s\n",
-                      policy_name[udpfwd_ctrl_cb_p->feature_config.policy]);
-    ds_put_format(ds, "DHCP Relay Option82 remote-id : %s\n",
-                      remote_id_name[udpfwd_ctrl_cb_p->feature_config.r_id]);
+        ds_put_format(ds, "DHCP Relay Option82 policy : %s\n",
+                          policy_name[udpfwd_ctrl_cb_p->feature_config.policy]);
+        ds_put_format(ds, "DHCP Relay Option82 remote-id : %s\n",
+                          remote_id_name[udpfwd_ctrl_cb_p->feature_config.r_id]);
+    }
 #endif /* FTR_DHCP_RELAY */
 
     if (!params->ifName) {
         /* dump all interfaces */
-        SHASH_FOR_EACH(temp, &udpfwd_ctrl_cb_p->intfHashTable)
-            udpfwd_interface_dump(temp, ds, params->port);
+        SHASH_FOR_EACH(temp, &udpfwd_ctrl_cb_p->intfHashTable) {
+            intfNode = (UDPFWD_INTERFACE_NODE_T *)temp->data;
+            if (udpfwd_intf_changed_since(intfNode, since))
+                udpfwd_interface_dump(temp, ds, params);
+        }
     }
     else {
         node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, params->ifName);
@@ -734,10 +1137,82 @@ static void udpfwd_interfaces_dump(struct ds *ds, struct dump_params *params)
             " this interface :%s\n", params->ifName);
             return;
         }
-        udpfwd_interface_dump(node, ds, params->port);
+        if (udpfwd_intf_changed_since(node->data, since))
+            udpfwd_interface_dump(node, ds, params);
     }
 }
 
+/*
+ * Function      : udpfwd_parse_dump_args
+ * Responsiblity : Parse udpfwd/dump arguments into dump parameters.
+ *                 Arguments are keyword based and may appear in any order:
+ *                 [--json] [interface NAME] [port N] [feature NAME]
+ *                 [--changed-since=GENERATION]
+ * Parameters    : argc, argv - unixctl arguments
+ *                 params - parsed parameters
+ *                 err - error description on failure
+ * Return        : true - on success
+ *                 false - on invalid arguments
+ */
+static bool udpfwd_parse_dump_args(int argc, const char *argv[],
+                                   struct dump_params *params,
+                                   struct ds *err)
+{
+    unsigned long long int value;
+    int iter;
+
+    memset(params, 0, sizeof(struct dump_params));
+    params->feature = INVALID_FEATURE;
+
+    for (iter = 1; iter < argc; iter++) {
+        if (!strcmp(argv[iter], "--json")) {
+            params->json = true;
+        } else if (!strncmp(argv[iter], "--changed-since=",
+                            strlen("--changed-since="))) {
+            if (!str_to_ullong(argv[iter] + strlen("--changed-since="),
+                               10, &value)) {
+                ds_put_format(err, "invalid generation: %s", argv[iter]);
+                return false;
+            }
+            params->changed_since = value;
+        } else if (iter + 1 >= argc) {
+            ds_put_format(err, "missing value for %s", argv[iter]);
+            return false;
+        } else if (!strcmp(argv[iter], "interface")
+                   || !strcmp(argv[iter], "int")) {
+            params->ifName = (char *)argv[++iter];
+        } else if (!strcmp(argv[iter], "port")) {
+            if (!str_to_ullong(argv[++iter], 10, &value)
+                || (0 == value) || (value > UINT16_MAX)) {
+                ds_put_format(err, "invalid port: %s", argv[iter]);
+                return false;
+            }
+            params->port = value;
+        } else if (!strcmp(argv[iter], "feature")) {
+            iter++;
+#ifdef FTR_DHCP_RELAY
+            if (!strcmp(argv[iter], "dhcp-relay")) {
+                params->feature = DHCP_RELAY;
+                continue;
+            }
+#endif /* FTR_DHCP_RELAY */
+#ifdef FTR_UDP_BCAST_FWD
+            if (!strcmp(argv[iter], "udp-bcast-forwarder")) {
+                params->feature = UDP_BCAST_FORWARDER;
+                continue;
+            }
+#endif /* FTR_UDP_BCAST_FWD */
+            ds_put_format(err, "unknown feature: %s", argv[iter]);
+            return false;
+        } else {
+            ds_put_format(err, "unknown argument: %s", argv[iter]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /*
  * Function      : udpfwd_unixctl_dump
  * Responsiblity : UDP fowarder module core dump callback
@@ -746,30 +1221,195 @@ static void udpfwd_interfaces_dump(struct ds *ds, struct dump_params *params)
  *                 aux - aux connection data
  * Return        : none
  */
-static void udpfwd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
-                   const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+static void udpfwd_unixctl_dump(struct unixctl_conn *conn, int argc,
+                   const char *argv[], void *aux OVS_UNUSED)
 {
     struct ds ds = DS_EMPTY_INITIALIZER;
     struct dump_params params;
-    memset(&params, 0, sizeof(struct dump_params));
+
     /*
-     * Parse unxictl arguments.
-     * second argument is always interface name.
-     * fourth argument is udp destination port number.
-     * ex : ovs-appctl -t ops-udpfwd udpfwd/dump int 1 port 67.
+     * ex : ovs-appctl -t ops-relay udpfwd/dump interface 1 port 67
+     *      ovs-appctl -t ops-relay udpfwd/dump --json --changed-since=42
      */
-    if (argc > 3) {
-        params.ifName = (char*)argv[2];
-        params.port = atoi(argv[4]);
+    if (!udpfwd_parse_dump_args(argc, argv, &params, &ds)) {
+        ds_put_format(&ds, "\nusage: udpfwd/dump %s", UDPFWD_DUMP_USAGE);
+        unixctl_command_reply_error(conn, ds_cstr(&ds));
+        ds_destroy(&ds);
+        return;
     }
-    else if (argc > 1)
-        params.ifName = (char*)argv[2];
 
-    udpfwd_interfaces_dump(&ds, &params);
+    /* Keep the packet thread from updating counters while dumping */
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_stamp_counters();
+    if (params.json)
+        udpfwd_interfaces_dump_json(&ds, &params);
+    else
+        udpfwd_interfaces_dump(&ds, &params);
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+
     unixctl_command_reply(conn, ds_cstr(&ds));
     ds_destroy(&ds);
 }
 
+/*
+ * Function      : udpfwd_unixctl_queues
+ * Responsiblity : Dump the counters of the receive scheduler classes
+ * Parameters    : conn - unixctl socket connection
+ *                 argc, argv - function parameters
+ *                 aux - aux connection data
+ * Return        : none
+ */
+static void udpfwd_unixctl_queues(struct unixctl_conn *conn,
+                   int argc OVS_UNUSED, const char *argv[] OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    static const char *class_name[UDPFWD_CLASS_MAX] = {
+        [UDPFWD_CLASS_DHCP] = "dhcp",
+        [UDPFWD_CLASS_FWD]  = "udp-forward",
+    };
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    uint64_t queued, dropped;
+    unsigned int depth;
+    int class;
+
+    for (class = 0; class < UDPFWD_CLASS_MAX; class++) {
+        atomic_read_relaxed(&udpfwd_ctrl_cb_p->classDepth[class], &depth);
+        atomic_read_relaxed(&udpfwd_ctrl_cb_p->classStats[class].queued,
+                            &queued);
+        atomic_read_relaxed(&udpfwd_ctrl_cb_p->classStats[class].dropped,
+                            &dropped);
+        ds_put_format(&ds, "%s : priority %d, depth %u, queued %"PRIu64
+                      ", dropped %"PRIu64"\n", class_name[class], class,
+                      depth, queued, dropped);
+    }
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+/*
+ * Function      : udpfwd_snapshot_save
+ * Responsiblity : Append the global state and the interface table to a
+ *                 warm restart snapshot.
+ * Parameters    : snap - snapshot being built
+ * Return        : none
+ */
+void udpfwd_snapshot_save(struct relay_snapshot *snap)
+{
+    UDPFWD_SNAPSHOT_GLOBAL global;
+    UDPFWD_SNAPSHOT_INTF rec;
+    UDPFWD_SNAPSHOT_SERVER server;
+    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
+    struct shash_node *node;
+    int32_t iter;
+
+    memset(&global, 0, sizeof(global));
+    atomic_read(&udpfwd_ctrl_cb_p->generation, &global.generation);
+    global.config = udpfwd_ctrl_cb_p->feature_config.config;
+#ifdef FTR_DHCP_RELAY
+    global.policy = udpfwd_ctrl_cb_p->feature_config.policy;
+    global.r_id = udpfwd_ctrl_cb_p->feature_config.r_id;
+#endif /* FTR_DHCP_RELAY */
+    global.stats_interval = udpfwd_ctrl_cb_p->stats_interval;
+
+    relay_snapshot_section_start(snap, RELAY_SNAPSHOT_UDPFWD_GLOBAL);
+    relay_snapshot_put(snap, &global, sizeof(global));
+    relay_snapshot_section_end(snap);
+
+    /* Counters are updated by the packet receive thread */
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+    SHASH_FOR_EACH(node, &udpfwd_ctrl_cb_p->intfHashTable) {
+        intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
+        if (strlen(intfNode->portName) >= sizeof(rec.portName)) {
+            VLOG_WARN("Interface name %s too long, not saved",
+                      intfNode->portName);
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        ovs_strzcpy(rec.portName, intfNode->portName, sizeof(rec.portName));
+        rec.bootp_gw = intfNode->bootp_gw;
+        rec.n_servers = intfNode->addrCount;
+#ifdef FTR_DHCP_RELAY
+        rec.dhcp_relay_pkt_counters = intfNode->dhcp_relay_pkt_counters;
+#endif /* FTR_DHCP_RELAY */
+
+        relay_snapshot_section_start(snap, RELAY_SNAPSHOT_UDPFWD_INTF);
+        relay_snapshot_put(snap, &rec, sizeof(rec));
+        for (iter = 0; iter < intfNode->addrCount; iter++) {
+            memset(&server, 0, sizeof(server));
+            server.ip_address = intfNode->servers[iter].ip_address;
+            server.udp_port = intfNode->servers[iter].udp_port;
+            relay_snapshot_put(snap, &server, sizeof(server));
+        }
+        relay_snapshot_section_end(snap);
+    }
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+}
+
+/*
+ * Function      : udpfwd_snapshot_restore
+ * Responsiblity : Restore one section of a warm restart snapshot. The
+ *                 restored state is reconciled against OVSDB on the first
+ *                 reconfigure.
+ * Parameters    : type - section type
+ *                 payload - section payload
+ *                 length - payload length
+ * Return        : none
+ */
+void udpfwd_snapshot_restore(uint16_t type, const void *payload,
+                             uint32_t length)
+{
+    const UDPFWD_SNAPSHOT_GLOBAL *global = NULL;
+    const UDPFWD_SNAPSHOT_INTF *rec = NULL;
+    uint64_t generation;
+
+    switch (type) {
+    case RELAY_SNAPSHOT_UDPFWD_GLOBAL:
+        if (length < sizeof(*global)) {
+            VLOG_WARN("Ignoring truncated global snapshot section");
+            break;
+        }
+        global = payload;
+
+        /* Keep generations monotonic for the dump clients */
+        atomic_read(&udpfwd_ctrl_cb_p->generation, &generation);
+        if (global->generation > generation) {
+            atomic_store(&udpfwd_ctrl_cb_p->generation, global->generation);
+            atomic_store(&udpfwd_ctrl_cb_p->config_generation,
+                         global->generation);
+        }
+
+        udpfwd_ctrl_cb_p->feature_config.config = global->config;
+#ifdef FTR_DHCP_RELAY
+        if (global->policy < INVALID) {
+            udpfwd_ctrl_cb_p->feature_config.policy = global->policy;
+        }
+        if (global->r_id < REMOTE_ID_INVALID) {
+            udpfwd_ctrl_cb_p->feature_config.r_id = global->r_id;
+        }
+#endif /* FTR_DHCP_RELAY */
+        if (global->stats_interval > 0) {
+            udpfwd_ctrl_cb_p->stats_interval = global->stats_interval;
+        }
+        break;
+
+    case RELAY_SNAPSHOT_UDPFWD_INTF:
+        rec = payload;
+        if ((length < sizeof(*rec))
+            || ((length - sizeof(*rec)) / sizeof(rec->servers[0])
+                < rec->n_servers)) {
+            VLOG_WARN("Ignoring truncated interface snapshot section");
+            break;
+        }
+        udpfwd_restore_interface(rec);
+        break;
+
+    default:
+        break;
+    }
+}
+
 /*
  * Function      : udpfwd_exit
  * Responsiblity : Daemon cleanup before exit
@@ -778,12 +1418,8 @@ static void udpfwd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
  */
 void udpfwd_exit(void)
 {
-    /* free memory for packet receive buffer */
-    if (0 < udpfwd_ctrl_cb_p->udpSockFd)
-        close(udpfwd_ctrl_cb_p->udpSockFd);
-
-    if (NULL != udpfwd_ctrl_cb_p->rcvbuff)
-        free(udpfwd_ctrl_cb_p->rcvbuff);
+    /* Stop the receive threads and close their sockets */
+    udpfwd_vrf_exit();
 }
 
 /*
@@ -810,6 +1446,13 @@ bool udpfwd_init(void)
 
     ovsdb_idl_add_column(idl,
                            &ovsrec_dhcp_relay_col_other_config);
+
+    /* Track record changes, so that updates only visit changed records */
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_port);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_vrf);
+    ovsdb_idl_track_add_column(idl,
+                               &ovsrec_dhcp_relay_col_ipv4_ucast_server);
+    ovsdb_idl_track_add_column(idl, &ovsrec_dhcp_relay_col_other_config);
 #endif /* FTR_DHCP_RELAY */
 
     /* Register for UDP_Bcast_Forwarder table updates */
@@ -820,8 +1463,22 @@ bool udpfwd_init(void)
     ovsdb_idl_add_column(idl, &ovsrec_udp_bcast_forwarder_server_col_udp_dport);
     ovsdb_idl_add_column(idl,
                          &ovsrec_udp_bcast_forwarder_server_col_ipv4_ucast_server);
+
+    /* Track record changes, so that updates only visit changed records */
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_src_port);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_dest_vrf);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_udp_dport);
+    ovsdb_idl_track_add_column(idl,
+                         &ovsrec_udp_bcast_forwarder_server_col_ipv4_ucast_server);
 #endif /* FTR_UDP_BCAST_FWD */
 
+    /* Register for VRF table updates, each VRF gets a receive context */
+    ovsdb_idl_add_table(idl, &ovsrec_table_vrf);
+    ovsdb_idl_add_column(idl, &ovsrec_vrf_col_name);
+
     /* Register for port table for dhcp_relay_statistics update */
     ovsdb_idl_add_table(idl, &ovsrec_table_port);
     ovsdb_idl_add_column(idl, &ovsrec_port_col_name);
@@ -836,8 +1493,10 @@ bool udpfwd_init(void)
         return false;
     }
 
-    unixctl_command_register("udpfwd/dump", "", 0, 4,
+    unixctl_command_register("udpfwd/dump", UDPFWD_DUMP_USAGE, 0, 9,
                              udpfwd_unixctl_dump, NULL);
+    unixctl_command_register("udpfwd/queues", "", 0, 0,
+                             udpfwd_unixctl_queues, NULL);
 
     return true;
 }
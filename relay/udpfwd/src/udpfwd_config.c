@@ -26,7 +26,10 @@
 #include "udpfwd.h"
 #include "udpfwd_common.h"
 #include "hash.h"
+#include "hmap.h"
+#include "sset.h"
 #include "udpfwd_util.h"
+#include <inttypes.h>
 
 VLOG_DEFINE_THIS_MODULE(udpfwd_config);
 
@@ -68,13 +71,7 @@ UDPFWD_SERVER_T* udpfwd_add_server_entry(IP_ADDRESS ipaddress, uint16_t udpPort)
 
     /* FIXME: Add a check for global maximum server count */
 
-    serverIP = (UDPFWD_SERVER_T *) malloc (sizeof(UDPFWD_SERVER_T));
-    if (NULL == serverIP) {
-        VLOG_ERR("Failed to allocate memory for the server entry for "
-                 "ip: %x, port: %d", ipaddress, udpPort);
-        return NULL;
-    }
-
+    serverIP = relay_pool_alloc(&udpfwd_ctrl_cb_p->serverPool);
     serverIP->ip_address = ipaddress;
     serverIP->udp_port   = udpPort;
     serverIP->ref_count  = 1;      /*Reference count starts with 1*/
@@ -85,266 +82,409 @@ UDPFWD_SERVER_T* udpfwd_add_server_entry(IP_ADDRESS ipaddress, uint16_t udpPort)
     return serverIP;
 }
 
+/* Entry of a server set, used while diffing a configuration update */
+struct udpfwd_server_set_node {
+    struct hmap_node hmap_node; /* in struct udpfwd_server_set map */
+    IP_ADDRESS ip_address;      /* Server IP address */
+    uint16_t udp_port;          /* UDP Port Number */
+    bool present;               /* already configured on the interface */
+};
+
+/* Set of configured servers. Lookups are by address and port, additions
+ * are applied in configuration order. */
+struct udpfwd_server_set {
+    struct hmap map;                          /* address and port index */
+    struct udpfwd_server_set_node **order;    /* configuration order */
+    size_t n;
+    size_t allocated;
+};
+
+/* Scope of udpfwd_apply_server_delta() covering every UDP broadcast
+ * forwarder port, i.e. all servers except the DHCP relay ones */
+#define UDPFWD_SCOPE_BCAST_PORTS 0
+
 /*
- * Function      : udpfwd_push_deleted_server_ref_to_end
- * Responsiblity : Move the deleted entry from the server array to the end
- * Parameters    : intfNode - Interface entry
- *                 deleted_index - Index in the server array of the interface
+ * Function      : udpfwd_server_set_init
+ * Responsiblity : Initialize an empty server set
+ * Parameters    : set - server set
  * Return        : none
  */
-void udpfwd_push_deleted_server_ref_to_end(UDPFWD_INTERFACE_NODE_T *intfNode,
-                int deleted_index)
+static void udpfwd_server_set_init(struct udpfwd_server_set *set)
 {
+    hmap_init(&set->map);
+    set->order = NULL;
+    set->n = set->allocated = 0;
+}
 
-   uint8_t       currentAddrCount = 0;
-   UDPFWD_SERVER_T *server;
-   UDPFWD_SERVER_T **serverArray = intfNode->serverArray;
-
-   currentAddrCount = intfNode->addrCount;
+/*
+ * Function      : udpfwd_server_set_destroy
+ * Responsiblity : Free a server set
+ * Parameters    : set - server set
+ * Return        : none
+ */
+static void udpfwd_server_set_destroy(struct udpfwd_server_set *set)
+{
+    size_t iter;
 
-   /* Move the NULL at the end of the list */
-   server = serverArray[currentAddrCount];
-   serverArray[currentAddrCount] = serverArray[deleted_index] = NULL;
-   serverArray[deleted_index] = server;
+    for (iter = 0; iter < set->n; iter++) {
+        free(set->order[iter]);
+    }
+    free(set->order);
+    hmap_destroy(&set->map);
 }
 
 /*
- * Function      : udpfwd_remove_server_ref_entry
- * Responsiblity : Remove reference to a server entry from an interface entry
- * Parameters    : intfNode - Interface entry
+ * Function      : udpfwd_server_set_find
+ * Responsiblity : Lookup a server in a server set
+ * Parameters    : set - server set
  *                 ipaddress - server IP address
  *                 udpPort - destination udp port
- *                 deleted_index - Index in the server array
- * Return        : true - if the entry is successfully dereferenced
- *                 false - entry not found
+ * Return        : set entry, NULL if not found
  */
-bool udpfwd_remove_server_ref_entry(UDPFWD_INTERFACE_NODE_T *intfNode,
-                                     IP_ADDRESS ipaddress, uint16_t udpPort,
-                                     int *deleted_index)
+static struct udpfwd_server_set_node *
+udpfwd_server_set_find(const struct udpfwd_server_set *set,
+                       IP_ADDRESS ipaddress, uint16_t udpPort)
 {
-    uint8_t index = 0;
-    UDPFWD_SERVER_T **serverArray = NULL;
-    UDPFWD_SERVER_T *server;
+    struct udpfwd_server_set_node *setNode;
 
-    serverArray = intfNode->serverArray;
-    /* Find the entry in Server IP Table & free the memory (structFree) if
-     * ref_count is zero */
-    for ( ; index < intfNode->addrCount; index++)
-    {
-        if ((serverArray[index]->ip_address == ipaddress) &&
-            (serverArray[index]->udp_port == udpPort))
-        /* check if address & port exist in table */
-        {
-            VLOG_INFO("Address to be deleted found in interface : %s",
-                      intfNode->portName);
-            server = serverArray[index];
-            assert(server->ref_count);
-            /* Decrement server reference Count */
-            server->ref_count--;
-            /* If reference count becomes zero */
-            if(0 >= server->ref_count)
-            {
-                VLOG_INFO("server reference count reached 0. Freeing entry");
-                cmap_remove(&udpfwd_ctrl_cb_p->serverHashMap,
-                            (struct cmap_node *)server,
-                            hash_int(ipaddress, udpPort));
-                free(server);
-            }
+    HMAP_FOR_EACH_WITH_HASH (setNode, hmap_node,
+                             hash_int(ipaddress, udpPort), &set->map) {
+        if ((setNode->ip_address == ipaddress)
+            && (setNode->udp_port == udpPort)) {
+            return setNode;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function      : udpfwd_server_set_add
+ * Responsiblity : Add a server to a server set, duplicates are ignored.
+ * Parameters    : set - server set
+ *                 ipaddress - server IP address
+ *                 udpPort - destination udp port of the server
+ * Return        : none
+ */
+static void udpfwd_server_set_add(struct udpfwd_server_set *set,
+                                  IP_ADDRESS ipaddress, uint16_t udpPort)
+{
+    struct udpfwd_server_set_node *setNode;
+
+    if (NULL != udpfwd_server_set_find(set, ipaddress, udpPort)) {
+        return;
+    }
+
+    setNode = xmalloc(sizeof *setNode);
+    setNode->ip_address = ipaddress;
+    setNode->udp_port = udpPort;
+    setNode->present = false;
+    hmap_insert(&set->map, &setNode->hmap_node, hash_int(ipaddress, udpPort));
+
+    if (set->n >= set->allocated) {
+        set->order = x2nrealloc(set->order, &set->allocated,
+                                sizeof *set->order);
+    }
+    set->order[set->n++] = setNode;
+}
 
-            *deleted_index = index;
-            /*Make the IP ref Table entry NULL*/
-            serverArray[index] = NULL;
-            return true;
+/*
+ * Function      : udpfwd_server_set_parse
+ * Responsiblity : Add the servers of an OVSDB record to a server set.
+ *                 Each address string is parsed once, invalid ones are
+ *                 logged and skipped, duplicates are ignored.
+ * Parameters    : set - server set
+ *                 servers - server IP address strings
+ *                 n_servers - number of servers
+ *                 udpPort - destination udp port of the servers
+ * Return        : none
+ */
+static void udpfwd_server_set_parse(struct udpfwd_server_set *set,
+                                    char **servers, size_t n_servers,
+                                    uint16_t udpPort)
+{
+    struct in_addr id;
+    size_t iter;
+
+    for (iter = 0; iter < n_servers; iter++) {
+        if (!inet_aton(servers[iter], &id) || (id.s_addr == 0)) {
+            VLOG_ERR("Invalid IP seen during server update : %s",
+                     servers[iter]);
+            continue;
         }
+
+        udpfwd_server_set_add(set, id.s_addr, udpPort);
     }
+}
 
-    return false;
+/*
+ * Function      : udpfwd_server_in_scope
+ * Responsiblity : Check whether a configuration update covers a server
+ * Parameters    : server - server entry
+ *                 udpPort - port covered by the update, or
+ *                           UDPFWD_SCOPE_BCAST_PORTS
+ * Return        : true - if the server is covered
+ *                 false - otherwise
+ */
+static bool udpfwd_server_in_scope(const UDPFWD_SERVER_REF_T *server,
+                                   uint16_t udpPort)
+{
+    if (UDPFWD_SCOPE_BCAST_PORTS == udpPort) {
+        return DHCPS_PORT != server->udp_port;
+    }
+    return udpPort == server->udp_port;
 }
 
 /*
- * Function      : udpfwd_store_address
- * Responsiblity : Add a server reference to an interface
- * Parameters    : intfNode - Interface entry
- *                 ipaddress - server IP address
+ * Function      : udpfwd_server_unref
+ * Responsiblity : Drop a reference to a server entry and free it once
+ *                 no interface uses it. Called with waitSem held.
+ * Parameters    : ipaddress - server IP address
  *                 udpPort - destination udp port
- * Return        : true - if the entry is successfully added
- *                 false - otherwise
+ * Return        : none
  */
-bool udpfwd_store_address(UDPFWD_INTERFACE_NODE_T *intfNode,
-                          IP_ADDRESS ipaddress, uint16_t udpPort)
+static void udpfwd_server_unref(IP_ADDRESS ipaddress, uint16_t udpPort)
 {
-   UDPFWD_SERVER_T  *server;
+    UDPFWD_SERVER_T *server;
 
-   if(intfNode->addrCount >= MAX_UDP_BCAST_SERVER_PER_INTERFACE)
-   {
-        VLOG_ERR("Maximum udp server configuration limit reached on interface"
-                  " %s (count : %d)", intfNode->portName, intfNode->addrCount);
-        return false;
-   }
+    server = udpfwd_get_server_entry(ipaddress, udpPort);
+    if (NULL == server)
+    {
+        VLOG_ERR("Server entry not found, ip: %x, port: %d",
+                 ipaddress, udpPort);
+        return;
+    }
 
-   sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+    assert(server->ref_count);
+    /* Decrement server reference Count */
+    server->ref_count--;
+    /* If reference count becomes zero */
+    if (0 >= server->ref_count)
+    {
+        VLOG_INFO("server reference count reached 0. Freeing entry");
+        cmap_remove(&udpfwd_ctrl_cb_p->serverHashMap,
+                    (struct cmap_node *)server,
+                    hash_int(server->ip_address, server->udp_port));
+        relay_pool_free(&udpfwd_ctrl_cb_p->serverPool, server);
+    }
+}
 
-   /* If address count is non zero but the addrses is NULL, return error */
-   if((0 != intfNode->addrCount) && (NULL == intfNode->serverArray))
-   {
-         VLOG_ERR("Address count is [%d], but server IP address ref array "
-                  "is NULL for Interface [%s] while storing a server ref",
-                  intfNode->addrCount, intfNode->portName);
-         sem_post(&udpfwd_ctrl_cb_p->waitSem);
-         return false;
-   }
+/*
+ * Function      : udpfwd_server_ref
+ * Responsiblity : Take a reference to a server entry, creating it if
+ *                 needed. Called with waitSem held.
+ * Parameters    : ipaddress - server IP address
+ *                 udpPort - destination udp port
+ * Return        : UDPFWD_SERVER_T* - server entry, NULL on failure
+ */
+static UDPFWD_SERVER_T *udpfwd_server_ref(IP_ADDRESS ipaddress,
+                                          uint16_t udpPort)
+{
+    UDPFWD_SERVER_T *server;
 
-   /* There is no server table pointers for this interface, we will allocate
-    * memory for this array of server entry pointers */
-   else if(intfNode->serverArray == NULL)
-   {
-      intfNode->addrCount = 0;
-      /* FIXME: Static allocation needs to be avoided.
-       *     1. one proposal is to have 4 server arrays which
-       *        are allocated on need basis
-       *     2. Have statically allocated array of server pointer and maintain
-       *        free/allocated list */
-      intfNode->serverArray = (UDPFWD_SERVER_T **)
-                              malloc(MAX_UDP_BCAST_SERVER_PER_INTERFACE
-                                     * sizeof(UDPFWD_SERVER_T *));
-      if (NULL == intfNode->serverArray) {
-          VLOG_ERR("Failed to allocate server array for interface : %s",
-                   intfNode->portName);
-          sem_post(&udpfwd_ctrl_cb_p->waitSem);
-          return false;
-      }
-    }
-
-    VLOG_INFO("Attempting to add server entry (ip: %d, udp_Port:%d), "
-              "on interface : %s", ipaddress, udpPort, intfNode->portName);
     /* Checks whether Server IP entry exists or not */
     server = udpfwd_get_server_entry(ipaddress, udpPort);
-    if(NULL != server)
+    if (NULL != server)
     {
         /* Increment server entry reference count */
         server->ref_count++;
-        VLOG_INFO("Matching server found, incremented ref count. "
-               "server : %d (refcount :%d)", server->ip_address,
-               server->ref_count);
-    }
-    else
-    {
-        /* No matching server entry, create new */
-        if((server = udpfwd_add_server_entry(
-                       ipaddress, udpPort)) == NULL)
-        {
-            VLOG_ERR("Error while adding a new server entry");
-            sem_post(&udpfwd_ctrl_cb_p->waitSem);
-            return false;
-        }
+        return server;
     }
 
-    /* Update IP reference table (per interface) */
-    intfNode->serverArray[intfNode->addrCount] = server;
-    /* Increment the address count in interface table */
-    intfNode->addrCount++;
+    /* No matching server entry, create new */
+    return udpfwd_add_server_entry(ipaddress, udpPort);
+}
+
+/*
+ * Function      : udpfwd_reserve_servers
+ * Responsiblity : Make room for one more server on an interface. The
+ *                 array starts inline in the interface entry and moves to
+ *                 the heap, doubling, once that is full.
+ *                 Called with waitSem held.
+ * Parameters    : intfNode - Interface entry
+ * Return        : true - if there is room
+ *                 false - the per interface limit is reached
+ */
+static bool udpfwd_reserve_servers(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    UDPFWD_SERVER_REF_T *servers;
+    size_t alloc;
 
-    VLOG_INFO("Server entry successfully updated for interface : %s, "
-              " current address_count : %d", intfNode->portName,
-              intfNode->addrCount);
+    if (intfNode->addrCount < intfNode->addrAlloc)
+        return true;
 
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    if (intfNode->addrAlloc >= UDPFWD_MAX_SERVERS_PER_INTERFACE)
+        return false;
 
+    alloc = MIN(2 * intfNode->addrAlloc, UDPFWD_MAX_SERVERS_PER_INTERFACE);
+    if (intfNode->servers == intfNode->inlineServers)
+    {
+        servers = xmalloc(alloc * sizeof *servers);
+        memcpy(servers, intfNode->inlineServers,
+               intfNode->addrCount * sizeof *servers);
+    }
+    else
+    {
+        servers = xrealloc(intfNode->servers, alloc * sizeof *servers);
+    }
+    intfNode->servers = servers;
+    intfNode->addrAlloc = alloc;
     return true;
 }
 
 /*
- * Function      : udpfwd_remove_address
- * Responsiblity : Remove a server reference from an interface
+ * Function      : udpfwd_release_servers
+ * Responsiblity : Return an interface with no servers to its inline array.
+ *                 Called with waitSem held.
  * Parameters    : intfNode - Interface entry
- *                 ipaddress - server IP address
- *                 udpPort - destination udp port
- * Return        : true - if the server reference is removed
- *                 false - otherwise
+ * Return        : none
  */
-bool udpfwd_remove_address(UDPFWD_INTERFACE_NODE_T *intfNode,
-                        IP_ADDRESS ipaddress, uint16_t udpPort)
+static void udpfwd_release_servers(UDPFWD_INTERFACE_NODE_T *intfNode)
 {
-    UDPFWD_SERVER_T **serverArray = NULL;
-    bool          retVal = false;
-    int           deleted_index;  /*IP ref table's deleted index*/
-    struct shash_node *node;
-
-    VLOG_INFO("Attempting to delete server : %d, udp_port : %d on "
-              "interface : %s", ipaddress, udpPort, intfNode->portName);
+    if (intfNode->servers != intfNode->inlineServers)
+        free(intfNode->servers);
 
-    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+    intfNode->servers = intfNode->inlineServers;
+    intfNode->addrAlloc = UDPFWD_INLINE_SERVERS;
+}
 
-    /* Server IP Reference table pointer */
-    serverArray = intfNode->serverArray;
+/*
+ * Function      : udpfwd_free_interface_node
+ * Responsiblity : Remove an interface entry which has no configuration
+ *                 left. Called with waitSem held.
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+static void udpfwd_free_interface_node(UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    struct shash_node *node;
 
-    retVal = udpfwd_remove_server_ref_entry(intfNode, ipaddress, udpPort,
-                                            (int*)&deleted_index);
-    if(false == retVal)
+    VLOG_INFO("All configuration on the interface : %s are removed."
+              " Freeing interface entry", intfNode->portName);
+    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, intfNode->portName);
+    if (NULL != node)
     {
-        /* Release the semaphore & return */
-        sem_post(&udpfwd_ctrl_cb_p->waitSem);
-        VLOG_ERR("Server entry not found on the interface");
-        return false;
+        shash_delete(&udpfwd_ctrl_cb_p->intfHashTable, node);
+    }
+    else
+    {
+        VLOG_ERR("Interface node not found in hash table : %s",
+                 intfNode->portName);
     }
+    if (NULL != intfNode->portName)
+        free(intfNode->portName);
 
-    /* Decrement interface server reference count */
-    intfNode->addrCount --;
+    udpfwd_release_servers(intfNode);
+    relay_stats_intf_free(intfNode->stats);
+    free(intfNode);
 
-    VLOG_INFO("Interface server reference count after decrement : %d",
-              intfNode->addrCount);
+    /* Deltas can not express a removed entry, so pollers older
+     * than this generation are sent the full table */
+    udpfwd_ctrl_cb_p->removed_generation = udpfwd_next_generation();
+}
 
-    /* Push the NULL entry at the end of the list
-     * If address count is zero & deleted index is also zero, no need to swap
-     * the deleted entry, because the entire list is NULL now.*/
-    if(!((0 == deleted_index) && (0 == intfNode->addrCount)))
-    {
-        udpfwd_push_deleted_server_ref_to_end(intfNode, deleted_index);
-    }
+/*
+ * Function      : udpfwd_release_unused_interface_node
+ * Responsiblity : Free the interface entry if neither servers nor a bootp
+ *                 gateway are configured on it, so that it must not be
+ *                 used afterwards. Called with waitSem held.
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+static void udpfwd_release_unused_interface_node(
+                                    UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    if (0 != intfNode->addrCount)
+        return;
 
-    /* Check whether this was the only configured server IP for the interface.
-     * In that case we must free the memory for entire server table
-     * for this interface. First entry NULL means, entire list is NULL.
-     * because NULL entries are
-     * always pushed to the end of the list */
-    if ((NULL == serverArray[0]) && (intfNode->addrCount ==0))
-    {
-        VLOG_INFO("All server configuration on the interface : %s are removed."
-                  " Freeing server array ", intfNode->portName);
+    udpfwd_release_servers(intfNode);
+    if (0 == intfNode->bootp_gw)
+        udpfwd_free_interface_node(intfNode);
+}
 
-        /* Delete the entire IP reference table */
-        free(serverArray);
-        /* Make interface table entry NULL, as no helper IP is configured */
-        intfNode->serverArray = NULL;
+/*
+ * Function      : udpfwd_apply_server_delta
+ * Responsiblity : Make the servers of an interface within a scope match a
+ *                 server set, in time linear in the number of servers.
+ *                 Called with waitSem held; the caller releases the entry
+ *                 once its configuration is applied.
+ * Parameters    : intfNode - Interface entry
+ *                 desired - servers that should be configured
+ *                 udpPort - port covered by the update, or
+ *                           UDPFWD_SCOPE_BCAST_PORTS
+ * Return        : none
+ */
+static void udpfwd_apply_server_delta(UDPFWD_INTERFACE_NODE_T *intfNode,
+                                      struct udpfwd_server_set *desired,
+                                      uint16_t udpPort)
+{
+    struct udpfwd_server_set_node *setNode;
+    UDPFWD_SERVER_REF_T server;
+    int iter, kept = 0, added = 0, removed = 0;
+    size_t iter1;
 
-        if (intfNode->bootp_gw == 0)
+    /* Drop the servers which are no longer configured, compacting the
+     * array in place */
+    for (iter = 0; iter < intfNode->addrCount; iter++)
+    {
+        server = intfNode->servers[iter];
+        if (udpfwd_server_in_scope(&server, udpPort))
         {
-            VLOG_INFO("All configuration on the interface : %s are removed."
-                      " Freeing interface entry", intfNode->portName);
-            node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable,
-                          intfNode->portName);
-            if (NULL != node)
-            {
-                shash_delete(&udpfwd_ctrl_cb_p->intfHashTable, node);
-            }
-            else
+            setNode = udpfwd_server_set_find(desired, server.ip_address,
+                                             server.udp_port);
+            if (NULL == setNode)
             {
-                VLOG_ERR("Interface node not found in hash table : %s",
-                     intfNode->portName);
+                udpfwd_server_unref(server.ip_address, server.udp_port);
+                removed++;
+                continue;
             }
-            if (NULL != intfNode->portName)
-                free(intfNode->portName);
+            setNode->present = true;
+        }
+        intfNode->servers[kept++] = server;
+    }
+    intfNode->addrCount = kept;
+
+    /* Add the servers which are newly configured */
+    for (iter1 = 0; iter1 < desired->n; iter1++)
+    {
+        setNode = desired->order[iter1];
+        if (setNode->present)
+            continue;
 
-            free(intfNode);
+        if (!udpfwd_reserve_servers(intfNode))
+        {
+            VLOG_ERR("Maximum udp server configuration limit reached on "
+                     "interface %s (count : %d)", intfNode->portName,
+                     intfNode->addrCount);
+            break;
+        }
+
+        if (NULL == udpfwd_server_ref(setNode->ip_address,
+                                      setNode->udp_port))
+        {
+            VLOG_ERR("Error while adding a new server entry");
+            continue;
         }
+        server.ip_address = setNode->ip_address;
+        server.udp_port = setNode->udp_port;
+        intfNode->servers[intfNode->addrCount++] = server;
+        added++;
     }
-    sem_post(&udpfwd_ctrl_cb_p->waitSem);
-    return true;
+
+    if ((0 == added) && (0 == removed))
+        return;
+
+    VLOG_INFO("Server entries updated for interface : %s, added : %d, "
+              "removed : %d, current address_count : %d",
+              intfNode->portName, added, removed, intfNode->addrCount);
+
+    UDPFWD_INTF_TOUCH(intfNode);
 }
 
 /*
  * Function      : udpfwd_create_intfnode
- * Responsiblity : Allocate memory for interface entry
+ * Responsiblity : Allocate memory for interface entry and add it to the
+ *                 interface table. Called with waitSem held, so that the
+ *                 entry is published together with its configuration.
  * Parameters    : pname - interface name
  * Return        : UDPFWD_INTERFACE_NODE_T* - Interface node
  */
@@ -371,72 +511,108 @@ UDPFWD_INTERFACE_NODE_T *udpfwd_create_intferface_node(char *pname)
 
     strncpy(intfNode->portName, pname, strlen(pname));
     intfNode->addrCount = 0;
-    intfNode->serverArray = NULL;
+    intfNode->servers = intfNode->inlineServers;
+    intfNode->addrAlloc = UDPFWD_INLINE_SERVERS;
+    intfNode->stats = relay_stats_intf_alloc(RELAY_STATS_KIND_UDPFWD, pname);
     shash_add(&udpfwd_ctrl_cb_p->intfHashTable, pname, intfNode);
     VLOG_INFO("Allocated interface table record for port : %s", pname);
 
     intfNode->bootp_gw = 0;
+    UDPFWD_INTF_TOUCH(intfNode);
 
     return intfNode;
 }
 
+/*
+ * Function      : udpfwd_stats_publish
+ * Responsiblity : Copy the interface counters to its shared memory
+ *                 statistics record, if statistics export is enabled.
+ * Parameters    : intfNode - Interface entry
+ * Return        : none
+ */
+void udpfwd_stats_publish(const UDPFWD_INTERFACE_NODE_T *intfNode)
+{
+    struct relay_stats_intf *stats = intfNode->stats;
+#ifdef FTR_DHCP_RELAY
+    const DHCP_RELAY_PKT_COUNTER *counters = &intfNode->dhcp_relay_pkt_counters;
+#endif /* FTR_DHCP_RELAY */
+
+    if (NULL == stats)
+        return;
+
+    relay_stats_intf_write_begin(stats);
+#ifdef FTR_DHCP_RELAY
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPR_CLIENT_DROPS],
+                      counters->client_drops);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPR_CLIENT_VALIDS],
+                      counters->client_valids);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPR_SERVER_DROPS],
+                      counters->serv_drops);
+    relay_stats_store(&stats->counters[RELAY_STATS_DHCPR_SERVER_VALIDS],
+                      counters->serv_valids);
+    relay_stats_store(
+        &stats->counters[RELAY_STATS_DHCPR_CLIENT_DROPS_OPTION82],
+        counters->client_drops_with_option82);
+    relay_stats_store(
+        &stats->counters[RELAY_STATS_DHCPR_CLIENT_VALIDS_OPTION82],
+        counters->client_valids_with_option82);
+    relay_stats_store(
+        &stats->counters[RELAY_STATS_DHCPR_SERVER_DROPS_OPTION82],
+        counters->serv_drops_with_option82);
+    relay_stats_store(
+        &stats->counters[RELAY_STATS_DHCPR_SERVER_VALIDS_OPTION82],
+        counters->serv_valids_with_option82);
+#endif /* FTR_DHCP_RELAY */
+    relay_stats_intf_write_end(stats);
+}
+
 #ifdef FTR_DHCP_RELAY
 /*
- * Function      : udpfwd_handle_dhcp_relay_row_delete
- * Responsiblity : Process delete event for one or more ports records from
- *                 DHCP-Relay table
- * Parameters    : idl - idl reference
+ * Function      : udpfwd_dhcp_relay_flush
+ * Responsiblity : Remove the DHCP-Relay configuration of an interface
+ * Parameters    : portName - interface name
  * Return        : none
  */
-void udpfwd_handle_dhcp_relay_row_delete(struct ovsdb_idl *idl)
+static void udpfwd_dhcp_relay_flush(const char *portName)
 {
-    const struct ovsrec_dhcp_relay *rec = NULL;
     UDPFWD_INTERFACE_NODE_T *intf = NULL;
-    struct shash_node *node = NULL, *next = NULL;
-    int iter = 0, addrCount = 0;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr = NULL;
-    bool found = false;
-
-    /* Walk the server configuration hash table per "port" to
-     * see if the corresponding record is deleted */
-    SHASH_FOR_EACH_SAFE(node, next, &udpfwd_ctrl_cb_p->intfHashTable) {
-        found = false;
-        /* Iterate through dhcp relay table to find a match */
-        OVSREC_DHCP_RELAY_FOR_EACH(rec, idl) {
-            if ((NULL != rec->port) &&
-                !strncmp(rec->port->name, node->name,
-                         strlen(rec->port->name))) {
-                found = true;
-                break;
-            }
-        }
+    struct udpfwd_server_set none;
 
-        if (false == found) {
-            intf = (UDPFWD_INTERFACE_NODE_T *)node->data;
-            intf->bootp_gw = 0;
-            memset(servers, 0, sizeof(servers));
-            arrayPtr = (UDPFWD_SERVER_T *)servers;
-            addrCount = intf->addrCount;
-            /* Delete the interface entry from hash table */
-            for (iter = 0; iter < addrCount; iter++) {
-                /* Delete only non DHCP-Relay server entries from the intf */
-                if (DHCPS_PORT == intf->serverArray[iter]->udp_port)
-                {
-                    *arrayPtr = *(intf->serverArray[iter]);
-                    arrayPtr++;
-                }
-            }
+    udpfwd_server_set_init(&none);
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
 
-            /* Delete the servers maked for removal */
-            for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-            {
-                udpfwd_remove_address(intf, servers[iter].ip_address,
-                                      servers[iter].udp_port);
-            }
-        }
+    intf = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable, portName);
+    if (NULL != intf) {
+        intf->bootp_gw = 0;
+        UDPFWD_INTF_TOUCH(intf);
+
+        /* Delete only the DHCP-Relay server entries from the intf */
+        udpfwd_apply_server_delta(intf, &none, DHCPS_PORT);
+        udpfwd_release_unused_interface_node(intf);
     }
 
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_server_set_destroy(&none);
+}
+
+/*
+ * Function      : udpfwd_handle_dhcp_relay_row_delete
+ * Responsiblity : Process delete event of a DHCP-Relay table record
+ * Parameters    : uuid - uuid of the deleted record
+ * Return        : none
+ */
+void udpfwd_handle_dhcp_relay_row_delete(const struct uuid *uuid)
+{
+    struct relay_row_ref *ref;
+
+    ref = relay_row_map_find(&udpfwd_ctrl_cb_p->dhcpRelayRows, uuid);
+    if (NULL == ref) {
+        return;
+    }
+
+    udpfwd_dhcp_relay_flush(ref->portName);
+    relay_row_map_remove(&udpfwd_ctrl_cb_p->dhcpRelayRows, ref);
+
     return;
 }
 
@@ -451,39 +627,42 @@ void udpfwd_handle_dhcp_relay_config_change(
               const struct ovsrec_dhcp_relay *rec, uint32_t idl_seqno)
 {
     struct in_addr id;
-    IP_ADDRESS ipaddress;
     char *portName = NULL, *bootp_gw = NULL;
-    int iter, iter1;
-    struct shash_node *node;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    uint32_t servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    uint32_t *arrayPtr;
+    struct udpfwd_server_set servers;
+    struct relay_row_ref *ref;
+    bool fresh, updateGw = false, updateServers;
+    IP_ADDRESS gwAddress = 0;
     int retVal;
-    bool found;
 
-    if ((NULL == rec) ||
-        (NULL == rec->port) ||
+    if (NULL == rec) {
+        return;
+    }
+
+    ref = relay_row_map_find(&udpfwd_ctrl_cb_p->dhcpRelayRows,
+                             &rec->header_.uuid);
+    if ((NULL == rec->port) ||
         (NULL == rec->vrf)) {
+        /* The record no longer configures an interface */
+        if (ref) {
+            udpfwd_dhcp_relay_flush(ref->portName);
+            relay_row_map_remove(&udpfwd_ctrl_cb_p->dhcpRelayRows, ref);
+        }
         return;
     }
 
     portName = rec->port->name;
 
-    /* Do lookup for the interface entry in hash table */
-    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, portName);
-    if (NULL == node) {
-       /* Interface entry not found, create one */
-       if (NULL == (intfNode = udpfwd_create_intferface_node(portName)))
-       {
-           return;
-       }
-    }
-    else
-    {
-        intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
+    /* A record moved to another interface is applied there in full */
+    fresh = (NULL == ref) || strcmp(ref->portName, portName);
+    if (ref && fresh) {
+        udpfwd_dhcp_relay_flush(ref->portName);
     }
+    relay_row_map_set(&udpfwd_ctrl_cb_p->dhcpRelayRows, &rec->header_.uuid,
+                      portName, DHCPS_PORT);
 
-    if (OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_other_config,
+    if (fresh
+        || OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_other_config,
                                idl_seqno)) {
 
         /* Check for bootp gateway configuration */
@@ -492,87 +671,53 @@ void udpfwd_handle_dhcp_relay_config_change(
 
         if (bootp_gw == NULL) {
             /* bootp gateway ip is deleted or not configured */
-            intfNode->bootp_gw = 0;
+            updateGw = true;
         }
         else {
             retVal = inet_aton(bootp_gw, &id);
             if (!retVal || id.s_addr == 0)
                 VLOG_ERR("Invalid IP address received"
                         "set as bootp gateway address");
-            else
-                intfNode->bootp_gw = id.s_addr;
-
+            else {
+                gwAddress = id.s_addr;
+                updateGw = true;
+            }
         }
     }
 
-    if (!OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv4_ucast_server,
-                               idl_seqno)) {
-        /* if no change in server ip column */
-        return;
-    }
-
-    memset(servers, 0, sizeof(servers));
-
-    arrayPtr = (uint32_t*)servers;
-    /* Collect the servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++) {
-        found = false;
-        ipaddress = intfNode->serverArray[iter]->ip_address;
-
-        for (iter1 = 0; iter1 < rec->n_ipv4_ucast_server; iter1++) {
-            retVal = inet_aton (rec->ipv4_ucast_server[iter1], &id);
-            if (!retVal || (id.s_addr == 0)) {
-                VLOG_ERR("Invalid IP seen during server update : %s",
-                        rec->ipv4_ucast_server[iter1]);
-                continue;
-            }
-            if (ipaddress == (id.s_addr)) {
-                found = true;
-                break;
-            }
-        }
+    updateServers = fresh
+        || OVSREC_IDL_IS_COLUMN_MODIFIED(ovsrec_dhcp_relay_col_ipv4_ucast_server,
+                               idl_seqno);
 
-        if (false == found) {
-            *arrayPtr = ipaddress;
-            arrayPtr++;
-        }
+    udpfwd_server_set_init(&servers);
+    if (updateServers) {
+        udpfwd_server_set_parse(&servers, rec->ipv4_ucast_server,
+                                rec->n_ipv4_ucast_server, DHCPS_PORT);
     }
 
-    /* Delete the servers that were removed in the config update */
-    for (iter = 0; servers[iter] != 0; iter++) {
-        udpfwd_remove_address(intfNode, servers[iter], DHCPS_PORT);
+    /* The entry is looked up, created, updated and released under a
+     * single waitSem hold, so readers never see it half configured */
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+
+    intfNode = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable, portName);
+    if (NULL == intfNode) {
+       /* Interface entry not found, create one */
+       intfNode = udpfwd_create_intferface_node(portName);
     }
 
-    memset(servers, 0, sizeof(servers));
-    /* Collect the servers that are newly added */
-    arrayPtr = (uint32_t*)servers;
-    for (iter = 0; iter < rec->n_ipv4_ucast_server; iter++) {
-        found = false;
-        retVal = inet_aton(rec->ipv4_ucast_server[iter], &id);
-        if (!retVal || (id.s_addr == 0)) {
-            VLOG_ERR("Invalid IP seen during server update : %s",
-                    rec->ipv4_ucast_server[iter]);
-            continue;
+    if (NULL != intfNode) {
+        if (updateGw) {
+            intfNode->bootp_gw = gwAddress;
+            UDPFWD_INTF_TOUCH(intfNode);
         }
-
-        for (iter1 = 0; iter1 < intfNode->addrCount; iter1++) {
-            if (intfNode->serverArray[iter1]->ip_address ==
-                       id.s_addr) {
-                found = true;
-                break;
-            }
-        }
-
-        if (false == found) {
-            *arrayPtr = id.s_addr;
-            arrayPtr++;
+        if (updateServers) {
+            udpfwd_apply_server_delta(intfNode, &servers, DHCPS_PORT);
         }
+        udpfwd_release_unused_interface_node(intfNode);
     }
 
-    /* Create the newly added servers */
-    for (iter = 0; servers[iter] != 0; iter++) {
-        udpfwd_store_address(intfNode, servers[iter], DHCPS_PORT);
-    }
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_server_set_destroy(&servers);
 
     return;
 }
@@ -716,110 +861,50 @@ refresh_dhcp_relay_stats()
 
 #ifdef FTR_UDP_BCAST_FWD
 /*
- * Function      : server_ip_exists
- * Responsiblity : Check if a server ip exists in a server array
- * Parameters    : server_ip - IP address of the server
- *                 servers - List of servers
- *                 server_count - Number of servers in the list
- * Return        : true - If the server ip exists in the list
- *                 false - otherwise
+ * Function      : udpfwd_bcast_forwarder_flush
+ * Responsiblity : Remove the servers of a UDP port from an interface
+ * Parameters    : portName - interface name
+ *                 udpPort - UDP destination port
+ * Return        : none
  */
-bool server_ip_exists(IP_ADDRESS server_ip, char **servers,
-                      uint32_t server_count)
+static void udpfwd_bcast_forwarder_flush(const char *portName,
+                                         uint16_t udpPort)
 {
-    struct in_addr id;
-    bool found = false;
-    int iter = 0;
+    UDPFWD_INTERFACE_NODE_T *intf = NULL;
+    struct udpfwd_server_set none;
 
-    for ( ; iter < server_count; iter++)
-    {
-        if (!(inet_aton (servers[iter], &id)) ||
-            (id.s_addr == 0))
-        {
-            continue;
-        }
+    udpfwd_server_set_init(&none);
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
 
-        if (server_ip == (id.s_addr))
-        {
-            found = true;
-            break;
-        }
+    intf = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable, portName);
+    if (NULL != intf) {
+        udpfwd_apply_server_delta(intf, &none, udpPort);
+        udpfwd_release_unused_interface_node(intf);
     }
 
-    return found;
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_server_set_destroy(&none);
 }
 
 /*
  * Function      : udpfwd_handle_udp_bcast_forwarder_row_delete
- * Responsiblity : Process delete event for one or more ports records from
- *                 UDP_Bcast_forwarder table
- * Parameters    : idl - idl reference
+ * Responsiblity : Process delete event of a UDP_Bcast_forwarder table
+ *                 record
+ * Parameters    : uuid - uuid of the deleted record
  * Return        : none
  */
-void udpfwd_handle_udp_bcast_forwarder_row_delete(struct ovsdb_idl *idl)
+void udpfwd_handle_udp_bcast_forwarder_row_delete(const struct uuid *uuid)
 {
-    const struct ovsrec_udp_bcast_forwarder_server *rec = NULL;
-    UDPFWD_INTERFACE_NODE_T *intf = NULL;
-    struct shash_node *node = NULL, *next = NULL;
-    int iter = 0;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr = NULL;
-    bool found = false;
-
-    /* Walk the server configuration hash table per "port" to
-     * see if configuration related to an interface is completely deleted */
-    SHASH_FOR_EACH_SAFE(node, next, &udpfwd_ctrl_cb_p->intfHashTable)
-    {
-        intf = (UDPFWD_INTERFACE_NODE_T *)node->data;
-        memset(servers, 0, sizeof(servers));
-        arrayPtr = (UDPFWD_SERVER_T *)servers;
+    struct relay_row_ref *ref;
 
-        for (iter = 0; iter < intf->addrCount; iter++)
-        {
-            found = false;
-            server = intf->serverArray[iter];
-            if (DHCPS_PORT == server->udp_port)
-                continue;
-
-            /* Iterate through UDP_Bcast_forwarder table to find a match */
-            OVSREC_UDP_BCAST_FORWARDER_SERVER_FOR_EACH(rec, idl) {
-                /* Check if portname and udp_dport matches with rec entry */
-                if ((NULL != rec->src_port) &&
-                    (0 != strncmp(rec->src_port->name, intf->portName,
-                             strlen(rec->src_port->name)))) {
-                    continue;
-                }
-
-                if ((DHCPS_PORT == rec->udp_dport) ||
-                    (rec->udp_dport != server->udp_port)) {
-                    continue;
-                }
-
-                /* Check if server ip exists in the udp_bcast_forwarder_table
-                 * record */
-                if (false != server_ip_exists(server->ip_address,
-                                              rec->ipv4_ucast_server,
-                                              rec->n_ipv4_ucast_server)) {
-                    found = true;
-                    break;
-                }
-            }
-
-            if (false == found) {
-                *arrayPtr = *server;
-                arrayPtr++;
-            }
-        }
-
-        /* Delete the servers maked for removal */
-        for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-        {
-            udpfwd_remove_address(intf, servers[iter].ip_address,
-                                  servers[iter].udp_port);
-        }
+    ref = relay_row_map_find(&udpfwd_ctrl_cb_p->bcastFwdRows, uuid);
+    if (NULL == ref) {
+        return;
     }
 
+    udpfwd_bcast_forwarder_flush(ref->portName, ref->udp_dport);
+    relay_row_map_remove(&udpfwd_ctrl_cb_p->bcastFwdRows, ref);
+
     return;
 }
 
@@ -832,121 +917,205 @@ void udpfwd_handle_udp_bcast_forwarder_row_delete(struct ovsdb_idl *idl)
 void udpfwd_handle_udp_bcast_forwarder_config_change(
               const struct ovsrec_udp_bcast_forwarder_server *rec)
 {
-    struct in_addr id;
     char *portName = NULL;
-    int iter, iter1;
-    struct shash_node *node;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
-    UDPFWD_SERVER_T *server;
-    UDPFWD_SERVER_T servers[MAX_UDP_BCAST_SERVER_PER_INTERFACE];
-    UDPFWD_SERVER_T *arrayPtr;
-    int retVal;
-    bool found;
+    struct udpfwd_server_set servers;
+    struct relay_row_ref *ref;
 
-    if ((NULL == rec) ||
-        (NULL == rec->src_port) ||
-        (NULL == rec->dest_vrf)) {
+    if (NULL == rec) {
+        return;
+    }
+
+    ref = relay_row_map_find(&udpfwd_ctrl_cb_p->bcastFwdRows,
+                             &rec->header_.uuid);
+    if ((NULL == rec->src_port) ||
+        (NULL == rec->dest_vrf) ||
+        (UDPFWD_SCOPE_BCAST_PORTS == rec->udp_dport)) {
+        /* The record no longer configures an interface */
+        if (ref) {
+            udpfwd_bcast_forwarder_flush(ref->portName, ref->udp_dport);
+            relay_row_map_remove(&udpfwd_ctrl_cb_p->bcastFwdRows, ref);
+        }
         return;
     }
 
     portName = rec->src_port->name;
 
+    /* Undo the old configuration of a record moved to another interface
+     * or UDP port */
+    if (ref && (strcmp(ref->portName, portName)
+                || (ref->udp_dport != rec->udp_dport))) {
+        udpfwd_bcast_forwarder_flush(ref->portName, ref->udp_dport);
+    }
+    relay_row_map_set(&udpfwd_ctrl_cb_p->bcastFwdRows, &rec->header_.uuid,
+                      portName, rec->udp_dport);
+
+    udpfwd_server_set_init(&servers);
+    udpfwd_server_set_parse(&servers, rec->ipv4_ucast_server,
+                            rec->n_ipv4_ucast_server, rec->udp_dport);
+
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+
     /* Do lookup for the interface entry in hash table */
-    node = shash_find(&udpfwd_ctrl_cb_p->intfHashTable, portName);
-    if (NULL == node)
+    intfNode = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable, portName);
+    if (NULL == intfNode)
     {
        /* Interface entry not found, create one */
-       if (NULL == (intfNode = udpfwd_create_intferface_node(portName)))
-       {
-           return;
-       }
+       intfNode = udpfwd_create_intferface_node(portName);
     }
-    else
+
+    if (NULL != intfNode)
     {
-        intfNode = (UDPFWD_INTERFACE_NODE_T *) node->data;
+        udpfwd_apply_server_delta(intfNode, &servers, rec->udp_dport);
+        udpfwd_release_unused_interface_node(intfNode);
     }
 
-    memset(servers, 0, sizeof(servers));
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_server_set_destroy(&servers);
 
-    arrayPtr = (UDPFWD_SERVER_T *)servers;
-    /* Collect the servers that are removed from the list */
-    for (iter = 0; iter < intfNode->addrCount; iter++)
-    {
-        found = false;
-        server = intfNode->serverArray[iter];
+    return;
+}
+#endif /* FTR_UDP_BCAST_FWD */
 
-        for (iter1 = 0; iter1 < rec->n_ipv4_ucast_server; iter1++)
-        {
-            retVal = inet_aton (rec->ipv4_ucast_server[iter1], &id);
-            if (!retVal || (id.s_addr == 0))
-            {
-                VLOG_ERR("Invalid IP seen during server update : %s",
-                        rec->ipv4_ucast_server[iter1]);
-                continue;
-            }
-            if ((server->ip_address == (id.s_addr))
-                && (server->udp_port== rec->udp_dport))
-            {
-                found = true;
-                break;
-            }
+/*
+ * Function      : udpfwd_restore_interface
+ * Responsiblity : Recreate an interface entry saved in a snapshot, so that
+ *                 forwarding resumes before the configuration is read.
+ * Parameters    : rec - interface snapshot, followed by its servers
+ * Return        : none
+ */
+void udpfwd_restore_interface(const UDPFWD_SNAPSHOT_INTF *rec)
+{
+    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
+    const UDPFWD_SNAPSHOT_SERVER *server;
+    struct udpfwd_server_set dhcpServers, bcastServers;
+    char portName[RELAY_SNAPSHOT_NAME_LEN];
+    uint32_t iter;
+
+    ovs_strzcpy(portName, rec->portName, sizeof portName);
+    if ('\0' == portName[0]) {
+        return;
+    }
+
+    udpfwd_server_set_init(&dhcpServers);
+    udpfwd_server_set_init(&bcastServers);
+    for (iter = 0; iter < rec->n_servers; iter++) {
+        server = &rec->servers[iter];
+        if (IP_ADDRESS_NULL == server->ip_address) {
+            continue;
         }
 
-        if ((false == found)
-            && (server->udp_port== rec->udp_dport))
-        {
-            *arrayPtr = *server;
-            arrayPtr++;
+        if (DHCPS_PORT == server->udp_port) {
+            udpfwd_server_set_add(&dhcpServers, server->ip_address,
+                                  server->udp_port);
+        } else if (UDPFWD_SCOPE_BCAST_PORTS != server->udp_port) {
+            udpfwd_server_set_add(&bcastServers, server->ip_address,
+                                  server->udp_port);
         }
     }
 
-    /* Delete the servers that were removed in the config update */
-    for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-    {
-        udpfwd_remove_address(intfNode, servers[iter].ip_address,
-                              servers[iter].udp_port);
+    sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+
+    if (NULL == shash_find(&udpfwd_ctrl_cb_p->intfHashTable, portName)) {
+        intfNode = udpfwd_create_intferface_node(portName);
     }
 
-    memset(servers, 0, sizeof(servers));
-    /* Collect the servers that are newly added */
-    arrayPtr = (UDPFWD_SERVER_T *)servers;
-    for (iter = 0; iter < rec->n_ipv4_ucast_server; iter++)
-    {
-        found = false;
-        retVal = inet_aton(rec->ipv4_ucast_server[iter], &id);
-        if (!retVal || (id.s_addr == 0))
-        {
-            VLOG_ERR("Invalid IP seen during server update : %s",
-                    rec->ipv4_ucast_server[iter]);
-            continue;
-        }
+    if (NULL != intfNode) {
+        intfNode->bootp_gw = rec->bootp_gw;
+#ifdef FTR_DHCP_RELAY
+        intfNode->dhcp_relay_pkt_counters = rec->dhcp_relay_pkt_counters;
+#endif /* FTR_DHCP_RELAY */
+        UDPFWD_INTF_TOUCH(intfNode);
 
-        for (iter1 = 0; iter1 < intfNode->addrCount; iter1++)
-        {
-            server = intfNode->serverArray[iter1];
-            if ((server->ip_address == id.s_addr)
-                 && (server->udp_port== rec->udp_dport))
-            {
-                found = true;
-                break;
-            }
+        udpfwd_apply_server_delta(intfNode, &dhcpServers, DHCPS_PORT);
+        udpfwd_apply_server_delta(intfNode, &bcastServers,
+                                  UDPFWD_SCOPE_BCAST_PORTS);
+        udpfwd_release_unused_interface_node(intfNode);
+    }
+
+    sem_post(&udpfwd_ctrl_cb_p->waitSem);
+    udpfwd_server_set_destroy(&dhcpServers);
+    udpfwd_server_set_destroy(&bcastServers);
+}
+
+/*
+ * Function      : udpfwd_reconcile_interfaces
+ * Responsiblity : Drop the restored state which no configuration record
+ *                 backs. Called once, after the first configuration walk
+ *                 following a snapshot restore.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_reconcile_interfaces(void)
+{
+    struct shash_node *node = NULL, *next = NULL;
+    struct sset dhcpPorts, bcastPorts;
+    struct relay_row_ref *ref;
+#ifdef FTR_UDP_BCAST_FWD
+    UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
+    const UDPFWD_SERVER_REF_T *server;
+    struct udpfwd_server_set keep;
+    char *key;
+    int iter;
+#endif /* FTR_UDP_BCAST_FWD */
+    char *portName;
+
+    sset_init(&dhcpPorts);
+    sset_init(&bcastPorts);
+
+#ifdef FTR_DHCP_RELAY
+    HMAP_FOR_EACH (ref, node, &udpfwd_ctrl_cb_p->dhcpRelayRows.rows) {
+        sset_add(&dhcpPorts, ref->portName);
+    }
+#endif /* FTR_DHCP_RELAY */
+
+#ifdef FTR_UDP_BCAST_FWD
+    HMAP_FOR_EACH (ref, node, &udpfwd_ctrl_cb_p->bcastFwdRows.rows) {
+        key = xasprintf("%s:%"PRId64, ref->portName, ref->udp_dport);
+        sset_add(&bcastPorts, key);
+        free(key);
+    }
+#endif /* FTR_UDP_BCAST_FWD */
+
+    SHASH_FOR_EACH_SAFE (node, next, &udpfwd_ctrl_cb_p->intfHashTable) {
+        /* The entry may be freed by the updates below */
+        portName = xstrdup(node->name);
+
+#ifdef FTR_DHCP_RELAY
+        if (!sset_contains(&dhcpPorts, portName)) {
+            udpfwd_dhcp_relay_flush(portName);
         }
+#endif /* FTR_DHCP_RELAY */
 
-        if (false == found)
-        {
-            arrayPtr->ip_address = id.s_addr;
-            arrayPtr->udp_port = rec->udp_dport;
-            arrayPtr++;
+#ifdef FTR_UDP_BCAST_FWD
+        sem_wait(&udpfwd_ctrl_cb_p->waitSem);
+        intfNode = shash_find_data(&udpfwd_ctrl_cb_p->intfHashTable,
+                                   portName);
+        if (NULL != intfNode) {
+            udpfwd_server_set_init(&keep);
+            for (iter = 0; iter < intfNode->addrCount; iter++) {
+                server = &intfNode->servers[iter];
+                if (DHCPS_PORT == server->udp_port) {
+                    continue;
+                }
+                key = xasprintf("%s:%u", portName, server->udp_port);
+                if (sset_contains(&bcastPorts, key)) {
+                    udpfwd_server_set_add(&keep, server->ip_address,
+                                          server->udp_port);
+                }
+                free(key);
+            }
+            udpfwd_apply_server_delta(intfNode, &keep,
+                                      UDPFWD_SCOPE_BCAST_PORTS);
+            udpfwd_release_unused_interface_node(intfNode);
+            udpfwd_server_set_destroy(&keep);
         }
-    }
+        sem_post(&udpfwd_ctrl_cb_p->waitSem);
+#endif /* FTR_UDP_BCAST_FWD */
 
-    /* Create the newly added servers */
-    for (iter = 0; (servers[iter].ip_address) != 0; iter++)
-    {
-        udpfwd_store_address(intfNode, servers[iter].ip_address,
-                             servers[iter].udp_port);
+        free(portName);
     }
 
-    return;
+    sset_destroy(&dhcpPorts);
+    sset_destroy(&bcastPorts);
 }
-#endif /* FTR_UDP_BCAST_FWD */
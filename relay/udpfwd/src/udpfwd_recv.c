@@ -27,11 +27,51 @@
 
 #include <sys/ioctl.h>
 #include <net/if.h>
-#include <sys/select.h>
+#include <time.h>
+#include "coverage.h"
 #include "udpfwd_util.h"
 
 VLOG_DEFINE_THIS_MODULE(udpfwd_recv);
 
+COVERAGE_DEFINE(udpfwd_recv_retry);
+COVERAGE_DEFINE(udpfwd_recv_overload);
+COVERAGE_DEFINE(udpfwd_recv_failure);
+
+/* How a receive error is handled */
+enum udpfwd_recv_error {
+    UDPFWD_RECV_RETRY,     /* interrupted, read again */
+    UDPFWD_RECV_OVERLOAD,  /* system short of resources, yield the thread */
+    UDPFWD_RECV_BROKEN     /* socket unusable, re-create it */
+};
+
+/*
+ * Function      : udpfwd_recv_classify
+ * Responsiblity : Classify a receive error
+ * Parameters    : err - errno of the failed receive
+ * Return        : enum udpfwd_recv_error
+ */
+static enum udpfwd_recv_error udpfwd_recv_classify(int err)
+{
+    switch (err) {
+    case EINTR:
+        return UDPFWD_RECV_RETRY;
+
+    case ENOBUFS:
+    case ENOMEM:
+        return UDPFWD_RECV_OVERLOAD;
+
+    case EBADF:
+    case ENOTSOCK:
+    case EFAULT:
+    case EINVAL:
+        return UDPFWD_RECV_BROKEN;
+
+    default:
+        /* Unknown errors count towards UDPFWD_RECV_MAX_ERRORS */
+        return UDPFWD_RECV_OVERLOAD;
+    }
+}
+
 /*
  * Function      : udpfwd_ctrl
  * Responsiblity : Depending on type of request(BOOTP REQUEST/BOOTP REPLY),
@@ -44,6 +84,7 @@ VLOG_DEFINE_THIS_MODULE(udpfwd_recv);
 void udpfwd_ctrl(void *pkt, int32_t size,
                  struct in_pktinfo *pktInfo)
 {
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
     struct ip *iph;              /* ip header */
     struct udphdr *udph;            /* udp header */
 #ifdef FTR_DHCP_RELAY
@@ -59,7 +100,23 @@ void udpfwd_ctrl(void *pkt, int32_t size,
     }
 
     iph  = (struct ip *) pkt;
+
+    /* The relay trusts ip_len and uh_ulen from here on: both headers and
+     * the UDP datagram must be within the received size. */
+    if ((size < (int32_t)sizeof(struct ip))
+        || (iph->ip_hl * 4 < (int32_t)sizeof(struct ip))
+        || (ntohs(iph->ip_len) > size)
+        || (ntohs(iph->ip_len) < iph->ip_hl * 4 + UDPHDR_LENGTH)) {
+        VLOG_DBG_RL(&rl, "Malformed IP header, %d bytes dropped", size);
+        return;
+    }
+
     udph = (struct udphdr *) ((char *)iph + (iph->ip_hl * 4));
+    if ((ntohs(udph->uh_ulen) < UDPHDR_LENGTH)
+        || (iph->ip_hl * 4 + ntohs(udph->uh_ulen) > ntohs(iph->ip_len))) {
+        VLOG_DBG_RL(&rl, "Malformed UDP header, %d bytes dropped", size);
+        return;
+    }
 
     switch (ntohs(udph->dest)) {
 #ifdef FTR_DHCP_RELAY
@@ -71,6 +128,12 @@ void udpfwd_ctrl(void *pkt, int32_t size,
                 return;
             }
 
+            if (DHCP_PKTLEN(udph) < (int32_t) DHCP_MIN_PKTLEN) {
+                VLOG_DBG_RL(&rl, "Truncated DHCP packet of %d bytes dropped",
+                            DHCP_PKTLEN(udph));
+                return;
+            }
+
             dhcp = (struct dhcp_packet *)
                         ((char *)iph + (iph->ip_hl * 4) + UDPHDR_LENGTH);
 
@@ -107,46 +170,187 @@ void udpfwd_ctrl(void *pkt, int32_t size,
 }
 
 /*
- * Function      : udp_packet_recv
- * Responsiblity : Thread to receive UDP packets to a
- *                 specified destination port.
- * Parameters    : args - arguments
+ * Function      : udpfwd_classify
+ * Responsiblity : Get the traffic class of a received packet
+ * Parameters    : pkt - raw ip packet
+ *                 size - size of the packet
+ * Return        : enum udpfwd_class
+ */
+static enum udpfwd_class udpfwd_classify(const void *pkt, int32_t size)
+{
+    const struct ip *iph = pkt;
+    const struct udphdr *udph;
+
+    if ((size < (int32_t)sizeof(struct ip))
+        || (size < iph->ip_hl * 4 + UDPHDR_LENGTH)) {
+        return UDPFWD_CLASS_FWD;
+    }
+
+    udph = (const struct udphdr *) ((const char *)iph + (iph->ip_hl * 4));
+    switch (ntohs(udph->dest)) {
+    case DHCPS_PORT:
+    case DHCPC_PORT:
+        return UDPFWD_CLASS_DHCP;
+
+    default:
+        return UDPFWD_CLASS_FWD;
+    }
+}
+
+/*
+ * Function      : udpfwd_process_slot
+ * Responsiblity : Relay a queued packet
+ * Parameters    : slot - received packet
  * Return        : none
  */
-void * udp_packet_recv(void *args)
+static void udpfwd_process_slot(UDPFWD_RX_SLOT_T *slot)
 {
+    struct timespec start, end;
+
+    if (relay_stats_enabled()) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        udpfwd_ctrl(slot->buff, slot->size, &slot->pktInfo);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        relay_stats_record_packet(RELAY_STATS_KIND_UDPFWD,
+                    (end.tv_sec - start.tv_sec) * 1000000000LL
+                    + (end.tv_nsec - start.tv_nsec));
+    } else {
+        udpfwd_ctrl(slot->buff, slot->size, &slot->pktInfo);
+    }
+}
+
+/*
+ * Function      : udpfwd_serve_queues
+ * Responsiblity : Relay the queued packets of a VRF context in strict
+ *                 class priority, the oldest packet of a class first.
+ * Parameters    : ctx - VRF context
+ *                 quota - maximum number of packets to relay
+ * Return        : none
+ */
+static void udpfwd_serve_queues(UDPFWD_VRF_CTX_T *ctx, int quota)
+{
+    UDPFWD_RX_QUEUE_T *queue;
+    uint16_t index;
+    int class;
+
+    for (class = 0; class < UDPFWD_CLASS_MAX; class++) {
+        queue = &ctx->queues[class];
+        while ((0 < queue->count) && (0 < quota--)) {
+            index = queue->slots[queue->head];
+            queue->head = (queue->head + 1) % UDPFWD_CLASS_MAX_DEPTH;
+            queue->count--;
+
+            udpfwd_process_slot(&ctx->slots[index]);
+            ctx->freeSlots[ctx->n_free++] = index;
+        }
+    }
+}
+
+/*
+ * Function      : udp_packet_recv
+ * Responsiblity : Reactor handler of a VRF context. Reads the queued
+ *                 packets of the context socket, at most budget of them,
+ *                 into the class queues of the context, then relays at
+ *                 most budget packets in class priority order. Packets
+ *                 left queued are relayed in the next round, ahead of
+ *                 the packets of a lower class read then. Once the socket
+ *                 is empty no further round may come, so the queues are
+ *                 then emptied.
+ *                 Receive errors never stop the daemon: transient errors
+ *                 yield to the other sockets, and a socket failing
+ *                 repeatedly or for good is reported as broken.
+ * Parameters    : ctx - VRF context
+ *                 budget - maximum number of packets to read
+ * Return        : true - socket usable
+ *                 false - socket must be re-created
+ */
+bool udp_packet_recv(UDPFWD_VRF_CTX_T *ctx, int budget)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
+    UDPFWD_CLASS_STATS_T *classStats = udpfwd_ctrl_cb_p->classStats;
+    unsigned int depth[UDPFWD_CLASS_MAX];
+    UDPFWD_RX_QUEUE_T *queue;
+    UDPFWD_RX_SLOT_T *slot;
+    enum udpfwd_class class;
     struct msghdr msg;
     struct sockaddr_in dest;
     struct cmsghdr *cmptr; /* pointer to ancillary data structure. */
     struct iovec iov;
     int32_t size;
     uint32_t ifinput = -1;
+    uint32_t drops;
     union packet_info pinfo;
     union control_u ctrl;
     char ifName[IF_NAMESIZE];
-
-    VLOG_INFO("UDP Broadcast packet receiver thread started");
+    bool usable = true, more = true;
+    uint16_t index;
+    uint8_t peek;
+    int quota;
+    uint64_t orig;
 
     pinfo.c = NULL; /*To Supress cmake error */
-    iov.iov_base = (void *) udpfwd_ctrl_cb_p->rcvbuff; /* buffer to store udp packet payload */
     iov.iov_len = RECV_BUFFER_SIZE - 1; /* length of buffer */
-    msg.msg_controllen = sizeof(union control_u); /* ancillary data buffer len */
     msg.msg_control = ctrl.control;  /* ancillary data length */
     msg.msg_name = &dest;
-    msg.msg_namelen = sizeof(dest);
     msg.msg_iov = &iov;
     msg.msg_iovlen = 1;
 
-    assert(udpfwd_ctrl_cb_p->udpSockFd);
+    for (class = 0; class < UDPFWD_CLASS_MAX; class++) {
+        atomic_read_relaxed(&udpfwd_ctrl_cb_p->classDepth[class],
+                            &depth[class]);
+    }
 
-    VLOG_INFO("\nListening for udp packets");
-    while (true)
+    budget = MIN(budget, RELAY_REACTOR_BUDGET);
+    quota = budget;
+    while (0 < budget--)
     {
-        size = recvmsg(udpfwd_ctrl_cb_p->udpSockFd, &msg, 0);
+        /* buffer to store udp packet payload. A slot is always free,
+         * there is one more than the queues can hold. */
+        index = ctx->freeSlots[ctx->n_free - 1];
+        slot = &ctx->slots[index];
+        if (NULL == slot->buff) {
+            slot->buff = xmalloc(RECV_BUFFER_SIZE);
+        }
+        iov.iov_base = slot->buff;
+
+        /* recvmsg updates the lengths, restore them for every packet */
+        msg.msg_controllen = sizeof(union control_u);
+        msg.msg_namelen = sizeof(dest);
+
+        size = recvmsg(ctx->sockFd, &msg, MSG_DONTWAIT);
         if (size < 0) {
-            VLOG_FATAL("Failed to recvmsg :%d, errno:%d", size, errno);
-            return NULL;
+            if (EAGAIN == errno) {
+                more = false;
+                break;
+            }
+
+            switch (udpfwd_recv_classify(errno)) {
+            case UDPFWD_RECV_RETRY:
+                COVERAGE_INC(udpfwd_recv_retry);
+                continue;
+
+            case UDPFWD_RECV_OVERLOAD:
+                COVERAGE_INC(udpfwd_recv_overload);
+                VLOG_WARN_RL(&rl, "Failed to recvmsg in VRF %s, errno : %d",
+                             ctx->name, errno);
+                /* Back off, the socket is reported again after the other
+                 * ready sockets */
+                usable = (++ctx->rxErrors < UDPFWD_RECV_MAX_ERRORS);
+                more = false;
+                break;
+
+            case UDPFWD_RECV_BROKEN:
+            default:
+                COVERAGE_INC(udpfwd_recv_failure);
+                VLOG_ERR_RL(&rl, "Receive socket of VRF %s failed, "
+                            "errno : %d", ctx->name, errno);
+                usable = false;
+                more = false;
+                break;
+            }
+            break;
         }
+        ctx->rxErrors = 0;
 
         if (msg.msg_controllen < sizeof(struct cmsghdr)) {
             continue;
@@ -164,7 +368,12 @@ void * udp_packet_recv(void *args)
             {
               pinfo.c = CMSG_DATA(cmptr);
               ifinput = pinfo.pktInfo->ipi_ifindex;
-              break;
+            }
+            else if (cmptr->cmsg_level == SOL_SOCKET
+                     && cmptr->cmsg_type == SO_RXQ_OVFL)
+            {
+              memcpy(&drops, CMSG_DATA(cmptr), sizeof(drops));
+              udpfwd_vrf_rxq_drops(ctx, drops);
             }
         }
         if (-1 == ifinput)
@@ -177,8 +386,30 @@ void * udp_packet_recv(void *args)
             continue;
         }
 
-        /* process the udp packets */
-        udpfwd_ctrl((void*)msg.msg_iov->iov_base, size, pinfo.pktInfo);
+        /* queue the packet in its class, the slot is reused on a drop */
+        class = udpfwd_classify(slot->buff, size);
+        queue = &ctx->queues[class];
+        if (queue->count >= MIN(depth[class], UDPFWD_CLASS_MAX_DEPTH)) {
+            atomic_add_relaxed(&classStats[class].dropped, 1, &orig);
+            continue;
+        }
+        atomic_add_relaxed(&classStats[class].queued, 1, &orig);
+
+        slot->size = size;
+        slot->pktInfo = *pinfo.pktInfo;
+        ctx->n_free--;
+        queue->slots[(queue->head + queue->count++)
+                     % UDPFWD_CLASS_MAX_DEPTH] = index;
+    }
+
+    /* The socket is re-armed after this round, but is only reported
+     * again if packets are left in it */
+    if (more && (0 > recv(ctx->sockFd, &peek, sizeof(peek),
+                          MSG_PEEK | MSG_DONTWAIT))) {
+        more = false;
     }
-    return NULL;
+
+    /* process the udp packets, highest class first */
+    udpfwd_serve_queues(ctx, more ? quota : INT_MAX);
+    return usable;
 }
@@ -0,0 +1,587 @@
+/*
+ * Copyright (C) 2016 Hewlett Packard Enterprise Development LP
+ * All Rights Reserved.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *   not use this file except in compliance with the License. You may obtain
+ *   a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *   WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *   License for the specific language governing permissions and limitations
+ *   under the License.
+ *
+ * File: udpfwd_vrf.c
+ *
+ */
+
+/*
+ * This file handles the following functionality:
+ * - Per VRF receive contexts, each with its own socket opened in the VRF
+ *   network namespace and registered with the receive reactor.
+ * - Open and close the contexts as VRFs are added and removed.
+ * - Re-create the sockets which failed.
+ * - Size the receive buffers from the drops reported by the kernel.
+ * - Dump the receive contexts through unixctl.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <net/if_arp.h>
+
+#include "coverage.h"
+#include "dynamic-string.h"
+#include "hash.h"
+#include "openswitch-dflt.h"
+#include "seq.h"
+#include "ovs-thread.h"
+#include "poll-loop.h"
+#include "timeval.h"
+#include "unixctl.h"
+#include "util.h"
+#include "relay_common.h"
+#include "relay_netns.h"
+#include "udpfwd_util.h"
+#include "vrf-utils.h"
+
+VLOG_DEFINE_THIS_MODULE(udpfwd_vrf);
+
+COVERAGE_DEFINE(udpfwd_vrf_recreate);
+COVERAGE_DEFINE(udpfwd_rxq_drops);
+COVERAGE_DEFINE(udpfwd_rcvbuf_grow);
+COVERAGE_DEFINE(udpfwd_arp_cache_hit);
+COVERAGE_DEFINE(udpfwd_arp_set);
+
+/* Context served by the calling receive thread */
+DEFINE_STATIC_PER_THREAD_DATA(UDPFWD_VRF_CTX_T *, current_vrf, NULL);
+
+/* vrf_seq value when the contexts were last checked */
+static uint64_t vrf_seqno = 0;
+
+/*
+ * Function      : udpfwd_set_rcvbuf
+ * Responsiblity : Set the receive buffer size of a socket. SO_RCVBUFFORCE
+ *                 overrides the system limit when the daemon is allowed
+ *                 to, SO_RCVBUF is used otherwise.
+ * Parameters    : sock - socket
+ *                 size - buffer size in bytes
+ * Return        : true - on success
+ *                 false - otherwise
+ */
+static bool udpfwd_set_rcvbuf(int sock, uint32_t size)
+{
+    int val = size;
+
+    if (0 == setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &val, sizeof(val)))
+        return true;
+
+    if (0 == setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val)))
+        return true;
+
+    VLOG_ERR("Failed to set receive buffer size %u, errno : %d", size, errno);
+    return false;
+}
+
+/*
+ * Function      : create_udp_socket
+ * Responsiblity : Create the raw socket used to send and receive UDP
+ *                 packets, in a network namespace.
+ * Parameters    : nsFd - namespace, -1 for the daemon namespace
+ * Return        : sockfd, on success
+ *                 -1, on failure
+ */
+static int create_udp_socket(int nsFd)
+{
+    int32_t sock = -1;
+    int32_t val = 1;
+    int retVal = -1;
+
+    VLOG_INFO("Creating UDP send socket");
+
+    /* Create socket to send UDP packets to client or server */
+    sock = relay_netns_socket(nsFd, PF_INET,
+                              SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                              IPPROTO_UDP);
+    if (-1 == sock) {
+        VLOG_ERR("Failed to create UDP socket");
+        return -1;
+    }
+
+    retVal = setsockopt(sock, IPPROTO_IP, IP_PKTINFO,
+                        (char *)&val, sizeof(val));
+    if (0 != retVal) {
+        VLOG_ERR("Failed to set IP_PKTINFO socket option : %d", retVal);
+        close(sock);
+        return -1;
+    }
+
+    retVal = setsockopt(sock, IPPROTO_IP, IP_HDRINCL,
+                        (char *)&val, sizeof(val));
+    if (0 != retVal) {
+        VLOG_ERR("Failed to set IP_HDRINCL socket option : %d", retVal);
+        close(sock);
+        return -1;
+    }
+
+    retVal = setsockopt(sock, SOL_SOCKET, SO_BROADCAST,
+                       (char *)&val, sizeof (val));
+    if (0 != retVal) {
+        VLOG_ERR("Failed to set broadcast socket option : %d", retVal);
+        close(sock);
+        return -1;
+    }
+
+    /* Report the packets dropped on a full receive queue */
+    retVal = setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL,
+                        (char *)&val, sizeof(val));
+    if (0 != retVal) {
+        VLOG_WARN("Failed to set SO_RXQ_OVFL socket option : %d", retVal);
+    }
+
+    VLOG_INFO("UDP send socket created successfully");
+    return sock;
+}
+
+/*
+ * Function      : udpfwd_vrf_handler
+ * Responsiblity : Reactor handler of a VRF context. The reactor thread
+ *                 runs in the VRF namespace, so interface lookups and
+ *                 the relayed packets resolve in that VRF.
+ * Parameters    : aux - VRF context
+ *                 budget - maximum number of packets to read
+ * Return        : true - socket usable
+ *                 false - socket handed to the main thread to re-create
+ */
+static bool udpfwd_vrf_handler(void *aux, int budget)
+{
+    UDPFWD_VRF_CTX_T *ctx = aux;
+    bool usable;
+
+    *current_vrf_get() = ctx;
+    usable = udp_packet_recv(ctx, budget);
+    *current_vrf_get() = NULL;
+
+    if (!usable) {
+        atomic_store(&ctx->broken, true);
+        seq_change(udpfwd_ctrl_cb_p->vrf_seq);
+    }
+    return usable;
+}
+
+/*
+ * Function      : udpfwd_vrf_open
+ * Responsiblity : Open the namespace and socket of a context and register
+ *                 the socket with the reactor. On failure the next attempt
+ *                 is scheduled, further apart after every failure.
+ * Parameters    : ctx - VRF context
+ * Return        : none
+ */
+static void udpfwd_vrf_open(UDPFWD_VRF_CTX_T *ctx)
+{
+    ctx->retryTime = time_msec() + ctx->retryInterval;
+    ctx->retryInterval = MIN(ctx->retryInterval * 2,
+                             UDPFWD_VRF_MAX_RETRY_INTERVAL);
+
+    /* The default VRF lives in the namespace of the daemon */
+    if ((NULL != ctx->nsName)
+        && (-1 == (ctx->nsFd = relay_netns_open(ctx->nsName)))) {
+        return;
+    }
+
+    ctx->sockFd = create_udp_socket(ctx->nsFd);
+    if (-1 == ctx->sockFd) {
+        goto error;
+    }
+
+    /* Drop counts restart with the socket, the namespace may be new */
+    ctx->rxqDrops = 0;
+    memset(ctx->arpCache, 0, sizeof(ctx->arpCache));
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->rcvbufMin, &ctx->rcvbufSize);
+    udpfwd_set_rcvbuf(ctx->sockFd, ctx->rcvbufSize);
+
+    ctx->source.fd = ctx->sockFd;
+    ctx->source.nsFd = ctx->nsFd;
+    ctx->source.cb = udpfwd_vrf_handler;
+    ctx->source.aux = ctx;
+    if (!relay_reactor_add(&ctx->source)) {
+        goto error;
+    }
+
+    ctx->active = true;
+    ctx->rxErrors = 0;
+    VLOG_INFO("Receiving UDP packets in VRF %s", ctx->name);
+    return;
+
+error:
+    if (0 <= ctx->sockFd) {
+        close(ctx->sockFd);
+        ctx->sockFd = -1;
+    }
+    if (0 <= ctx->nsFd) {
+        close(ctx->nsFd);
+        ctx->nsFd = -1;
+    }
+}
+
+/*
+ * Function      : udpfwd_vrf_close
+ * Responsiblity : Unregister a context from the reactor and close its
+ *                 socket and namespace. The context can be opened again.
+ *                 Must not be called with waitSem held.
+ * Parameters    : ctx - VRF context
+ * Return        : none
+ */
+static void udpfwd_vrf_close(UDPFWD_VRF_CTX_T *ctx)
+{
+    if (ctx->active) {
+        relay_reactor_remove(&ctx->source);
+        ctx->active = false;
+    }
+    atomic_store(&ctx->broken, false);
+
+    if (0 <= ctx->sockFd) {
+        close(ctx->sockFd);
+        ctx->sockFd = -1;
+    }
+    if (0 <= ctx->nsFd) {
+        close(ctx->nsFd);
+        ctx->nsFd = -1;
+    }
+}
+
+/*
+ * Function      : udpfwd_vrf_create
+ * Responsiblity : Create the receive context of a VRF and open it
+ * Parameters    : name - VRF name
+ *                 nsName - namespace name of the VRF, NULL for the
+ *                          default VRF
+ * Return        : none
+ */
+static void udpfwd_vrf_create(const char *name, const char *nsName)
+{
+    UDPFWD_VRF_CTX_T *ctx;
+    int iter;
+
+    ctx = xzalloc(sizeof *ctx);
+    ctx->name = xstrdup(name);
+    ctx->nsName = nsName ? xstrdup(nsName) : NULL;
+    ctx->nsFd = -1;
+    ctx->sockFd = -1;
+    for (iter = 0; iter < UDPFWD_RX_SLOTS; iter++) {
+        ctx->freeSlots[iter] = iter;
+    }
+    ctx->n_free = UDPFWD_RX_SLOTS;
+    ctx->retryInterval = UDPFWD_VRF_RETRY_INTERVAL;
+    atomic_init(&ctx->broken, false);
+    shash_add(&udpfwd_ctrl_cb_p->vrfTable,
+              nsName ? nsName : DEFAULT_VRF_NAME, ctx);
+
+    VLOG_INFO("Opening receive context of VRF %s, namespace %s", name,
+              nsName ? nsName : "of the daemon");
+    udpfwd_vrf_open(ctx);
+}
+
+/*
+ * Function      : udpfwd_vrf_destroy
+ * Responsiblity : Close and free the receive context of a VRF
+ * Parameters    : ctx - VRF context
+ * Return        : none
+ */
+static void udpfwd_vrf_destroy(UDPFWD_VRF_CTX_T *ctx)
+{
+    int iter;
+
+    VLOG_INFO("Closing receive context of VRF %s", ctx->name);
+
+    udpfwd_vrf_close(ctx);
+    shash_find_and_delete(&udpfwd_ctrl_cb_p->vrfTable,
+                          ctx->nsName ? ctx->nsName : DEFAULT_VRF_NAME);
+    for (iter = 0; iter < UDPFWD_RX_SLOTS; iter++) {
+        free(ctx->slots[iter].buff);
+    }
+    free(ctx->nsName);
+    free(ctx->name);
+    free(ctx);
+}
+
+/*
+ * Function      : udpfwd_vrf_unixctl_dump
+ * Responsiblity : Dump the receive contexts with their namespace and
+ *                 state
+ * Parameters    : conn - unixctl socket connection
+ *                 argc, argv - function parameters
+ *                 aux - aux connection data
+ * Return        : none
+ */
+static void udpfwd_vrf_unixctl_dump(struct unixctl_conn *conn,
+                   int argc OVS_UNUSED, const char *argv[] OVS_UNUSED,
+                   void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node **nodes;
+    const UDPFWD_VRF_CTX_T *ctx;
+    size_t iter, count;
+
+    count = shash_count(&udpfwd_ctrl_cb_p->vrfTable);
+    nodes = shash_sort(&udpfwd_ctrl_cb_p->vrfTable);
+    for (iter = 0; iter < count; iter++) {
+        ctx = nodes[iter]->data;
+        ds_put_format(&ds, "VRF %s : namespace %s, %s\n", ctx->name,
+                      ctx->nsName ? ctx->nsName : "of the daemon",
+                      ctx->active ? "receiving" : "not receiving");
+    }
+    free(nodes);
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+/*
+ * Function      : udpfwd_vrf_init
+ * Responsiblity : Initialize the VRF table and open the default VRF
+ *                 context, which exists regardless of the configuration.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_vrf_init(void)
+{
+    shash_init(&udpfwd_ctrl_cb_p->vrfTable);
+    udpfwd_ctrl_cb_p->vrf_seq = seq_create();
+    vrf_seqno = seq_read(udpfwd_ctrl_cb_p->vrf_seq);
+    udpfwd_vrf_create(DEFAULT_VRF_NAME, NULL);
+
+    unixctl_command_register("udpfwd/vrfs", "", 0, 0,
+                             udpfwd_vrf_unixctl_dump, NULL);
+}
+
+/*
+ * Function      : udpfwd_vrf_exit
+ * Responsiblity : Close and free all VRF contexts
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_vrf_exit(void)
+{
+    struct shash_node *node, *next;
+
+    SHASH_FOR_EACH_SAFE (node, next, &udpfwd_ctrl_cb_p->vrfTable) {
+        udpfwd_vrf_destroy(node->data);
+    }
+    shash_destroy(&udpfwd_ctrl_cb_p->vrfTable);
+    seq_destroy(udpfwd_ctrl_cb_p->vrf_seq);
+}
+
+/*
+ * Function      : udpfwd_vrf_reconfigure
+ * Responsiblity : Make the VRF contexts match the VRF table. Contexts of
+ *                 removed VRFs are closed, added VRFs get a context. The
+ *                 namespace of a VRF is named after its UUID, contexts
+ *                 are matched by namespace name.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_vrf_reconfigure(void)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    const struct ovsrec_vrf *vrf_row = NULL;
+    struct shash_node *node, *next;
+    struct shash vrfs;
+    char nsName[UUID_LEN + 1];
+
+    shash_init(&vrfs);
+    shash_add(&vrfs, DEFAULT_VRF_NAME, NULL);
+    OVSREC_VRF_FOR_EACH (vrf_row, idl) {
+        if (!strcmp(vrf_row->name, DEFAULT_VRF_NAME))
+            continue;
+
+        if (-1 == get_vrf_ns_from_name(idl, vrf_row->name, nsName)) {
+            VLOG_WARN_RL(&rl, "Failed to get the namespace of VRF %s",
+                         vrf_row->name);
+            continue;
+        }
+        shash_add_once(&vrfs, nsName, vrf_row);
+    }
+
+    SHASH_FOR_EACH_SAFE (node, next, &udpfwd_ctrl_cb_p->vrfTable) {
+        if (NULL == shash_find(&vrfs, node->name)) {
+            udpfwd_vrf_destroy(node->data);
+        }
+    }
+
+    SHASH_FOR_EACH (node, &vrfs) {
+        vrf_row = node->data;
+        if ((NULL != vrf_row)
+            && (NULL == shash_find(&udpfwd_ctrl_cb_p->vrfTable,
+                                   node->name))) {
+            udpfwd_vrf_create(vrf_row->name, node->name);
+        }
+    }
+    shash_destroy(&vrfs);
+}
+
+/*
+ * Function      : udpfwd_vrf_run
+ * Responsiblity : Re-create the sockets reported as failed by the reactor
+ *                 and open again the contexts which failed to set up,
+ *                 typically because the VRF namespace did not exist yet.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_vrf_run(void)
+{
+    UDPFWD_VRF_CTX_T *ctx;
+    struct shash_node *node;
+    bool broken;
+
+    /* Read before the flags, a failure racing with the check wakes up
+     * the next poll_block */
+    vrf_seqno = seq_read(udpfwd_ctrl_cb_p->vrf_seq);
+
+    SHASH_FOR_EACH (node, &udpfwd_ctrl_cb_p->vrfTable) {
+        ctx = node->data;
+
+        atomic_read(&ctx->broken, &broken);
+        if (broken) {
+            VLOG_WARN("Re-creating receive socket of VRF %s", ctx->name);
+            COVERAGE_INC(udpfwd_vrf_recreate);
+            udpfwd_vrf_close(ctx);
+
+            /* A socket which worked for a while is re-created at once, one
+             * failing again soon after is re-created on the backoff timer */
+            if (time_msec() >= ctx->retryTime
+                               + UDPFWD_VRF_MAX_RETRY_INTERVAL) {
+                ctx->retryInterval = UDPFWD_VRF_RETRY_INTERVAL;
+                udpfwd_vrf_open(ctx);
+            }
+        } else if (!ctx->active && (time_msec() >= ctx->retryTime)) {
+            udpfwd_vrf_open(ctx);
+        }
+    }
+}
+
+/*
+ * Function      : udpfwd_vrf_wait
+ * Responsiblity : Wake up when a socket failed, and for the next attempt
+ *                 while a context is not receiving.
+ * Parameters    : none
+ * Return        : none
+ */
+void udpfwd_vrf_wait(void)
+{
+    UDPFWD_VRF_CTX_T *ctx;
+    struct shash_node *node;
+
+    seq_wait(udpfwd_ctrl_cb_p->vrf_seq, vrf_seqno);
+
+    SHASH_FOR_EACH (node, &udpfwd_ctrl_cb_p->vrfTable) {
+        ctx = node->data;
+        if (!ctx->active) {
+            poll_timer_wait_until(ctx->retryTime);
+        }
+    }
+}
+
+/*
+ * Function      : udpfwd_vrf_rxq_drops
+ * Responsiblity : Account the drop count reported with a received packet
+ *                 and grow the receive buffer of the socket while the
+ *                 kernel keeps dropping packets. Called from the reactor
+ *                 handler of the context.
+ * Parameters    : ctx - VRF context
+ *                 count - SO_RXQ_OVFL count, packets dropped since the
+ *                         socket was created
+ * Return        : none
+ */
+void udpfwd_vrf_rxq_drops(UDPFWD_VRF_CTX_T *ctx, uint32_t count)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    uint32_t drops = count - ctx->rxqDrops;
+    unsigned int min_size, max_size;
+    uint32_t size;
+
+    if (0 == drops)
+        return;
+    ctx->rxqDrops = count;
+
+    relay_stats_record_kernel_drops(RELAY_STATS_KIND_UDPFWD, drops);
+    COVERAGE_ADD(udpfwd_rxq_drops, drops);
+
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->rcvbufMin, &min_size);
+    atomic_read_relaxed(&udpfwd_ctrl_cb_p->rcvbufMax, &max_size);
+    size = MIN(MAX((uint64_t)ctx->rcvbufSize * 2, min_size), max_size);
+    if (size <= ctx->rcvbufSize) {
+        VLOG_WARN_RL(&rl, "Kernel dropped %u packets in VRF %s, receive "
+                     "buffer at its maximum of %u", drops, ctx->name,
+                     ctx->rcvbufSize);
+        return;
+    }
+
+    if (udpfwd_set_rcvbuf(ctx->sockFd, size)) {
+        VLOG_INFO_RL(&rl, "Kernel dropped %u packets in VRF %s, receive "
+                     "buffer grown to %u", drops, ctx->name, size);
+        ctx->rcvbufSize = size;
+        COVERAGE_INC(udpfwd_rcvbuf_grow);
+    }
+}
+
+/*
+ * Function      : udpfwd_vrf_set_arp
+ * Responsiblity : Install an ARP entry in the VRF being served by the
+ *                 calling reactor thread, unless the same entry was
+ *                 installed recently.
+ * Parameters    : req - ARP entry, unused bytes zeroed
+ *                 ifIndex - index of req->arp_dev
+ * Return        : none
+ */
+void udpfwd_vrf_set_arp(struct arpreq *req, uint32_t ifIndex)
+{
+    UDPFWD_VRF_CTX_T *ctx = *current_vrf_get();
+    UDPFWD_ARP_CACHE_ENTRY_T *entry;
+    IP_ADDRESS ip;
+    long long int now = time_msec();
+
+    if (NULL == ctx)
+        return;
+
+    ip = ((struct sockaddr_in *)&req->arp_pa)->sin_addr.s_addr;
+    entry = &ctx->arpCache[hash_2words(ifIndex, ip)
+                           & (UDPFWD_ARP_CACHE_SIZE - 1)];
+    if ((now < entry->expires) && (entry->ifIndex == ifIndex)
+        && (entry->ip == ip)
+        && !memcmp(&entry->ha, &req->arp_ha, sizeof(entry->ha))) {
+        COVERAGE_INC(udpfwd_arp_cache_hit);
+        return;
+    }
+
+    COVERAGE_INC(udpfwd_arp_set);
+    if (ioctl(ctx->sockFd, SIOCSARP, req) == -1) {
+        VLOG_ERR("ARP Failed, errno value = %d", errno);
+        entry->expires = 0;
+        return;
+    }
+
+    entry->expires = now + UDPFWD_ARP_CACHE_TTL;
+    entry->ifIndex = ifIndex;
+    entry->ip = ip;
+    entry->ha = req->arp_ha;
+}
+
+/*
+ * Function      : udpfwd_vrf_sock
+ * Responsiblity : Get the socket of the VRF being served by the calling
+ *                 reactor thread. Packets are relayed in the VRF they
+ *                 came from.
+ * Parameters    : none
+ * Return        : sockfd, -1 if called outside of a VRF handler
+ */
+int32_t udpfwd_vrf_sock(void)
+{
+    UDPFWD_VRF_CTX_T *ctx = *current_vrf_get();
+
+    return ctx ? ctx->sockFd : -1;
+}
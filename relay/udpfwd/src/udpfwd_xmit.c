@@ -63,7 +63,9 @@ static bool udpfwd_send_pkt_through_socket(void *pkt,
     iph->ip_dst.s_addr = to->sin_addr.s_addr;
     udph->uh_dport = to->sin_port;
 
-    iph->ip_sum = in_cksum((uint16_t *) pkt, iph->ip_len, 0);
+    /* The checksum covers the header only, ip_len is in network order */
+    iph->ip_sum = 0;
+    iph->ip_sum = in_cksum((uint16_t *) pkt, iph->ip_hl * 4, 0);
     /* FIXME: Add udp checksum calculation function */
     udph->check = 0;
 
@@ -86,9 +88,8 @@ static bool udpfwd_send_pkt_through_socket(void *pkt,
     cmptr->cmsg_level = IPPROTO_IP;
     cmptr->cmsg_type = IP_PKTINFO;
 
-    assert(udpfwd_ctrl_cb_p->udpSockFd);
-
-    if (sendmsg(udpfwd_ctrl_cb_p->udpSockFd, &msg, 0) < 0 )
+    /* Relay through the socket of the VRF the packet came from */
+    if (sendmsg(udpfwd_vrf_sock(), &msg, 0) < 0 )
     {
         VLOG_ERR("errno = %d, sending packet failed", errno);
     }
@@ -123,8 +124,7 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
     char ifName[IF_NAMESIZE + 1];
     struct sockaddr_in to;
     struct shash_node *node;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T **serverArray = NULL;
+    const UDPFWD_SERVER_REF_T *server = NULL;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
 
     ifIndex = pktInfo->ipi_ifindex;
@@ -156,11 +156,10 @@ void udpfwd_forward_packet (void *pkt, uint16_t udp_dport, int32_t size,
     }
 
     intfNode = (UDPFWD_INTERFACE_NODE_T *)node->data;
-    serverArray = intfNode->serverArray;
 
     /* UDP Broadcast Forwarder request to each of the configured server. */
     for(iter = 0; iter < intfNode->addrCount; iter++) {
-        server = serverArray[iter];
+        server = &intfNode->servers[iter];
         if (server->udp_port != udp_dport) {
             continue;
         }
@@ -220,8 +219,7 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
     uint32_t ifIndex = -1;
     struct sockaddr_in to;
     struct shash_node *node;
-    UDPFWD_SERVER_T *server = NULL;
-    UDPFWD_SERVER_T **serverArray = NULL;
+    const UDPFWD_SERVER_REF_T *server = NULL;
     UDPFWD_INTERFACE_NODE_T *intfNode = NULL;
     char ifName[IF_NAMESIZE + 1];
     DHCP_OPTION_82_OPTIONS  option82_info;
@@ -336,11 +334,10 @@ void udpfwd_relay_to_dhcp_server(void* pkt, int32_t size,
 
     /* update value of size */
     size = ntohs(iph->ip_len);
-    serverArray = intfNode->serverArray;
 
     /* Relay DHCP-Request to each of the configured server. */
     for(iter = 0; iter < intfNode->addrCount; iter++) {
-        server = serverArray[iter];
+        server = &intfNode->servers[iter];
         if (server->udp_port != DHCPS_PORT) {
             continue;
         }
@@ -510,13 +507,15 @@ void udpfwd_relay_to_dhcp_client(void* pkt, int32_t size,
             }
         }
 
+        /* Cleared, so that identical entries compare equal */
+        memset(&arp_req, 0, sizeof(arp_req));
         strncpy(arp_req.arp_dev, ifName, IF_NAMESIZE);
         memcpy(&arp_req.arp_pa, &dest, sizeof(struct sockaddr_in));
         arp_req.arp_ha.sa_family = dhcp->htype;
-        memcpy(arp_req.arp_ha.sa_data, dhcp->chaddr, dhcp->hlen);
+        memcpy(arp_req.arp_ha.sa_data, dhcp->chaddr,
+               MIN(dhcp->hlen, sizeof(arp_req.arp_ha.sa_data)));
         arp_req.arp_flags = ATF_COM;
-        if (ioctl(udpfwd_ctrl_cb_p->udpSockFd, SIOCSARP, &arp_req) == -1)
-            VLOG_ERR("ARP Failed, errno value = %d", errno);
+        udpfwd_vrf_set_arp(&arp_req, ifIndex);
     }
 
     pktInfo->ipi_ifindex = ifIndex;